@@ -0,0 +1,84 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_ATOMIC_H
+#define ZCUTILS_ATOMIC_H
+
+namespace zcUtils {
+    // Size of a cache line, used to keep hot atomics written by different threads apart.
+#define ZCUTILS_CACHE_LINE_SIZE 64
+
+    // Hint the cpu that we are spinning.
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+
+    // Full barrier, orders earlier stores against later loads.
+    inline void memoryFence() {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    /*
+     * class Atomic
+     * Wrapper facade for the compiler atomic builtins.
+     * T must be an integral or pointer type whose size the cpu can update lock-free.
+     *
+     * Loads are acquire, stores are release and read-modify-write operations are
+     * sequentially consistent unless the relaxed variants are used.
+     */
+    template<class T>
+    class Atomic {
+    public:
+        Atomic(T value = T()) : m_tValue_(value) {}
+
+        T load() const { return __atomic_load_n(&m_tValue_, __ATOMIC_ACQUIRE); }
+
+        T loadRelaxed() const { return __atomic_load_n(&m_tValue_, __ATOMIC_RELAXED); }
+
+        void store(T value) { __atomic_store_n(&m_tValue_, value, __ATOMIC_RELEASE); }
+
+        void storeRelaxed(T value) { __atomic_store_n(&m_tValue_, value, __ATOMIC_RELAXED); }
+
+        // Replace the value and return the previous one.
+        T exchange(T value) { return __atomic_exchange_n(&m_tValue_, value, __ATOMIC_SEQ_CST); }
+
+        /*
+         * Brief:
+         *     Store desired if the current value equals expected.
+         * return:
+         *     true if the value was replaced, otherwise expected receives the current value.
+         */
+        bool compareExchange(T &expected, T desired) {
+            return __atomic_compare_exchange_n(&m_tValue_, &expected, desired, false,
+                                               __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+        }
+
+        // Add / subtract and return the previous value.
+        T fetchAdd(T delta) { return __atomic_fetch_add(&m_tValue_, delta, __ATOMIC_SEQ_CST); }
+
+        T fetchSub(T delta) { return __atomic_fetch_sub(&m_tValue_, delta, __ATOMIC_SEQ_CST); }
+
+        T fetchAddRelaxed(T delta) { return __atomic_fetch_add(&m_tValue_, delta, __ATOMIC_RELAXED); }
+
+        // Add / subtract and return the new value.
+        T addFetch(T delta) { return __atomic_add_fetch(&m_tValue_, delta, __ATOMIC_SEQ_CST); }
+
+        T subFetch(T delta) { return __atomic_sub_fetch(&m_tValue_, delta, __ATOMIC_SEQ_CST); }
+
+    private:
+        // Don't need copy or assignment
+        Atomic(const Atomic &);
+
+        Atomic &operator=(const Atomic &);
+
+    private:
+        T m_tValue_;
+    };
+}
+
+#endif //ZCUTILS_ATOMIC_H
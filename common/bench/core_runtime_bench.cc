@@ -0,0 +1,174 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+ * Throughput of cross-core message passing, CoreRuntime against a shared locked queue.
+ * Usage: core_runtime_bench [max_cores] [seconds] [tokens]
+ *
+ * Every core starts with `tokens` messages. Handling a message bumps a counter owned by
+ * the handling core and sends a new message to the next core, so every message crosses
+ * a core boundary. The baseline runs the same loop on plain threads sharing one
+ * mutex-guarded queue, the way the services pass work around today.
+ * Each case runs with 1, 2, 4 ... max_cores threads; per-core rates should stay flat
+ * for the runtime while the shared queue flattens out.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+#include "atomic.h"
+#include "core_runtime.h"
+
+static const unsigned int MAX_CORES = 256;
+
+// one counter per core, each on its own cache line and written by its core only.
+struct CoreCounter {
+    unsigned long value;
+    char pad[ZCUTILS_CACHE_LINE_SIZE - sizeof(unsigned long)];
+};
+
+static CoreCounter g_counters[MAX_CORES];
+static zcUtils::Atomic<int> g_stop(0);
+
+static unsigned long nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+static unsigned long sumCounters(unsigned int cores) {
+    unsigned long total = 0;
+    for (unsigned int i = 0; i < cores; ++i)
+        total += g_counters[i].value;
+    return total;
+}
+
+static void resetCounters() {
+    for (unsigned int i = 0; i < MAX_CORES; ++i)
+        g_counters[i].value = 0;
+    g_stop.store(0);
+}
+
+class HopTask : public zcUtils::CoreTask {
+public:
+    void run(zcUtils::CoreContext &core) {
+        ++g_counters[core.coreId()].value;
+        if (g_stop.load())
+            return;
+        zcUtils::CoreRuntime &runtime = core.runtime();
+        runtime.submitTo((core.coreId() + 1) % runtime.coreCount(), new HopTask);
+    }
+};
+
+static unsigned long runRuntime(unsigned int cores, unsigned int seconds, unsigned int tokens) {
+    resetCounters();
+    zcUtils::CoreRuntime runtime;
+    if (!runtime.start(cores, true, 4096)) {
+        printf("failed to start %u cores\n", cores);
+        return 0;
+    }
+    unsigned long start = nowUs();
+    for (unsigned int i = 0; i < cores; ++i) {
+        for (unsigned int n = 0; n < tokens; ++n)
+            runtime.submitTo(i, new HopTask);
+    }
+    sleep(seconds);
+    g_stop.store(1);
+    unsigned long cost = nowUs() - start;
+    runtime.shutdown();
+    return (unsigned long) (sumCounters(cores) * 1000000.0 / cost);
+}
+
+/*
+ * Baseline: the same hops through one std::deque behind a pthread mutex.
+ */
+struct SharedQueue {
+    pthread_mutex_t lock;
+    std::deque<unsigned int *> queue;
+};
+
+struct WorkerArgs {
+    SharedQueue *shared;
+    unsigned int id;
+};
+
+static void *sharedWorker(void *arg) {
+    WorkerArgs *args = (WorkerArgs *) arg;
+    SharedQueue *shared = args->shared;
+    while (!g_stop.load()) {
+        unsigned int *msg = NULL;
+        pthread_mutex_lock(&shared->lock);
+        if (!shared->queue.empty()) {
+            msg = shared->queue.front();
+            shared->queue.pop_front();
+        }
+        pthread_mutex_unlock(&shared->lock);
+        if (NULL == msg) {
+            zcUtils::cpuRelax();
+            continue;
+        }
+        ++g_counters[args->id].value;
+        delete msg;
+        pthread_mutex_lock(&shared->lock);
+        shared->queue.push_back(new unsigned int(args->id));
+        pthread_mutex_unlock(&shared->lock);
+    }
+    return NULL;
+}
+
+static unsigned long runShared(unsigned int cores, unsigned int seconds, unsigned int tokens) {
+    resetCounters();
+    SharedQueue shared;
+    pthread_mutex_init(&shared.lock, NULL);
+    for (unsigned int i = 0; i < cores * tokens; ++i)
+        shared.queue.push_back(new unsigned int(0));
+
+    std::vector<pthread_t> ids(cores);
+    std::vector<WorkerArgs> args(cores);
+    unsigned long start = nowUs();
+    for (unsigned int i = 0; i < cores; ++i) {
+        args[i].shared = &shared;
+        args[i].id = i;
+        pthread_create(&ids[i], NULL, sharedWorker, &args[i]);
+    }
+    sleep(seconds);
+    g_stop.store(1);
+    unsigned long cost = nowUs() - start;
+    for (unsigned int i = 0; i < cores; ++i)
+        pthread_join(ids[i], NULL);
+    for (size_t i = 0; i < shared.queue.size(); ++i)
+        delete shared.queue[i];
+    pthread_mutex_destroy(&shared.lock);
+    return (unsigned long) (sumCounters(cores) * 1000000.0 / cost);
+}
+
+int main(int argc, char **argv) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int max_cores = argc > 1 ? (unsigned int) atoi(argv[1]) : (online > 0 ? (unsigned int) online : 1);
+    unsigned int seconds = argc > 2 ? (unsigned int) atoi(argv[2]) : 2;
+    unsigned int tokens = argc > 3 ? (unsigned int) atoi(argv[3]) : 64;
+    if (0 == max_cores || max_cores > MAX_CORES || 0 == seconds || 0 == tokens) {
+        printf("usage: %s [max_cores] [seconds] [tokens]\n", argv[0]);
+        return 1;
+    }
+    printf("online cpus:%ld seconds:%u tokens per core:%u\n", online, seconds, tokens);
+    printf("%-6s %16s %16s %16s %16s\n", "cores", "runtime msg/s", "per core", "shared msg/s", "per core");
+
+    for (unsigned int cores = 1;; cores *= 2) {
+        if (cores > max_cores)
+            cores = max_cores;
+        unsigned long runtime_rate = runRuntime(cores, seconds, tokens);
+        unsigned long shared_rate = runShared(cores, seconds, tokens);
+        printf("%-6u %16lu %16lu %16lu %16lu\n", cores, runtime_rate, runtime_rate / cores, shared_rate,
+               shared_rate / cores);
+        if (cores == max_cores)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#include "circuit_breaker.h"
+#include "rate_limiter.h"
+
+namespace zcUtils {
+    CircuitBreaker::CircuitBreaker(const Config &config)
+            : m_stConfig_(config), m_nState_(STATE_CLOSED), m_nFailures_(0), m_nOpenUntilNs_(0), m_nTrials_(0),
+              m_nTrialSuccesses_(0), m_nRejected_(0), m_nOpened_(0) {
+        if (0 == m_stConfig_.failure_threshold)
+            m_stConfig_.failure_threshold = 1;
+        if (0 == m_stConfig_.half_open_trials)
+            m_stConfig_.half_open_trials = 1;
+        if (0 == m_stConfig_.success_threshold)
+            m_stConfig_.success_threshold = 1;
+    }
+
+    bool CircuitBreaker::allow() {
+        int state = m_nState_.load();
+        if (STATE_CLOSED == state)
+            return true;
+        if (STATE_OPEN == state) {
+            if (monotonicNanos() < m_nOpenUntilNs_.load()) {
+                m_nRejected_.fetchAdd(1);
+                return false;
+            }
+            // the trial counters were cleared by trip(), nobody touches them while open.
+            m_nState_.compareExchange(state, STATE_HALF_OPEN);
+            state = m_nState_.load();
+            if (STATE_CLOSED == state)
+                return true;
+            if (STATE_OPEN == state) {
+                m_nRejected_.fetchAdd(1);
+                return false;
+            }
+        }
+        if (m_nTrials_.fetchAdd(1) < m_stConfig_.half_open_trials)
+            return true;
+        m_nTrials_.fetchSub(1);
+        m_nRejected_.fetchAdd(1);
+        return false;
+    }
+
+    void CircuitBreaker::onSuccess() {
+        int state = m_nState_.load();
+        if (STATE_CLOSED == state) {
+            if (m_nFailures_.loadRelaxed())
+                m_nFailures_.store(0);
+            return;
+        }
+        if (STATE_HALF_OPEN != state)
+            return;
+        if (m_nTrialSuccesses_.addFetch(1) >= m_stConfig_.success_threshold) {
+            m_nFailures_.store(0);
+            m_nState_.compareExchange(state, STATE_CLOSED);
+            return;
+        }
+        releaseTrial();
+    }
+
+    void CircuitBreaker::onFailure() {
+        int state = m_nState_.load();
+        if (STATE_CLOSED == state) {
+            if (m_nFailures_.addFetch(1) >= m_stConfig_.failure_threshold)
+                trip(STATE_CLOSED);
+        } else if (STATE_HALF_OPEN == state) {
+            trip(STATE_HALF_OPEN);
+        }
+    }
+
+    void CircuitBreaker::cancel() {
+        if (STATE_HALF_OPEN == m_nState_.load())
+            releaseTrial();
+    }
+
+    void CircuitBreaker::releaseTrial() {
+        // let the next probe in.
+        unsigned int trials = m_nTrials_.load();
+        while (trials > 0 && !m_nTrials_.compareExchange(trials, trials - 1));
+    }
+
+    void CircuitBreaker::trip(int from) {
+        m_nOpenUntilNs_.store(monotonicNanos() + (long) m_stConfig_.open_ms * 1000000L);
+        m_nTrials_.store(0);
+        m_nTrialSuccesses_.store(0);
+        if (m_nState_.compareExchange(from, STATE_OPEN))
+            m_nOpened_.fetchAdd(1);
+    }
+
+    void CircuitBreaker::reset() {
+        m_nFailures_.store(0);
+        m_nState_.store(STATE_CLOSED);
+    }
+
+    const char *CircuitBreaker::stateName(STATE state) {
+        switch (state) {
+            case STATE_CLOSED:
+                return "closed";
+            case STATE_OPEN:
+                return "open";
+            case STATE_HALF_OPEN:
+                return "half-open";
+        }
+        return "unknown";
+    }
+}
@@ -0,0 +1,97 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_CIRCUIT_BREAKER_H
+#define ZCUTILS_CIRCUIT_BREAKER_H
+
+#include "atomic.h"
+
+namespace zcUtils {
+    /*
+     * Brief:
+     *     Lock-free circuit breaker in front of a downstream (DB, FreeSWITCH host...).
+     *
+     *     STATE_CLOSED    - calls pass, failure_threshold consecutive failures open the breaker.
+     *     STATE_OPEN      - calls are rejected at once for open_ms.
+     *     STATE_HALF_OPEN - up to half_open_trials calls pass as probes; success_threshold
+     *                       successful probes close the breaker, any failure opens it again.
+     *
+     *     Every call that allow() let through should report its outcome with onSuccess() or
+     *     onFailure(). Failures observed outside of a call (e.g. a background reconnect) may be
+     *     reported with onFailure() too.
+     *
+     * Usage:
+     *     CircuitBreaker breaker(CircuitBreaker::Config(5, 3000));
+     *     if (!breaker.allow()) return ERR_UNAVAILABLE;
+     *     if (call()) breaker.onSuccess(); else breaker.onFailure();
+     */
+    class CircuitBreaker {
+    public:
+        enum STATE {
+            STATE_CLOSED = 0,
+            STATE_OPEN,
+            STATE_HALF_OPEN
+        };
+
+        struct Config {
+            unsigned int failure_threshold; // consecutive failures that open the breaker
+            unsigned long open_ms;          // how long to reject before probing
+            unsigned int half_open_trials;  // probes allowed at the same time
+            unsigned int success_threshold; // successful probes that close the breaker
+
+            Config(unsigned int failure_threshold = 5, unsigned long open_ms = 5000,
+                   unsigned int half_open_trials = 1, unsigned int success_threshold = 1)
+                    : failure_threshold(failure_threshold), open_ms(open_ms),
+                      half_open_trials(half_open_trials), success_threshold(success_threshold) {}
+        };
+
+        explicit CircuitBreaker(const Config &config);
+
+        // May a call go through now, never blocks.
+        bool allow();
+
+        void onSuccess();
+
+        void onFailure();
+
+        // The call allow() let through never reached the downstream, no outcome to report.
+        void cancel();
+
+        // Close the breaker and forget the failures.
+        void reset();
+
+        STATE getState() const { return (STATE) m_nState_.load(); }
+
+        // Calls rejected by allow().
+        unsigned long getRejected() const { return m_nRejected_.load(); }
+
+        // Times the breaker went open.
+        unsigned long getOpened() const { return m_nOpened_.load(); }
+
+        static const char *stateName(STATE state);
+
+    private:
+        // Don't need copy or assignment
+        CircuitBreaker(const CircuitBreaker &);
+
+        CircuitBreaker &operator=(const CircuitBreaker &);
+
+        // Move from `from` to STATE_OPEN.
+        void trip(int from);
+
+        void releaseTrial();
+
+    private:
+        Config m_stConfig_;
+        Atomic<int> m_nState_;
+        Atomic<unsigned int> m_nFailures_;
+        Atomic<long> m_nOpenUntilNs_;
+        Atomic<unsigned int> m_nTrials_;
+        Atomic<unsigned int> m_nTrialSuccesses_;
+        Atomic<unsigned long> m_nRejected_;
+        Atomic<unsigned long> m_nOpened_;
+    };
+}
+
+#endif //ZCUTILS_CIRCUIT_BREAKER_H
@@ -0,0 +1,95 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#include "config_snapshot.h"
+#include "readconfig.h"
+
+#include <stdlib.h>
+#include <strings.h>
+
+namespace zcUtils {
+    // the snapshot returned by ConfigSnapshot::Reader.
+    static RcuPointer<ConfigSnapshot> s_cCurrentSnapshot;
+    // versions handed out to built snapshots.
+    static Atomic<unsigned long> s_nSnapshotVersion(0);
+
+    ConfigSnapshot::ConfigSnapshot() : m_nVersion_(s_nSnapshotVersion.addFetch(1)) {}
+
+    ConfigSnapshot *ConfigSnapshot::build(const Options &options, const std::string &ast_config_file) {
+        if (ast_config_file.empty())
+            return build(options, (const ast_config *) NULL);
+        ast_config *config = ast_config_load(ast_config_file.c_str());
+        if (NULL == config)
+            return NULL;
+        ConfigSnapshot *snapshot = build(options, config);
+        ast_config_destroy(config);
+        return snapshot;
+    }
+
+    ConfigSnapshot *ConfigSnapshot::build(const Options &options, const ast_config *config) {
+        ConfigSnapshot *snapshot = new ConfigSnapshot();
+        snapshot->loadOptions(options);
+        if (config)
+            snapshot->loadAstConfig(config);
+        return snapshot;
+    }
+
+    void ConfigSnapshot::loadOptions(const Options &options) {
+        map<string, string> values;
+        options.getAll(values);
+        m_mapSections_[""].insert(values.begin(), values.end());
+    }
+
+    void ConfigSnapshot::loadAstConfig(const ast_config *config) {
+        for (const ast_category *category = config->root; category; category = category->next) {
+            if (category->ignored)
+                continue;
+            Section &section = m_mapSections_[category->name];
+            for (const ast_variable *variable = category->root; variable; variable = variable->next)
+                section[variable->name] = variable->value ? variable->value : "";
+        }
+    }
+
+    void ConfigSnapshot::publish(ConfigSnapshot *snapshot) {
+        s_cCurrentSnapshot.publish(snapshot);
+    }
+
+    const std::string *ConfigSnapshot::find(const std::string &category, const std::string &name) const {
+        SectionMap::const_iterator section = m_mapSections_.find(category);
+        if (m_mapSections_.end() == section)
+            return NULL;
+        Section::const_iterator it = section->second.find(name);
+        if (section->second.end() == it)
+            return NULL;
+        return &it->second;
+    }
+
+    std::string ConfigSnapshot::getString(const std::string &category, const std::string &name,
+                                          const std::string &default_value) const {
+        const std::string *value = find(category, name);
+        return value ? *value : default_value;
+    }
+
+    long ConfigSnapshot::getLong(const std::string &category, const std::string &name, long default_value) const {
+        const std::string *value = find(category, name);
+        if (NULL == value || value->empty())
+            return default_value;
+        char *end = NULL;
+        long ret = strtol(value->c_str(), &end, 0);
+        return (end && *end == '\0') ? ret : default_value;
+    }
+
+    bool ConfigSnapshot::getBool(const std::string &category, const std::string &name, bool default_value) const {
+        const std::string *value = find(category, name);
+        if (NULL == value)
+            return default_value;
+        if (value->empty())
+            return category.empty(); // a switch option that was found.
+        const char *str = value->c_str();
+        return !(0 == strcasecmp(str, "no") || 0 == strcasecmp(str, "false") ||
+                 0 == strcasecmp(str, "off") || 0 == strcmp(str, "0"));
+    }
+
+    ConfigSnapshot::Reader::Reader() : m_pSnapshot_(s_cCurrentSnapshot.read()) {}
+}
@@ -0,0 +1,115 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_CONFIG_SNAPSHOT_H
+#define ZCUTILS_CONFIG_SNAPSHOT_H
+
+#include "rcu.h"
+#include "options.h"
+
+#include <map>
+#include <string>
+
+struct ast_config;
+
+namespace zcUtils {
+    /*
+     * Brief:
+     *     Immutable copy of the program configuration.
+     *     Built from the Options values (category "") and, optionally, an ast_config file
+     *     (one category per [section]). A snapshot never changes once built; a reload
+     *     builds a new one and publishes it, readers holding the old one keep a consistent view.
+     *
+     *     The current snapshot is read without any lock:
+     *         ConfigSnapshot::Reader config;
+     *         long timeout = config->getLong("db", "timeout", 3);
+     *     Keep the Reader short lived, a publish waits for readers of the old snapshot.
+     */
+    class ConfigSnapshot {
+    public:
+        typedef std::map<std::string, std::string> Section;
+        typedef std::map<std::string, Section> SectionMap;
+
+        /*
+         * Brief:
+         *     Build a snapshot.
+         * Params:
+         *     options - command line / environment / config file options
+         *     ast_config_file - file loaded with ast_config_load, empty to skip
+         * return:
+         *     the new snapshot, or NULL if ast_config_file could not be loaded.
+         */
+        static ConfigSnapshot *build(const Options &options, const std::string &ast_config_file);
+
+        // Build from an already loaded ast_config, the config stays owned by the caller.
+        static ConfigSnapshot *build(const Options &options, const ast_config *config);
+
+        /*
+         * Brief:
+         *     Make snapshot the current one, the previous one is deleted once unused.
+         *     Takes ownership. Must not be called inside a read section.
+         */
+        static void publish(ConfigSnapshot *snapshot);
+
+        // Find a value, NULL if missing. Options are in category "".
+        const std::string *find(const std::string &category, const std::string &name) const;
+
+        std::string getString(const std::string &category, const std::string &name,
+                              const std::string &default_value = "") const;
+
+        long getLong(const std::string &category, const std::string &name, long default_value = 0) const;
+
+        /*
+         * Missing keys give default_value; "", "no", "false", "off" and "0" are false,
+         * except that an Options switch that is present (empty value) is true.
+         */
+        bool getBool(const std::string &category, const std::string &name, bool default_value = false) const;
+
+        const SectionMap &getSections() const { return m_mapSections_; }
+
+        // Increases with every snapshot built.
+        unsigned long getVersion() const { return m_nVersion_; }
+
+        // Scoped access to the current snapshot, wait-free.
+        class Reader {
+        public:
+            Reader();
+
+            // false until a first snapshot was published.
+            bool valid() const { return NULL != m_pSnapshot_; }
+
+            const ConfigSnapshot *operator->() const { return m_pSnapshot_; }
+
+            const ConfigSnapshot &operator*() const { return *m_pSnapshot_; }
+
+        private:
+            // Don't need copy or assignment
+            Reader(const Reader &);
+
+            Reader &operator=(const Reader &);
+
+        private:
+            RcuReadGuard m_cGuard_;
+            const ConfigSnapshot *m_pSnapshot_;
+        };
+
+    private:
+        ConfigSnapshot();
+
+        // Don't need copy or assignment
+        ConfigSnapshot(const ConfigSnapshot &);
+
+        ConfigSnapshot &operator=(const ConfigSnapshot &);
+
+        void loadOptions(const Options &options);
+
+        void loadAstConfig(const ast_config *config);
+
+    private:
+        SectionMap m_mapSections_;
+        unsigned long m_nVersion_;
+    };
+}
+
+#endif //ZCUTILS_CONFIG_SNAPSHOT_H
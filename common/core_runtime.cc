@@ -0,0 +1,338 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#include "core_runtime.h"
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace zcUtils {
+    // max tasks taken from one ring before looking at the others.
+    static const unsigned int MAX_RING_BATCH = 256;
+    // max events handled per reactor iteration.
+    static const int MAX_REACTOR_EVENTS = 64;
+    // idle wait of the reactor, also bounds how late a shutdown is noticed.
+    static const int REACTOR_IDLE_TIMEOUT_MS = 100;
+
+    // the core the current thread runs, NULL for threads outside any runtime.
+    static __thread CoreContext *tls_pCurrentCore = NULL;
+
+    /*
+     * CoreArena
+     */
+    static const size_t ARENA_ALIGN = 16;
+
+    static inline size_t alignUp(size_t size) {
+        return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    }
+
+    CoreArena::CoreArena(size_t chunk_size) : m_pChunk_(NULL), m_nChunkSize_(chunk_size), m_nReserved_(0) {}
+
+    CoreArena::~CoreArena() {
+        while (m_pChunk_) {
+            Chunk *next = m_pChunk_->next;
+            free(m_pChunk_);
+            m_pChunk_ = next;
+        }
+    }
+
+    void *CoreArena::allocate(size_t size) {
+        const size_t header = alignUp(sizeof(Chunk));
+        size = alignUp(size ? size : 1);
+        if (NULL == m_pChunk_ || m_pChunk_->used + size > m_pChunk_->size) {
+            size_t chunk_size = size > m_nChunkSize_ ? size : m_nChunkSize_;
+            Chunk *chunk = static_cast<Chunk *>(malloc(header + chunk_size));
+            if (NULL == chunk)
+                return NULL;
+            chunk->size = chunk_size;
+            chunk->used = 0;
+            chunk->next = m_pChunk_;
+            m_pChunk_ = chunk;
+            m_nReserved_ += header + chunk_size;
+        }
+        void *ptr = reinterpret_cast<char *>(m_pChunk_) + header + m_pChunk_->used;
+        m_pChunk_->used += size;
+        return ptr;
+    }
+
+    void CoreArena::reset() {
+        if (NULL == m_pChunk_)
+            return;
+        // keep the oldest chunk, it's the one of the regular size.
+        Chunk *keep = m_pChunk_;
+        while (keep->next) {
+            Chunk *next = keep->next;
+            m_nReserved_ -= alignUp(sizeof(Chunk)) + keep->size;
+            free(keep);
+            keep = next;
+        }
+        keep->used = 0;
+        m_pChunk_ = keep;
+    }
+
+    /*
+     * CoreContext
+     */
+    CoreContext::CoreContext(CoreRuntime *runtime, unsigned int core_id, unsigned int core_num,
+                             unsigned int ring_size)
+            : m_pRuntime_(runtime), m_nCoreId_(core_id), m_nEpollFd_(-1), m_nWakeFd_(-1),
+              m_nExternalPending_(0), m_nSleeping_(0) {
+        m_nEpollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        m_nWakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_nEpollFd_ >= 0 && m_nWakeFd_ >= 0) {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = NULL;
+            epoll_ctl(m_nEpollFd_, EPOLL_CTL_ADD, m_nWakeFd_, &event);
+        }
+        for (unsigned int i = 0; i < core_num; ++i)
+            m_vecInbox_.push_back(new SpscRing<CoreTask *>(ring_size));
+    }
+
+    CoreContext::~CoreContext() {
+        CoreTask *task = NULL;
+        for (size_t i = 0; i < m_vecInbox_.size(); ++i) {
+            while (m_vecInbox_[i]->pop(task))
+                delete task;
+            delete m_vecInbox_[i];
+        }
+        for (size_t i = 0; i < m_vecExternalInbox_.size(); ++i)
+            delete m_vecExternalInbox_[i];
+        if (m_nWakeFd_ >= 0)
+            close(m_nWakeFd_);
+        if (m_nEpollFd_ >= 0)
+            close(m_nEpollFd_);
+    }
+
+    bool CoreContext::addEvent(int fd, unsigned int events, CoreEventHandler *handler) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.ptr = handler;
+        return 0 == epoll_ctl(m_nEpollFd_, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    bool CoreContext::modifyEvent(int fd, unsigned int events, CoreEventHandler *handler) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.ptr = handler;
+        return 0 == epoll_ctl(m_nEpollFd_, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    bool CoreContext::removeEvent(int fd) {
+        struct epoll_event event;
+        return 0 == epoll_ctl(m_nEpollFd_, EPOLL_CTL_DEL, fd, &event);
+    }
+
+    unsigned int CoreContext::drainInbox() {
+        unsigned int executed = 0;
+        CoreTask *task = NULL;
+        for (size_t i = 0; i < m_vecInbox_.size(); ++i) {
+            for (unsigned int n = 0; n < MAX_RING_BATCH && m_vecInbox_[i]->pop(task); ++n) {
+                task->run(*this);
+                delete task;
+                ++executed;
+            }
+        }
+        if (m_nExternalPending_.load()) {
+            std::vector<CoreTask *> tasks;
+            {
+                MutexLock lock(m_cExternalMutex_);
+                tasks.swap(m_vecExternalInbox_);
+                m_nExternalPending_.store(0);
+            }
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                tasks[i]->run(*this);
+                delete tasks[i];
+                ++executed;
+            }
+        }
+        return executed;
+    }
+
+    bool CoreContext::hasPendingWork() {
+        for (size_t i = 0; i < m_vecInbox_.size(); ++i) {
+            if (!m_vecInbox_[i]->empty())
+                return true;
+        }
+        return 0 != m_nExternalPending_.load();
+    }
+
+    void CoreContext::wakeUp() {
+        // pairs with the fence in CoreRuntime::run(), either we see the core sleeping or it sees our task.
+        memoryFence();
+        if (m_nSleeping_.load() && m_nSleeping_.exchange(0)) {
+            uint64_t one = 1;
+            ssize_t ret = write(m_nWakeFd_, &one, sizeof(one));
+            (void) ret;
+        }
+    }
+
+    /*
+     * CoreRuntime
+     */
+    CoreRuntime::CoreRuntime() : m_nCoreNum_(0), m_nNextCore_(0), m_nRunning_(0), m_nExternalSubmits_(0),
+                                 m_bPin_(true) {}
+
+    CoreRuntime::~CoreRuntime() {
+        shutdown();
+    }
+
+    bool CoreRuntime::start(unsigned int core_num, bool pin, unsigned int ring_size) {
+        if (m_nRunning_.load() || !m_vecCores_.empty())
+            return false;
+        if (0 == core_num) {
+            long online = sysconf(_SC_NPROCESSORS_ONLN);
+            core_num = online > 0 ? (unsigned int) online : 1;
+        }
+        m_bPin_ = pin;
+        m_nNextCore_.store(0);
+        for (unsigned int i = 0; i < core_num; ++i)
+            m_vecCores_.push_back(new CoreContext(this, i, core_num, ring_size));
+        for (unsigned int i = 0; i < core_num; ++i) {
+            if (m_vecCores_[i]->m_nEpollFd_ < 0 || m_vecCores_[i]->m_nWakeFd_ < 0) {
+                releaseCores();
+                return false;
+            }
+        }
+        m_nCoreNum_.store(core_num);
+        m_nRunning_.store(1);
+        if (!Thread::start("core", core_num)) {
+            shutdown();
+            return false;
+        }
+        return true;
+    }
+
+    void CoreRuntime::shutdown() {
+        if (m_vecCores_.empty())
+            return;
+        m_nRunning_.store(0);
+        // pairs with the fence in submitTo(), a submitter either sees the stop or is counted.
+        memoryFence();
+        Thread::stop();
+        for (size_t i = 0; i < m_vecCores_.size(); ++i) {
+            uint64_t one = 1;
+            ssize_t ret = write(m_vecCores_[i]->m_nWakeFd_, &one, sizeof(one));
+            (void) ret;
+        }
+        CoreContext *current = tls_pCurrentCore;
+        if (current && &current->runtime() == this)
+            return;
+        join2(0);
+        // the cores are gone, only submitters from other threads can still touch them.
+        while (m_nExternalSubmits_.load())
+            sched_yield();
+        releaseCores();
+    }
+
+    void CoreRuntime::releaseCores() {
+        m_nCoreNum_.store(0);
+        for (size_t i = 0; i < m_vecCores_.size(); ++i)
+            delete m_vecCores_[i];
+        m_vecCores_.clear();
+    }
+
+    bool CoreRuntime::submitTo(unsigned int core, CoreTask *task) {
+        if (NULL == task)
+            return false;
+        CoreContext *source = tls_pCurrentCore;
+        if (NULL == source || &source->runtime() != this) {
+            // the cores outlive their own submissions, only other threads must hold shutdown() off.
+            m_nExternalSubmits_.fetchAdd(1);
+            memoryFence();
+            bool queued = submitToCore(core, task, NULL);
+            m_nExternalSubmits_.fetchSub(1);
+            return queued;
+        }
+        return submitToCore(core, task, source);
+    }
+
+    bool CoreRuntime::submitToCore(unsigned int core, CoreTask *task, CoreContext *source) {
+        if (!m_nRunning_.load() || core >= m_nCoreNum_.load()) {
+            delete task;
+            return false;
+        }
+        CoreContext *target = m_vecCores_[core];
+        /*
+         * A full ring spills into the external inbox rather than blocking,
+         * two cores waiting on each other's full ring would otherwise deadlock.
+         * Tasks from one producer keep their order unless such a spill happens.
+         */
+        if (NULL == source || !target->m_vecInbox_[source->coreId()]->push(task)) {
+            MutexLock lock(target->m_cExternalMutex_);
+            target->m_vecExternalInbox_.push_back(task);
+            target->m_nExternalPending_.store(1);
+        }
+        if (target != source)
+            target->wakeUp();
+        return true;
+    }
+
+    unsigned int CoreRuntime::shardOf(const std::string &key) const {
+        unsigned int core_num = m_nCoreNum_.load();
+        if (0 == core_num)
+            return 0;
+        // FNV-1a
+        unsigned int hash = 2166136261u;
+        for (size_t i = 0; i < key.size(); ++i) {
+            hash ^= (unsigned char) key[i];
+            hash *= 16777619u;
+        }
+        return hash % core_num;
+    }
+
+    CoreContext *CoreRuntime::currentCore() {
+        return tls_pCurrentCore;
+    }
+
+    int CoreRuntime::run() {
+        unsigned int core_id = m_nNextCore_.fetchAdd(1);
+        if (core_id >= m_vecCores_.size())
+            return -1;
+        CoreContext *core = m_vecCores_[core_id];
+        tls_pCurrentCore = core;
+
+        if (m_bPin_) {
+            long online = sysconf(_SC_NPROCESSORS_ONLN);
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(core_id % (online > 0 ? online : 1), &cpu_set);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        }
+        onCoreStart(*core);
+
+        struct epoll_event events[MAX_REACTOR_EVENTS];
+        while (m_nRunning_.load()) {
+            int timeout = 0;
+            if (0 == core->drainInbox()) {
+                // announce we are about to sleep, then check again for work queued meanwhile.
+                core->m_nSleeping_.exchange(1);
+                memoryFence();
+                if (core->hasPendingWork())
+                    core->m_nSleeping_.store(0);
+                else
+                    timeout = REACTOR_IDLE_TIMEOUT_MS;
+            }
+            int count = epoll_wait(core->m_nEpollFd_, events, MAX_REACTOR_EVENTS, timeout);
+            core->m_nSleeping_.store(0);
+            for (int i = 0; i < count; ++i) {
+                CoreEventHandler *handler = static_cast<CoreEventHandler *>(events[i].data.ptr);
+                if (NULL == handler) {
+                    uint64_t value = 0;
+                    ssize_t ret = read(core->m_nWakeFd_, &value, sizeof(value));
+                    (void) ret;
+                } else
+                    handler->handleEvent(*core, events[i].events);
+            }
+        }
+
+        onCoreStop(*core);
+        tls_pCurrentCore = NULL;
+        return 0;
+    }
+}
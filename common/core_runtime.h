@@ -0,0 +1,247 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_CORE_RUNTIME_H
+#define ZCUTILS_CORE_RUNTIME_H
+
+#include "mutex.h"
+#include "thread.h"
+#include "atomic.h"
+#include "spsc_ring.h"
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+namespace zcUtils {
+    class CoreContext;
+
+    class CoreRuntime;
+
+    /*
+     * Base class for work items executed on a core.
+     * Derived classes implement run(), the task is deleted by the runtime once run() returns.
+     */
+    class CoreTask {
+    public:
+        virtual ~CoreTask() {}
+
+        // Executed on the target core's thread, never concurrently with other work of that core.
+        virtual void run(CoreContext &core) = 0;
+    };
+
+    // Handler for file descriptors registered on a core's reactor.
+    class CoreEventHandler {
+    public:
+        virtual ~CoreEventHandler() {}
+
+        /*
+         * Called on the owning core when the registered fd becomes ready.
+         * events is a mask of EPOLLIN, EPOLLOUT, EPOLLERR...
+         */
+        virtual void handleEvent(CoreContext &core, unsigned int events) = 0;
+    };
+
+    /*
+     * A per-core bump allocator.
+     * Memory is handed out from large chunks and only released by reset() or the dtor,
+     * so it suits state whose lifetime is bound to the core (or to one batch of work).
+     * Not thread-safe: only the owning core may use it.
+     */
+    class CoreArena {
+    public:
+        explicit CoreArena(size_t chunk_size = 64 * 1024);
+
+        ~CoreArena();
+
+        // Allocate size bytes aligned to 16 bytes.
+        void *allocate(size_t size);
+
+        // Release every allocation but keep the first chunk for reuse.
+        void reset();
+
+        // Total bytes currently reserved from the system.
+        size_t reserved() const { return m_nReserved_; }
+
+    private:
+        // Don't need copy or assignment
+        CoreArena(const CoreArena &);
+
+        CoreArena &operator=(const CoreArena &);
+
+    private:
+        struct Chunk {
+            Chunk *next;
+            size_t size;
+            size_t used;
+        };
+
+        Chunk *m_pChunk_;
+        size_t m_nChunkSize_;
+        size_t m_nReserved_;
+    };
+
+    /*
+     * State owned by one core of a CoreRuntime: its reactor, arena and inboxes.
+     * Everything here except the inboxes' producer side is only touched by the owning core.
+     */
+    class CoreContext {
+    public:
+        // Index of this core inside the runtime, in [0, CoreRuntime::coreCount()).
+        unsigned int coreId() const { return m_nCoreId_; }
+
+        CoreRuntime &runtime() { return *m_pRuntime_; }
+
+        CoreArena &arena() { return m_cArena_; }
+
+        /*
+         * Brief:
+         *     Register fd on this core's reactor. Must be called from this core.
+         * Params:
+         *     fd - file descriptor, should be non-blocking
+         *     events - epoll event mask
+         *     handler - invoked on this core when fd is ready, not owned
+         */
+        bool addEvent(int fd, unsigned int events, CoreEventHandler *handler);
+
+        bool modifyEvent(int fd, unsigned int events, CoreEventHandler *handler);
+
+        bool removeEvent(int fd);
+
+    private:
+        friend class CoreRuntime;
+
+        CoreContext(CoreRuntime *runtime, unsigned int core_id, unsigned int core_num, unsigned int ring_size);
+
+        ~CoreContext();
+
+        // Don't need copy or assignment
+        CoreContext(const CoreContext &);
+
+        CoreContext &operator=(const CoreContext &);
+
+        // Run every queued task, return number of tasks executed.
+        unsigned int drainInbox();
+
+        bool hasPendingWork();
+
+        // Wake the core up if it is blocked in epoll_wait.
+        void wakeUp();
+
+    private:
+        CoreRuntime *m_pRuntime_;
+        unsigned int m_nCoreId_;
+        int m_nEpollFd_;
+        int m_nWakeFd_;
+        CoreArena m_cArena_;
+        // m_vecInbox_[i] is written by core i only.
+        std::vector<SpscRing<CoreTask *> *> m_vecInbox_;
+        // Submissions from threads outside the runtime, or overflow of a full ring.
+        Mutex m_cExternalMutex_;
+        std::vector<CoreTask *> m_vecExternalInbox_;
+        Atomic<int> m_nExternalPending_;
+        Atomic<int> m_nSleeping_;
+    };
+
+    /*
+     * Brief:
+     *     Thread-per-core shared-nothing runtime.
+     *     start() launches one Thread per core, each pinned to its cpu and running its own
+     *     reactor (epoll), arena and inbox. Cores talk to each other through SPSC rings,
+     *     one per (source, destination) pair, so the message path is lock-free.
+     *
+     *     State that belongs to one key (e.g. an ESL call sharded by its UUID) should be
+     *     created and only touched on core shardOf(key); other threads hand work over
+     *     with submitTo()/submitToShard() instead of sharing the state behind a mutex.
+     *
+     * Usage:
+     *     CoreRuntime runtime;
+     *     runtime.start();
+     *     runtime.submitToShard(uuid, new HangupTask(uuid));
+     *     ...
+     *     runtime.shutdown();
+     */
+    class CoreRuntime : public Thread {
+    public:
+        CoreRuntime();
+
+        virtual ~CoreRuntime();
+
+        /*
+         * Brief:
+         *     Start the cores.
+         * Params:
+         *     core_num - number of cores, 0 means one per online cpu
+         *     pin - bind each core thread to its cpu
+         *     ring_size - capacity of each core-to-core ring
+         * return:
+         *     true if all cores were started.
+         */
+        bool start(unsigned int core_num = 0, bool pin = true, unsigned int ring_size = 4096);
+
+        /*
+         * Brief:
+         *     Stop all cores and wait for them to exit. Tasks still queued are deleted without running.
+         *     Waits for submitTo() calls from other threads that are still in progress before the
+         *     cores are released.
+         *     A core can't join itself: called from a core thread it only tells the cores to stop,
+         *     a later shutdown() (or the dtor) from outside the runtime joins and releases them.
+         */
+        void shutdown();
+
+        unsigned int coreCount() const { return m_nCoreNum_.load(); }
+
+        /*
+         * Brief:
+         *     Queue task for execution on core, the runtime takes ownership.
+         *     From a core thread this is lock-free; from any other thread it takes the
+         *     target core's external inbox lock.
+         *     Safe to call from any thread at any time, also while shutdown() is running.
+         * return:
+         *     false if core is out of range or the runtime is not running (task is deleted).
+         */
+        bool submitTo(unsigned int core, CoreTask *task);
+
+        // Queue task on the core owning key.
+        bool submitToShard(const std::string &key, CoreTask *task) { return submitTo(shardOf(key), task); }
+
+        // Map a key (e.g. a call UUID) to its owning core.
+        unsigned int shardOf(const std::string &key) const;
+
+        // The core the calling thread belongs to, or NULL if it's not a core thread.
+        static CoreContext *currentCore();
+
+    protected:
+        // Hooks run on each core thread before it enters / after it leaves its loop.
+        virtual void onCoreStart(CoreContext & /*core*/) {}
+
+        virtual void onCoreStop(CoreContext & /*core*/) {}
+
+        virtual int run();
+
+    private:
+        // Don't need copy or assignment
+        CoreRuntime(const CoreRuntime &);
+
+        CoreRuntime &operator=(const CoreRuntime &);
+
+        void releaseCores();
+
+        // submitTo() once the caller is known, source is NULL for threads outside the cores.
+        bool submitToCore(unsigned int core, CoreTask *task, CoreContext *source);
+
+    private:
+        std::vector<CoreContext *> m_vecCores_;
+        // size of m_vecCores_, readable without racing with shutdown().
+        Atomic<unsigned int> m_nCoreNum_;
+        Atomic<unsigned int> m_nNextCore_;
+        Atomic<int> m_nRunning_;
+        // submitTo() calls from threads outside the cores still in progress.
+        Atomic<int> m_nExternalSubmits_;
+        bool m_bPin_;
+    };
+}
+
+#endif //ZCUTILS_CORE_RUNTIME_H
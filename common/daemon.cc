@@ -8,9 +8,11 @@
 #include "filelock.h"
 #include "singleton.h"
 #include "setusergroup.h"
+#include "config_snapshot.h"
 
 #include <fcntl.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -82,6 +84,15 @@ namespace zcUtils {
                         setupLog();
                         setupSignals();
                         if (m_pFileLock_->lock()) {
+                            if (!publishConfig()) {
+                                // don't report success to the parent, it reports our exit code instead
+                                cout << getName() << " daemon: invalid config, not started." << endl;
+                                m_nErrorCode_ = ERR_INITIALISE_FAILED_E;
+                                m_pFileLock_->unlock();
+                                if (m_nStarterPid_ != getpid())
+                                    exit(m_nErrorCode_);
+                                return false;
+                            }
                             if (m_nStarterPid_ != getpid()) // we're running in daemon mode
                                 kill(m_nStarterPid_,
                                      SIGUSR1); // send notifications to parent about successfully initialisation
@@ -110,17 +121,41 @@ namespace zcUtils {
     }
 
     int Daemon::waitForShutdown() {
-        return Signal::instance()->waitSignal(Signal::INFINITE_TIMEOUT);
+        while (true) {
+            int signal_num = Signal::instance()->waitSignal(Signal::INFINITE_TIMEOUT);
+            if (SIGHUP == signal_num && sighupHandler.isSet()) {
+                reload();
+                continue;
+            }
+            return signal_num;
+        }
     }
 
     void Daemon::setupTracing() {}
 
+    /*
+     * Re-read the configuration into a new snapshot and swap it in atomically.
+     * Workers reading through ConfigSnapshot::Reader pick the new values up on their next read,
+     * restart() is still called for the settings the application must re-apply itself.
+     */
     bool Daemon::reload() {
-        bool ret = false;
+        m_cOptions_.reloadOptions();
+        bool ret = publishConfig();
         restart();
         return ret;
     }
 
+    bool Daemon::publishConfig() {
+        ConfigSnapshot *snapshot = ConfigSnapshot::build(m_cOptions_, m_strAstConfigFile_);
+        if (NULL == snapshot) {
+            cout << "Failed to load config file:'" << m_strAstConfigFile_ << "', keep the previous config." << endl;
+            return false;
+        }
+        ConfigSnapshot::publish(snapshot);
+        cout << "Config snapshot " << snapshot->getVersion() << " published." << endl;
+        return true;
+    }
+
     bool Daemon::shutdown() {
         m_pFileLock_->unlock();
         terminate();
@@ -332,4 +367,8 @@ namespace zcUtils {
     void Daemon::addValueOption(char short_name, const string long_name, const string description) {
         m_cOptions_.addValueOption(short_name, long_name, description);
     }
+
+    void Daemon::setAstConfigFile(const string filename) {
+        m_strAstConfigFile_ = filename;
+    }
 }
\ No newline at end of file
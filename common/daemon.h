@@ -53,9 +53,19 @@ namespace zcUtils {
 
         void addValueOption(char short_name, const string long_name, const string description);
 
+        /*
+         * Optional ast_config file (see readconfig.h) merged into the ConfigSnapshot.
+         * The snapshot is published before start() and again on every SIGHUP.
+         */
+        void setAstConfigFile(const string filename);
+
     protected:
+        // Wait for a terminating signal, a SIGHUP triggers reload() and keeps waiting.
         virtual int waitForShutdown();
 
+        // Build a ConfigSnapshot from the current options and publish it.
+        bool publishConfig();
+
         bool printInfo();
 
         bool personalize();
@@ -75,6 +85,7 @@ namespace zcUtils {
         pid_t m_nStarterPid_;
         FileLock *m_pFileLock_;
         string m_strWorkingDir_;
+        string m_strAstConfigFile_;
         DAEMON_ERROR_CODES m_nErrorCode_;
     };
 }
@@ -0,0 +1,138 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_MPMC_QUEUE_H
+#define ZCUTILS_MPMC_QUEUE_H
+
+#include "atomic.h"
+
+namespace zcUtils {
+    /*
+     * A bounded multi-producer multi-consumer queue (Vyukov's array queue).
+     * Any number of threads may push and pop concurrently, none of them ever takes a lock.
+     * Each slot carries a sequence number that tells whether it is ready to be written or read,
+     * so producers and consumers only contend on the tail and head counters respectively.
+     *
+     * The capacity is rounded up to a power of two.
+     */
+    template<class T>
+    class MpmcQueue {
+    public:
+        explicit MpmcQueue(unsigned int capacity = 1024) : m_nHead_(0), m_nTail_(0) {
+            unsigned int size = 2;
+            while (size < capacity)
+                size <<= 1;
+            m_nMask_ = size - 1;
+            m_pCells_ = new Cell[size];
+            for (unsigned int i = 0; i < size; i++)
+                m_pCells_[i].seq.storeRelaxed(i);
+        }
+
+        ~MpmcQueue() { delete[] m_pCells_; }
+
+        // return false if the queue is full.
+        bool push(const T &item) {
+            unsigned long pos = m_nTail_.loadRelaxed();
+            Cell *cell;
+            while (true) {
+                cell = &m_pCells_[pos & m_nMask_];
+                long diff = (long) cell->seq.load() - (long) pos;
+                if (0 == diff) {
+                    if (m_nTail_.compareExchange(pos, pos + 1))
+                        break;
+                } else if (diff < 0)
+                    return false;
+                else
+                    pos = m_nTail_.loadRelaxed();
+            }
+            cell->data = item;
+            cell->seq.store(pos + 1);
+            return true;
+        }
+
+        // return false if the queue is empty.
+        bool pop(T &item) {
+            unsigned long pos = m_nHead_.loadRelaxed();
+            Cell *cell;
+            while (true) {
+                cell = &m_pCells_[pos & m_nMask_];
+                long diff = (long) cell->seq.load() - (long) (pos + 1);
+                if (0 == diff) {
+                    if (m_nHead_.compareExchange(pos, pos + 1))
+                        break;
+                } else if (diff < 0)
+                    return false;
+                else
+                    pos = m_nHead_.loadRelaxed();
+            }
+            item = cell->data;
+            cell->seq.store(pos + m_nMask_ + 1);
+            return true;
+        }
+
+        /*
+         * Brief:
+         *     Take up to max items with a single claim on the head counter.
+         *     Only the run of slots that are already filled is claimed, so a slow producer
+         *     in the middle of the queue limits the batch but never blocks it.
+         * return:
+         *     the number of items stored in items.
+         */
+        unsigned int popBatch(T *items, unsigned int max) {
+            unsigned long pos = m_nHead_.loadRelaxed();
+            unsigned int count;
+            while (true) {
+                count = 0;
+                while (count < max && count <= m_nMask_ &&
+                       m_pCells_[(pos + count) & m_nMask_].seq.load() == pos + count + 1)
+                    ++count;
+                if (0 == count) {
+                    // another consumer has moved the head past pos
+                    long diff = (long) m_pCells_[pos & m_nMask_].seq.load() - (long) (pos + 1);
+                    if (diff < 0)
+                        return 0;
+                    pos = m_nHead_.loadRelaxed();
+                    continue;
+                }
+                if (m_nHead_.compareExchange(pos, pos + count))
+                    break;
+            }
+            for (unsigned int i = 0; i < count; i++) {
+                Cell *cell = &m_pCells_[(pos + i) & m_nMask_];
+                items[i] = cell->data;
+                cell->seq.store(pos + i + m_nMask_ + 1);
+            }
+            return count;
+        }
+
+        // Approximate, may be called from any thread.
+        bool empty() const { return m_nHead_.load() >= m_nTail_.load(); }
+
+        unsigned int capacity() const { return m_nMask_ + 1; }
+
+    private:
+        struct Cell {
+            Atomic<unsigned long> seq;
+            T data;
+        };
+
+        // Don't need copy or assignment
+        MpmcQueue(const MpmcQueue &);
+
+        MpmcQueue &operator=(const MpmcQueue &);
+
+    private:
+        Cell *m_pCells_;
+        unsigned long m_nMask_;
+        // consumers' counter
+        char m_szPad0_[ZCUTILS_CACHE_LINE_SIZE];
+        Atomic<unsigned long> m_nHead_;
+        // producers' counter
+        char m_szPad1_[ZCUTILS_CACHE_LINE_SIZE];
+        Atomic<unsigned long> m_nTail_;
+        char m_szPad2_[ZCUTILS_CACHE_LINE_SIZE];
+    };
+}
+
+#endif //ZCUTILS_MPMC_QUEUE_H
@@ -45,13 +45,15 @@ namespace zcUtils {
             string description; // a short description of this option
             string value; // receives the argument's value
             bool found; // true, if this option is present
+            bool from_command_line; // true, if the value came from the command line
 
             Option(char short_name, const string &long_name, bool has_argument, string description)
                     : short_name(short_name),
                       long_name(long_name),
                       has_argument(has_argument),
                       description(description),
-                      found(false) {}
+                      found(false),
+                      from_command_line(false) {}
         };
 
         // ctor. default only
@@ -173,6 +175,7 @@ namespace zcUtils {
                     o = find(option_array[option_index].name);
                 if (o) {
                     o->found = true;
+                    o->from_command_line = true;
                     if (o->has_argument)
                         o->value = optarg ? optarg : "null";
                 }
@@ -182,6 +185,24 @@ namespace zcUtils {
             return ::optind;
         }
 
+        /*
+         * Re-read the config file and the environment variables, used when reloading.
+         * Options given on the command line keep their value, the others are rebuilt.
+         */
+        int reloadOptions() {
+            // start from scratch, so options removed from the file or the environment are dropped
+            for (vector<Option *>::const_iterator it = m_vecOptions_.begin(); m_vecOptions_.end() != it; ++it) {
+                Option *option = *it;
+                if (!option->from_command_line) {
+                    option->found = false;
+                    option->value.clear();
+                }
+            }
+            int ret = readConfigFileOptions();
+            ret += readEnvironmentOptions();
+            return ret;
+        }
+
         // Prints all options in a format suitable for help screens.
         friend ostream &operator<<(ostream &s, const Options *o);
 
@@ -232,7 +253,7 @@ namespace zcUtils {
             for (vector<Option *>::const_iterator it = m_vecOptions_.begin(); m_vecOptions_.end() != it; ++it) {
                 Option *option = *it;
                 char *opt = ::getenv(option->long_name.c_str());
-                if (opt) {
+                if (opt && !option->from_command_line) {
                     ret++;
                     if (option->has_argument) {
                         option->found = true;
@@ -250,7 +271,7 @@ namespace zcUtils {
             int ret = 0;
             if (m_strConfigFile_.length()) {
                 FILE *fh = NULL;
-                if ((fh = ::fopen(m_strConfigFile_.c_str(), "r")) > 0) {
+                if ((fh = ::fopen(m_strConfigFile_.c_str(), "r")) != NULL) {
                     char *line = NULL;
                     size_t len = 0;
                     ssize_t read_length = 0;
@@ -284,7 +305,7 @@ namespace zcUtils {
                                 *tmp = '\0';
 
                             Option *option = find(name);
-                            if (option) {
+                            if (option && !option->from_command_line) {
                                 ret++;
                                 if (option->has_argument) {
                                     option->found = true;
@@ -0,0 +1,206 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#include "rate_limiter.h"
+
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+
+namespace zcUtils {
+    // waiters of a ConcurrencyLimiter re-check at least this often, in case a wake-up got lost.
+    static const unsigned long MAX_SLOT_WAIT_SLICE_MS = 10;
+    // samples after which the gradient limiter forgets its min latency.
+    static const unsigned int MIN_LATENCY_WINDOW = 1000;
+    // longest interval between two permits of a TokenBucket, one day.
+    static const double MAX_TOKEN_INTERVAL_NS = 86400e9;
+
+    long monotonicNanos() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000000L + now.tv_nsec;
+    }
+
+    static void sleepNanos(long ns) {
+        if (ns <= 0)
+            return;
+        struct timespec req;
+        req.tv_sec = ns / 1000000000L;
+        req.tv_nsec = ns % 1000000000L;
+        while (-1 == nanosleep(&req, &req));
+    }
+
+    /*
+     * TokenBucket
+     */
+    TokenBucket::TokenBucket(const Config &config)
+            : m_nNextFreeNs_(0), m_nIntervalNs_(0), m_nBurst_(config.burst ? config.burst : 1) {
+        setRate(config.rate);
+    }
+
+    void TokenBucket::setRate(double rate) {
+        if (rate <= 0) {
+            m_nIntervalNs_.store(0);
+            return;
+        }
+        // slower than one permit a day is clamped, it keeps interval * permits far from overflowing.
+        double interval = 1e9 / rate;
+        if (interval > MAX_TOKEN_INTERVAL_NS)
+            interval = MAX_TOKEN_INTERVAL_NS;
+        m_nIntervalNs_.store(interval >= 1 ? (long) interval : 1);
+    }
+
+    long TokenBucket::reserve(unsigned int permits, long max_wait_ns) {
+        long interval = m_nIntervalNs_.load();
+        // unlimited, nothing to schedule.
+        if (0 == interval)
+            return 0;
+        long next_free = m_nNextFreeNs_.load();
+        while (true) {
+            long now = monotonicNanos();
+            long new_next_free = (next_free > now ? next_free : now) + interval * (long) permits;
+            // the bucket holds m_nBurst_ permits, we may run ahead of the schedule by that much.
+            long wait = new_next_free - interval * (long) m_nBurst_ - now;
+            if (wait > max_wait_ns)
+                return -1;
+            if (m_nNextFreeNs_.compareExchange(next_free, new_next_free))
+                return wait > 0 ? wait : 0;
+        }
+    }
+
+    bool TokenBucket::tryAcquire(unsigned int permits) {
+        return reserve(permits, 0) >= 0;
+    }
+
+    bool TokenBucket::tryAcquire(unsigned int permits, unsigned long ms) {
+        long wait = reserve(permits, (long) ms * 1000000L);
+        if (wait < 0)
+            return false;
+        sleepNanos(wait);
+        return true;
+    }
+
+    void TokenBucket::acquire(unsigned int permits) {
+        sleepNanos(reserve(permits, LONG_MAX));
+    }
+
+    /*
+     * ConcurrencyLimiter
+     */
+    ConcurrencyLimiter::ConcurrencyLimiter(const Config &config)
+            : m_stConfig_(config), m_nLimit_(0), m_nInFlight_(0), m_nWaiters_(0), m_nSuccessCount_(0),
+              m_nMinLatencyUs_(0) {
+        if (m_stConfig_.min_limit < 1)
+            m_stConfig_.min_limit = 1;
+        if (m_stConfig_.max_limit < m_stConfig_.min_limit)
+            m_stConfig_.max_limit = m_stConfig_.min_limit;
+        setLimit(config.initial_limit);
+    }
+
+    bool ConcurrencyLimiter::tryAcquire() {
+        unsigned int in_flight = m_nInFlight_.load();
+        while (in_flight < m_nLimit_.load()) {
+            if (m_nInFlight_.compareExchange(in_flight, in_flight + 1))
+                return true;
+        }
+        return false;
+    }
+
+    bool ConcurrencyLimiter::tryAcquire(unsigned long ms) {
+        if (tryAcquire())
+            return true;
+        if (0 == ms)
+            return false;
+        long deadline = monotonicNanos() + (long) ms * 1000000L;
+        bool acquired = false;
+        m_nWaiters_.fetchAdd(1);
+        while (!(acquired = tryAcquire())) {
+            long remaining_ms = (deadline - monotonicNanos()) / 1000000L;
+            if (remaining_ms <= 0)
+                break;
+            m_cSemSlotFreed_.tryWait((unsigned long) remaining_ms < MAX_SLOT_WAIT_SLICE_MS ?
+                                     (unsigned long) remaining_ms : MAX_SLOT_WAIT_SLICE_MS);
+        }
+        m_nWaiters_.fetchSub(1);
+        return acquired;
+    }
+
+    void ConcurrencyLimiter::acquire() {
+        while (!tryAcquire(1000UL));
+    }
+
+    void ConcurrencyLimiter::release(bool success, unsigned long latency_us) {
+        m_nInFlight_.fetchSub(1);
+        adjustLimit(success, latency_us);
+        if (m_nWaiters_.load())
+            m_cSemSlotFreed_.post();
+    }
+
+    void ConcurrencyLimiter::setLimit(unsigned int limit) {
+        if (limit < m_stConfig_.min_limit)
+            limit = m_stConfig_.min_limit;
+        if (limit > m_stConfig_.max_limit)
+            limit = m_stConfig_.max_limit;
+        m_nLimit_.store(limit);
+    }
+
+    void ConcurrencyLimiter::adjustLimit(bool success, unsigned long latency_us) {
+        unsigned int limit = m_nLimit_.load();
+        switch (m_stConfig_.mode) {
+            case LIMIT_AIMD:
+                if (!success || (m_stConfig_.latency_threshold_us && latency_us > m_stConfig_.latency_threshold_us))
+                    setLimit((unsigned int) (limit * m_stConfig_.backoff_ratio));
+                else if (m_nSuccessCount_.addFetch(1) >= limit) {
+                    // one more slot per "round trip" of the whole window.
+                    m_nSuccessCount_.store(0);
+                    setLimit(limit + 1);
+                }
+                break;
+            case LIMIT_GRADIENT: {
+                if (!success) {
+                    setLimit((unsigned int) (limit * m_stConfig_.backoff_ratio));
+                    break;
+                }
+                if (0 == latency_us)
+                    break;
+                unsigned long min_latency = m_nMinLatencyUs_.load();
+                if (0 == m_nSuccessCount_.addFetch(1) % MIN_LATENCY_WINDOW)
+                    m_nMinLatencyUs_.store(min_latency = latency_us);
+                while ((0 == min_latency || latency_us < min_latency) &&
+                       !m_nMinLatencyUs_.compareExchange(min_latency, latency_us));
+                if (0 == min_latency || latency_us < min_latency)
+                    min_latency = latency_us;
+                double gradient = (double) min_latency / (double) latency_us;
+                if (gradient < 0.5)
+                    gradient = 0.5;
+                double target = limit * gradient + sqrt((double) limit);
+                // smooth so one outlier doesn't halve the limit.
+                setLimit((unsigned int) (0.8 * limit + 0.2 * target + 0.5));
+                break;
+            }
+            case LIMIT_FIXED:
+            default:
+                break;
+        }
+        if (m_nLimit_.load() > limit && m_nWaiters_.load())
+            m_cSemSlotFreed_.post();
+    }
+
+    /*
+     * ConcurrencyPermit
+     */
+    ConcurrencyPermit::ConcurrencyPermit(ConcurrencyLimiter &limiter, unsigned long ms)
+            : m_cLimiter_(limiter), m_bAcquired_(false), m_nStartNs_(0) {
+        m_bAcquired_ = ms ? m_cLimiter_.tryAcquire(ms) : m_cLimiter_.tryAcquire();
+        if (m_bAcquired_)
+            m_nStartNs_ = monotonicNanos();
+    }
+
+    void ConcurrencyPermit::release(bool success) {
+        if (!m_bAcquired_)
+            return;
+        m_bAcquired_ = false;
+        m_cLimiter_.release(success, (unsigned long) (monotonicNanos() - m_nStartNs_) / 1000UL);
+    }
+}
@@ -0,0 +1,237 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_RATE_LIMITER_H
+#define ZCUTILS_RATE_LIMITER_H
+
+#include "sem.h"
+#include "mutex.h"
+#include "atomic.h"
+
+#include <map>
+#include <string>
+
+namespace zcUtils {
+    /*
+     * Brief:
+     *     Lock-free token bucket.
+     *     Implemented as a virtual scheduler: the bucket only keeps the time at which the
+     *     next permit becomes free, every acquire moves it forward by one interval with a CAS.
+     *     Up to `burst` permits may be taken back to back after an idle period.
+     *
+     * Usage:
+     *     TokenBucket bucket(TokenBucket::Config(200, 20)); // 200/s, bursts of 20
+     *     if (bucket.tryAcquire()) conn->api("status");
+     */
+    class TokenBucket {
+    public:
+        struct Config {
+            double rate;        // permits per second
+            unsigned int burst; // permits that may be taken at once after idling
+
+            Config(double rate = 100.0, unsigned int burst = 1) : rate(rate), burst(burst) {}
+        };
+
+        explicit TokenBucket(const Config &config);
+
+        // Take permits if available now, never blocks.
+        bool tryAcquire(unsigned int permits = 1);
+
+        /*
+         * Brief:
+         *     Take permits, waiting at most ms milliseconds for them.
+         *     Gives up immediately (without consuming anything) if the permits can't be
+         *     available within ms.
+         */
+        bool tryAcquire(unsigned int permits, unsigned long ms);
+
+        // Take permits, block as long as needed.
+        void acquire(unsigned int permits = 1);
+
+        // Change the rate at runtime, takes effect for the next acquire. rate <= 0 means unlimited.
+        void setRate(double rate);
+
+        // 0 when unlimited.
+        double getRate() const {
+            long interval = m_nIntervalNs_.load();
+            return interval > 0 ? 1e9 / (double) interval : 0;
+        }
+
+    private:
+        // Don't need copy or assignment
+        TokenBucket(const TokenBucket &);
+
+        TokenBucket &operator=(const TokenBucket &);
+
+        // Reserve permits, return nanoseconds to wait or -1 if that exceeds max_wait_ns.
+        long reserve(unsigned int permits, long max_wait_ns);
+
+    private:
+        Atomic<long> m_nNextFreeNs_;
+        // 0 when unlimited.
+        Atomic<long> m_nIntervalNs_;
+        unsigned int m_nBurst_;
+    };
+
+    /*
+     * Brief:
+     *     Lock-free concurrency limiter with an optional adaptive limit.
+     *     Callers take a slot before talking to a downstream and give it back with the
+     *     observed latency; in the adaptive modes the limit follows the downstream capacity:
+     *
+     *     LIMIT_FIXED    - the limit never changes.
+     *     LIMIT_AIMD     - +1 per `limit` good completions, multiplied by backoff_ratio on a
+     *                      failure or a completion slower than latency_threshold_us.
+     *     LIMIT_GRADIENT - limit = limit * min_latency / latency + sqrt(limit), i.e. it shrinks
+     *                      as soon as queueing makes latency drift above the best seen.
+     *
+     * Usage:
+     *     ConcurrencyPermit permit(limiter, 50);
+     *     if (permit.acquired()) { ...; permit.release(true); }
+     */
+    class ConcurrencyLimiter {
+    public:
+        enum LIMIT_MODE {
+            LIMIT_FIXED = 0,
+            LIMIT_AIMD,
+            LIMIT_GRADIENT
+        };
+
+        struct Config {
+            LIMIT_MODE mode;
+            unsigned int initial_limit;
+            unsigned int min_limit;
+            unsigned int max_limit;
+            double backoff_ratio;               // AIMD decrease factor
+            unsigned long latency_threshold_us; // AIMD, 0 to react on failures only
+
+            Config(LIMIT_MODE mode = LIMIT_FIXED, unsigned int initial_limit = 16, unsigned int min_limit = 1,
+                   unsigned int max_limit = 1024)
+                    : mode(mode), initial_limit(initial_limit), min_limit(min_limit), max_limit(max_limit),
+                      backoff_ratio(0.9), latency_threshold_us(0) {}
+        };
+
+        explicit ConcurrencyLimiter(const Config &config);
+
+        // Take a slot if one is free now.
+        bool tryAcquire();
+
+        // Take a slot, waiting at most ms milliseconds.
+        bool tryAcquire(unsigned long ms);
+
+        // Take a slot, block as long as needed.
+        void acquire();
+
+        /*
+         * Brief:
+         *     Give back a slot.
+         * Params:
+         *     success - false for errors/timeouts of the downstream, they shrink an adaptive limit
+         *     latency_us - how long the slot was held, 0 if unknown
+         */
+        void release(bool success = true, unsigned long latency_us = 0);
+
+        unsigned int getLimit() const { return m_nLimit_.load(); }
+
+        unsigned int getInFlight() const { return m_nInFlight_.load(); }
+
+    private:
+        // Don't need copy or assignment
+        ConcurrencyLimiter(const ConcurrencyLimiter &);
+
+        ConcurrencyLimiter &operator=(const ConcurrencyLimiter &);
+
+        void adjustLimit(bool success, unsigned long latency_us);
+
+        void setLimit(unsigned int limit);
+
+    private:
+        Config m_stConfig_;
+        Atomic<unsigned int> m_nLimit_;
+        Atomic<unsigned int> m_nInFlight_;
+        Atomic<unsigned int> m_nWaiters_;
+        Atomic<unsigned int> m_nSuccessCount_;
+        Atomic<unsigned long> m_nMinLatencyUs_;
+        Semaphore m_cSemSlotFreed_;
+    };
+
+    /*
+     * Scoped slot of a ConcurrencyLimiter.
+     * The slot is released as a success when the permit goes out of scope, unless release()
+     * was called to report the real outcome.
+     */
+    class ConcurrencyPermit {
+    public:
+        // ms - max wait, 0 to only try once
+        ConcurrencyPermit(ConcurrencyLimiter &limiter, unsigned long ms = 0);
+
+        ~ConcurrencyPermit() { release(true); }
+
+        bool acquired() const { return m_bAcquired_; }
+
+        void release(bool success);
+
+    private:
+        // Don't need copy or assignment
+        ConcurrencyPermit(const ConcurrencyPermit &);
+
+        ConcurrencyPermit &operator=(const ConcurrencyPermit &);
+
+    private:
+        ConcurrencyLimiter &m_cLimiter_;
+        bool m_bAcquired_;
+        long m_nStartNs_;
+    };
+
+    /*
+     * Brief:
+     *     One limiter instance per key (e.g. per FreeSWITCH host or DB endpoint).
+     *     Instances are created on first use with the shared config and live as long as this object.
+     *     T is TokenBucket or ConcurrencyLimiter.
+     */
+    template<class T>
+    class KeyedLimiter {
+    public:
+        explicit KeyedLimiter(const typename T::Config &config) : m_stConfig_(config) {}
+
+        ~KeyedLimiter() {
+            for (typename std::map<std::string, T *>::iterator it = m_mapLimiters_.begin();
+                 m_mapLimiters_.end() != it; ++it)
+                delete it->second;
+        }
+
+        // Get (or create) the limiter for key.
+        T &get(const std::string &key) {
+            {
+                MutexReadLock lock(m_cMutex_);
+                typename std::map<std::string, T *>::iterator it = m_mapLimiters_.find(key);
+                if (m_mapLimiters_.end() != it)
+                    return *it->second;
+            }
+            MutexLock lock(m_cMutex_);
+            typename std::map<std::string, T *>::iterator it = m_mapLimiters_.find(key);
+            if (m_mapLimiters_.end() != it)
+                return *it->second;
+            T *limiter = new T(m_stConfig_);
+            m_mapLimiters_.insert(std::make_pair(key, limiter));
+            return *limiter;
+        }
+
+    private:
+        // Don't need copy or assignment
+        KeyedLimiter(const KeyedLimiter &);
+
+        KeyedLimiter &operator=(const KeyedLimiter &);
+
+    private:
+        typename T::Config m_stConfig_;
+        Mutex m_cMutex_;
+        std::map<std::string, T *> m_mapLimiters_;
+    };
+
+    // Monotonic clock in nanoseconds, used by the limiters.
+    long monotonicNanos();
+}
+
+#endif //ZCUTILS_RATE_LIMITER_H
@@ -0,0 +1,91 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#include "rcu.h"
+
+#include <sched.h>
+#include <pthread.h>
+
+namespace zcUtils {
+    // slot of the current thread: -2 not registered yet, -1 overflow.
+    static __thread int tls_nRcuSlot = -2;
+    // nesting depth of read sections of the current thread.
+    static __thread int tls_nRcuDepth = 0;
+    // gives the slot back when the thread exits.
+    static pthread_key_t s_stRcuSlotKey;
+
+    RcuDomain &RcuDomain::instance() {
+        static RcuDomain domain;
+        return domain;
+    }
+
+    RcuDomain::RcuDomain() : m_nSlotHighWater_(0), m_nEpoch_(1), m_nOverflowReaders_(0) {
+        pthread_key_create(&s_stRcuSlotKey, unregisterThread);
+    }
+
+    int RcuDomain::registerThread() {
+        for (int i = 0; i < MAX_READERS; ++i) {
+            int unused = 0;
+            if (m_stSlots_[i].used.loadRelaxed() || !m_stSlots_[i].used.compareExchange(unused, 1))
+                continue;
+            int high_water = m_nSlotHighWater_.load();
+            while (high_water < i + 1 && !m_nSlotHighWater_.compareExchange(high_water, i + 1));
+            // store slot + 1, a NULL value would not trigger the destructor.
+            pthread_setspecific(s_stRcuSlotKey, reinterpret_cast<void *>((long) i + 1));
+            return i;
+        }
+        return -1;
+    }
+
+    void RcuDomain::unregisterThread(void *slot) {
+        long index = reinterpret_cast<long>(slot) - 1;
+        if (index < 0 || index >= MAX_READERS)
+            return;
+        RcuDomain &domain = instance();
+        domain.m_stSlots_[index].epoch.store(0);
+        domain.m_stSlots_[index].used.store(0);
+    }
+
+    void RcuDomain::readLock() {
+        if (tls_nRcuDepth++ > 0)
+            return;
+        if (-2 == tls_nRcuSlot)
+            tls_nRcuSlot = registerThread();
+        if (tls_nRcuSlot >= 0) {
+            m_stSlots_[tls_nRcuSlot].epoch.store(m_nEpoch_.load());
+            // the epoch must be visible before we load any protected pointer.
+            memoryFence();
+        } else
+            m_nOverflowReaders_.fetchAdd(1);
+    }
+
+    void RcuDomain::readUnlock() {
+        if (--tls_nRcuDepth > 0)
+            return;
+        if (tls_nRcuSlot >= 0)
+            m_stSlots_[tls_nRcuSlot].epoch.store(0);
+        else
+            m_nOverflowReaders_.fetchSub(1);
+    }
+
+    /*
+     * Readers that entered before the epoch moved announced an older epoch (or none yet,
+     * then they will load the new pointer), so waiting for those to leave is enough.
+     * Must not be called from inside a read section.
+     */
+    void RcuDomain::synchronize() {
+        unsigned long target = m_nEpoch_.addFetch(1);
+        int high_water = m_nSlotHighWater_.load();
+        for (int i = 0; i < high_water; ++i) {
+            while (true) {
+                unsigned long epoch = m_stSlots_[i].epoch.load();
+                if (0 == epoch || epoch >= target)
+                    break;
+                sched_yield();
+            }
+        }
+        while (m_nOverflowReaders_.load() > 0)
+            sched_yield();
+    }
+}
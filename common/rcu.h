@@ -0,0 +1,119 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_RCU_H
+#define ZCUTILS_RCU_H
+
+#include "atomic.h"
+
+#include <stddef.h>
+
+namespace zcUtils {
+    /*
+     * Brief:
+     *     Epoch based read-copy-update, process wide.
+     *     Readers announce the epoch they entered in a slot of their own, which costs two
+     *     stores and a fence and never waits. Writers swap the protected pointer, advance the
+     *     epoch and wait until no reader is left in an older epoch before freeing the old object.
+     *
+     *     Each thread takes a slot on its first read section and gives it back when it exits.
+     *     Should all MAX_READERS slots be taken, further threads share an overflow counter:
+     *     still correct, only their writers may wait a little longer.
+     */
+    class RcuDomain {
+    public:
+        static const int MAX_READERS = 1024;
+
+        static RcuDomain &instance();
+
+        // Enter / leave a read section, may be nested.
+        void readLock();
+
+        void readUnlock();
+
+        // Wait until every read section started before this call has ended.
+        void synchronize();
+
+    private:
+        RcuDomain();
+
+        // Don't need copy or assignment
+        RcuDomain(const RcuDomain &);
+
+        RcuDomain &operator=(const RcuDomain &);
+
+        int registerThread();
+
+        static void unregisterThread(void *slot);
+
+    private:
+        struct ReaderSlot {
+            Atomic<unsigned long> epoch; // 0 when not in a read section
+            Atomic<int> used;
+            char pad[ZCUTILS_CACHE_LINE_SIZE - sizeof(unsigned long) - sizeof(int)];
+        };
+
+        ReaderSlot m_stSlots_[MAX_READERS];
+        Atomic<int> m_nSlotHighWater_;
+        Atomic<unsigned long> m_nEpoch_;
+        Atomic<long> m_nOverflowReaders_;
+    };
+
+    // Scoped read section.
+    class RcuReadGuard {
+    public:
+        RcuReadGuard() { RcuDomain::instance().readLock(); }
+
+        ~RcuReadGuard() { RcuDomain::instance().readUnlock(); }
+
+    private:
+        // Don't need copy or assignment
+        RcuReadGuard(const RcuReadGuard &);
+
+        RcuReadGuard &operator=(const RcuReadGuard &);
+    };
+
+    /*
+     * Brief:
+     *     A pointer whose object is replaced as a whole and read without any lock.
+     *     read() must be called inside a read section (RcuReadGuard) and the object may only
+     *     be used until that section ends. publish() takes ownership of the new object and
+     *     deletes the previous one once no reader can see it anymore.
+     *
+     * Usage:
+     *     RcuPointer<Table> table;
+     *     table.publish(new Table(...));          // writer
+     *     { RcuReadGuard guard; table.read()->find(key); } // reader
+     */
+    template<class T>
+    class RcuPointer {
+    public:
+        explicit RcuPointer(T *object = NULL) : m_ptObject_(object) {}
+
+        // Only safe once no reader can be running.
+        ~RcuPointer() { delete m_ptObject_.load(); }
+
+        T *read() const { return m_ptObject_.load(); }
+
+        // Replace the object, blocks until the old one can be deleted.
+        void publish(T *object) {
+            T *old = m_ptObject_.exchange(object);
+            if (old) {
+                RcuDomain::instance().synchronize();
+                delete old;
+            }
+        }
+
+    private:
+        // Don't need copy or assignment
+        RcuPointer(const RcuPointer &);
+
+        RcuPointer &operator=(const RcuPointer &);
+
+    private:
+        Atomic<T *> m_ptObject_;
+    };
+}
+
+#endif //ZCUTILS_RCU_H
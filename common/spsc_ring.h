@@ -0,0 +1,84 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef ZCUTILS_SPSC_RING_H
+#define ZCUTILS_SPSC_RING_H
+
+#include "atomic.h"
+
+namespace zcUtils {
+    /*
+     * A bounded single-producer single-consumer ring buffer.
+     * Exactly one thread may call push() and exactly one thread may call pop(),
+     * neither of them ever takes a lock or makes a system call.
+     *
+     * The capacity is rounded up to a power of two.
+     */
+    template<class T>
+    class SpscRing {
+    public:
+        explicit SpscRing(unsigned int capacity = 1024) : m_nHead_(0), m_nCachedTail_(0), m_nTail_(0),
+                                                          m_nCachedHead_(0) {
+            unsigned int size = 2;
+            while (size < capacity)
+                size <<= 1;
+            m_nMask_ = size - 1;
+            m_ptSlots_ = new T[size];
+        }
+
+        ~SpscRing() { delete[] m_ptSlots_; }
+
+        // Producer side. return false if the ring is full.
+        bool push(const T &item) {
+            unsigned long tail = m_nTail_.loadRelaxed();
+            if (tail - m_nCachedHead_ > m_nMask_) {
+                m_nCachedHead_ = m_nHead_.load();
+                if (tail - m_nCachedHead_ > m_nMask_)
+                    return false;
+            }
+            m_ptSlots_[tail & m_nMask_] = item;
+            m_nTail_.store(tail + 1);
+            return true;
+        }
+
+        // Consumer side. return false if the ring is empty.
+        bool pop(T &item) {
+            unsigned long head = m_nHead_.loadRelaxed();
+            if (head == m_nCachedTail_) {
+                m_nCachedTail_ = m_nTail_.load();
+                if (head == m_nCachedTail_)
+                    return false;
+            }
+            item = m_ptSlots_[head & m_nMask_];
+            m_nHead_.store(head + 1);
+            return true;
+        }
+
+        // Approximate, may be called from either side.
+        bool empty() const { return m_nHead_.load() == m_nTail_.load(); }
+
+        unsigned int capacity() const { return m_nMask_ + 1; }
+
+    private:
+        // Don't need copy or assignment
+        SpscRing(const SpscRing &);
+
+        SpscRing &operator=(const SpscRing &);
+
+    private:
+        T *m_ptSlots_;
+        unsigned long m_nMask_;
+        // consumer owned line
+        char m_szPad0_[ZCUTILS_CACHE_LINE_SIZE];
+        Atomic<unsigned long> m_nHead_;
+        unsigned long m_nCachedTail_;
+        // producer owned line
+        char m_szPad1_[ZCUTILS_CACHE_LINE_SIZE];
+        Atomic<unsigned long> m_nTail_;
+        unsigned long m_nCachedHead_;
+        char m_szPad2_[ZCUTILS_CACHE_LINE_SIZE];
+    };
+}
+
+#endif //ZCUTILS_SPSC_RING_H
@@ -1 +1,112 @@
+#include "fsEslHelper.h"
 
+#include <stdio.h>
+#include <string.h>
+
+fsEslHelper::fsEslHelper(const char *host, int port, const char *password)
+    : m_pConnection(new ESLconnection(host, port, password)),
+      m_pRateLimiter(NULL), m_nRateWaitMs(0),
+      m_pConcurrencyLimiter(NULL), m_nConcurrencyWaitMs(0),
+      m_nRejected(0)
+{
+    char key[16];
+    snprintf(key, sizeof(key), ":%d", port);
+    m_strKey = std::string(host ? host : "") + key;
+}
+
+fsEslHelper::~fsEslHelper()
+{
+    delete m_pConnection;
+}
+
+void fsEslHelper::setRateLimiter(zcUtils::TokenBucket *rate_limiter, unsigned long wait_ms)
+{
+    m_pRateLimiter = rate_limiter;
+    m_nRateWaitMs = wait_ms;
+}
+
+void fsEslHelper::setConcurrencyLimiter(zcUtils::ConcurrencyLimiter *concurrency_limiter, unsigned long wait_ms)
+{
+    m_pConcurrencyLimiter = concurrency_limiter;
+    m_nConcurrencyWaitMs = wait_ms;
+}
+
+bool fsEslHelper::connected()
+{
+    return m_pConnection->connected() != 0;
+}
+
+bool fsEslHelper::acquireGuards()
+{
+    if (m_pRateLimiter && !m_pRateLimiter->tryAcquire(1, m_nRateWaitMs))
+    {
+        m_nRejected.fetchAdd(1);
+        return false;
+    }
+    if (m_pConcurrencyLimiter && !m_pConcurrencyLimiter->tryAcquire(m_nConcurrencyWaitMs))
+    {
+        m_nRejected.fetchAdd(1);
+        return false;
+    }
+    return true;
+}
+
+void fsEslHelper::releaseGuards(bool success, long start_ns)
+{
+    if (m_pConcurrencyLimiter)
+        m_pConcurrencyLimiter->release(success, (unsigned long)(zcUtils::monotonicNanos() - start_ns) / 1000UL);
+}
+
+// an api reply starting with -ERR, or no reply at all, counts as a failure for the adaptive limiter.
+bool fsEslHelper::isReplyOk(ESLevent *event)
+{
+    if (NULL == event)
+        return false;
+    const char *body = event->getBody();
+    if (body && 0 == strncmp(body, "-ERR", 4))
+        return false;
+    const char *reply = event->getHeader("Reply-Text");
+    if (reply && 0 == strncmp(reply, "-ERR", 4))
+        return false;
+    return true;
+}
+
+int fsEslHelper::send(const char *cmd)
+{
+    if (!acquireGuards())
+        return ESL_FAIL;
+    long start_ns = zcUtils::monotonicNanos();
+    int ret = m_pConnection->send(cmd);
+    releaseGuards(ESL_SUCCESS == ret, start_ns);
+    return ret;
+}
+
+ESLevent *fsEslHelper::sendRecv(const char *cmd)
+{
+    if (!acquireGuards())
+        return NULL;
+    long start_ns = zcUtils::monotonicNanos();
+    ESLevent *event = m_pConnection->sendRecv(cmd);
+    releaseGuards(isReplyOk(event), start_ns);
+    return event;
+}
+
+ESLevent *fsEslHelper::api(const char *cmd, const char *arg)
+{
+    if (!acquireGuards())
+        return NULL;
+    long start_ns = zcUtils::monotonicNanos();
+    ESLevent *event = m_pConnection->api(cmd, arg);
+    releaseGuards(isReplyOk(event), start_ns);
+    return event;
+}
+
+ESLevent *fsEslHelper::bgapi(const char *cmd, const char *arg, const char *job_uuid)
+{
+    if (!acquireGuards())
+        return NULL;
+    long start_ns = zcUtils::monotonicNanos();
+    ESLevent *event = m_pConnection->bgapi(cmd, arg, job_uuid);
+    releaseGuards(isReplyOk(event), start_ns);
+    return event;
+}
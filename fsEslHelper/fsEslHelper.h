@@ -5,10 +5,68 @@
 #include <string>
 
 #include "esl.h"
+#include "esl_oop.h"
+#include "rate_limiter.h"
 
-class 
-
+/*
+ * Brief:
+ *     Wrapper of an ESLconnection that can guard the send path with limiters,
+ *     so bursts of api/bgapi commands don't overload FreeSWITCH.
+ *     Both guards are optional and not owned; share one instance between all the
+ *     helpers talking to the same FreeSWITCH (see zcUtils::KeyedLimiter).
+ *
+ *     When a guard can't be passed within its wait time the command is not sent
+ *     and NULL (or ESL_FAIL for send) is returned.
+ */
 class fsEslHelper
-{};
+{
+public:
+    fsEslHelper(const char *host, int port, const char *password);
+    ~fsEslHelper();
+
+    /*
+     * rate_limiter - caps commands per second
+     * wait_ms - max time a command waits for a permit, 0 to fail at once
+     */
+    void setRateLimiter(zcUtils::TokenBucket *rate_limiter, unsigned long wait_ms = 0);
+
+    /*
+     * concurrency_limiter - caps commands waiting for their reply
+     * wait_ms - max time a command waits for a slot, 0 to fail at once
+     */
+    void setConcurrencyLimiter(zcUtils::ConcurrencyLimiter *concurrency_limiter, unsigned long wait_ms = 0);
+
+    // destination key of this connection, "host:port".
+    const std::string &getKey() const { return m_strKey; }
+
+    bool connected();
+
+    ESLconnection *getConnection() { return m_pConnection; }
+
+    int send(const char *cmd);
+    ESLevent *sendRecv(const char *cmd);
+    ESLevent *api(const char *cmd, const char *arg = NULL);
+    ESLevent *bgapi(const char *cmd, const char *arg = NULL, const char *job_uuid = NULL);
+
+    // commands refused by a guard since creation.
+    unsigned long getRejectedCount() const { return m_nRejected.load(); }
+
+private:
+    fsEslHelper(const fsEslHelper &);
+    fsEslHelper &operator=(const fsEslHelper &);
+
+    bool acquireGuards();
+    void releaseGuards(bool success, long start_ns);
+    static bool isReplyOk(ESLevent *event);
+
+private:
+    ESLconnection *m_pConnection;
+    std::string m_strKey;
+    zcUtils::TokenBucket *m_pRateLimiter;
+    unsigned long m_nRateWaitMs;
+    zcUtils::ConcurrencyLimiter *m_pConcurrencyLimiter;
+    unsigned long m_nConcurrencyWaitMs;
+    zcUtils::Atomic<unsigned long> m_nRejected;
+};
 
 #endif
@@ -0,0 +1,475 @@
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "AsyncMysql.h"
+
+/* epoll 事件中表示唤醒 fd 的序号 */
+#define ASYNC_WAKE_INDEX 0xFFFFFFFFu
+/* 重连失败后的重试间隔(ms) */
+#define ASYNC_RECONNECT_INTERVAL 1000
+
+namespace MysqlApi {
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 以等待的方式取异步结果
+*/
+    AsyncFuture::AsyncFuture() : m_errno(0), m_affected_rows(0), m_result((MYSQL *) NULL) {
+        sem_init(&m_sem, 0, 0);
+    }
+
+    AsyncFuture::~AsyncFuture() {
+        sem_destroy(&m_sem);
+    }
+
+    void AsyncFuture::OnQueryDone(unsigned int err_no, const char *error,
+                                  ResultView &result, unsigned long affected_rows) {
+        m_errno = err_no;
+        m_error = error ? error : "";
+        m_affected_rows = affected_rows;
+        m_result.Attach(result.Detach());
+        sem_post(&m_sem);
+    }
+
+    bool AsyncFuture::Wait(unsigned long timeout_ms) {
+        if (0 == timeout_ms) {
+            while (sem_wait(&m_sem) != 0) {
+                if (errno != EINTR)
+                    return false;
+            }
+            return true;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += timeout_ms / 1000;
+        ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+        while (sem_timedwait(&m_sem, &ts) != 0) {
+            if (errno != EINTR)
+                return false;
+        }
+        return true;
+    }
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 异步查询引擎
+*/
+    AsyncMysqlEngine::AsyncMysqlEngine()
+            : m_DbPort(0), m_ConnectTimeout(10), m_ReadTimeout(3), m_WriteTimeout(10),
+              m_epfd(-1), m_wakefd(-1), m_started(0), m_queued(0), m_inflight(0) {
+        pthread_mutex_init(&m_submit_lock, NULL);
+    }
+
+    AsyncMysqlEngine::~AsyncMysqlEngine() {
+        Stop();
+        pthread_mutex_destroy(&m_submit_lock);
+    }
+
+#ifdef LIBMARIADB
+
+    unsigned long AsyncMysqlEngine::NowMs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+    }
+
+    bool AsyncMysqlEngine::IsConnectionError(unsigned int err) {
+        return CR_SERVER_GONE_ERROR == err || CR_SERVER_LOST == err;
+    }
+
+    MYSQL *AsyncMysqlEngine::NewHandle() {
+        MYSQL *mysql = mysql_init(NULL);
+        if (NULL == mysql)
+            return NULL;
+        mysql_options(mysql, MYSQL_OPT_NONBLOCK, 0);
+        mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &m_ConnectTimeout);
+        mysql_options(mysql, MYSQL_OPT_READ_TIMEOUT, &m_ReadTimeout);
+        mysql_options(mysql, MYSQL_OPT_WRITE_TIMEOUT, &m_WriteTimeout);
+        return mysql;
+    }
+
+    bool AsyncMysqlEngine::Start(const char *pDbServer, const char *pDbDatabase, const char *pDbUser,
+                                 const char *pDbPwd, unsigned int pDbPort, int nConnNum,
+                                 unsigned int unConnectTimeout, unsigned int unReadTimeout, unsigned int unWriteTimeout) {
+        if (m_started.load() || nConnNum <= 0)
+            return false;
+        m_DbServer = pDbServer;
+        m_DbDataBase = pDbDatabase;
+        m_DbUser = pDbUser;
+        m_DbPwd = pDbPwd;
+        m_DbPort = pDbPort;
+        m_ConnectTimeout = unConnectTimeout;
+        m_ReadTimeout = unReadTimeout;
+        m_WriteTimeout = unWriteTimeout;
+
+        m_epfd = epoll_create1(EPOLL_CLOEXEC);
+        m_wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_epfd < 0 || m_wakefd < 0) {
+            cout << "AsyncMysqlEngine::Start failed to create epoll/eventfd, err:" << strerror(errno) << endl;
+            Stop();
+            return false;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = ASYNC_WAKE_INDEX;
+        epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_wakefd, &ev);
+
+        m_conns.resize(nConnNum);
+        for (unsigned int i = 0; i < m_conns.size(); i++) {
+            memset(&m_conns[i], 0, sizeof(AsyncConn));
+            m_conns[i].fd = -1;
+            m_conns[i].state = CONN_BROKEN;
+        }
+        if (!ConnectAll()) {
+            Stop();
+            return false;
+        }
+        m_started.store(1);
+        if (!start("async_mysql")) {
+            cout << "AsyncMysqlEngine::Start failed to start thread." << endl;
+            Stop();
+            return false;
+        }
+        return true;
+    }
+
+/* 启动时同步建立所有连接, 任一失败则启动失败 */
+    bool AsyncMysqlEngine::ConnectAll() {
+        for (unsigned int i = 0; i < m_conns.size(); i++) {
+            AsyncConn &conn = m_conns[i];
+            if (!(conn.mysql = NewHandle()))
+                return false;
+            if (!mysql_real_connect(conn.mysql, m_DbServer.c_str(), m_DbUser.c_str(), m_DbPwd.c_str(),
+                                    m_DbDataBase.c_str(), m_DbPort, NULL, 0)) {
+                cout << "AsyncMysqlEngine connect is fail! err:" << mysql_error(conn.mysql) << endl;
+                return false;
+            }
+            conn.state = CONN_IDLE;
+        }
+        return true;
+    }
+
+    void AsyncMysqlEngine::Stop() {
+        int started;
+        {
+            //之后的 Submit 都会失败, 已通过检查的已入队并写完 m_wakefd, 下面的 FailAll 和 close 不会漏掉或误写
+            autoLock al(m_submit_lock);
+            started = m_started.exchange(0);
+        }
+        if (started) {
+            stop();
+            uint64_t one = 1;
+            if (write(m_wakefd, &one, sizeof(one)) < 0) {}
+            //不能用 join: 它先 pthread_cancel, 线程可能在持有队列锁或 _cont 进行到一半时被取消
+            join2(0);
+        }
+        //线程退出后提交的查询
+        FailAll();
+        for (unsigned int i = 0; i < m_conns.size(); i++) {
+            Unregister(m_conns[i]);
+            if (m_conns[i].mysql)
+                mysql_close(m_conns[i].mysql);
+        }
+        m_conns.clear();
+        if (m_wakefd >= 0)
+            close(m_wakefd);
+        if (m_epfd >= 0)
+            close(m_epfd);
+        m_wakefd = -1;
+        m_epfd = -1;
+    }
+
+    bool AsyncMysqlEngine::Submit(const string &sql, AsyncResultHandler *handler) {
+        if (NULL == handler)
+            return false;
+        autoLock al(m_submit_lock);
+        if (!m_started.load())
+            return false;
+        AsyncQuery *query = new AsyncQuery;
+        query->sql = sql;
+        query->handler = handler;
+        m_queued.fetchAdd(1);
+        m_queue.PutMsg(query);
+        uint64_t one = 1;
+        if (write(m_wakefd, &one, sizeof(one)) < 0) {}
+        return true;
+    }
+
+/* 把排队的查询分派给空闲连接 */
+    void AsyncMysqlEngine::Dispatch() {
+        for (unsigned int i = 0; i < m_conns.size(); i++) {
+            //查询可能立即完成, 连接随即又空闲
+            while (CONN_IDLE == m_conns[i].state) {
+                AsyncQuery *query = NULL;
+                if (!m_queue.GetMsg(query))
+                    return;
+                m_queued.fetchSub(1);
+                m_inflight.fetchAdd(1);
+                BeginQuery(m_conns[i], query);
+            }
+        }
+    }
+
+    void AsyncMysqlEngine::BeginConnect(AsyncConn &conn) {
+        Unregister(conn);
+        if (conn.mysql)
+            mysql_close(conn.mysql);
+        conn.connect_ret = NULL;
+        if (!(conn.mysql = NewHandle())) {
+            conn.state = CONN_BROKEN;
+            conn.deadline_ms = NowMs() + ASYNC_RECONNECT_INTERVAL;
+            return;
+        }
+        conn.state = CONN_CONNECTING;
+        int status = mysql_real_connect_start(&conn.connect_ret, conn.mysql, m_DbServer.c_str(), m_DbUser.c_str(),
+                                              m_DbPwd.c_str(), m_DbDataBase.c_str(), m_DbPort, NULL, 0);
+        Step(conn, status);
+    }
+
+    void AsyncMysqlEngine::BeginQuery(AsyncConn &conn, AsyncQuery *query) {
+        conn.query = query;
+        conn.query_ret = 0;
+        conn.result = NULL;
+        conn.state = CONN_QUERYING;
+        int status = mysql_real_query_start(&conn.query_ret, conn.mysql, query->sql.c_str(),
+                                            (unsigned long) query->sql.length());
+        Step(conn, status);
+    }
+
+    void AsyncMysqlEngine::Continue(AsyncConn &conn, int ready_status) {
+        int status = 0;
+        switch (conn.state) {
+            case CONN_CONNECTING:
+                status = mysql_real_connect_cont(&conn.connect_ret, conn.mysql, ready_status);
+                break;
+            case CONN_QUERYING:
+                status = mysql_real_query_cont(&conn.query_ret, conn.mysql, ready_status);
+                break;
+            case CONN_STORING:
+                status = mysql_store_result_cont(&conn.result, conn.mysql, ready_status);
+                break;
+            default:
+                return;
+        }
+        Step(conn, status);
+    }
+
+    void AsyncMysqlEngine::Step(AsyncConn &conn, int status) {
+        if (status) {
+            Wait(conn, status);
+            return;
+        }
+        //当前操作已完成
+        conn.wait_status = 0;
+        conn.deadline_ms = 0;
+        switch (conn.state) {
+            case CONN_CONNECTING:
+                if (NULL == conn.connect_ret) {
+                    cout << "AsyncMysqlEngine reconnect is fail! err:" << mysql_error(conn.mysql) << endl;
+                    Unregister(conn);
+                    conn.state = CONN_BROKEN;
+                    conn.deadline_ms = NowMs() + ASYNC_RECONNECT_INTERVAL;
+                } else
+                    conn.state = CONN_IDLE;
+                break;
+            case CONN_QUERYING:
+                if (conn.query_ret) {
+                    Finish(conn, mysql_errno(conn.mysql), mysql_error(conn.mysql));
+                    break;
+                }
+                conn.state = CONN_STORING;
+                Step(conn, mysql_store_result_start(&conn.result, conn.mysql));
+                break;
+            case CONN_STORING:
+                if (NULL == conn.result && mysql_field_count(conn.mysql))
+                    Finish(conn, mysql_errno(conn.mysql), mysql_error(conn.mysql));
+                else
+                    Finish(conn, 0, "");
+                break;
+            default:
+                break;
+        }
+    }
+
+    void AsyncMysqlEngine::Finish(AsyncConn &conn, unsigned int err_no, const char *error) {
+        AsyncQuery *query = conn.query;
+        conn.query = NULL;
+        unsigned long affected_rows = (0 == err_no && NULL == conn.result) ? (unsigned long) mysql_affected_rows(conn.mysql) : 0;
+        //回调可能再次提交查询, 先把连接置为空闲
+        conn.state = CONN_IDLE;
+        {
+            ResultView result(conn.mysql);
+            result.Attach(conn.result);
+            conn.result = NULL;
+            query->handler->OnQueryDone(err_no, error, result, affected_rows);
+        }
+        delete query;
+        m_inflight.fetchSub(1);
+        if (IsConnectionError(err_no))
+            BeginConnect(conn);
+    }
+
+/* 按客户端库要求的事件注册 epoll */
+    void AsyncMysqlEngine::Wait(AsyncConn &conn, int status) {
+        conn.wait_status = status;
+        conn.deadline_ms = (status & MYSQL_WAIT_TIMEOUT) ? NowMs() + mysql_get_timeout_value_ms(conn.mysql) : 0;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        if (status & MYSQL_WAIT_READ)
+            ev.events |= EPOLLIN;
+        if (status & MYSQL_WAIT_WRITE)
+            ev.events |= EPOLLOUT;
+        if (status & MYSQL_WAIT_EXCEPT)
+            ev.events |= EPOLLPRI;
+        ev.data.u32 = (uint32_t) (&conn - &m_conns[0]);
+
+        int fd = mysql_get_socket(conn.mysql);
+        if (fd != conn.fd)
+            Unregister(conn);
+        if (fd < 0)
+            return;
+        if (conn.fd < 0) {
+            if (0 == epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev))
+                conn.fd = fd;
+        } else
+            epoll_ctl(m_epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    void AsyncMysqlEngine::Unregister(AsyncConn &conn) {
+        if (conn.fd >= 0 && m_epfd >= 0)
+            epoll_ctl(m_epfd, EPOLL_CTL_DEL, conn.fd, NULL);
+        conn.fd = -1;
+    }
+
+/* 最近的超时或重连时刻, 最多等1s以便检查停止标志 */
+    int AsyncMysqlEngine::NextTimeout() {
+        unsigned long now = NowMs();
+        unsigned long timeout = 1000;
+        for (unsigned int i = 0; i < m_conns.size(); i++) {
+            if (0 == m_conns[i].deadline_ms)
+                continue;
+            if (m_conns[i].deadline_ms <= now)
+                return 0;
+            if (m_conns[i].deadline_ms - now < timeout)
+                timeout = m_conns[i].deadline_ms - now;
+        }
+        return (int) timeout;
+    }
+
+/* 在途和排队中的查询全部以失败回调 */
+    void AsyncMysqlEngine::FailAll() {
+        for (unsigned int i = 0; i < m_conns.size(); i++) {
+            AsyncConn &conn = m_conns[i];
+            //操作进行到一半的连接不能再用, 也不再重连
+            if (conn.result)
+                mysql_free_result(conn.result);
+            conn.result = NULL;
+            if (conn.query != NULL) {
+                ResultView result((MYSQL *) NULL);
+                conn.query->handler->OnQueryDone(CR_SERVER_GONE_ERROR, "async engine stopped", result, 0);
+                delete conn.query;
+                conn.query = NULL;
+                m_inflight.fetchSub(1);
+            }
+            conn.state = CONN_BROKEN;
+            conn.wait_status = 0;
+            conn.deadline_ms = 0;
+        }
+        AsyncQuery *query = NULL;
+        while (m_queue.GetMsg(query)) {
+            m_queued.fetchSub(1);
+            ResultView result((MYSQL *) NULL);
+            query->handler->OnQueryDone(CR_SERVER_GONE_ERROR, "async engine stopped", result, 0);
+            delete query;
+        }
+    }
+
+    int AsyncMysqlEngine::run() {
+        struct epoll_event events[64];
+        while (!isStopping()) {
+            int n = epoll_wait(m_epfd, events, 64, NextTimeout());
+            if (n < 0 && errno != EINTR) {
+                cout << "AsyncMysqlEngine epoll_wait is failed, err:" << strerror(errno) << endl;
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                if (ASYNC_WAKE_INDEX == events[i].data.u32) {
+                    uint64_t count;
+                    if (read(m_wakefd, &count, sizeof(count)) < 0) {}
+                    continue;
+                }
+                AsyncConn &conn = m_conns[events[i].data.u32];
+                int ready = 0;
+                if (events[i].events & EPOLLIN)
+                    ready |= MYSQL_WAIT_READ;
+                if (events[i].events & EPOLLOUT)
+                    ready |= MYSQL_WAIT_WRITE;
+                if (events[i].events & EPOLLPRI)
+                    ready |= MYSQL_WAIT_EXCEPT;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    ready |= conn.wait_status & (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+                if (ready && conn.wait_status)
+                    Continue(conn, ready);
+            }
+            //超时和重连
+            unsigned long now = NowMs();
+            for (unsigned int i = 0; i < m_conns.size(); i++) {
+                AsyncConn &conn = m_conns[i];
+                if (0 == conn.deadline_ms || conn.deadline_ms > now)
+                    continue;
+                conn.deadline_ms = 0;
+                if (CONN_BROKEN == conn.state)
+                    BeginConnect(conn);
+                else if (conn.wait_status & MYSQL_WAIT_TIMEOUT)
+                    Continue(conn, MYSQL_WAIT_TIMEOUT);
+            }
+            Dispatch();
+        }
+        FailAll();
+        return 0;
+    }
+
+#else
+
+/* libmysqlclient 没有 _start/_cont 接口 */
+    bool AsyncMysqlEngine::Start(const char *pDbServer, const char *pDbDatabase, const char *pDbUser,
+                                 const char *pDbPwd, unsigned int pDbPort, int nConnNum,
+                                 unsigned int unConnectTimeout, unsigned int unReadTimeout, unsigned int unWriteTimeout) {
+        (void) pDbServer;
+        (void) pDbDatabase;
+        (void) pDbUser;
+        (void) pDbPwd;
+        (void) pDbPort;
+        (void) nConnNum;
+        (void) unConnectTimeout;
+        (void) unReadTimeout;
+        (void) unWriteTimeout;
+        cout << "AsyncMysqlEngine::Start needs the non-blocking API of MariaDB Connector/C." << endl;
+        return false;
+    }
+
+    void AsyncMysqlEngine::Stop() {}
+
+    bool AsyncMysqlEngine::Submit(const string &sql, AsyncResultHandler *handler) {
+        (void) sql;
+        (void) handler;
+        return false;
+    }
+
+    int AsyncMysqlEngine::run() {
+        return 0;
+    }
+
+#endif
+/* -------------------------------------------------- */
+}
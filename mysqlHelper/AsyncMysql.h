@@ -0,0 +1,173 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _ASYNC_MYSQL_H_
+#define _ASYNC_MYSQL_H_
+
+#include <semaphore.h>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "thread.h"
+#include "threadUtil.h"
+#include "MysqlApi.h"
+
+namespace MysqlApi
+{
+/*
+* 异步查询完成的回调
+* 1 在引擎线程中回调, 回调中不要做耗时操作, 也不要在其中同步等待别的异步查询
+* 2 err_no 为0表示成功, 查询语句的结果在 result 中, 回调返回后 result 被释放(可用 Detach 接管)
+* 3 handler 不被引擎持有, 需保证回调前有效
+*/
+class AsyncResultHandler
+{
+public:
+    virtual ~AsyncResultHandler() {}
+
+    virtual void OnQueryDone(unsigned int err_no, const char *error,
+                             ResultView &result, unsigned long affected_rows) = 0;
+};
+
+/*
+* 以等待的方式取异步结果
+* AsyncFuture f;
+* engine.Submit(sql, &f);
+* if (f.Wait(3000) && 0 == f.GetErrno()) ... f.GetResult() ...
+*/
+class AsyncFuture : public AsyncResultHandler
+{
+public:
+    AsyncFuture();
+    ~AsyncFuture();
+
+    void OnQueryDone(unsigned int err_no, const char *error,
+                     ResultView &result, unsigned long affected_rows);
+
+    /* 等待完成, timeout_ms 为0则一直等待, 超时返回false */
+    bool Wait(unsigned long timeout_ms = 0);
+
+    unsigned int GetErrno() const { return m_errno; }
+    const string &GetError() const { return m_error; }
+    unsigned long GetAffectedRows() const { return m_affected_rows; }
+    ResultView &GetResult() { return m_result; }
+
+private:
+    /* Don't need copy or assignment */
+    AsyncFuture(const AsyncFuture &);
+    AsyncFuture &operator=(const AsyncFuture &);
+
+private:
+    sem_t m_sem;
+    unsigned int m_errno;
+    string m_error;
+    unsigned long m_affected_rows;
+    ResultView m_result;
+};
+
+/*
+* 基于客户端非阻塞接口(_start/_cont)的异步查询引擎
+* 1 引擎线程用 epoll 驱动所有连接, 同时在途的查询数等于连接数, 其余在队列中排队
+* 2 Submit 线程安全, 可在任意线程(包括回调中)提交
+* 3 连接断开后在引擎线程内非阻塞地重连, 期间该连接不分派查询
+* 4 非阻塞接口来自 MariaDB Connector/C(或 libmariadb 兼容的客户端库), 用 libmysqlclient 编译时 Start 返回false
+*/
+class AsyncMysqlEngine : public zcUtils::Thread
+{
+public:
+    AsyncMysqlEngine();
+    ~AsyncMysqlEngine();
+
+    /* 建立 nConnNum 个非阻塞连接并启动引擎线程 */
+    bool Start(const char *pDbServer, const char *pDbDatabase, const char *pDbUser, const char *pDbPwd, unsigned int pDbPort,
+               int nConnNum = 4, unsigned int unConnectTimeout = 10, unsigned int unReadTimeout = 3, unsigned int unWriteTimeout = 10);
+    /* 停止引擎, 排队和在途的查询以 CR_SERVER_GONE_ERROR 回调 */
+    void Stop();
+
+    /* 提交查询, 引擎未启动返回false */
+    bool Submit(const string &sql, AsyncResultHandler *handler);
+
+    /* 排队中的查询数 */
+    long GetQueueSize() const { return m_queued.load(); }
+    /* 在途的查询数 */
+    long GetInFlight() const { return m_inflight.load(); }
+
+protected:
+    int run();
+
+private:
+    enum ConnState
+    {
+        CONN_IDLE,
+        CONN_CONNECTING,
+        CONN_QUERYING,
+        CONN_STORING,
+        /* 等待重连 */
+        CONN_BROKEN
+    };
+
+    struct AsyncQuery
+    {
+        string sql;
+        AsyncResultHandler *handler;
+    };
+
+    struct AsyncConn
+    {
+        MYSQL *mysql;
+        int fd;
+        ConnState state;
+        /* 正在等待的事件(MYSQL_WAIT_*) */
+        int wait_status;
+        /* 等待超时/重连的时刻(ms), 0为不限 */
+        unsigned long deadline_ms;
+        AsyncQuery *query;
+        int query_ret;
+        MYSQL *connect_ret;
+        MYSQL_RES *result;
+    };
+
+    bool ConnectAll();
+    /* 创建设置好非阻塞和超时选项的句柄 */
+    MYSQL *NewHandle();
+    void BeginConnect(AsyncConn &conn);
+    void BeginQuery(AsyncConn &conn, AsyncQuery *query);
+    /* 事件就绪或超时后继续当前操作 */
+    void Continue(AsyncConn &conn, int ready_status);
+    /* 根据 _start/_cont 的返回值推进状态 */
+    void Step(AsyncConn &conn, int status);
+    void Finish(AsyncConn &conn, unsigned int err_no, const char *error);
+    void Wait(AsyncConn &conn, int status);
+    void Unregister(AsyncConn &conn);
+    void Dispatch();
+    void FailAll();
+    int NextTimeout();
+    static unsigned long NowMs();
+    static bool IsConnectionError(unsigned int err);
+
+private:
+    string m_DbServer;
+    string m_DbDataBase;
+    string m_DbUser;
+    string m_DbPwd;
+    unsigned int m_DbPort;
+    unsigned int m_ConnectTimeout;
+    unsigned int m_ReadTimeout;
+    unsigned int m_WriteTimeout;
+
+    int m_epfd;
+    int m_wakefd;
+    /* Submit 在任意线程读 */
+    zcUtils::Atomic<int> m_started;
+    /* Submit 的检查/入队/唤醒与 Stop 清零 m_started 互斥 */
+    pthread_mutex_t m_submit_lock;
+    vector<AsyncConn> m_conns;
+    SafeQueue<AsyncQuery *> m_queue;
+    zcUtils::Atomic<long> m_queued;
+    zcUtils::Atomic<long> m_inflight;
+};
+} // namespace MysqlApi
+
+#endif
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "BulkWriter.h"
+#include "timeval.h"
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 一行待写入的数据
+*/
+//push_back 按引用取用, 需要定义
+const unsigned int BulkRow::NULL_LENGTH;
+
+BulkRow &BulkRow::Add(const char *value, unsigned long length) {
+    if (NULL == value)
+        return AddNull();
+    m_data.insert(m_data.end(), value, value + length);
+    m_lengths.push_back((unsigned int) length);
+    return *this;
+}
+
+BulkRow &BulkRow::Add(long long value) {
+    char temp[32];
+    int len = snprintf(temp, sizeof(temp), "%lld", value);
+    return Add(temp, len);
+}
+
+BulkRow &BulkRow::Add(double value) {
+    char temp[32];
+    int len = snprintf(temp, sizeof(temp), "%.17g", value);
+    return Add(temp, len);
+}
+
+BulkRow &BulkRow::AddNull() {
+    m_lengths.push_back(NULL_LENGTH);
+    return *this;
+}
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 批量写入
+*/
+BulkWriter::BulkWriter(CdbConncetPool &pool, const Config &config)
+        : m_pool(pool), m_config(config), m_pending_bytes(0), m_flush_all(false), m_running(false), m_stopping(false),
+          m_written(0), m_failed(0), m_dropped(0) {
+    if (0 == m_config.max_rows)
+        m_config.max_rows = 1;
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_ready, NULL);
+    pthread_cond_init(&m_space, NULL);
+}
+
+BulkWriter::~BulkWriter() {
+    Stop();
+    for (map<string, TableBuffer *>::iterator it = m_tables.begin(); it != m_tables.end(); ++it)
+        delete it->second;
+    pthread_cond_destroy(&m_space);
+    pthread_cond_destroy(&m_ready);
+    pthread_mutex_destroy(&m_lock);
+}
+
+unsigned long BulkWriter::NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+bool BulkWriter::Start() {
+    {
+        autoLock al(m_lock);
+        if (m_running)
+            return false;
+        m_running = true;
+        m_stopping = false;
+    }
+    if (!start("bulk_writer")) {
+        cout << "BulkWriter::Start failed to start thread." << endl;
+        autoLock al(m_lock);
+        m_running = false;
+        return false;
+    }
+    return true;
+}
+
+void BulkWriter::Stop() {
+    {
+        autoLock al(m_lock);
+        if (!m_running)
+            return;
+        m_stopping = true;
+        pthread_cond_signal(&m_ready);
+        //唤醒等待空间的写入者, 让其返回
+        pthread_cond_broadcast(&m_space);
+    }
+    //后台线程写完缓存的行后自行退出; join 会先 pthread_cancel, 未写的行会丢失, 还可能在等待条件变量时带着锁被取消
+    stop();
+    join2(0);
+    autoLock al(m_lock);
+    m_running = false;
+}
+
+void BulkWriter::Flush() {
+    autoLock al(m_lock);
+    m_flush_all = true;
+    pthread_cond_signal(&m_ready);
+}
+
+unsigned long BulkWriter::GetPendingBytes() {
+    autoLock al(m_lock);
+    return m_pending_bytes;
+}
+
+bool BulkWriter::Write(const string &table, const string &columns, const BulkRow &row) {
+    unsigned long bytes = row.GetBytes();
+    autoLock al(m_lock);
+    if (!m_running || m_stopping) {
+        m_dropped.fetchAdd(1);
+        return false;
+    }
+
+    //缓存满时等待后台线程写出
+    if (m_pending_bytes + bytes > m_config.max_pending_bytes && m_pending_bytes > 0) {
+        if (m_config.block_ms > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += m_config.block_ms / 1000;
+            ts.tv_nsec += (m_config.block_ms % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec += 1;
+                ts.tv_nsec -= 1000000000;
+            }
+            while (m_pending_bytes + bytes > m_config.max_pending_bytes && m_pending_bytes > 0 && !m_stopping) {
+                if (ETIMEDOUT == pthread_cond_timedwait(&m_space, &m_lock, &ts))
+                    break;
+            }
+        }
+        if ((m_pending_bytes + bytes > m_config.max_pending_bytes && m_pending_bytes > 0) || m_stopping) {
+            m_dropped.fetchAdd(1);
+            return false;
+        }
+    }
+
+    string key = table + "(" + columns + ")";
+    TableBuffer *&buffer = m_tables[key];
+    if (NULL == buffer) {
+        buffer = new TableBuffer;
+        buffer->table = table;
+        buffer->columns = columns;
+        buffer->column_num = 1;
+        for (string::size_type i = 0; i < columns.length(); i++) {
+            if (',' == columns[i])
+                ++buffer->column_num;
+        }
+    }
+    if (row.Size() != buffer->column_num) {
+        cout << "BulkWriter::Write value count " << row.Size() << " doesn't match columns:" << key << endl;
+        m_dropped.fetchAdd(1);
+        return false;
+    }
+    if (0 == buffer->rows)
+        buffer->first_ms = NowMs();
+    buffer->data.insert(buffer->data.end(), row.m_data.begin(), row.m_data.end());
+    buffer->lengths.insert(buffer->lengths.end(), row.m_lengths.begin(), row.m_lengths.end());
+    ++buffer->rows;
+    m_pending_bytes += bytes;
+    if (buffer->rows >= m_config.max_rows || buffer->data.size() >= m_config.max_bytes)
+        pthread_cond_signal(&m_ready);
+    return true;
+}
+
+bool BulkWriter::IsReady(const TableBuffer &buffer, unsigned long now_ms) const {
+    if (0 == buffer.rows)
+        return false;
+    return buffer.rows >= m_config.max_rows || buffer.data.size() >= m_config.max_bytes ||
+           now_ms - buffer.first_ms >= m_config.flush_interval_ms;
+}
+
+void BulkWriter::TakeReady(vector<TableBuffer *> &batches, bool all) {
+    unsigned long now = NowMs();
+    for (map<string, TableBuffer *>::iterator it = m_tables.begin(); it != m_tables.end(); ++it) {
+        TableBuffer *buffer = it->second;
+        if (0 == buffer->rows || (!all && !IsReady(*buffer, now)))
+            continue;
+        //整个缓冲交给后台线程, 原位置换一个空的
+        TableBuffer *fresh = new TableBuffer;
+        fresh->table = buffer->table;
+        fresh->columns = buffer->columns;
+        fresh->column_num = buffer->column_num;
+        it->second = fresh;
+        batches.push_back(buffer);
+    }
+}
+
+void BulkWriter::BuildSQL(MYSQL *mysql, const TableBuffer &batch, string &sql) {
+    sql.clear();
+    sql.reserve(batch.data.size() * 2 + batch.lengths.size() * 3 + 64);
+    sql += m_config.verb;
+    sql += " INTO ";
+    sql += batch.table;
+    sql += " (";
+    sql += batch.columns;
+    sql += ") VALUES ";
+
+    vector<char> escaped;
+    const char *data = batch.data.empty() ? NULL : &batch.data[0];
+    unsigned long offset = 0;
+    unsigned int cell = 0;
+    for (unsigned int r = 0; r < batch.rows; r++) {
+        sql += (0 == r) ? "(" : ",(";
+        for (int c = 0; c < batch.column_num; c++, cell++) {
+            if (c > 0)
+                sql += ',';
+            unsigned int length = batch.lengths[cell];
+            if (BulkRow::NULL_LENGTH == length) {
+                sql += "NULL";
+                continue;
+            }
+            escaped.resize(length * 2 + 1);
+            unsigned long n = mysql_real_escape_string(mysql, &escaped[0], data + offset, length);
+            sql += '\'';
+            sql.append(&escaped[0], n);
+            sql += '\'';
+            offset += length;
+        }
+        sql += ')';
+    }
+}
+
+/*
+* 写入一批
+* 连接断开时重建连接重试, 其他错误不重试
+*/
+bool BulkWriter::WriteBatch(const TableBuffer &batch) {
+    string sql;
+    for (int attempt = 0; attempt <= m_config.max_retries; attempt++) {
+        Connection *pConn = m_pool.GetConnection();
+        if (NULL == pConn) {
+            sleep(1);
+            continue;
+        }
+        BuildSQL(pConn->hDB.GetMysql(), batch, sql);
+        int rt = pConn->hDB.ExecQuery(sql);
+        if (rt >= 0) {
+            m_pool.ReleaseConnection(pConn);
+            return true;
+        }
+        unsigned int err = mysql_errno(pConn->hDB.GetMysql());
+        if (CR_SERVER_GONE_ERROR == err || CR_SERVER_LOST == err) {
+            cout << "BulkWriter::WriteBatch connection lost, retry:" << attempt << ",table:" << batch.table << endl;
+            pConn = m_pool.ReCreateConnection(pConn);
+            m_pool.ReleaseConnection(pConn);
+            continue;
+        }
+        m_pool.ReleaseConnection(pConn);
+        return false;
+    }
+    return false;
+}
+
+int BulkWriter::run() {
+    vector<TableBuffer *> batches;
+    while (true) {
+        bool stopping;
+        {
+            autoLock al(m_lock);
+            while (true) {
+                TakeReady(batches, m_flush_all || m_stopping);
+                m_flush_all = false;
+                if (!batches.empty() || m_stopping)
+                    break;
+                //等到最早的一批到期
+                unsigned long now = NowMs();
+                unsigned long wait_ms = m_config.flush_interval_ms;
+                for (map<string, TableBuffer *>::iterator it = m_tables.begin(); it != m_tables.end(); ++it) {
+                    if (0 == it->second->rows)
+                        continue;
+                    unsigned long age = now - it->second->first_ms;
+                    unsigned long left = age >= m_config.flush_interval_ms ? 0 : m_config.flush_interval_ms - age;
+                    if (left < wait_ms)
+                        wait_ms = left;
+                }
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_sec += wait_ms / 1000;
+                ts.tv_nsec += (wait_ms % 1000) * 1000000;
+                if (ts.tv_nsec >= 1000000000) {
+                    ts.tv_sec += 1;
+                    ts.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&m_ready, &m_lock, &ts);
+            }
+            stopping = m_stopping;
+        }
+
+        for (unsigned int i = 0; i < batches.size(); i++) {
+            TableBuffer *batch = batches[i];
+            if (WriteBatch(*batch))
+                m_written.fetchAdd(batch->rows);
+            else {
+                cout << "BulkWriter::run failed to write " << batch->rows << " rows into " << batch->table << endl;
+                m_failed.fetchAdd(batch->rows);
+            }
+            autoLock al(m_lock);
+            m_pending_bytes -= batch->data.size();
+            pthread_cond_broadcast(&m_space);
+            delete batch;
+        }
+        batches.clear();
+        if (stopping)
+            break;
+    }
+    return 0;
+}
+/* -------------------------------------------------- */
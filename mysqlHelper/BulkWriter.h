@@ -0,0 +1,159 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _BULK_WRITER_H_
+#define _BULK_WRITER_H_
+
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "thread.h"
+#include "DbConnectPool.h"
+
+/*
+* 一行待写入的数据, 值以原始字节保存, 写入时再用连接的字符集转义
+*/
+class BulkRow
+{
+public:
+    BulkRow() {}
+
+    BulkRow &Add(const string &value) { return Add(value.data(), (unsigned long) value.length()); }
+    BulkRow &Add(const char *value, unsigned long length);
+    BulkRow &Add(long long value);
+    BulkRow &Add(double value);
+    BulkRow &AddNull();
+
+    void Clear()
+    {
+        m_data.clear();
+        m_lengths.clear();
+    }
+    int Size() const { return (int) m_lengths.size(); }
+    unsigned long GetBytes() const { return m_data.size(); }
+
+private:
+    friend class BulkWriter;
+
+    /* 表示NULL值的长度 */
+    static const unsigned int NULL_LENGTH = 0xFFFFFFFFu;
+
+    vector<char> m_data;
+    vector<unsigned int> m_lengths;
+};
+
+/*
+* 批量写入
+* 1 按 表+字段 缓存行, 攒够 max_rows 行或 max_bytes 字节, 或最早一行等待超过 flush_interval_ms 时,
+*   由后台线程从连接池取连接, 以一条多行 INSERT ... VALUES (...),(...) 写入
+* 2 所有表缓存的总字节数受 max_pending_bytes 限制, 超出时 Write 最多阻塞 block_ms, 仍无空间则丢弃该行并返回false
+* 3 连接断开(2006/2013)时重建连接并重试, 最多 max_retries 次; 其他错误(如语法, 主键冲突)整批计为失败
+* 4 Write 线程安全; Stop 会写完所有缓存的行
+*
+* 用法:
+*     BulkWriter writer(Singleton<CdbConncetPool>::instance());
+*     writer.Start();
+*     BulkRow row;
+*     row.Add(caller).Add(callee).Add((long long) duration);
+*     writer.Write("cdr", "caller,callee,duration", row);
+*/
+class BulkWriter : public zcUtils::Thread
+{
+public:
+    struct Config
+    {
+        /* 单批最多行数 */
+        unsigned int max_rows;
+        /* 单批最多字节数(未转义的数据) */
+        unsigned long max_bytes;
+        /* 最早一行最多等待多久写入 */
+        unsigned long flush_interval_ms;
+        /* 所有表缓存的总字节数上限 */
+        unsigned long max_pending_bytes;
+        /* 缓存满时 Write 最多等待的时间, 0则立即返回false */
+        unsigned long block_ms;
+        /* 连接断开时的重试次数 */
+        int max_retries;
+        /* INSERT / INSERT IGNORE / REPLACE */
+        string verb;
+
+        Config()
+            : max_rows(500), max_bytes(1024 * 1024), flush_interval_ms(1000),
+              max_pending_bytes(64 * 1024 * 1024), block_ms(0), max_retries(3), verb("INSERT") {}
+    };
+
+    BulkWriter(CdbConncetPool &pool, const Config &config = Config());
+    ~BulkWriter();
+
+    bool Start();
+    /* 写完缓存的行后停止 */
+    void Stop();
+
+    /*
+    * 添加一行, columns 为逗号分隔的字段名, row 的值个数必须与之相同
+    * 返回false表示引擎未启动, 值个数不符或缓存已满
+    */
+    bool Write(const string &table, const string &columns, const BulkRow &row);
+    /* 立即写出所有缓存的行, 不等待写完 */
+    void Flush();
+
+    unsigned long GetWrittenRows() const { return m_written.load(); }
+    unsigned long GetFailedRows() const { return m_failed.load(); }
+    unsigned long GetDroppedRows() const { return m_dropped.load(); }
+    unsigned long GetPendingBytes();
+
+protected:
+    int run();
+
+private:
+    struct TableBuffer
+    {
+        string table;
+        string columns;
+        int column_num;
+        vector<char> data;
+        vector<unsigned int> lengths;
+        unsigned int rows;
+        /* 最早一行加入的时间(ms) */
+        unsigned long first_ms;
+
+        TableBuffer() : column_num(0), rows(0), first_ms(0) {}
+    };
+
+    /* Don't need copy or assignment */
+    BulkWriter(const BulkWriter &);
+    BulkWriter &operator=(const BulkWriter &);
+
+    bool IsReady(const TableBuffer &buffer, unsigned long now_ms) const;
+    /* 取出需要写入的批次, 需持有锁 */
+    void TakeReady(vector<TableBuffer *> &batches, bool all);
+    /* 写入一批, 返回是否成功 */
+    bool WriteBatch(const TableBuffer &batch);
+    void BuildSQL(MYSQL *mysql, const TableBuffer &batch, string &sql);
+    static unsigned long NowMs();
+
+private:
+    CdbConncetPool &m_pool;
+    Config m_config;
+
+    pthread_mutex_t m_lock;
+    /* 有批次可写 */
+    pthread_cond_t m_ready;
+    /* 缓存有空间 */
+    pthread_cond_t m_space;
+    map<string, TableBuffer *> m_tables;
+    unsigned long m_pending_bytes;
+    bool m_flush_all;
+    bool m_running;
+    bool m_stopping;
+
+    zcUtils::Atomic<unsigned long> m_written;
+    zcUtils::Atomic<unsigned long> m_failed;
+    zcUtils::Atomic<unsigned long> m_dropped;
+};
+
+#endif
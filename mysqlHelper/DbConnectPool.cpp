@@ -1,5 +1,8 @@
 #include <iostream>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
 
 #include "timeval.h"
 #include "MysqlApi.h"
@@ -8,6 +11,15 @@
 #define MAXCOUNT 100000
 auto_ptr <CdbConncetPool> CdbConncetPool::gInstance(new CdbConncetPool);
 
+/* 当前线程留下的连接: 所属连接池, 槽位, 留下时的槽位状态 */
+static __thread CdbConncetPool *t_sticky_pool = NULL;
+static __thread int t_sticky_slot = -1;
+static __thread unsigned long t_sticky_state = 0;
+
+static bool LessLastUsed(const Connection *a, const Connection *b) {
+    return a->nLastUsed < b->nLastUsed;
+}
+
 CdbConncetPool *CdbConncetPool::Instance() {
     if (0 == gInstance.get()) {
         gInstance.reset(new CdbConncetPool);
@@ -69,11 +81,6 @@ bool CdbConncetPool::Init() {
     if (m_initialized)
         return false;
 
-    int err = sem_init(&m_sem, 0, 0);
-    if (0 != err) {
-        cout << "CdbConncetPool::Init Error: failed to do sem_init." << endl;
-        return false;
-    }
     InitDatabase();
     m_initialized = true;
     return true;
@@ -83,14 +90,34 @@ bool CdbConncetPool::PutMsg(Connection *pConn) {
     if (!m_initialized)
         return false;
 
-    //put message into the queue, and signal semaphore
-    m_queue.PutMsg(pConn);
-    if (m_stop)
-        return true;
-    int err = sem_post(&m_sem);
-    if (0 != err) {
-        cout << "CdbConncetPool::PutMsg Error: failed to do sem_post." << endl;
-        return false;
+    pConn->nLastUsed = util::get_monotonic_us();
+    Slot &slot = m_slots[pConn->nNumber];
+    //本线程还没有留下连接且没有人等待时留在本线程
+    if (m_sticky && !m_stop && 0 == m_waiters.load() &&
+        !(t_sticky_pool == this && m_slots[t_sticky_slot].state.load() == t_sticky_state)) {
+        unsigned long sticky = (slot.state.load() & ~(unsigned long) SLOT_STATE_MASK) | SLOT_STICKY;
+        slot.state.store(sticky);
+        t_sticky_pool = this;
+        t_sticky_slot = pConn->nNumber;
+        t_sticky_state = sticky;
+        zcUtils::memoryFence();
+        if (0 == m_waiters.load())
+            return true;
+        //同时有线程开始等待, 可能没看到这个连接, 取回放入共享栈
+        unsigned long expected = sticky;
+        if (!slot.state.compareExchange(expected, sticky - SLOT_STICKY + SLOT_IN_USE))
+            return true;
+        t_sticky_pool = NULL;
+    }
+
+    PushFree(pConn->nNumber);
+    zcUtils::memoryFence();
+    if (m_waiters.load() > 0 || m_stop) {
+        autoLock al(m_lock);
+        if (m_stop)
+            pthread_cond_broadcast(&m_idle_cond);
+        else
+            pthread_cond_signal(&m_idle_cond);
     }
     return true;
 }
@@ -98,24 +125,45 @@ bool CdbConncetPool::PutMsg(Connection *pConn) {
 bool CdbConncetPool::Stop() {
     if (!m_initialized)
         return false;
-    m_stop = true;
 
-    Connection *pConn = NULL;
+    pthread_mutex_lock(&m_lock);
+    m_stop = true;
+    pthread_cond_broadcast(&m_idle_cond);
+    pthread_cond_signal(&m_keeper_cond);
+    pthread_mutex_unlock(&m_lock);
+    //还在后台建连的启动线程
+    for (unsigned int i = 0; i < m_start_threads.size(); i++)
+        pthread_join(m_start_threads[i], NULL);
+    m_start_threads.clear();
+    if (m_keeper_started) {
+        m_keeper.Join();
+        m_keeper_started = false;
+    }
 
-    for (int i = 0; i < m_num; i++) {
-        //disconnect DB handle
-        if (m_queue.GetMsg(pConn)) {
-            TerminateConnection(pConn);
-        } else {
-            sleep(1);
-            i--;
+    //等所有被占用的连接归还后关闭
+    vector<Connection *> conns;
+    pthread_mutex_lock(&m_lock);
+    while (m_num > 0) {
+        conns.clear();
+        TakeAllIdle(conns);
+        for (unsigned int i = 0; i < conns.size(); i++) {
+            RemoveConnection(conns[i]);
+            TerminateConnection(conns[i]);
+        }
+        if (m_num > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&m_idle_cond, &m_lock, &ts);
         }
     }
+    pthread_mutex_unlock(&m_lock);
     m_initialized = false;
     return true;
 }
 
-Connection *CdbConncetPool::CreateConnection() {
+Connection *CdbConncetPool::CreateConnection(unsigned long *pConnectUs, unsigned long *pWarmUpUs) {
+    unsigned long starttime = util::get_monotonic_us();
     Connection *pConn = new Connection;
     if (NULL == pConn) {
         cout << "Create Connection object failed!" << endl;
@@ -125,48 +173,394 @@ Connection *CdbConncetPool::CreateConnection() {
         delete pConn;
         return NULL;
     }
+    unsigned long connected = util::get_monotonic_us();
+    if (pConnectUs)
+        *pConnectUs = connected - starttime;
+    if (!WarmUp(pConn)) {
+        TerminateConnection(pConn);
+        return NULL;
+    }
+    if (pWarmUpUs)
+        *pWarmUpUs = util::get_monotonic_us() - connected;
     return pConn;
 }
 
+bool CdbConncetPool::WarmUp(Connection *pConn) {
+    for (unsigned int i = 0; i < m_session_sqls.size(); i++) {
+        if (pConn->hDB.ExecQuery(m_session_sqls[i]) < 0) {
+            cout << "CdbConncetPool::WarmUp failed to run session sql:" << m_session_sqls[i] << endl;
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < m_warmup_stmts.size(); i++) {
+        if (NULL == pConn->stmts.Get(pConn->hDB, m_warmup_stmts[i]))
+            cout << "CdbConncetPool::WarmUp failed to prepare:" << m_warmup_stmts[i] << endl;
+    }
+    return true;
+}
+
+void CdbConncetPool::SetConnectParallel(int nParallel) {
+    m_ConnectParallel = nParallel < 1 ? 1 : nParallel;
+}
+
+void CdbConncetPool::SetStartQuorum(int nQuorum) {
+    m_StartQuorum = nQuorum < 0 ? START_IN_BACKGROUND : nQuorum;
+}
+
+void CdbConncetPool::AddSessionSQL(const string &sql) {
+    m_session_sqls.push_back(sql);
+}
+
+void CdbConncetPool::AddWarmUpStatement(const string &sql) {
+    m_warmup_stmts.push_back(sql);
+}
+
+void CdbConncetPool::GetStartupStats(StartupStats &stats) {
+    autoLock al(m_lock);
+    stats = m_startup;
+}
+
+void *CdbConncetPool::StartupWorker(void *arg) {
+    ((CdbConncetPool *) arg)->StartupLoop();
+    return NULL;
+}
+
+/*
+* 启动时的建连线程: 领一个名额建一个连接, 直到领完
+* 名额先计入 m_num, 后台线程不会重复补足
+*/
+void CdbConncetPool::StartupLoop() {
+    while (true) {
+        {
+            autoLock al(m_lock);
+            if (m_stop || m_start_tasks <= 0)
+                break;
+            --m_start_tasks;
+            ++m_num;
+        }
+        unsigned long connect_us = 0, warmup_us = 0;
+        Connection *pConn = CreateConnection(&connect_us, &warmup_us);
+
+        autoLock al(m_lock);
+        if (NULL == pConn) {
+            --m_num;
+            ++m_startup.failed;
+            if (m_pBreaker)
+                m_pBreaker->onFailure();
+            //没建成的由后台线程按最小连接数补足
+            pthread_cond_signal(&m_keeper_cond);
+        } else {
+            AddConnection(pConn);
+            pthread_cond_signal(&m_idle_cond);
+            ++m_startup.connected;
+            m_startup.total_connect_ms += connect_us / 1000;
+            m_startup.total_warmup_ms += warmup_us / 1000;
+            if (connect_us / 1000 > m_startup.max_connect_ms)
+                m_startup.max_connect_ms = connect_us / 1000;
+            if (warmup_us / 1000 > m_startup.max_warmup_ms)
+                m_startup.max_warmup_ms = warmup_us / 1000;
+        }
+        unsigned long elapsed = (util::get_monotonic_us() - m_start_begin) / 1000;
+        int quorum = (0 == m_StartQuorum || m_StartQuorum > m_MinConn) ? m_MinConn : m_StartQuorum;
+        if (0 == m_startup.quorum_ms && m_startup.connected >= quorum && m_startup.connected > 0)
+            m_startup.quorum_ms = elapsed;
+        if (m_startup.connected + m_startup.failed == m_MinConn) {
+            m_startup.total_ms = elapsed;
+            cout << "CdbConncetPool startup connected:" << m_startup.connected << ",failed:" << m_startup.failed
+                 << ",quorum:" << m_startup.quorum_ms << "ms,total:" << m_startup.total_ms << "ms"
+                 << ",connect avg:" << (m_startup.connected ? m_startup.total_connect_ms / m_startup.connected : 0)
+                 << "ms max:" << m_startup.max_connect_ms << "ms"
+                 << ",warmup avg:" << (m_startup.connected ? m_startup.total_warmup_ms / m_startup.connected : 0)
+                 << "ms max:" << m_startup.max_warmup_ms << "ms" << endl;
+        }
+        pthread_cond_broadcast(&m_start_cond);
+    }
+}
+
+bool CdbConncetPool::SetPoolLimits(int nMinConn, int nMaxIdle, int nMaxConn, unsigned int unIdleTimeout,
+                                   unsigned int unCheckInterval) {
+    if (nMaxConn < 1 || nMinConn < 0 || nMinConn > nMaxConn) {
+        cout << "CdbConncetPool::SetPoolLimits invalid limits, min:" << nMinConn << ",max:" << nMaxConn << endl;
+        return false;
+    }
+    autoLock al(m_lock);
+    m_MinConn = nMinConn;
+    m_MaxConn = nMaxConn;
+    //空闲数上限介于最小和最大连接数之间
+    m_MaxIdle = nMaxIdle < nMinConn ? nMinConn : (nMaxIdle > nMaxConn ? nMaxConn : nMaxIdle);
+    m_IdleTimeout = unIdleTimeout;
+    m_CheckInterval = unCheckInterval;
+    return true;
+}
+
+int CdbConncetPool::GetTotalNum() {
+    autoLock al(m_lock);
+    return m_num;
+}
+
+int CdbConncetPool::GetIdleNum() {
+    int num = m_free_num.load();
+    for (int i = 0; m_slots && i < m_MaxConn; i++) {
+        if (SLOT_STICKY == (m_slots[i].state.load() & SLOT_STATE_MASK))
+            ++num;
+    }
+    return num;
+}
+
+void CdbConncetPool::GetStats(PoolStats &stats) {
+    stats.checkouts = m_stat_checkouts.load();
+    stats.timeouts = m_stat_timeouts.load();
+    stats.breaker_rejected = m_stat_breaker_rejected.load();
+    stats.limiter_rejected = m_stat_limiter_rejected.load();
+    stats.total_wait_us = m_stat_total_wait_us.load();
+    stats.max_wait_us = m_stat_max_wait_us.load();
+    stats.idle = GetIdleNum();
+    stats.waiters = m_waiters.load();
+    autoLock al(m_lock);
+    stats.total = m_num;
+}
+
+void CdbConncetPool::SetStickyConnection(bool bSticky) {
+    m_sticky = bSticky;
+}
+
+void CdbConncetPool::SetRateLimiter(zcUtils::TokenBucket *pLimiter, unsigned long unWaitMs) {
+    m_pRateLimiter = pLimiter;
+    m_RateWaitMs = unWaitMs;
+}
+
+void CdbConncetPool::SetConcurrencyLimiter(zcUtils::ConcurrencyLimiter *pLimiter, unsigned long unWaitMs) {
+    m_pConcurrencyLimiter = pLimiter;
+    m_ConcurrencyWaitMs = unWaitMs;
+}
+
+void CdbConncetPool::SetCircuitBreaker(zcUtils::CircuitBreaker *pBreaker) {
+    m_pBreaker = pBreaker;
+}
+
+void CdbConncetPool::SetWaitTimeout(unsigned long unTimeoutMs) {
+    m_WaitTimeoutMs = unTimeoutMs;
+}
+
 Connection *CdbConncetPool::GetConnection() {
+    return GetConnection(m_WaitTimeoutMs);
+}
+
+Connection *CdbConncetPool::GetConnection(unsigned long unTimeoutMs) {
 
     unsigned long costtime;
-    unsigned long starttime = util::get_current_time_stamp();
-
-    _RETYR_:
-    int err = sem_wait(&m_sem);
-    if (0 != err) {
-        cout << "CdbConncetPool::Run Error: failed to do sem_wait." << endl;
-        if (errno == EINTR)
-            goto _RETYR_;
-        else
-            return NULL;
+    unsigned long starttime = util::get_monotonic_us();
+
+    //熔断打开时直接拒绝, 不打日志, 看统计
+    if (m_pBreaker && !m_pBreaker->allow()) {
+        m_stat_breaker_rejected.fetchAdd(1);
+        return NULL;
     }
 
-    if (m_stop)
+    //限流的等待也算在期限内
+    unsigned long rate_wait = m_RateWaitMs < unTimeoutMs ? m_RateWaitMs : unTimeoutMs;
+    if (m_pRateLimiter && !m_pRateLimiter->tryAcquire(1, rate_wait)) {
+        cout << "CdbConncetPool::GetConnection rejected by rate limiter." << endl;
+        m_stat_limiter_rejected.fetchAdd(1);
+        //没有到数据库, 不算熔断的成功或失败
+        if (m_pBreaker)
+            m_pBreaker->cancel();
+        return NULL;
+    }
+    unsigned long left = unTimeoutMs;
+    if (unTimeoutMs != WAIT_FOREVER) {
+        unsigned long used = (util::get_monotonic_us() - starttime) / 1000;
+        left = used < unTimeoutMs ? unTimeoutMs - used : 0;
+    }
+    zcUtils::ConcurrencyLimiter *pLimiter = m_pConcurrencyLimiter;
+    if (pLimiter && !pLimiter->tryAcquire(m_ConcurrencyWaitMs < left ? m_ConcurrencyWaitMs : left)) {
+        cout << "CdbConncetPool::GetConnection rejected by concurrency limiter, limit:" << pLimiter->getLimit()
+             << endl;
+        m_stat_limiter_rejected.fetchAdd(1);
+        if (m_pBreaker)
+            m_pBreaker->cancel();
         return NULL;
+    }
+    if (unTimeoutMs != WAIT_FOREVER) {
+        unsigned long used = (util::get_monotonic_us() - starttime) / 1000;
+        left = used < unTimeoutMs ? unTimeoutMs - used : 0;
+    }
+
+    Connection *pConn = TakeSticky();
+    if (NULL == pConn)
+        pConn = TakeIdle(left);
+    unsigned long wait_us = util::get_monotonic_us() - starttime;
+    m_stat_total_wait_us.fetchAdd(wait_us);
+    unsigned long max_wait = m_stat_max_wait_us.load();
+    while (wait_us > max_wait && !m_stat_max_wait_us.compareExchange(max_wait, wait_us));
+    if (NULL == pConn) {
+        if (pLimiter)
+            pLimiter->release(false);
+        //不等待时没有现成的连接不算超时
+        if (!m_stop && unTimeoutMs > 0) {
+            m_stat_timeouts.fetchAdd(1);
+            cout << "CdbConncetPool::GetConnection timeout after " << wait_us / 1000 << "ms, total:" << m_num
+                 << ",max:" << m_MaxConn << endl;
+            if (m_pBreaker)
+                m_pBreaker->onFailure();
+        } else if (m_pBreaker)
+            m_pBreaker->cancel();
+        return NULL;
+    }
 
-    costtime = (util::get_current_time_stamp() - starttime) / 1000;
+    costtime = wait_us / 1000;
     if (costtime >= 1000)
         cout << "Warn:Use " << costtime << "s to get dbpool connection..." << endl;
 
-    Connection *pConn = NULL;
-    if (m_queue.GetMsg(pConn)) {
-        /********
-		if(pConn->nCount++>MAXCOUNT)
-		{
-			cout <<"GetConnection Times longer than the maximum,Recreate connection..." << endl;
-			pConn=ReCreateConnection(pConn);
-		}
-********/
-        return pConn;
+    m_stat_checkouts.fetchAdd(1);
+    pConn->nCheckoutTime = util::get_monotonic_us();
+    pConn->pPermit = pLimiter;
+    return pConn;
+}
+
+Connection *CdbConncetPool::TakeSticky() {
+    if (t_sticky_pool != this)
+        return NULL;
+    t_sticky_pool = NULL;
+    //可能已被其他线程抢走
+    unsigned long expected = t_sticky_state;
+    if (!m_slots[t_sticky_slot].state.compareExchange(expected, t_sticky_state - SLOT_STICKY + SLOT_IN_USE))
+        return NULL;
+    return m_slots[t_sticky_slot].pConn;
+}
+
+Connection *CdbConncetPool::TakeIdle(unsigned long unTimeoutMs) {
+    if (m_stop)
+        return NULL;
+    int nSlot = PopFree();
+    if (nSlot < 0)
+        nSlot = StealSticky();
+    if (nSlot < 0 && unTimeoutMs > 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        if (unTimeoutMs != WAIT_FOREVER) {
+            deadline.tv_sec += unTimeoutMs / 1000;
+            deadline.tv_nsec += (unTimeoutMs % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000;
+            }
+        }
+        autoLock al(m_lock);
+        m_waiters.fetchAdd(1);
+        while (!m_stop) {
+            nSlot = PopFree();
+            if (nSlot < 0)
+                nSlot = StealSticky();
+            if (nSlot >= 0)
+                break;
+            //没有空闲连接, 通知后台新建
+            if (m_num < m_MaxConn)
+                pthread_cond_signal(&m_keeper_cond);
+            if (unTimeoutMs == WAIT_FOREVER)
+                pthread_cond_wait(&m_idle_cond, &m_lock);
+            else if (ETIMEDOUT == pthread_cond_timedwait(&m_idle_cond, &m_lock, &deadline)) {
+                nSlot = PopFree();
+                break;
+            }
+        }
+        m_waiters.fetchSub(1);
+    }
+    if (nSlot < 0)
+        return NULL;
+    return m_slots[nSlot].pConn;
+}
+
+/*
+* 空闲栈(Treiber 栈), 后进先出, 让不常用的连接闲置到超时被回收
+* 栈顶带版本号, 每次修改加1, 避免弹出时的ABA问题
+*/
+void CdbConncetPool::PushFree(int nSlot) {
+    Slot &slot = m_slots[nSlot];
+    slot.state.store((slot.state.load() & ~(unsigned long) SLOT_STATE_MASK) | SLOT_IDLE);
+    m_free_num.fetchAdd(1);
+    unsigned long head = m_free_head.load();
+    while (true) {
+        slot.next.store((int) (head & 0xFFFFFFFFUL) - 1);
+        unsigned long desired = (((head >> 32) + 1) << 32) | (unsigned long) (nSlot + 1);
+        if (m_free_head.compareExchange(head, desired))
+            break;
+    }
+}
+
+int CdbConncetPool::PopFree() {
+    unsigned long head = m_free_head.load();
+    while (true) {
+        int top = (int) (head & 0xFFFFFFFFUL) - 1;
+        if (top < 0)
+            return -1;
+        int next = m_slots[top].next.load();
+        unsigned long desired = (((head >> 32) + 1) << 32) | (unsigned long) (next + 1);
+        if (m_free_head.compareExchange(head, desired)) {
+            m_free_num.fetchSub(1);
+            Slot &slot = m_slots[top];
+            slot.state.store((slot.state.load() & ~(unsigned long) SLOT_STATE_MASK) | SLOT_IN_USE);
+            return top;
+        }
     }
-    return NULL;
+}
+
+int CdbConncetPool::StealSticky() {
+    for (int i = 0; m_slots && i < m_MaxConn; i++) {
+        unsigned long state = m_slots[i].state.load();
+        if (SLOT_STICKY != (state & SLOT_STATE_MASK))
+            continue;
+        if (m_slots[i].state.compareExchange(state, state - SLOT_STICKY + SLOT_IN_USE))
+            return i;
+    }
+    return -1;
+}
+
+void CdbConncetPool::TakeAllIdle(vector<Connection *> &conns) {
+    for (int nSlot = PopFree(); nSlot >= 0; nSlot = PopFree())
+        conns.push_back(m_slots[nSlot].pConn);
+    for (int i = 0; m_slots && i < m_MaxConn; i++) {
+        unsigned long state = m_slots[i].state.load();
+        if (SLOT_STICKY == (state & SLOT_STATE_MASK) &&
+            m_slots[i].state.compareExchange(state, state - SLOT_STICKY + SLOT_IN_USE))
+            conns.push_back(m_slots[i].pConn);
+    }
+}
+
+void CdbConncetPool::AddConnection(Connection *pConn) {
+    int nSlot = m_empty_slots.back();
+    m_empty_slots.pop_back();
+    Slot &slot = m_slots[nSlot];
+    slot.pConn = pConn;
+    //换了连接, 代数加1
+    slot.state.store(((slot.state.load() & ~(unsigned long) SLOT_STATE_MASK) + SLOT_GEN_STEP) | SLOT_IN_USE);
+    pConn->nNumber = nSlot;
+    pConn->nLastUsed = util::get_monotonic_us();
+    PushFree(nSlot);
+}
+
+void CdbConncetPool::RemoveConnection(Connection *pConn) {
+    m_slots[pConn->nNumber].pConn = NULL;
+    m_empty_slots.push_back(pConn->nNumber);
+    --m_num;
 }
 
 void CdbConncetPool::ReleaseConnection(Connection *pConn) {
-    if (pConn != NULL)
+    if (pConn != NULL) {
+        //设置限流器之前取出的连接没有占用许可
+        if (pConn->pPermit) {
+            pConn->pPermit->release(!pConn->bFailed, util::get_monotonic_us() - pConn->nCheckoutTime);
+            pConn->pPermit = NULL;
+        }
+        if (m_pBreaker) {
+            if (pConn->bFailed)
+                m_pBreaker->onFailure();
+            else
+                m_pBreaker->onSuccess();
+        }
+        pConn->bFailed = false;
         PutMsg(pConn);
+    }
 }
 
 bool CdbConncetPool::CreateConnectionPool(const char *pDbServer, const char *pDbDatabase, const char *pDbUser,
@@ -175,58 +569,257 @@ bool CdbConncetPool::CreateConnectionPool(const char *pDbServer, const char *pDb
                                           unsigned int unWriteTimeout) {
     if (!m_initialized)
         return false;
+    //连接和启动线程都引用着 m_slots, 不能重建
+    if (m_slots) {
+        cout << "CdbConncetPool::CreateConnectionPool the pool has already been created." << endl;
+        return false;
+    }
 
     m_DbUser = pDbUser;
     m_DbPwd = pDbPwd;
     m_DbDataBase = pDbDatabase;
     m_DbServer = pDbServer;
     m_DbPort = pDbPort;
-    m_num = nConnNum;
     m_ConnectTimeout = unConnectTimeout;
     m_ReadTimeout = unReadTimeout;
     m_WriteTimeout = unWriteTimeout;
 
-    for (int i = 0; i < nConnNum; i++) {
-        //Create DB handle connect pool
-        Connection *pConn = CreateConnection();
-        if (NULL == pConn) {
-            return false;
+    //未设置连接数限制时固定为 nConnNum 个
+    if (0 == m_MaxConn) {
+        m_MinConn = m_MaxIdle = m_MaxConn = nConnNum < 1 ? 1 : nConnNum;
+    }
+    m_slots = new Slot[m_MaxConn];
+    m_empty_slots.clear();
+    for (int i = m_MaxConn - 1; i >= 0; i--) {
+        m_slots[i].pConn = NULL;
+        m_slots[i].state.store(SLOT_IN_USE);
+        m_slots[i].next.store(-1);
+        m_empty_slots.push_back(i);
+    }
+
+    //并行建立最小连接数个连接
+    memset(&m_startup, 0, sizeof(m_startup));
+    m_start_begin = util::get_monotonic_us();
+    m_start_tasks = m_MinConn;
+    int workers = m_ConnectParallel < m_MinConn ? m_ConnectParallel : m_MinConn;
+    for (int i = 0; i < workers; i++) {
+        pthread_t id;
+        if (0 != pthread_create(&id, NULL, CdbConncetPool::StartupWorker, this)) {
+            cout << "CdbConncetPool::CreateConnectionPool failed to create connect thread." << endl;
+            break;
         }
-        pConn->nNumber = i;
-        PutMsg(pConn);
+        m_start_threads.push_back(id);
     }
+    if (m_start_threads.empty())
+        StartupLoop();
 
+    int quorum = (0 == m_StartQuorum || m_StartQuorum > m_MinConn) ? m_MinConn : m_StartQuorum;
+    if (START_IN_BACKGROUND == m_StartQuorum)
+        quorum = 0;
+    int connected;
+    {
+        autoLock al(m_lock);
+        //等到达到法定数, 或失败的太多已经达不到
+        while (m_startup.connected < quorum && m_MinConn - m_startup.failed >= quorum)
+            pthread_cond_wait(&m_start_cond, &m_lock);
+        connected = m_startup.connected;
+    }
+    if (connected < quorum) {
+        cout << "CdbConncetPool::CreateConnectionPool only " << connected << " of " << quorum
+             << " connections are up." << endl;
+        AbortStartup();
+        return false;
+    }
+
+    if (!m_keeper.Start(1)) {
+        cout << "CdbConncetPool::CreateConnectionPool failed to start keeper thread." << endl;
+        AbortStartup();
+        return false;
+    }
+    m_keeper_started = true;
     return true;
 }
 
+void CdbConncetPool::AbortStartup() {
+    for (unsigned int i = 0; i < m_start_threads.size(); i++)
+        pthread_join(m_start_threads[i], NULL);
+    m_start_threads.clear();
+
+    vector<Connection *> conns;
+    autoLock al(m_lock);
+    TakeAllIdle(conns);
+    for (unsigned int i = 0; i < conns.size(); i++) {
+        RemoveConnection(conns[i]);
+        TerminateConnection(conns[i]);
+    }
+    //还有被取走的连接时保留 m_slots, 由 Stop 回收
+    if (0 == m_num) {
+        delete[] m_slots;
+        m_slots = NULL;
+        m_empty_slots.clear();
+    }
+}
+
 void CdbConncetPool::TerminateConnection(Connection *pConn) {
     if (NULL == pConn)
         return;
+    pConn->stmts.Clear();
     DisConnectDB(pConn->hDB);
     delete pConn;
     pConn = NULL;
 }
 
 Connection *CdbConncetPool::ReCreateConnection(Connection *pConn) {
-    cout << "enter ReCreateConnection" << endl;
     if (NULL == pConn) {
         cout << "pConn is NULL!we will return!" << endl;
         return NULL;
     }
-    int nNumber = pConn->nNumber;
+    cout << "CdbConncetPool::ReCreateConnection drop connection:" << pConn->nNumber << endl;
+    unsigned long nCheckoutTime = pConn->nCheckoutTime;
+    zcUtils::ConcurrencyLimiter *pPermit = pConn->pPermit;
+    {
+        //空出的名额由后台补足
+        autoLock al(m_lock);
+        RemoveConnection(pConn);
+        pthread_cond_signal(&m_keeper_cond);
+    }
     TerminateConnection(pConn);
 
-    while (1) {
-        pConn = CreateConnection();
-        if (NULL == pConn) {
-            cout << "CreateConnection failed,recreate connection...." << endl;
-            sleep(1);
-        } else {
-            pConn->nNumber = nNumber;
-            cout << "CreateConnection success!" << endl;
-            break;
+    pConn = TakeIdle(m_WaitTimeoutMs);
+    if (NULL == pConn) {
+        //调用者拿不到连接, 无法再归还, 这里释放并发许可
+        if (pPermit)
+            pPermit->release(false);
+        if (m_pBreaker)
+            m_pBreaker->onFailure();
+        return NULL;
+    }
+    pConn->nCheckoutTime = nCheckoutTime;
+    pConn->pPermit = pPermit;
+    pConn->bFailed = true;
+    return pConn;
+}
+
+bool CdbConncetPool::NeedGrow() const {
+    if (m_stop)
+        return false;
+    return m_num < m_MinConn || (m_waiters.load() > m_free_num.load() && m_num < m_MaxConn);
+}
+
+/*
+* 后台维护:
+* 补足最小连接数, 为等待者新建连接(建连失败间隔1秒重试)
+* 每 m_CheckInterval 秒回收和检查空闲连接
+*/
+void CdbConncetPool::KeeperLoop() {
+    unsigned long last_check = util::get_monotonic_us();
+    bool backoff = false;
+    pthread_mutex_lock(&m_lock);
+    while (!m_stop) {
+        if (backoff || !NeedGrow()) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&m_keeper_cond, &m_lock, &ts);
+            backoff = false;
+            if (m_stop)
+                break;
+        }
+
+        if (NeedGrow()) {
+            //先占名额, 建连时不持锁
+            ++m_num;
+            pthread_mutex_unlock(&m_lock);
+            Connection *pConn = CreateConnection();
+            pthread_mutex_lock(&m_lock);
+            if (NULL == pConn) {
+                --m_num;
+                backoff = true;
+                if (m_pBreaker)
+                    m_pBreaker->onFailure();
+                cout << "CdbConncetPool::KeeperLoop failed to create connection, total:" << m_num << endl;
+                continue;
+            }
+            //名额已在上面占过
+            AddConnection(pConn);
+            pthread_cond_signal(&m_idle_cond);
+            continue;
+        }
+
+        unsigned long now = util::get_monotonic_us();
+        unsigned long interval = m_CheckInterval > 0 ? m_CheckInterval : 1;
+        if (now - last_check >= interval * 1000000UL) {
+            last_check = now;
+            pthread_mutex_unlock(&m_lock);
+            CheckIdle();
+            pthread_mutex_lock(&m_lock);
         }
     }
+    pthread_mutex_unlock(&m_lock);
+}
 
-    return pConn;
-}
\ No newline at end of file
+void CdbConncetPool::CheckIdle() {
+    vector<Connection *> idle;
+    vector<Connection *> expired;
+    vector<Connection *> checking;
+    //取出全部空闲连接(包括留在各线程的), 按归还时间从旧到新排序
+    TakeAllIdle(idle);
+    sort(idle.begin(), idle.end(), LessLastUsed);
+    {
+        autoLock al(m_lock);
+        unsigned long now = util::get_monotonic_us();
+        //从最久未用的开始回收, 保留最小连接数
+        unsigned int i = 0;
+        for (; i < idle.size() && m_num > m_MinConn; i++) {
+            if ((int) (idle.size() - i) <= m_MaxIdle &&
+                (0 == m_IdleTimeout || now - idle[i]->nLastUsed < m_IdleTimeout * 1000000UL))
+                break;
+            RemoveConnection(idle[i]);
+            expired.push_back(idle[i]);
+        }
+        //闲置超过检查间隔的去 Ping, 其余按从旧到新放回, 最近用过的在栈顶
+        bool returned = false;
+        for (; i < idle.size(); i++) {
+            if (m_CheckInterval > 0 && now - idle[i]->nLastUsed >= m_CheckInterval * 1000000UL) {
+                checking.push_back(idle[i]);
+            } else {
+                PushFree(idle[i]->nNumber);
+                returned = true;
+            }
+        }
+        if (returned)
+            pthread_cond_broadcast(&m_idle_cond);
+    }
+
+    for (unsigned int i = 0; i < expired.size(); i++)
+        TerminateConnection(expired[i]);
+
+    vector<Connection *> alive;
+    vector<Connection *> dead;
+    for (unsigned int i = 0; i < checking.size(); i++) {
+        if (0 == checking[i]->hDB.Ping())
+            alive.push_back(checking[i]);
+        else
+            dead.push_back(checking[i]);
+    }
+
+    {
+        //放回时不更新 nLastUsed, 仍按上次使用的时间回收
+        autoLock al(m_lock);
+        for (unsigned int i = 0; i < alive.size(); i++)
+            PushFree(alive[i]->nNumber);
+        for (unsigned int i = 0; i < dead.size(); i++)
+            RemoveConnection(dead[i]);
+        if (!alive.empty())
+            pthread_cond_broadcast(&m_idle_cond);
+        if (!dead.empty())
+            pthread_cond_signal(&m_keeper_cond);
+        for (unsigned int i = 0; m_pBreaker && i < dead.size(); i++)
+            m_pBreaker->onFailure();
+    }
+    for (unsigned int i = 0; i < dead.size(); i++)
+        TerminateConnection(dead[i]);
+
+    if (!expired.empty() || !dead.empty())
+        cout << "CdbConncetPool::CheckIdle closed idle:" << expired.size() << ",dead:" << dead.size() << endl;
+}
@@ -3,27 +3,135 @@
 
 #include "threadUtil.h"
 #include <pthread.h>
+#include <string.h>
 #include <memory>
+#include <vector>
 #include "MysqlApi.h"
+#include "PreparedStmt.h"
+#include "rate_limiter.h"
+#include "atomic.h"
+#include "circuit_breaker.h"
 
 using namespace std;
 
 class Connection
 {
 public:
+    /* 在连接池中的槽位 */
     int nNumber;
+    /* 多节点连接池(CdbRoutedPool)中所属的节点, 单节点时为-1 */
+    int nEndpoint;
     int nCount;
+    /* 被取出的时间(单调时钟, us), 用于并发限流的耗时统计 */
+    unsigned long nCheckoutTime;
+    /* 最近一次归还的时间(单调时钟, us), 用于空闲回收和健康检查 */
+    unsigned long nLastUsed;
+    /* 本次使用中发生过重连, 归还时按失败反馈给并发限流 */
+    bool bFailed;
+    /* 取出时占用了许可的并发限流器, 归还时只还给它; NULL 表示没有占用 */
+    zcUtils::ConcurrencyLimiter *pPermit;
     MysqlApi::DataBase hDB;
+    /* 该连接上预处理过的语句, 连接重建后随新对象重新预处理 */
+    MysqlApi::StmtCache stmts;
 
-    Connection() : nNumber(-1), nCount(0) {}
+    Connection() : nNumber(-1), nEndpoint(-1), nCount(0), nCheckoutTime(0), nLastUsed(0), bFailed(false),
+                   pPermit(NULL) {}
     virtual ~Connection() {}
 };
 
+/*
+* 弹性连接池
+* 1 连接数在 [nMinConn, nMaxConn] 之间, 空闲连接不足时由后台线程按需新建, 调用者只等待空闲连接
+* 2 空闲连接后进先出, 最久未用的超过 unIdleTimeout 或空闲数超过 nMaxIdle 时关闭(不低于 nMinConn)
+* 3 后台线程每 unCheckInterval 秒对闲置超过该时间的连接 Ping, 失败则关闭, 由后台补足
+* 4 ReCreateConnection 不再阻塞重连: 关闭坏连接后换一个空闲连接返回, 重连由后台完成
+* 5 空闲连接放在无锁栈中, 取/还连接不加锁; 只有没有空闲连接需要等待时才用 m_lock
+* 6 可选的线程粘滞(SetStickyConnection): 归还的连接先留在本线程, 下次优先取回;
+*   其他线程没有空闲连接时可以抢走, 有线程在等待时直接放回共享栈
+* 7 GetConnection 可限定等待时间; 可选的熔断器(SetCircuitBreaker)在连续超时/失败后快速拒绝
+* 8 启动时并行建立连接, 每个新连接执行预热语句; 可在达到法定数后先返回, 其余在后台继续建立
+*/
 class CdbConncetPool
 {
 public:
+    /* 一直等待 */
+    static const unsigned long WAIT_FOREVER = (unsigned long) -1;
+    /* SetStartQuorum: 不等待, 全部连接在后台建立 */
+    static const int START_IN_BACKGROUND = -1;
+
+    struct PoolStats
+    {
+        /* 取到连接的次数 */
+        unsigned long checkouts;
+        /* 等待空闲连接超时的次数 */
+        unsigned long timeouts;
+        /* 被熔断器拒绝的次数 */
+        unsigned long breaker_rejected;
+        /* 被限流拒绝的次数 */
+        unsigned long limiter_rejected;
+        /* 取连接的累计/最长等待时间(us) */
+        unsigned long total_wait_us;
+        unsigned long max_wait_us;
+        int total;
+        int idle;
+        int waiters;
+    };
+
+    /* 启动耗时分解 */
+    struct StartupStats
+    {
+        int connected;
+        int failed;
+        /* 达到法定数的耗时 */
+        unsigned long quorum_ms;
+        /* 全部建完的耗时, 未完成为0 */
+        unsigned long total_ms;
+        /* 建连(不含预热)的累计/最长耗时 */
+        unsigned long total_connect_ms;
+        unsigned long max_connect_ms;
+        /* 预热的累计/最长耗时 */
+        unsigned long total_warmup_ms;
+        unsigned long max_warmup_ms;
+    };
+
 protected:
 private:
+    /* 后台维护线程 */
+    class Keeper : public ThreadPool
+    {
+    public:
+        Keeper(CdbConncetPool *pPool) : m_pPool(pPool) {}
+        virtual bool Stop() { return true; }
+
+    protected:
+        virtual int Run()
+        {
+            m_pPool->KeeperLoop();
+            return 0;
+        }
+
+    private:
+        CdbConncetPool *m_pPool;
+    };
+
+    /* 槽位状态, 高位为代数(槽位换连接时加1), 防止线程粘滞的旧记录抢到新连接 */
+    enum
+    {
+        SLOT_IDLE = 0,
+        SLOT_IN_USE = 1,
+        SLOT_STICKY = 2,
+        SLOT_STATE_MASK = 3,
+        SLOT_GEN_STEP = 4,
+    };
+
+    struct Slot
+    {
+        Connection *pConn;
+        zcUtils::Atomic<unsigned long> state;
+        /* 空闲栈中的下一个槽位, -1为栈底 */
+        zcUtils::Atomic<int> next;
+    };
+
     pthread_mutex_t m_lock;
 
     static auto_ptr<CdbConncetPool> gInstance;
@@ -37,22 +145,92 @@ private:
     unsigned int m_ReadTimeout;
     unsigned int m_WriteTimeout;
 
-    SafeQueue<Connection *> m_queue;
-    sem_t m_sem;
+    /* 槽位, 个数为最大连接数 */
+    Slot *m_slots;
+    /* 没有连接的槽位, 需持有 m_lock */
+    vector<int> m_empty_slots;
+    /* 空闲栈顶: 高32位为版本号(防ABA), 低32位为槽位+1, 0表示空 */
+    zcUtils::Atomic<unsigned long> m_free_head;
+    zcUtils::Atomic<int> m_free_num;
+    bool m_sticky;
+    /* 有空闲连接或停止时通知 */
+    pthread_cond_t m_idle_cond;
+    /* 唤醒后台线程 */
+    pthread_cond_t m_keeper_cond;
     bool m_initialized;
     bool m_stop;
+    /* 当前连接数(含被占用和正在新建的) */
     int m_num;
+    /* 等待空闲连接的调用者数, 在 m_lock 内修改 */
+    zcUtils::Atomic<int> m_waiters;
+
+    int m_MinConn;
+    int m_MaxIdle;
+    int m_MaxConn;
+    unsigned int m_IdleTimeout;
+    unsigned int m_CheckInterval;
+
+    Keeper m_keeper;
+    bool m_keeper_started;
+
+    /* 可选的限流保护, 不持有所有权 */
+    zcUtils::TokenBucket *m_pRateLimiter;
+    unsigned long m_RateWaitMs;
+    zcUtils::ConcurrencyLimiter *m_pConcurrencyLimiter;
+    unsigned long m_ConcurrencyWaitMs;
+    zcUtils::CircuitBreaker *m_pBreaker;
+    /* GetConnection() 的默认等待时间 */
+    unsigned long m_WaitTimeoutMs;
+
+    zcUtils::Atomic<unsigned long> m_stat_checkouts;
+    zcUtils::Atomic<unsigned long> m_stat_timeouts;
+    zcUtils::Atomic<unsigned long> m_stat_breaker_rejected;
+    zcUtils::Atomic<unsigned long> m_stat_limiter_rejected;
+    zcUtils::Atomic<unsigned long> m_stat_total_wait_us;
+    zcUtils::Atomic<unsigned long> m_stat_max_wait_us;
+
+    /* 新连接执行的会话语句和预处理的语句 */
+    vector<string> m_session_sqls;
+    vector<string> m_warmup_stmts;
+    int m_ConnectParallel;
+    int m_StartQuorum;
+    /* 启动时的建连线程, Stop 时回收 */
+    vector<pthread_t> m_start_threads;
+    /* 还没开始建的启动连接数 */
+    int m_start_tasks;
+    unsigned long m_start_begin;
+    StartupStats m_startup;
+    pthread_cond_t m_start_cond;
 
 public:
-    CdbConncetPool() : m_initialized(false), m_stop(false), m_num(10)
+    CdbConncetPool() : m_slots(NULL), m_free_head(0), m_free_num(0), m_sticky(false),
+                       m_initialized(false), m_stop(false), m_num(0), m_waiters(0),
+                       m_MinConn(0), m_MaxIdle(0), m_MaxConn(0), m_IdleTimeout(300), m_CheckInterval(30),
+                       m_keeper(this), m_keeper_started(false),
+                       m_pRateLimiter(NULL), m_RateWaitMs(0), m_pConcurrencyLimiter(NULL), m_ConcurrencyWaitMs(0),
+                       m_pBreaker(NULL), m_WaitTimeoutMs(WAIT_FOREVER), m_stat_checkouts(0), m_stat_timeouts(0),
+                       m_stat_breaker_rejected(0), m_stat_limiter_rejected(0), m_stat_total_wait_us(0), m_stat_max_wait_us(0),
+                       m_ConnectParallel(8), m_StartQuorum(0), m_start_tasks(0), m_start_begin(0)
     {
+        memset(&m_startup, 0, sizeof(m_startup));
         pthread_mutex_init(&m_lock, NULL);
+        //等待的期限按单调时钟计算, 不受调整系统时间的影响
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&m_idle_cond, &attr);
+        pthread_cond_init(&m_keeper_cond, &attr);
+        pthread_cond_init(&m_start_cond, &attr);
+        pthread_condattr_destroy(&attr);
     }
     ~CdbConncetPool()
     {
         Stop();
-        sem_destroy(&m_sem);
+        pthread_cond_destroy(&m_start_cond);
+        pthread_cond_destroy(&m_keeper_cond);
+        pthread_cond_destroy(&m_idle_cond);
         pthread_mutex_destroy(&m_lock);
+        delete[] m_slots;
     }
 
     static CdbConncetPool *Instance();
@@ -61,15 +239,68 @@ public:
 
     bool PutMsg(Connection *pConn);
 
+    /*
+     * 连接数限制, 需在 CreateConnectionPool 之前调用
+     * 不调用则固定为 CreateConnectionPool 的 nConnNum 个连接(仍有健康检查)
+     * unIdleTimeout 为0则不按时间回收, unCheckInterval 为0则不做健康检查
+     */
+    bool SetPoolLimits(int nMinConn, int nMaxIdle, int nMaxConn, unsigned int unIdleTimeout = 300, unsigned int unCheckInterval = 30);
+
+    /* 归还的连接留在本线程(每个线程一个), 需在 CreateConnectionPool 之前调用 */
+    void SetStickyConnection(bool bSticky);
+
+    /*
+     * 启动参数, 需在 CreateConnectionPool 之前调用
+     * SetConnectParallel 同时建立的连接数上限
+     * SetStartQuorum 建好 nQuorum 个连接即返回, 其余在后台继续; 0为全部建好才返回,
+     *     START_IN_BACKGROUND 为立即返回, 建连失败由后台线程重试
+     */
+    void SetConnectParallel(int nParallel);
+    void SetStartQuorum(int nQuorum);
+    /*
+     * 新连接的预热, 需在 CreateConnectionPool 之前调用, 对后台新建的连接同样生效
+     * AddSessionSQL 如 "set names utf8mb4", 失败则放弃该连接
+     * AddWarmUpStatement 预处理到连接的语句缓存中, 失败只打日志, 用时再预处理
+     */
+    void AddSessionSQL(const string &sql);
+    void AddWarmUpStatement(const string &sql);
+
+    /* 启动时建立 nMinConn 个连接(并行), 达不到法定数返回false */
     bool CreateConnectionPool(const char *pDbServer, const char *pDbDatabase, const char *pDbUser, const char *pDbPwd, unsigned int pDport,
                               int nConnNum = 1, unsigned int unConnectTimeout = 10, unsigned int unReadTimeout = 3, unsigned int unWriteTimeout = 10);
 
+    /*
+     * 获取连接前的可选限流:
+     * SetRateLimiter 限制每秒获取连接(即下发查询)的次数
+     * SetConcurrencyLimiter 限制同时被占用的连接数, 自适应模式下按归还时的耗时/失败调整
+     * unWaitMs 为等待许可的最长时间, 超时则 GetConnection 返回NULL
+     */
+    void SetRateLimiter(zcUtils::TokenBucket *pLimiter, unsigned long unWaitMs = 0);
+    void SetConcurrencyLimiter(zcUtils::ConcurrencyLimiter *pLimiter, unsigned long unWaitMs = 0);
+
+    /*
+     * 熔断器, 不持有所有权
+     * 取连接超时、ReCreateConnection、后台建连失败计为失败, 正常归还计为成功;
+     * 打开期间 GetConnection 直接返回NULL, 到期后放少量请求试探
+     */
+    void SetCircuitBreaker(zcUtils::CircuitBreaker *pBreaker);
+    /* GetConnection() 等待空闲连接的最长时间, 默认一直等待 */
+    void SetWaitTimeout(unsigned long unTimeoutMs);
+
     Connection *GetConnection();
+    /* 最多等待 unTimeoutMs 毫秒(含限流的等待), 0则只取现成的, 超时返回NULL */
+    Connection *GetConnection(unsigned long unTimeoutMs);
 
     void ReleaseConnection(Connection *pConn);
     void TerminateConnection(Connection *pConn);
+    /* 关闭坏连接, 返回另一个空闲连接(沿用取出时间, 标记为失败), 停止时返回NULL */
     Connection *ReCreateConnection(Connection *pConn);
 
+    int GetTotalNum();
+    int GetIdleNum();
+    void GetStats(PoolStats &stats);
+    void GetStartupStats(StartupStats &stats);
+
     bool isInitialized()
     {
         autoLock al(m_lock);
@@ -82,7 +313,32 @@ private:
     short ConnectDB(MysqlApi::DataBase &hDB);
     short InitDatabase();
     short DisConnectDB(MysqlApi::DataBase &hDB);
-    Connection *CreateConnection();
+    /* 建连并预热, 可返回两部分的耗时(us) */
+    Connection *CreateConnection(unsigned long *pConnectUs = NULL, unsigned long *pWarmUpUs = NULL);
+    bool WarmUp(Connection *pConn);
+    static void *StartupWorker(void *arg);
+    void StartupLoop();
+    /* 启动失败时等待启动线程并关闭已建好的连接, 之后可以再次 CreateConnectionPool */
+    void AbortStartup();
+
+    /* 等待并取出一个空闲连接, 超时或停止时返回NULL */
+    Connection *TakeIdle(unsigned long unTimeoutMs);
+    /* 无锁空闲栈, 没有返回-1 */
+    void PushFree(int nSlot);
+    int PopFree();
+    /* 抢一个留在其他线程的连接, 没有返回-1 */
+    int StealSticky();
+    /* 取回当前线程留下的连接 */
+    Connection *TakeSticky();
+    /* 取出所有空闲连接(含线程留下的) */
+    void TakeAllIdle(vector<Connection *> &conns);
+    /* 以下需持有 m_lock */
+    bool NeedGrow() const;
+    void AddConnection(Connection *pConn);
+    void RemoveConnection(Connection *pConn);
+    void KeeperLoop();
+    /* 回收超时的空闲连接, Ping 闲置较久的连接 */
+    void CheckIdle();
 };
 
 #endif
\ No newline at end of file
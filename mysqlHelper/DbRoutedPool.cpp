@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <unistd.h>
+
+#include "DbRoutedPool.h"
+#include "timeval.h"
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 多节点连接池
+*/
+CdbRoutedPool::CdbRoutedPool()
+        : m_mode(BALANCE_LEAST_OUTSTANDING), m_ejection(5, 10000, 1, 1), m_WaitTimeoutMs(3000), m_started(false) {
+}
+
+CdbRoutedPool::~CdbRoutedPool() {
+    for (unsigned int i = 0; i < m_endpoints.size(); i++) {
+        delete m_endpoints[i]->pool;
+        delete m_endpoints[i]->breaker;
+        delete m_endpoints[i];
+    }
+}
+
+void CdbRoutedPool::SetBalanceMode(BALANCE_MODE mode) {
+    m_mode = mode;
+}
+
+void CdbRoutedPool::SetEjection(const zcUtils::CircuitBreaker::Config &config) {
+    m_ejection = config;
+}
+
+void CdbRoutedPool::SetWaitTimeout(unsigned long unTimeoutMs) {
+    m_WaitTimeoutMs = unTimeoutMs;
+}
+
+bool CdbRoutedPool::AddEndpoint(const char *pDbServer, unsigned int unPort, bool bPrimary, int nWeight,
+                                int nMinConn, int nMaxConn) {
+    if (m_started) {
+        cout << "CdbRoutedPool::AddEndpoint must be called before Start." << endl;
+        return false;
+    }
+    Endpoint *endpoint = new Endpoint;
+    endpoint->server = pDbServer;
+    endpoint->port = unPort;
+    endpoint->primary = bPrimary;
+    endpoint->weight = nWeight < 1 ? 1 : nWeight;
+    endpoint->min_conn = nMinConn;
+    endpoint->max_conn = nMaxConn;
+    m_endpoints.push_back(endpoint);
+    return true;
+}
+
+bool CdbRoutedPool::Start(const char *pDbDatabase, const char *pDbUser, const char *pDbPwd,
+                          unsigned int unConnectTimeout, unsigned int unReadTimeout, unsigned int unWriteTimeout) {
+    if (m_started)
+        return false;
+
+    for (unsigned int i = 0; i < m_endpoints.size(); i++) {
+        Endpoint *endpoint = m_endpoints[i];
+        endpoint->breaker = new zcUtils::CircuitBreaker(m_ejection);
+        endpoint->pool = new CdbConncetPool;
+        endpoint->pool->Init();
+        if (!endpoint->pool->SetPoolLimits(endpoint->min_conn, endpoint->max_conn, endpoint->max_conn))
+            return false;
+        endpoint->pool->SetCircuitBreaker(endpoint->breaker);
+        //各节点并行在后台建连, 连不上的由各自的后台线程重试, 失败计入熔断器
+        endpoint->pool->SetStartQuorum(CdbConncetPool::START_IN_BACKGROUND);
+        if (!endpoint->pool->CreateConnectionPool(endpoint->server.c_str(), pDbDatabase, pDbUser, pDbPwd,
+                                                  endpoint->port, endpoint->min_conn, unConnectTimeout,
+                                                  unReadTimeout, unWriteTimeout))
+            return false;
+    }
+
+    //等到有一个主库连上, 或所有主库的启动连接都失败
+    while (true) {
+        bool pending = false;
+        for (unsigned int i = 0; i < m_endpoints.size(); i++) {
+            Endpoint *endpoint = m_endpoints[i];
+            if (!endpoint->primary)
+                continue;
+            CdbConncetPool::StartupStats stats;
+            endpoint->pool->GetStartupStats(stats);
+            //不预建连接的主库用时再连
+            if (stats.connected > 0 || 0 == endpoint->min_conn) {
+                m_started = true;
+                return true;
+            }
+            if (stats.failed < endpoint->min_conn)
+                pending = true;
+        }
+        if (!pending)
+            break;
+        usleep(10000);
+    }
+    cout << "CdbRoutedPool::Start no primary is available." << endl;
+    return false;
+}
+
+double CdbRoutedPool::Score(const Endpoint &endpoint) const {
+    double load = endpoint.outstanding.load() + 1;
+    if (BALANCE_LATENCY_EWMA == m_mode)
+        load *= (double) endpoint.ewma_us.load() + 1;
+    return load / endpoint.weight;
+}
+
+static bool LessScore(const pair<double, int> &a, const pair<double, int> &b) {
+    return a.first < b.first;
+}
+
+void CdbRoutedPool::Candidates(DB_ROUTE route, vector<int> &candidates) const {
+    vector<pair<double, int> > replicas;
+    vector<pair<double, int> > primaries;
+    for (unsigned int i = 0; i < m_endpoints.size(); i++) {
+        const Endpoint &endpoint = *m_endpoints[i];
+        if (endpoint.primary)
+            primaries.push_back(make_pair(Score(endpoint), (int) i));
+        else if (DB_ROUTE_READ == route)
+            replicas.push_back(make_pair(Score(endpoint), (int) i));
+    }
+    sort(replicas.begin(), replicas.end(), LessScore);
+    sort(primaries.begin(), primaries.end(), LessScore);
+    //读请求从库在前, 主库兜底
+    for (unsigned int i = 0; i < replicas.size(); i++)
+        candidates.push_back(replicas[i].second);
+    for (unsigned int i = 0; i < primaries.size(); i++)
+        candidates.push_back(primaries[i].second);
+}
+
+Connection *CdbRoutedPool::Checkout(int nEndpoint, unsigned long unTimeoutMs) {
+    Endpoint &endpoint = *m_endpoints[nEndpoint];
+    //先计入, 让并发的选择看到
+    endpoint.outstanding.fetchAdd(1);
+    Connection *pConn = endpoint.pool->GetConnection(unTimeoutMs);
+    if (NULL == pConn) {
+        endpoint.outstanding.fetchSub(1);
+        return NULL;
+    }
+    pConn->nEndpoint = nEndpoint;
+    endpoint.checkouts.fetchAdd(1);
+    return pConn;
+}
+
+/*
+* 按分数依次试取现成的连接(被摘除的节点会立即拒绝)
+* 都没有时在分数最低且未被摘除的节点上等待
+*/
+Connection *CdbRoutedPool::GetConnection(DB_ROUTE route) {
+    if (!m_started)
+        return NULL;
+    vector<int> candidates;
+    Candidates(route, candidates);
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        Connection *pConn = Checkout(candidates[i], 0);
+        if (pConn)
+            return pConn;
+    }
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        if (zcUtils::CircuitBreaker::STATE_OPEN == m_endpoints[candidates[i]]->breaker->getState())
+            continue;
+        return Checkout(candidates[i], m_WaitTimeoutMs);
+    }
+    cout << "CdbRoutedPool::GetConnection no endpoint is available, route:" << route << endl;
+    return NULL;
+}
+
+void CdbRoutedPool::ReleaseConnection(Connection *pConn) {
+    if (NULL == pConn)
+        return;
+    if (pConn->nEndpoint < 0 || pConn->nEndpoint >= (int) m_endpoints.size()) {
+        cout << "CdbRoutedPool::ReleaseConnection unknown endpoint:" << pConn->nEndpoint << endl;
+        return;
+    }
+    Endpoint &endpoint = *m_endpoints[pConn->nEndpoint];
+    //占用时长的EWMA, 新样本占1/5
+    unsigned long sample = util::get_monotonic_us() - pConn->nCheckoutTime;
+    unsigned long ewma = endpoint.ewma_us.load();
+    while (!endpoint.ewma_us.compareExchange(ewma, 0 == ewma ? sample : (ewma * 4 + sample) / 5));
+    endpoint.outstanding.fetchSub(1);
+    endpoint.pool->ReleaseConnection(pConn);
+}
+
+Connection *CdbRoutedPool::ReCreateConnection(Connection *pConn) {
+    if (NULL == pConn)
+        return NULL;
+    int nEndpoint = pConn->nEndpoint;
+    Endpoint &endpoint = *m_endpoints[nEndpoint];
+    pConn = endpoint.pool->ReCreateConnection(pConn);
+    if (NULL == pConn) {
+        endpoint.outstanding.fetchSub(1);
+        return NULL;
+    }
+    pConn->nEndpoint = nEndpoint;
+    return pConn;
+}
+
+void CdbRoutedPool::GetEndpointStats(vector<EndpointStats> &stats) {
+    stats.resize(m_endpoints.size());
+    for (unsigned int i = 0; i < m_endpoints.size(); i++) {
+        Endpoint &endpoint = *m_endpoints[i];
+        EndpointStats &stat = stats[i];
+        stat.server = endpoint.server;
+        stat.port = endpoint.port;
+        stat.primary = endpoint.primary;
+        stat.weight = endpoint.weight;
+        stat.state = endpoint.breaker ? endpoint.breaker->getState() : zcUtils::CircuitBreaker::STATE_OPEN;
+        stat.outstanding = endpoint.outstanding.load();
+        stat.ewma_us = endpoint.ewma_us.load();
+        stat.checkouts = endpoint.checkouts.load();
+        stat.total = endpoint.pool ? endpoint.pool->GetTotalNum() : 0;
+        stat.idle = endpoint.pool ? endpoint.pool->GetIdleNum() : 0;
+    }
+}
+/* -------------------------------------------------- */
@@ -0,0 +1,122 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _DB_ROUTED_POOL_H_
+#define _DB_ROUTED_POOL_H_
+
+#include <string>
+#include <vector>
+
+#include "DbConnectPool.h"
+#include "circuit_breaker.h"
+
+/* 请求的去向 */
+enum DB_ROUTE
+{
+    /* 写(以及需要读到最新数据的读)走主库 */
+    DB_ROUTE_WRITE = 0,
+    /* 只读, 优先走从库, 没有可用的从库时走主库 */
+    DB_ROUTE_READ = 1,
+};
+
+/*
+* 多节点连接池, 读写分离
+* 1 每个节点(主库或从库, 带权重)一个 CdbConncetPool, 连接数/健康检查等沿用单节点连接池
+* 2 读请求在可用的从库间按 最少未归还连接数 或 延迟EWMA 选择, 写请求只走主库
+* 3 每个节点一个熔断器: 取连接超时、连接断开、后台建连/Ping 失败累计到阈值后摘除该节点,
+*   open_ms 后放一个请求试探, 成功则恢复
+*
+* 用法:
+*     CdbRoutedPool &router = Singleton<CdbRoutedPool>::instance();
+*     router.AddEndpoint("10.0.0.1", 3306, true);
+*     router.AddEndpoint("10.0.0.2", 3306, false, 2);
+*     router.Start("db", "user", "pwd");
+*     PLMySql mysql_db(DB_ROUTE_READ);    // 启动后 PLMySql 经由此连接池
+*/
+class CdbRoutedPool
+{
+public:
+    enum BALANCE_MODE
+    {
+        /* 未归还连接数/权重 最小 */
+        BALANCE_LEAST_OUTSTANDING = 0,
+        /* 延迟EWMA * (未归还连接数+1) / 权重 最小 */
+        BALANCE_LATENCY_EWMA = 1,
+    };
+
+    struct EndpointStats
+    {
+        string server;
+        unsigned int port;
+        bool primary;
+        int weight;
+        zcUtils::CircuitBreaker::STATE state;
+        int outstanding;
+        /* 连接占用时长的EWMA(us) */
+        unsigned long ewma_us;
+        unsigned long checkouts;
+        int total;
+        int idle;
+    };
+
+    CdbRoutedPool();
+    ~CdbRoutedPool();
+
+    /* 以下需在 Start 之前调用 */
+    void SetBalanceMode(BALANCE_MODE mode);
+    /* 节点摘除的条件和时长, 默认连续5次失败摘除10秒 */
+    void SetEjection(const zcUtils::CircuitBreaker::Config &config);
+    /* 等待连接的最长时间, 默认3秒 */
+    void SetWaitTimeout(unsigned long unTimeoutMs);
+    bool AddEndpoint(const char *pDbServer, unsigned int unPort, bool bPrimary, int nWeight = 1,
+                     int nMinConn = 2, int nMaxConn = 16);
+
+    /* 连接所有节点, 至少有一个主库可用时返回true */
+    bool Start(const char *pDbDatabase, const char *pDbUser, const char *pDbPwd,
+               unsigned int unConnectTimeout = 10, unsigned int unReadTimeout = 3, unsigned int unWriteTimeout = 10);
+    bool IsStarted() const { return m_started; }
+
+    Connection *GetConnection(DB_ROUTE route);
+    void ReleaseConnection(Connection *pConn);
+    /* 关闭坏连接, 返回同一节点的另一个连接 */
+    Connection *ReCreateConnection(Connection *pConn);
+
+    void GetEndpointStats(vector<EndpointStats> &stats);
+
+private:
+    struct Endpoint
+    {
+        string server;
+        unsigned int port;
+        bool primary;
+        int weight;
+        int min_conn;
+        int max_conn;
+        CdbConncetPool *pool;
+        zcUtils::CircuitBreaker *breaker;
+        zcUtils::Atomic<int> outstanding;
+        zcUtils::Atomic<unsigned long> ewma_us;
+        zcUtils::Atomic<unsigned long> checkouts;
+
+        Endpoint() : port(0), primary(false), weight(1), min_conn(0), max_conn(0), pool(NULL), breaker(NULL) {}
+    };
+
+    /* Don't need copy or assignment */
+    CdbRoutedPool(const CdbRoutedPool &);
+    CdbRoutedPool &operator=(const CdbRoutedPool &);
+
+    double Score(const Endpoint &endpoint) const;
+    /* 按分数从低到高排列可选的节点 */
+    void Candidates(DB_ROUTE route, vector<int> &candidates) const;
+    Connection *Checkout(int nEndpoint, unsigned long unTimeoutMs);
+
+private:
+    vector<Endpoint *> m_endpoints;
+    BALANCE_MODE m_mode;
+    zcUtils::CircuitBreaker::Config m_ejection;
+    unsigned long m_WaitTimeoutMs;
+    bool m_started;
+};
+
+#endif
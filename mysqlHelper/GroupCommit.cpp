@@ -0,0 +1,316 @@
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "GroupCommit.h"
+
+/* mysqld_error.h 中的定义, mysql.h 不包含它 */
+#ifndef ER_LOCK_DEADLOCK
+#define ER_LOCK_DEADLOCK 1213
+#endif
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 组提交中一个操作的结果
+*/
+GroupCommitFuture::GroupCommitFuture() : m_result(-1), m_errno(0) {
+    sem_init(&m_sem, 0, 0);
+}
+
+GroupCommitFuture::~GroupCommitFuture() {
+    sem_destroy(&m_sem);
+}
+
+void GroupCommitFuture::Done(long result, unsigned int err_no, const string &error) {
+    m_result = result;
+    m_errno = err_no;
+    m_error = error;
+    sem_post(&m_sem);
+}
+
+bool GroupCommitFuture::Wait(unsigned long timeout_ms) {
+    if (0 == timeout_ms) {
+        while (sem_wait(&m_sem) != 0) {
+            if (errno != EINTR)
+                return false;
+        }
+        return true;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(&m_sem, &ts) != 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 组提交
+*/
+GroupCommitter::GroupCommitter(CdbConncetPool &pool, const Config &config)
+        : m_pool(pool), m_config(config), m_pConn(NULL), m_running(false), m_stopping(false),
+          m_commits(0), m_committed(0), m_failed(0), m_retries(0) {
+    if (0 == m_config.max_batch)
+        m_config.max_batch = 1;
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_ready, NULL);
+}
+
+GroupCommitter::~GroupCommitter() {
+    Stop();
+    pthread_cond_destroy(&m_ready);
+    pthread_mutex_destroy(&m_lock);
+}
+
+unsigned long GroupCommitter::NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+bool GroupCommitter::IsAbortError(unsigned int err) {
+    return CR_SERVER_GONE_ERROR == err || CR_SERVER_LOST == err || ER_LOCK_DEADLOCK == err;
+}
+
+bool GroupCommitter::Start() {
+    {
+        autoLock al(m_lock);
+        if (m_running)
+            return false;
+        m_running = true;
+        m_stopping = false;
+    }
+    if (!start("group_commit")) {
+        cout << "GroupCommitter::Start failed to start thread." << endl;
+        autoLock al(m_lock);
+        m_running = false;
+        return false;
+    }
+    return true;
+}
+
+void GroupCommitter::Stop() {
+    {
+        autoLock al(m_lock);
+        if (!m_running)
+            return;
+        m_stopping = true;
+        pthread_cond_broadcast(&m_ready);
+    }
+    //后台线程执行完排队的操作, 归还连接后自行退出; 不能用 join, 它先 pthread_cancel,
+    //线程可能在等待条件变量时带着 m_lock 被取消, 或在事务执行到一半时退出, 排队的 future 永远不会完成
+    stop();
+    join2(0);
+    autoLock al(m_lock);
+    m_running = false;
+}
+
+unsigned long GroupCommitter::GetQueueSize() {
+    autoLock al(m_lock);
+    return m_queue.size();
+}
+
+bool GroupCommitter::Submit(const string &sql, GroupCommitFuture *future) {
+    return Submit(vector<string>(1, sql), future);
+}
+
+bool GroupCommitter::Submit(const vector<string> &sqls, GroupCommitFuture *future) {
+    if (sqls.empty() || NULL == future)
+        return false;
+    Operation *op = new Operation;
+    op->sqls = sqls;
+    op->future = future;
+    op->result = -1;
+    op->err_no = 0;
+    op->submit_ms = NowMs();
+
+    autoLock al(m_lock);
+    if (!m_running || m_stopping || m_queue.size() >= m_config.max_queue) {
+        delete op;
+        return false;
+    }
+    m_queue.push_back(op);
+    //第一个操作开始计时, 凑满一批时立即执行
+    if (1 == m_queue.size() || m_queue.size() >= m_config.max_batch)
+        pthread_cond_signal(&m_ready);
+    return true;
+}
+
+bool GroupCommitter::TakeBatch(vector<Operation *> &batch) {
+    autoLock al(m_lock);
+    while (m_queue.empty() && !m_stopping)
+        pthread_cond_wait(&m_ready, &m_lock);
+    if (m_queue.empty())
+        return false;
+
+    if (m_config.window_ms > 0 && m_queue.size() < m_config.max_batch && !m_stopping) {
+        unsigned long waited = NowMs() - m_queue.front()->submit_ms;
+        if (waited < m_config.window_ms) {
+            unsigned long wait_ms = m_config.window_ms - waited;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += wait_ms / 1000;
+            ts.tv_nsec += (wait_ms % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec += 1;
+                ts.tv_nsec -= 1000000000;
+            }
+            while (m_queue.size() < m_config.max_batch && !m_stopping) {
+                if (ETIMEDOUT == pthread_cond_timedwait(&m_ready, &m_lock, &ts))
+                    break;
+            }
+        }
+    }
+
+    while (!m_queue.empty() && batch.size() < m_config.max_batch) {
+        batch.push_back(m_queue.front());
+        m_queue.pop_front();
+    }
+    return true;
+}
+
+unsigned int GroupCommitter::Control(const char *sql) {
+    MYSQL *mysql = m_pConn->hDB.GetMysql();
+    if (0 == mysql_real_query(mysql, sql, (unsigned long) strlen(sql)))
+        return 0;
+    unsigned int err = mysql_errno(mysql);
+    return err ? err : CR_UNKNOWN_ERROR;
+}
+
+/*
+* 在一个事务中执行一批操作
+* 单条语句的操作不设保存点: 语句失败时 InnoDB 只回滚该语句, 事务中之前的修改不受影响
+*/
+GroupCommitter::BatchResult GroupCommitter::RunTransaction(vector<Operation *> &batch, unsigned int &err_no,
+                                                           string &error) {
+    MYSQL *mysql = m_pConn->hDB.GetMysql();
+    //关闭自动重连: 事务中途断线时客户端库会在新会话上以自动提交重发语句, 之后的语句和 COMMIT 都会成功,
+    //之前的操作却已被服务器回滚. 关闭后断线直接返回 CR_SERVER_LOST, 整批重试
+    my_bool reconnect = 0;
+    mysql_options(mysql, MYSQL_OPT_RECONNECT, &reconnect);
+    err_no = Control("START TRANSACTION");
+    if (err_no) {
+        error = mysql_error(mysql);
+        return BATCH_ABORTED;
+    }
+    for (unsigned int i = 0; i < batch.size(); i++) {
+        Operation *op = batch[i];
+        op->result = 0;
+        op->err_no = 0;
+        op->error.clear();
+        bool savepoint = op->sqls.size() > 1;
+        if (savepoint && (err_no = Control("SAVEPOINT group_commit_op")) != 0) {
+            error = mysql_error(mysql);
+            Control("ROLLBACK");
+            return BATCH_ABORTED;
+        }
+        for (unsigned int k = 0; k < op->sqls.size(); k++) {
+            int rt = m_pConn->hDB.ExecQuery(op->sqls[k]);
+            if (rt < 0) {
+                op->result = -1;
+                op->err_no = mysql_errno(mysql);
+                op->error = mysql_error(mysql);
+                break;
+            }
+            op->result += rt;
+        }
+        if (op->result >= 0)
+            continue;
+        //整个事务已被服务器回滚或连接已断开
+        if (IsAbortError(op->err_no)) {
+            err_no = op->err_no;
+            error = op->error;
+            Control("ROLLBACK");
+            return BATCH_ABORTED;
+        }
+        if (savepoint && (err_no = Control("ROLLBACK TO SAVEPOINT group_commit_op")) != 0) {
+            error = mysql_error(mysql);
+            Control("ROLLBACK");
+            return BATCH_ABORTED;
+        }
+    }
+    err_no = Control("COMMIT");
+    if (err_no) {
+        error = mysql_error(mysql);
+        if (CR_SERVER_GONE_ERROR == err_no || CR_SERVER_LOST == err_no)
+            return BATCH_UNKNOWN;
+        Control("ROLLBACK");
+        return BATCH_ABORTED;
+    }
+    return BATCH_COMMITTED;
+}
+
+void GroupCommitter::Finish(vector<Operation *> &batch, unsigned int err_no, const string &error) {
+    for (unsigned int i = 0; i < batch.size(); i++) {
+        Operation *op = batch[i];
+        if (err_no) {
+            op->result = -1;
+            op->err_no = err_no;
+            op->error = error;
+        }
+        if (op->result >= 0)
+            m_committed.fetchAdd(1);
+        else
+            m_failed.fetchAdd(1);
+        op->future->Done(op->result, op->err_no, op->error);
+        delete op;
+    }
+    batch.clear();
+}
+
+void GroupCommitter::ExecuteBatch(vector<Operation *> &batch) {
+    unsigned int err_no = CR_SERVER_GONE_ERROR;
+    string error = "no db connection";
+    for (int attempt = 0; attempt <= m_config.max_retries; attempt++) {
+        if (attempt > 0)
+            m_retries.fetchAdd(1);
+        if (NULL == m_pConn) {
+            m_pConn = m_pool.GetConnection(m_config.conn_wait_ms);
+            if (NULL == m_pConn) {
+                err_no = CR_SERVER_GONE_ERROR;
+                error = "no db connection";
+                continue;
+            }
+        }
+        BatchResult result = RunTransaction(batch, err_no, error);
+        if (BATCH_COMMITTED == result) {
+            m_commits.fetchAdd(1);
+            Finish(batch, 0, "");
+            return;
+        }
+        if (CR_SERVER_GONE_ERROR == err_no || CR_SERVER_LOST == err_no) {
+            cout << "GroupCommitter::ExecuteBatch connection lost, retry:" << attempt << ",err:" << error << endl;
+            m_pConn = m_pool.ReCreateConnection(m_pConn);
+        }
+        if (BATCH_UNKNOWN == result) {
+            error = "commit result unknown: " + error;
+            break;
+        }
+    }
+    cout << "GroupCommitter::ExecuteBatch failed to commit " << batch.size() << " operations, err:" << error << endl;
+    Finish(batch, err_no, error);
+}
+
+int GroupCommitter::run() {
+    vector<Operation *> batch;
+    while (TakeBatch(batch))
+        ExecuteBatch(batch);
+    if (m_pConn) {
+        //归还前恢复连接池的自动重连设置
+        my_bool reconnect = 1;
+        mysql_options(m_pConn->hDB.GetMysql(), MYSQL_OPT_RECONNECT, &reconnect);
+        m_pool.ReleaseConnection(m_pConn);
+        m_pConn = NULL;
+    }
+    return 0;
+}
+/* -------------------------------------------------- */
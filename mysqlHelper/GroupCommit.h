@@ -0,0 +1,161 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _GROUP_COMMIT_H_
+#define _GROUP_COMMIT_H_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "thread.h"
+#include "DbConnectPool.h"
+
+/*
+* 以等待的方式取组提交中一个操作的结果
+* 完成前 future 必须有效(Wait 超时后也会被写入)
+*/
+class GroupCommitFuture
+{
+public:
+    GroupCommitFuture();
+    ~GroupCommitFuture();
+
+    /* 等待完成, timeout_ms 为0则一直等待, 超时返回false */
+    bool Wait(unsigned long timeout_ms = 0);
+
+    /* 成功为各语句影响的行数之和, 失败为-1 */
+    long GetResult() const { return m_result; }
+    unsigned int GetErrno() const { return m_errno; }
+    const string &GetError() const { return m_error; }
+
+private:
+    friend class GroupCommitter;
+
+    void Done(long result, unsigned int err_no, const string &error);
+
+    /* Don't need copy or assignment */
+    GroupCommitFuture(const GroupCommitFuture &);
+    GroupCommitFuture &operator=(const GroupCommitFuture &);
+
+private:
+    sem_t m_sem;
+    long m_result;
+    unsigned int m_errno;
+    string m_error;
+};
+
+/*
+* 组提交
+* 1 多个线程提交的写操作(一条或几条语句)排队, 由后台线程在专用连接上攒批: 队列达到 max_batch,
+*   或第一个操作等待超过 window_ms 时, 把这一批放进一个事务执行, 只 COMMIT 一次(服务器只刷一次盘)
+* 2 多条语句的操作前设保存点, 其中任一语句失败则回滚到保存点; 单条语句失败由服务器只回滚该语句.
+*   因此只有出错的操作失败, 同批的其他操作照常提交
+* 3 连接断开(2006/2013)或死锁(1213)使整个事务回滚, 此时整批重试, 最多 max_retries 次;
+*   COMMIT 时连接断开则结果未知, 整批以失败返回, 不重试
+* 4 每个操作的结果(影响的行数或错误)通过各自的 future 返回
+*
+* 用法:
+*     GroupCommitter committer(Singleton<CdbConncetPool>::instance());
+*     committer.Start();
+*     GroupCommitFuture f;
+*     committer.Submit("update account set balance=balance-1 where id=1", &f);
+*     if (f.Wait() && f.GetResult() >= 0) ...
+*/
+class GroupCommitter : public zcUtils::Thread
+{
+public:
+    struct Config
+    {
+        /* 单个事务最多包含的操作数 */
+        unsigned int max_batch;
+        /* 第一个操作最多等待多久凑批, 0则只合并执行期间积压的操作 */
+        unsigned long window_ms;
+        /* 排队操作数上限, 超出时 Submit 返回false */
+        unsigned int max_queue;
+        /* 事务整体回滚时的重试次数 */
+        int max_retries;
+        /* 取专用连接的最长等待时间 */
+        unsigned long conn_wait_ms;
+
+        Config() : max_batch(128), window_ms(2), max_queue(100000), max_retries(3), conn_wait_ms(3000) {}
+    };
+
+    GroupCommitter(CdbConncetPool &pool, const Config &config = Config());
+    ~GroupCommitter();
+
+    bool Start();
+    /* 执行完排队的操作后停止, 归还专用连接 */
+    void Stop();
+
+    /* 提交一个操作, 其中的语句在同一保存点内执行; 未启动或队列已满返回false, future 不会被回调 */
+    bool Submit(const vector<string> &sqls, GroupCommitFuture *future);
+    bool Submit(const string &sql, GroupCommitFuture *future);
+
+    unsigned long GetCommits() const { return m_commits.load(); }
+    unsigned long GetCommittedOps() const { return m_committed.load(); }
+    unsigned long GetFailedOps() const { return m_failed.load(); }
+    unsigned long GetRetries() const { return m_retries.load(); }
+    unsigned long GetQueueSize();
+
+protected:
+    int run();
+
+private:
+    struct Operation
+    {
+        vector<string> sqls;
+        GroupCommitFuture *future;
+        unsigned long submit_ms;
+        long result;
+        unsigned int err_no;
+        string error;
+    };
+
+    enum BatchResult
+    {
+        BATCH_COMMITTED,
+        /* 事务已整体回滚, 可以重试 */
+        BATCH_ABORTED,
+        /* 提交结果未知 */
+        BATCH_UNKNOWN
+    };
+
+    /* Don't need copy or assignment */
+    GroupCommitter(const GroupCommitter &);
+    GroupCommitter &operator=(const GroupCommitter &);
+
+    /* 等待并取出一批, 停止且队列为空时返回false */
+    bool TakeBatch(vector<Operation *> &batch);
+    void ExecuteBatch(vector<Operation *> &batch);
+    BatchResult RunTransaction(vector<Operation *> &batch, unsigned int &err_no, string &error);
+    /* 执行事务控制语句, 失败返回错误码 */
+    unsigned int Control(const char *sql);
+    /* 回调并释放这一批, err_no 非0时所有操作都以该错误失败 */
+    void Finish(vector<Operation *> &batch, unsigned int err_no, const string &error);
+    static bool IsAbortError(unsigned int err);
+    static unsigned long NowMs();
+
+private:
+    CdbConncetPool &m_pool;
+    Config m_config;
+    /* 专用连接, 只在后台线程中使用 */
+    Connection *m_pConn;
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_ready;
+    deque<Operation *> m_queue;
+    bool m_running;
+    bool m_stopping;
+
+    zcUtils::Atomic<unsigned long> m_commits;
+    zcUtils::Atomic<unsigned long> m_committed;
+    zcUtils::Atomic<unsigned long> m_failed;
+    zcUtils::Atomic<unsigned long> m_retries;
+};
+
+#endif
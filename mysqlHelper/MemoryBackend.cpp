@@ -0,0 +1,578 @@
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+
+#include "MemoryBackend.h"
+
+/* mysqld_error.h 中的定义 */
+#define MEMORY_ER_PARSE_ERROR 1064
+#define MEMORY_ER_NO_SUCH_TABLE 1146
+#define MEMORY_ER_BAD_FIELD_ERROR 1054
+#define MEMORY_ER_WRONG_ARGUMENTS 1210
+
+namespace MysqlApi
+{
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 语句的词法和解析
+*/
+enum MemoryTokenType
+{
+    TOKEN_END,
+    /* 关键字和标识符, 已转小写 */
+    TOKEN_WORD,
+    /* 字符串常量, 已去掉转义 */
+    TOKEN_STRING,
+    TOKEN_NUMBER,
+    TOKEN_PARAM,
+    TOKEN_SYMBOL
+};
+
+struct MemoryToken
+{
+    MemoryTokenType type;
+    string text;
+};
+
+static string ToLower(const string &s) {
+    string lower = s;
+    for (unsigned int i = 0; i < lower.length(); i++)
+        lower[i] = (char) tolower((unsigned char) lower[i]);
+    return lower;
+}
+
+static bool Tokenize(const string &sql, vector<MemoryToken> &tokens) {
+    tokens.clear();
+    unsigned long i = 0, length = sql.length();
+    while (i < length) {
+        char c = sql[i];
+        if (isspace((unsigned char) c)) {
+            ++i;
+            continue;
+        }
+        MemoryToken token;
+        if ('\'' == c || '"' == c) {
+            token.type = TOKEN_STRING;
+            ++i;
+            bool closed = false;
+            while (i < length) {
+                char ch = sql[i++];
+                if ('\\' == ch && i < length) {
+                    ch = sql[i++];
+                    switch (ch) {
+                        case '0':
+                            token.text += '\0';
+                            break;
+                        case 'n':
+                            token.text += '\n';
+                            break;
+                        case 'r':
+                            token.text += '\r';
+                            break;
+                        case 'Z':
+                            token.text += '\032';
+                            break;
+                        default:
+                            token.text += ch;
+                            break;
+                    }
+                } else if (c == ch) {
+                    //两个引号是转义
+                    if (i < length && c == sql[i]) {
+                        token.text += ch;
+                        ++i;
+                    } else {
+                        closed = true;
+                        break;
+                    }
+                } else
+                    token.text += ch;
+            }
+            if (!closed)
+                return false;
+        } else if ('`' == c) {
+            unsigned long end = sql.find('`', i + 1);
+            if (string::npos == end)
+                return false;
+            token.type = TOKEN_WORD;
+            token.text = ToLower(sql.substr(i + 1, end - i - 1));
+            i = end + 1;
+        } else if (isdigit((unsigned char) c) || ('-' == c && i + 1 < length && isdigit((unsigned char) sql[i + 1]))) {
+            token.type = TOKEN_NUMBER;
+            unsigned long start = i++;
+            while (i < length && (isalnum((unsigned char) sql[i]) || '.' == sql[i]))
+                ++i;
+            token.text = sql.substr(start, i - start);
+        } else if (isalpha((unsigned char) c) || '_' == c) {
+            token.type = TOKEN_WORD;
+            unsigned long start = i;
+            while (i < length && (isalnum((unsigned char) sql[i]) || '_' == sql[i] || '$' == sql[i]))
+                ++i;
+            token.text = ToLower(sql.substr(start, i - start));
+        } else if ('?' == c) {
+            token.type = TOKEN_PARAM;
+            ++i;
+        } else {
+            token.type = TOKEN_SYMBOL;
+            token.text = c;
+            ++i;
+        }
+        tokens.push_back(token);
+    }
+    MemoryToken end;
+    end.type = TOKEN_END;
+    tokens.push_back(end);
+    return true;
+}
+
+/* 语句中的值: 常量或第几个参数 */
+struct MemoryValue
+{
+    int param;
+    string text;
+};
+
+enum MemoryPlanType
+{
+    /* 事务等语句, 直接返回成功 */
+    PLAN_NOOP,
+    /* 不带 from 的常量查询 */
+    PLAN_CONSTANT,
+    PLAN_SELECT
+};
+
+struct MemoryPlan
+{
+    MemoryPlanType type;
+    const void *table;
+    vector<int> columns;
+    /* 结果的字段名 */
+    vector<string> names;
+    int where_column;
+    vector<MemoryValue> values;
+    int group_column;
+};
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 内存引擎的会话
+*/
+class MemorySession : public BackendSession
+{
+public:
+    MemorySession(MemoryBackend *pBackend) : m_pBackend(pBackend) {}
+
+    unsigned int Query(const string &sql, const vector<CellView> &params, BackendResult &result);
+    const char *GetError() const { return m_error.c_str(); }
+
+private:
+    typedef MemoryBackend::Table Table;
+
+    unsigned int Parse(const string &sql, MemoryPlan &plan);
+    unsigned int Execute(const MemoryPlan &plan, const vector<CellView> &params, BackendResult &result);
+    unsigned int SetError(unsigned int err, const string &error);
+    /* 解析一个字段名(可带表名前缀), 失败返回-1 */
+    int ParseColumn(const vector<MemoryToken> &tokens, unsigned int &pos, const Table *table);
+    bool ParseValue(const vector<MemoryToken> &tokens, unsigned int &pos, int &param_num, MemoryValue &value);
+    void FindRows(const Table &table, int column, const CellView &value);
+
+private:
+    MemoryBackend *m_pBackend;
+    string m_error;
+    /* 带参数的语句的解析结果 */
+    map<string, MemoryPlan> m_plans;
+    /* 以下在每次查询时复用 */
+    vector<MemoryToken> m_tokens;
+    vector<unsigned int> m_rows;
+    MemoryPlan m_plan;
+};
+
+unsigned int MemorySession::SetError(unsigned int err, const string &error) {
+    m_error = error;
+    return err;
+}
+
+static int CompareCell(const char *a, unsigned long a_len, const char *b, unsigned long b_len) {
+    int ret = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (ret != 0)
+        return ret;
+    return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+}
+
+int MemorySession::ParseColumn(const vector<MemoryToken> &tokens, unsigned int &pos, const Table *table) {
+    if (tokens[pos].type != TOKEN_WORD)
+        return -1;
+    string name = tokens[pos++].text;
+    //表名.字段名
+    if (TOKEN_SYMBOL == tokens[pos].type && "." == tokens[pos].text && TOKEN_WORD == tokens[pos + 1].type) {
+        name = tokens[pos + 1].text;
+        pos += 2;
+    }
+    return table ? MemoryBackend::FindColumn(*table, name) : -1;
+}
+
+bool MemorySession::ParseValue(const vector<MemoryToken> &tokens, unsigned int &pos, int &param_num,
+                               MemoryValue &value) {
+    const MemoryToken &token = tokens[pos];
+    if (TOKEN_PARAM == token.type) {
+        value.param = param_num++;
+        value.text.clear();
+    } else if (TOKEN_STRING == token.type || TOKEN_NUMBER == token.type) {
+        value.param = -1;
+        value.text = token.text;
+    } else
+        return false;
+    ++pos;
+    return true;
+}
+
+unsigned int MemorySession::Parse(const string &sql, MemoryPlan &plan) {
+    plan.type = PLAN_SELECT;
+    plan.table = NULL;
+    plan.columns.clear();
+    plan.names.clear();
+    plan.where_column = -1;
+    plan.values.clear();
+    plan.group_column = -1;
+
+    if (!Tokenize(sql, m_tokens))
+        return SetError(MEMORY_ER_PARSE_ERROR, "unterminated quote");
+    const vector<MemoryToken> &tokens = m_tokens;
+    const string &verb = tokens[0].text;
+    if ("start" == verb || "begin" == verb || "commit" == verb || "rollback" == verb || "set" == verb ||
+        "savepoint" == verb || "release" == verb) {
+        plan.type = PLAN_NOOP;
+        return 0;
+    }
+    if (verb != "select")
+        return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+
+    //先找到表, 再解析字段列表
+    unsigned int pos = 1;
+    unsigned int from = 1;
+    while (tokens[from].type != TOKEN_END && !(TOKEN_WORD == tokens[from].type && "from" == tokens[from].text))
+        ++from;
+    const Table *table = NULL;
+    if (TOKEN_END == tokens[from].type)
+        plan.type = PLAN_CONSTANT;
+    else {
+        if (tokens[from + 1].type != TOKEN_WORD)
+            return SetError(MEMORY_ER_PARSE_ERROR, "missing table:" + sql);
+        table = m_pBackend->FindTable(tokens[from + 1].text);
+        if (NULL == table)
+            return SetError(MEMORY_ER_NO_SUCH_TABLE, "Table '" + tokens[from + 1].text + "' doesn't exist");
+        plan.table = table;
+    }
+
+    int param_num = 0;
+    while (pos < from) {
+        const MemoryToken &token = tokens[pos];
+        if (PLAN_CONSTANT == plan.type) {
+            MemoryValue value;
+            if (!ParseValue(tokens, pos, param_num, value))
+                return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+            plan.values.push_back(value);
+            plan.names.push_back(value.param < 0 ? value.text : "?");
+        } else if (TOKEN_SYMBOL == token.type && "*" == token.text) {
+            for (unsigned int i = 0; i < table->columns.size(); i++) {
+                plan.columns.push_back(i);
+                plan.names.push_back(table->columns[i]);
+            }
+            ++pos;
+        } else {
+            int column = ParseColumn(tokens, pos, table);
+            if (column < 0)
+                return SetError(MEMORY_ER_BAD_FIELD_ERROR, "Unknown column '" + token.text + "' in 'field list'");
+            plan.columns.push_back(column);
+            plan.names.push_back(table->columns[column]);
+        }
+        if (TOKEN_SYMBOL == tokens[pos].type && "," == tokens[pos].text)
+            ++pos;
+        else if (pos != from)
+            return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+    }
+    if (PLAN_CONSTANT == plan.type)
+        return 0;
+
+    pos = from + 2;
+    if (TOKEN_WORD == tokens[pos].type && "where" == tokens[pos].text) {
+        ++pos;
+        string name = tokens[pos].text;
+        plan.where_column = ParseColumn(tokens, pos, table);
+        if (plan.where_column < 0)
+            return SetError(MEMORY_ER_BAD_FIELD_ERROR, "Unknown column '" + name + "' in 'where clause'");
+        MemoryValue value;
+        if (TOKEN_SYMBOL == tokens[pos].type && "=" == tokens[pos].text) {
+            ++pos;
+            if (!ParseValue(tokens, pos, param_num, value))
+                return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+            plan.values.push_back(value);
+        } else if (TOKEN_WORD == tokens[pos].type && "in" == tokens[pos].text &&
+                   TOKEN_SYMBOL == tokens[pos + 1].type && "(" == tokens[pos + 1].text) {
+            pos += 2;
+            while (true) {
+                if (!ParseValue(tokens, pos, param_num, value))
+                    return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+                plan.values.push_back(value);
+                if (TOKEN_SYMBOL == tokens[pos].type && "," == tokens[pos].text)
+                    ++pos;
+                else
+                    break;
+            }
+            if (!(TOKEN_SYMBOL == tokens[pos].type && ")" == tokens[pos].text))
+                return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+            ++pos;
+        } else
+            return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+    }
+    if (TOKEN_WORD == tokens[pos].type && "group" == tokens[pos].text &&
+        TOKEN_WORD == tokens[pos + 1].type && "by" == tokens[pos + 1].text) {
+        pos += 2;
+        string name = tokens[pos].text;
+        plan.group_column = ParseColumn(tokens, pos, table);
+        if (plan.group_column < 0)
+            return SetError(MEMORY_ER_BAD_FIELD_ERROR, "Unknown column '" + name + "' in 'group statement'");
+    }
+    if (TOKEN_SYMBOL == tokens[pos].type && ";" == tokens[pos].text)
+        ++pos;
+    if (tokens[pos].type != TOKEN_END)
+        return SetError(MEMORY_ER_PARSE_ERROR, "memory backend doesn't support:" + sql);
+    return 0;
+}
+
+/* 按某列的值排序行号 */
+struct MemoryRowLess
+{
+    const ColumnStore *store;
+    int column;
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        int ret = CompareCell(store->GetData(a, column), store->GetLength(a, column),
+                              store->GetData(b, column), store->GetLength(b, column));
+        return ret != 0 ? ret < 0 : a < b;
+    }
+};
+
+void MemorySession::FindRows(const Table &table, int column, const CellView &value) {
+    //NULL 不等于任何值
+    if (value.IsNull())
+        return;
+    const ColumnStore &store = table.store;
+    if (!table.indexed[column]) {
+        for (unsigned long r = 0; r < store.GetRowCount(); r++) {
+            if (!store.IsNull(r, column) &&
+                0 == CompareCell(store.GetData(r, column), store.GetLength(r, column), value.Data(), value.Size()))
+                m_rows.push_back((unsigned int) r);
+        }
+        return;
+    }
+    //在索引中二分查找第一个不小于 value 的位置
+    const vector<unsigned int> &index = table.indexes[column];
+    unsigned long low = 0, high = index.size();
+    while (low < high) {
+        unsigned long mid = (low + high) / 2;
+        unsigned int r = index[mid];
+        if (CompareCell(store.GetData(r, column), store.GetLength(r, column), value.Data(), value.Size()) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    for (; low < index.size(); low++) {
+        unsigned int r = index[low];
+        if (CompareCell(store.GetData(r, column), store.GetLength(r, column), value.Data(), value.Size()) != 0)
+            break;
+        if (!store.IsNull(r, column))
+            m_rows.push_back(r);
+    }
+}
+
+unsigned int MemorySession::Execute(const MemoryPlan &plan, const vector<CellView> &params, BackendResult &result) {
+    result.Clear();
+    if (PLAN_NOOP == plan.type)
+        return 0;
+
+    for (unsigned int i = 0; i < plan.values.size(); i++) {
+        if (plan.values[i].param >= (int) params.size())
+            return SetError(MEMORY_ER_WRONG_ARGUMENTS, "Incorrect arguments to EXECUTE");
+    }
+    for (unsigned int i = 0; i < plan.names.size(); i++)
+        result.fields.push_back(plan.names[i].c_str());
+
+    if (PLAN_CONSTANT == plan.type) {
+        for (unsigned int i = 0; i < plan.values.size(); i++) {
+            const MemoryValue &value = plan.values[i];
+            result.cells.push_back(value.param < 0 ? CellView(value.text.data(), value.text.length())
+                                                   : params[value.param]);
+        }
+        result.rows = 1;
+        return 0;
+    }
+
+    const Table &table = *(const Table *) plan.table;
+    const ColumnStore &store = table.store;
+    m_rows.clear();
+    if (plan.where_column < 0) {
+        for (unsigned long r = 0; r < store.GetRowCount(); r++)
+            m_rows.push_back((unsigned int) r);
+    } else {
+        for (unsigned int i = 0; i < plan.values.size(); i++) {
+            const MemoryValue &value = plan.values[i];
+            FindRows(table, plan.where_column,
+                     value.param < 0 ? CellView(value.text.data(), value.text.length()) : params[value.param]);
+        }
+        //in 的多个值可能有重复
+        if (plan.values.size() > 1) {
+            sort(m_rows.begin(), m_rows.end());
+            m_rows.erase(unique(m_rows.begin(), m_rows.end()), m_rows.end());
+        }
+    }
+
+    if (plan.group_column >= 0 && !m_rows.empty()) {
+        MemoryRowLess less = {&store, plan.group_column};
+        sort(m_rows.begin(), m_rows.end(), less);
+        unsigned long kept = 1;
+        for (unsigned long i = 1; i < m_rows.size(); i++) {
+            unsigned int prev = m_rows[kept - 1], r = m_rows[i];
+            if (CompareCell(store.GetData(prev, plan.group_column), store.GetLength(prev, plan.group_column),
+                            store.GetData(r, plan.group_column), store.GetLength(r, plan.group_column)) != 0)
+                m_rows[kept++] = r;
+        }
+        m_rows.resize(kept);
+    }
+
+    result.cells.reserve(m_rows.size() * plan.columns.size());
+    for (unsigned long i = 0; i < m_rows.size(); i++) {
+        unsigned int r = m_rows[i];
+        for (unsigned int k = 0; k < plan.columns.size(); k++) {
+            int c = plan.columns[k];
+            if (store.IsNull(r, c))
+                result.cells.push_back(CellView());
+            else
+                result.cells.push_back(CellView(store.GetData(r, c), store.GetLength(r, c)));
+        }
+    }
+    result.rows = m_rows.size();
+    return 0;
+}
+
+unsigned int MemorySession::Query(const string &sql, const vector<CellView> &params, BackendResult &result) {
+    m_error.clear();
+    if (params.empty()) {
+        unsigned int err = Parse(sql, m_plan);
+        if (err) {
+            result.Clear();
+            return err;
+        }
+        return Execute(m_plan, params, result);
+    }
+    map<string, MemoryPlan>::iterator it = m_plans.find(sql);
+    if (it == m_plans.end()) {
+        MemoryPlan plan;
+        unsigned int err = Parse(sql, plan);
+        if (err) {
+            result.Clear();
+            return err;
+        }
+        it = m_plans.insert(make_pair(sql, plan)).first;
+    }
+    return Execute(it->second, params, result);
+}
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 内存存储引擎
+*/
+MemoryBackend::MemoryBackend() {}
+
+MemoryBackend::~MemoryBackend() {
+    for (map<string, Table *>::iterator it = m_tables.begin(); it != m_tables.end(); ++it)
+        delete it->second;
+}
+
+BackendSession *MemoryBackend::Open(const string &host, const string &user, const string &passwd,
+                                    const string &db, unsigned int port) {
+    (void) host;
+    (void) user;
+    (void) passwd;
+    (void) db;
+    (void) port;
+    return new MemorySession(this);
+}
+
+MemoryBackend::Table *MemoryBackend::FindTable(const string &table) const {
+    map<string, Table *>::const_iterator it = m_tables.find(ToLower(table));
+    return it == m_tables.end() ? NULL : it->second;
+}
+
+int MemoryBackend::FindColumn(const Table &table, const string &column) {
+    string name = ToLower(column);
+    for (unsigned int i = 0; i < table.columns.size(); i++) {
+        if (table.columns[i] == name)
+            return (int) i;
+    }
+    return -1;
+}
+
+bool MemoryBackend::CreateTable(const string &table, const vector<string> &columns) {
+    string name = ToLower(table);
+    if (columns.empty() || m_tables.count(name))
+        return false;
+    Table *t = new Table;
+    for (unsigned int i = 0; i < columns.size(); i++)
+        t->columns.push_back(ToLower(columns[i]));
+    t->store.Reset((int) columns.size());
+    t->indexes.resize(columns.size());
+    t->indexed.resize(columns.size(), 0);
+    m_tables[name] = t;
+    return true;
+}
+
+bool MemoryBackend::Insert(const string &table, const vector<string> &values) {
+    Table *t = FindTable(table);
+    if (NULL == t || values.size() != t->columns.size())
+        return false;
+    vector<char *> row(values.size());
+    vector<unsigned long> lengths(values.size());
+    for (unsigned int i = 0; i < values.size(); i++) {
+        row[i] = (char *) values[i].data();
+        lengths[i] = values[i].length();
+    }
+    t->store.AppendRow(&row[0], &lengths[0]);
+    //已建的索引按序插入新行
+    unsigned int r = (unsigned int) t->store.GetRowCount() - 1;
+    for (unsigned int c = 0; c < t->indexes.size(); c++) {
+        if (!t->indexed[c])
+            continue;
+        vector<unsigned int> &index = t->indexes[c];
+        MemoryRowLess less = {&t->store, (int) c};
+        index.insert(upper_bound(index.begin(), index.end(), r, less), r);
+    }
+    return true;
+}
+
+bool MemoryBackend::CreateIndex(const string &table, const string &column) {
+    Table *t = FindTable(table);
+    if (NULL == t)
+        return false;
+    int c = FindColumn(*t, column);
+    if (c < 0)
+        return false;
+    vector<unsigned int> &index = t->indexes[c];
+    index.resize(t->store.GetRowCount());
+    for (unsigned int r = 0; r < index.size(); r++)
+        index[r] = r;
+    MemoryRowLess less = {&t->store, c};
+    sort(index.begin(), index.end(), less);
+    t->indexed[c] = 1;
+    return true;
+}
+
+long MemoryBackend::GetRowCount(const string &table) const {
+    Table *t = FindTable(table);
+    return t ? (long) t->store.GetRowCount() : -1;
+}
+/* -------------------------------------------------- */
+} // namespace MysqlApi
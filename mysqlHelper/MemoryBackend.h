@@ -0,0 +1,81 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _MEMORY_BACKEND_H_
+#define _MEMORY_BACKEND_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "StorageBackend.h"
+
+namespace MysqlApi
+{
+class MemorySession;
+
+/*
+* 内存存储引擎, 用于在没有 MySQL 的环境下压测连接池、缓存和结果处理
+* 1 表在加载后只读, 查询不加锁; 建表/插入/建索引须在开始查询前完成
+* 2 每列保存在 ColumnStore 中, 结果的单元格直接指向表的数据, 不拷贝
+* 3 只支持 DbFactory 等读路径用到的语句:
+*     select 列|* from 表 [where 列 = 值 | 列 in (值, ...)] [group by 列] [;]
+*     select 常量, ...(如连接预热的 select 1)
+*   值为字符串、数字常量或预处理语句的 ?; 事务语句和 set 等直接返回成功; 其余语句返回错误 1064
+* 4 where 的列有索引时二分查找, 否则逐行比较; 比较按字节进行(不区分排序规则)
+* 5 group by 按分组列的值排序, 每组取第一行
+* 6 带参数的语句在会话内缓存解析结果
+*
+* 用法:
+*     MemoryBackend backend;
+*     vector<string> columns;  ... "prefix", "phone", "province", "city", "isp"
+*     backend.CreateTable("phone_number_region", columns);
+*     backend.Insert("phone_number_region", values);
+*     backend.CreateIndex("phone_number_region", "phone");
+*     StorageBackend::Install(&backend);
+*/
+class MemoryBackend : public StorageBackend
+{
+public:
+    MemoryBackend();
+    ~MemoryBackend();
+
+    const char *GetName() const { return "memory"; }
+    BackendSession *Open(const string &host, const string &user, const string &passwd,
+                         const string &db, unsigned int port);
+
+    /* 建表, 表名和字段名不区分大小写, 已存在返回false */
+    bool CreateTable(const string &table, const vector<string> &columns);
+    /* 追加一行, 值的个数须与字段数相同 */
+    bool Insert(const string &table, const vector<string> &values);
+    /* 为一列建索引, 之后插入的行同时加入索引; 批量导入时先插入再建索引更快 */
+    bool CreateIndex(const string &table, const string &column);
+    /* 表不存在返回-1 */
+    long GetRowCount(const string &table) const;
+
+private:
+    friend class MemorySession;
+
+    struct Table
+    {
+        vector<string> columns;
+        ColumnStore store;
+        /* 每列按值排序的行号, 没有索引的列为空 */
+        vector<vector<unsigned int> > indexes;
+        vector<char> indexed;
+    };
+
+    /* Don't need copy or assignment */
+    MemoryBackend(const MemoryBackend &);
+    MemoryBackend &operator=(const MemoryBackend &);
+
+    Table *FindTable(const string &table) const;
+    static int FindColumn(const Table &table, const string &column);
+
+private:
+    map<string, Table *> m_tables;
+};
+} // namespace MysqlApi
+
+#endif
@@ -1,7 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "MysqlApi.h"
 #include "timeval.h"
+#include "QueryStats.h"
+#include "StorageBackend.h"
 
 namespace MysqlApi {
 
@@ -114,49 +118,107 @@ namespace MysqlApi {
 /*-----------------------------------------------------*/
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
 /*
+* 列式存储的记录数据
+*/
+    ColumnStore::ColumnStore() : m_rows(0) {}
+
+    void ColumnStore::Reset(int field_num) {
+        m_data.clear();
+        m_columns.resize(field_num > 0 ? field_num : 0);
+        for (unsigned int i = 0; i < m_columns.size(); i++) {
+            m_columns[i].offset.clear();
+            m_columns[i].length.clear();
+            m_columns[i].is_null.clear();
+        }
+        m_rows = 0;
+    }
+
+    void ColumnStore::Reserve(unsigned long rows) {
+        for (unsigned int i = 0; i < m_columns.size(); i++) {
+            m_columns[i].offset.reserve(rows);
+            m_columns[i].length.reserve(rows);
+            m_columns[i].is_null.reserve(rows);
+        }
+    }
+
+    void ColumnStore::AppendRow(MYSQL_ROW row, unsigned long *lengths) {
+        for (unsigned int k = 0; k < m_columns.size(); k++) {
+            Column &c = m_columns[k];
+            if (row[k] == NULL) {
+                c.offset.push_back(0);
+                c.length.push_back(0);
+                c.is_null.push_back(1);
+            } else {
+                c.offset.push_back(m_data.size());
+                c.length.push_back((unsigned int) lengths[k]);
+                c.is_null.push_back(0);
+                m_data.insert(m_data.end(), row[k], row[k] + lengths[k]);
+                m_data.push_back('\0');
+            }
+        }
+        ++m_rows;
+    }
+/*-----------------------------------------------------*/
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
 * 1 单条记录
 * 2 [int ]操作 [""]操作
 */
-    Record::Record(Field *m_f) {
-        m_field = m_f;
+    Record::Record(Field *m_f, const ColumnStore *store, unsigned long row)
+            : m_field(m_f), m_store(store), m_row(row) {
     }
 
     Record::~Record() {};
 
-    void Record::SetData(string value) {
-        m_rs.push_back(value);
-    }
-
 /* [""]操作 */
     string Record::operator[](string s) {
-        return m_rs[m_field->GetField_NO(s)];
+        int num = m_field->GetField_NO(s);
+        return string(m_store->GetData(m_row, num), m_store->GetLength(m_row, num));
     }
 
     string Record::operator[](int num) {
-        return m_rs[num];
+        return string(m_store->GetData(m_row, num), m_store->GetLength(m_row, num));
+    }
+
+    const char *Record::GetValue(int num) const {
+        return m_store->GetData(m_row, num);
+    }
+
+    unsigned long Record::GetLength(int num) const {
+        return m_store->GetLength(m_row, num);
+    }
+
+    int Record::Size() const {
+        return m_store ? m_store->GetFieldNum() : 0;
+    }
+
+    CellView Record::GetCell(int num) const {
+        if (m_store->IsNull(m_row, num))
+            return CellView();
+        return CellView(m_store->GetData(m_row, num), m_store->GetLength(m_row, num));
     }
 
 /* null值判断 */
     bool Record::IsNull(int num) {
-        if ("" == m_rs[num].c_str())
-            return true;
-        else
-            return false;
+        return m_store->IsNull(m_row, num);
     }
 
     bool Record::IsNull(string s) {
-        if ("" == m_rs[m_field->GetField_NO(s)].c_str())
-            return true;
-        else
-            return false;
+        return m_store->IsNull(m_row, m_field->GetField_NO(s));
     }
 
 /* 主要-功能:用 value tab value 的形式 返回结果 */
     string Record::GetTabText() {
         string temp;
-        for (unsigned int i = 0; i < m_rs.size(); i++) {
-            temp += m_rs[i];
-            if (i < m_rs.size() - 1)
+        int size = Size();
+        //先算出总长度, 只分配一次
+        unsigned long length = size > 0 ? size - 1 : 0;
+        for (int i = 0; i < size; i++)
+            length += m_store->GetLength(m_row, i);
+        temp.reserve(length);
+        for (int i = 0; i < size; i++) {
+            temp.append(m_store->GetData(m_row, i), m_store->GetLength(m_row, i));
+            if (i < size - 1)
                 temp += "\t";
         }
         return temp;
@@ -172,6 +234,7 @@ namespace MysqlApi {
     RecordSet::RecordSet() {
         res = NULL;
         row = NULL;
+        m_pSession = NULL;
         pos = 0;
     }
 
@@ -179,9 +242,56 @@ namespace MysqlApi {
         res = NULL;
         row = NULL;
         m_Data = hSQL;
+        m_pSession = NULL;
         pos = 0;
     }
 
+    RecordSet::RecordSet(DataBase *db) {
+        res = NULL;
+        row = NULL;
+        m_Data = db->GetMysql();
+        m_pSession = db->GetSession();
+        pos = 0;
+    }
+
+/* 后端的单元格转为 MYSQL_ROW 的形式追加到列式存储 */
+    static void AppendBackendRow(ColumnStore &store, const CellView *cells, int field_num,
+                                 vector<char *> &row, vector<unsigned long> &lengths) {
+        row.resize(field_num);
+        lengths.resize(field_num);
+        for (int i = 0; i < field_num; i++) {
+            row[i] = cells[i].IsNull() ? NULL : (char *) cells[i].Data();
+            lengths[i] = cells[i].Size();
+        }
+        store.AppendRow(&row[0], &lengths[0]);
+    }
+
+    static void SetBackendFields(Field &field, const BackendResult &result) {
+        field.m_name.clear();
+        field.m_type.clear();
+        field.m_table.clear();
+        for (unsigned int i = 0; i < result.fields.size(); i++) {
+            field.m_name.push_back(result.fields[i]);
+            field.m_type.push_back(MYSQL_TYPE_VAR_STRING);
+            field.m_table.push_back("");
+        }
+    }
+
+    int RecordSet::StoreBackendResult(const BackendResult &result) {
+        if (0 == result.rows || result.fields.empty())
+            return 0;
+        m_recordcount = (int) result.rows;
+        m_field_num = (int) result.fields.size();
+        SetBackendFields(m_field, result);
+        m_store.Reset(m_field_num);
+        m_store.Reserve(result.rows);
+        vector<char *> row_ptrs;
+        vector<unsigned long> lengths;
+        for (unsigned long r = 0; r < result.rows; r++)
+            AppendBackendRow(m_store, &result.cells[r * m_field_num], m_field_num, row_ptrs, lengths);
+        return m_recordcount;
+    }
+
     RecordSet::~RecordSet() {
     }
 
@@ -194,50 +304,180 @@ namespace MysqlApi {
         int nRt;
         unsigned long costtime;
         unsigned long starttime = util::get_current_time_stamp();
-        nRt = mysql_real_query(m_Data, SQL.c_str(), strlen(SQL.c_str()));
-        if (!nRt) {
-            //保存查询结果
-            res = mysql_store_result(m_Data);
+        pos = 0;
+        m_recordcount = 0;
+        m_field_num = 0;
+        m_store.Reset(0);
+        m_field.m_name.clear();
+        m_field.m_type.clear();
+        m_field.m_table.clear();
+
+        if (m_pSession) {
+            BackendResult result;
+            bool failed = m_pSession->Query(SQL, vector<CellView>(), result) != 0;
+            if (failed)
+                cout << "BackendSession::Query is failed!!sql:" << SQL << ",err:" << m_pSession->GetError() << endl;
+            else
+                StoreBackendResult(result);
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime,
+                                          failed ? -1 : (long) m_store.GetRowCount(), m_store.GetDataBytes(), failed);
+            return failed ? -1 : (int) m_store.GetRowCount();
+        }
 
-            if (res != NULL && (int) mysql_num_rows(res) > 0) {
-                //usleep(1000*1000);
-                //得到记录数量
-                m_recordcount = (int) mysql_num_rows(res);
-                //得到字段数量
-                m_field_num = mysql_num_fields(res);
-                for (int x = 0; fd = mysql_fetch_field(res); x++) {
-                    m_field.m_name.push_back(fd->name);
-                    m_field.m_type.push_back(fd->type);
-                    m_field.m_table.push_back(fd->table);
-                }
-                //保存所有数据
-                while (row = mysql_fetch_row(res)) {
-                    Record temp(&m_field);
-                    for (int k = 0; k < m_field_num; k++) {
-                        if (row[k] == NULL || (!strlen(row[k]))) {
-                            temp.SetData("");
-                        } else {
-                            temp.SetData(row[k]);
-                        }
-                    }
-                    //添加新记录
-                    m_s.push_back(temp);
-                }
-                mysql_free_result(res);
-                costtime = (util::get_current_time_stamp() - starttime) / 1000;
-                if (costtime >= 1000)
-                    cout << "Warn:Use " << costtime << "ms to do sql..." << SQL << endl;
-                return m_s.size();
-            } else {
-                m_recordcount = 0;
-                m_field_num = 0;
+        nRt = mysql_real_query(m_Data, SQL.c_str(), (unsigned long) SQL.length());
+        if (nRt) {
+            cout << "mysql_real_query is failed!!sql:" << SQL << ",rt:" << nRt << ",err:" << mysql_error(m_Data) << endl;
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, -1, 0, true);
+            return -1;
+        }
+        //保存查询结果
+        res = mysql_store_result(m_Data);
+        if (res != NULL && (int) mysql_num_rows(res) > 0) {
+            //得到记录数量
+            m_recordcount = (int) mysql_num_rows(res);
+            //得到字段数量
+            m_field_num = mysql_num_fields(res);
+            while ((fd = mysql_fetch_field(res))) {
+                m_field.m_name.push_back(fd->name);
+                m_field.m_type.push_back(fd->type);
+                m_field.m_table.push_back(fd->table);
             }
+            //保存所有数据, 一次性分配好各列的索引
+            m_store.Reset(m_field_num);
+            m_store.Reserve(m_recordcount);
+            while ((row = mysql_fetch_row(res)))
+                m_store.AppendRow(row, mysql_fetch_lengths(res));
+        }
+        if (res != NULL)
             mysql_free_result(res);
-            costtime = (util::get_current_time_stamp() - starttime) / 1000;
-            if (costtime >= 1000)
-                cout << "Warn:Use " << costtime << "ms to do sql..." << SQL << endl;
-            return 0;
+        res = NULL;
+        unsigned long cost_us = util::get_current_time_stamp() - starttime;
+        QueryStats::Instance().Record(SQL, cost_us, (long) m_store.GetRowCount(), m_store.GetDataBytes(), false);
+        costtime = cost_us / 1000;
+        if (costtime >= 1000)
+            cout << "Warn:Use " << costtime << "ms to do sql..." << SQL << endl;
+        return (int) m_store.GetRowCount();
+    }
+
+/*
+* 流式处理返回多行的查询
+* 1 使用 mysql_use_result 逐行从服务器读取, 每凑满 batch_size 条回调一次 handler
+* 2 用于回调的 Record 在各批之间复用, 内存占用与结果集大小无关
+* 成功返回处理的行数，失败返回-1
+*/
+    long RecordSet::ExecuteSQLStream(string SQL, RowHandler &handler, unsigned int batch_size) {
+        unsigned long costtime;
+        unsigned long starttime = util::get_current_time_stamp();
+        if (0 == batch_size)
+            batch_size = 1;
+        if (m_pSession)
+            return ExecuteBackendStream(SQL, handler, batch_size, starttime);
+
+        if (mysql_real_query(m_Data, SQL.c_str(), (unsigned long) SQL.length())) {
+            cout << "mysql_real_query is failed!!sql:" << SQL << ",err:" << mysql_error(m_Data) << endl;
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, -1, 0, true);
+            return -1;
+        }
+        res = mysql_use_result(m_Data);
+        if (NULL == res) {
+            //没有结果集的语句或读取失败
+            m_recordcount = 0;
+            m_field_num = 0;
+            bool no_result = 0 == mysql_field_count(m_Data);
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, 0, 0, !no_result);
+            return no_result ? 0 : -1;
+        }
+
+        m_field_num = mysql_num_fields(res);
+        m_field.m_name.clear();
+        m_field.m_type.clear();
+        m_field.m_table.clear();
+        while ((fd = mysql_fetch_field(res))) {
+            m_field.m_name.push_back(fd->name);
+            m_field.m_type.push_back(fd->type);
+            m_field.m_table.push_back(fd->table);
+        }
+        handler.HandleFields(&m_field);
+
+        //每批数据放在同一块列式存储中, 各批之间复用其内存
+        ColumnStore batch;
+        batch.Reset(m_field_num);
+        batch.Reserve(batch_size);
+        vector<Record> rows;
+        rows.reserve(batch_size);
+        long total = 0;
+        unsigned long bytes = 0;
+        bool go_on = true;
+        while (go_on && (row = mysql_fetch_row(res))) {
+            batch.AppendRow(row, mysql_fetch_lengths(res));
+            rows.push_back(Record(&m_field, &batch, batch.GetRowCount() - 1));
+            ++total;
+            if (rows.size() == batch_size) {
+                go_on = handler.HandleRows(rows);
+                bytes += batch.GetDataBytes();
+                batch.Reset(m_field_num);
+                rows.clear();
+            }
+        }
+        if (go_on && !rows.empty())
+            handler.HandleRows(rows);
+
+        bool failed = go_on && mysql_errno(m_Data);
+        if (failed)
+            cout << "mysql_fetch_row is failed!!sql:" << SQL << ",err:" << mysql_error(m_Data) << endl;
+        //提前终止时 mysql_free_result 会读完剩余的行
+        mysql_free_result(res);
+        res = NULL;
+        m_recordcount = (int) total;
+
+        unsigned long cost_us = util::get_current_time_stamp() - starttime;
+        QueryStats::Instance().Record(SQL, cost_us, total, bytes + batch.GetDataBytes(), failed);
+        costtime = cost_us / 1000;
+        if (costtime >= 1000)
+            cout << "Warn:Use " << costtime << "ms to do sql..." << SQL << endl;
+        return failed ? -1 : total;
+    }
+
+/* 存储后端的结果已在内存中, 按批回调即可 */
+    long RecordSet::ExecuteBackendStream(const string &SQL, RowHandler &handler, unsigned int batch_size,
+                                         unsigned long starttime) {
+        BackendResult result;
+        if (m_pSession->Query(SQL, vector<CellView>(), result) != 0) {
+            cout << "BackendSession::Query is failed!!sql:" << SQL << ",err:" << m_pSession->GetError() << endl;
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, -1, 0, true);
+            return -1;
+        }
+        m_field_num = (int) result.fields.size();
+        SetBackendFields(m_field, result);
+        handler.HandleFields(&m_field);
+
+        ColumnStore batch;
+        batch.Reset(m_field_num);
+        batch.Reserve(batch_size);
+        vector<Record> rows;
+        rows.reserve(batch_size);
+        vector<char *> row_ptrs;
+        vector<unsigned long> lengths;
+        unsigned long bytes = 0;
+        long total = 0;
+        bool go_on = true;
+        for (unsigned long r = 0; go_on && m_field_num > 0 && r < result.rows; r++) {
+            AppendBackendRow(batch, &result.cells[r * m_field_num], m_field_num, row_ptrs, lengths);
+            rows.push_back(Record(&m_field, &batch, batch.GetRowCount() - 1));
+            ++total;
+            if (rows.size() == batch_size) {
+                go_on = handler.HandleRows(rows);
+                bytes += batch.GetDataBytes();
+                batch.Reset(m_field_num);
+                rows.clear();
+            }
         }
+        if (go_on && !rows.empty())
+            handler.HandleRows(rows);
+        m_recordcount = (int) total;
+        QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, total,
+                                      bytes + batch.GetDataBytes(), false);
+        return total;
     }
 
 /*
@@ -256,8 +496,8 @@ namespace MysqlApi {
             pos = 0;
             return 0;
         } else {
-            if (l >= m_s.size()) {
-                pos = m_s.size() - 1;
+            if (l >= m_store.GetRowCount()) {
+                pos = m_store.GetRowCount() - 1;
                 return pos;
             } else {
                 pos = l;
@@ -274,7 +514,7 @@ namespace MysqlApi {
 
 /* 移动游标到结束位置 */
     bool RecordSet::MoveLast() {
-        pos = m_s.size() - 1;
+        pos = m_store.GetRowCount() - 1;
         return true;
     }
 
@@ -285,31 +525,38 @@ namespace MysqlApi {
 
 /* 获取当前游标的对应字段数据 */
     std::string RecordSet::GetCurrentFieldValue(std::string sFieldName) {
-        return m_s[pos][sFieldName].c_str();
+        int iFieldNum = m_field.GetField_NO(sFieldName);
+        return string(m_store.GetData(pos, iFieldNum), m_store.GetLength(pos, iFieldNum));
     }
 
     std::string RecordSet::GetCurrentFieldValue(int iFieldNum) {
         if (this)
-            return m_s[pos][iFieldNum].c_str();
+            return string(m_store.GetData(pos, iFieldNum), m_store.GetLength(pos, iFieldNum));
         else
             return "0";
     }
 
+    const char *RecordSet::GetCurrentFieldData(int iFieldNum, unsigned long *pLength) {
+        if (pLength)
+            *pLength = m_store.GetLength(pos, iFieldNum);
+        return m_store.GetData(pos, iFieldNum);
+    }
+
 /* 获取游标的对应字段数据 */
     bool RecordSet::GetFieldValue(long index, const char *sFieldName,
                                   char *sValue) {
-        strcpy(sValue, m_s[index][sFieldName].c_str());
+        strcpy(sValue, m_store.GetData(index, m_field.GetField_NO(sFieldName)));
         return true;
     }
 
     bool RecordSet::GetFieldValue(long index, int iFieldNum, char *sValue) {
-        strcpy(sValue, m_s[index][iFieldNum].c_str());
+        strcpy(sValue, m_store.GetData(index, iFieldNum));
         return true;
     }
 
 /* 是否到达游标尾部 */
     bool RecordSet::IsEof() {
-        return (pos == m_s.size()) ? true : false;
+        return (pos == m_store.GetRowCount()) ? true : false;
     }
 
 /*
@@ -352,11 +599,205 @@ namespace MysqlApi {
 * 返回指定序号的记录
 */
     Record RecordSet::operator[](int num) {
-        return m_s[num];
+        return Record(&m_field, &m_store, num);
+    }
+
+/* -------------------------------------------------- */
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 单元格视图
+*/
+    bool CellView::Equals(const char *s, unsigned long length) const {
+        if (m_null || m_length != length)
+            return false;
+        return 0 == memcmp(m_data, s, length);
+    }
+
+    long CellView::ToLong(long def) const {
+        if (m_null || 0 == m_length)
+            return def;
+        //行缓冲中的数据以'\0'结尾, 可以直接解析
+        char *end = NULL;
+        long ret = strtol(m_data, &end, 10);
+        return (end == m_data + m_length) ? ret : def;
+    }
+
+    double CellView::ToDouble(double def) const {
+        if (m_null || 0 == m_length)
+            return def;
+        char *end = NULL;
+        double ret = strtod(m_data, &end);
+        return (end == m_data + m_length) ? ret : def;
+    }
+
+/*
+* 零拷贝的查询结果
+*/
+    ResultView::ResultView(MYSQL *hSQL)
+            : m_Data(hSQL), m_res(NULL), m_row(NULL), m_lengths(NULL), m_recordcount(0), m_field_num(0),
+              m_pSession(NULL), m_pResult(NULL), m_cursor(0) {
+    }
+
+    ResultView::ResultView(DataBase *db)
+            : m_Data(db->GetMysql()), m_res(NULL), m_row(NULL), m_lengths(NULL), m_recordcount(0), m_field_num(0),
+              m_pSession(db->GetSession()), m_pResult(NULL), m_cursor(0) {
+        if (m_pSession)
+            m_pResult = new BackendResult;
+    }
+
+    ResultView::~ResultView() {
+        Free();
+        delete m_pResult;
+    }
+
+    void ResultView::Free() {
+        if (m_res != NULL)
+            mysql_free_result(m_res);
+        if (m_pResult != NULL)
+            m_pResult->Clear();
+        m_cursor = 0;
+        m_res = NULL;
+        m_row = NULL;
+        m_lengths = NULL;
+        m_recordcount = 0;
+        m_field_num = 0;
+    }
+
+    void ResultView::Attach(MYSQL_RES *res) {
+        Free();
+        m_res = res;
+        if (m_res != NULL) {
+            m_recordcount = (int) mysql_num_rows(m_res);
+            m_field_num = mysql_num_fields(m_res);
+        }
+    }
+
+    MYSQL_RES *ResultView::Detach() {
+        MYSQL_RES *res = m_res;
+        m_res = NULL;
+        Free();
+        return res;
+    }
+
+    int ResultView::ExecuteBackend(const string &SQL) {
+        unsigned long starttime = util::get_current_time_stamp();
+        if (m_pSession->Query(SQL, vector<CellView>(), *m_pResult) != 0) {
+            cout << "BackendSession::Query is failed!!sql:" << SQL << ",err:" << m_pSession->GetError() << endl;
+            m_pResult->Clear();
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, -1, 0, true);
+            return -1;
+        }
+        m_recordcount = (int) m_pResult->rows;
+        m_field_num = (int) m_pResult->fields.size();
+        QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, m_recordcount, 0, false);
+        return m_recordcount;
+    }
+
+    int ResultView::ExecuteSQL(const string &SQL) {
+        unsigned long costtime;
+        unsigned long starttime = util::get_current_time_stamp();
+        Free();
+        if (m_pSession)
+            return ExecuteBackend(SQL);
+        if (mysql_real_query(m_Data, SQL.c_str(), (unsigned long) SQL.length())) {
+            cout << "mysql_real_query is failed!!sql:" << SQL << ",err:" << mysql_error(m_Data) << endl;
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, -1, 0, true);
+            return -1;
+        }
+        m_res = mysql_store_result(m_Data);
+        if (NULL == m_res) {
+            //没有结果集的语句或读取失败
+            bool no_result = 0 == mysql_field_count(m_Data);
+            QueryStats::Instance().Record(SQL, util::get_current_time_stamp() - starttime, 0, 0, !no_result);
+            return no_result ? 0 : -1;
+        }
+        m_recordcount = (int) mysql_num_rows(m_res);
+        m_field_num = mysql_num_fields(m_res);
+        //数据按行取用, 此时不统计字节数
+        unsigned long cost_us = util::get_current_time_stamp() - starttime;
+        QueryStats::Instance().Record(SQL, cost_us, m_recordcount, 0, false);
+        costtime = cost_us / 1000;
+        if (costtime >= 1000)
+            cout << "Warn:Use " << costtime << "ms to do sql..." << SQL << endl;
+        return m_recordcount;
+    }
+
+    bool ResultView::Fetch() {
+        if (m_pSession) {
+            if (m_cursor >= (long) m_pResult->rows)
+                return false;
+            ++m_cursor;
+            return true;
+        }
+        if (NULL == m_res)
+            return false;
+        m_row = mysql_fetch_row(m_res);
+        m_lengths = m_row ? mysql_fetch_lengths(m_res) : NULL;
+        return m_row != NULL;
+    }
+
+    CellView ResultView::Get(int iFieldNum) const {
+        if (m_pSession) {
+            if (0 == m_cursor || iFieldNum < 0 || iFieldNum >= m_field_num)
+                return CellView();
+            return m_pResult->cells[(m_cursor - 1) * m_field_num + iFieldNum];
+        }
+        if (NULL == m_row || iFieldNum < 0 || iFieldNum >= m_field_num)
+            return CellView();
+        return CellView(m_row[iFieldNum], m_lengths[iFieldNum]);
+    }
+
+    CellView ResultView::Get(const char *sFieldName) const {
+        return Get(GetFieldIndex(sFieldName));
+    }
+
+    enum_field_types ResultView::GetFieldType(int iFieldNum) const {
+        if (iFieldNum < 0 || iFieldNum >= m_field_num)
+            return MYSQL_TYPE_NULL;
+        //存储后端的值都按字符串返回
+        if (m_pSession)
+            return MYSQL_TYPE_VAR_STRING;
+        if (NULL == m_res)
+            return MYSQL_TYPE_NULL;
+        return mysql_fetch_fields(m_res)[iFieldNum].type;
+    }
+
+    int ResultView::GetFieldIndex(const char *sFieldName) const {
+        if (m_pSession) {
+            for (int i = 0; i < m_field_num; i++) {
+                if (!strcmp(m_pResult->fields[i], sFieldName))
+                    return i;
+            }
+            return -1;
+        }
+        if (NULL == m_res)
+            return -1;
+        MYSQL_FIELD *fields = mysql_fetch_fields(m_res);
+        for (int i = 0; i < m_field_num; i++) {
+            if (!strcmp(fields[i].name, sFieldName))
+                return i;
+        }
+        return -1;
     }
 
 /* -------------------------------------------------- */
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 存储后端
+*/
+    static StorageBackend *s_backend = NULL;
+
+    void StorageBackend::Install(StorageBackend *backend) {
+        s_backend = backend;
+    }
+
+    StorageBackend *StorageBackend::GetInstalled() {
+        return s_backend;
+    }
+/* -------------------------------------------------- */
+
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
 /*
 * 1 负责数据库的连接关闭
@@ -364,11 +805,11 @@ namespace MysqlApi {
 * 3 处理事务
 */
     DataBase::DataBase()
-            : m_Data(NULL) {
+            : m_Data(NULL), m_pSession(NULL) {
     }
 
     DataBase::~DataBase() {
-        if (NULL != m_Data) {
+        if (NULL != m_Data || NULL != m_pSession) {
             DisConnect();
         }
     }
@@ -378,6 +819,47 @@ namespace MysqlApi {
         return m_Data;
     }
 
+/*
+* 转义字符串
+* 存储后端没有连接字符集, 按 mysql_escape_string 的规则转义
+*/
+    unsigned long DataBase::EscapeString(char *to, const char *from, unsigned long length) {
+        if (m_Data)
+            return mysql_real_escape_string(m_Data, to, from, length);
+        char *p = to;
+        for (unsigned long i = 0; i < length; i++) {
+            char escape = 0;
+            switch (from[i]) {
+                case 0:
+                    escape = '0';
+                    break;
+                case '\n':
+                    escape = 'n';
+                    break;
+                case '\r':
+                    escape = 'r';
+                    break;
+                case '\032':
+                    escape = 'Z';
+                    break;
+                case '\\':
+                case '\'':
+                case '"':
+                    escape = from[i];
+                    break;
+                default:
+                    break;
+            }
+            if (escape) {
+                *p++ = '\\';
+                *p++ = escape;
+            } else
+                *p++ = from[i];
+        }
+        *p = '\0';
+        return (unsigned long) (p - to);
+    }
+
 /*
 * 主要功能:连接数据库
 * 参数说明:
@@ -393,6 +875,12 @@ namespace MysqlApi {
     int DataBase::Connect(string host, string user, string passwd, string db, unsigned int port,
                           unsigned int connectTimeout,
                           unsigned int readTimeout, unsigned int writeTimeout, unsigned long client_flag) {
+        StorageBackend *backend = StorageBackend::GetInstalled();
+        if (backend) {
+            delete m_pSession;
+            m_pSession = backend->Open(host, user, passwd, db, port);
+            return m_pSession ? 0 : -3;
+        }
         if (!(m_Data = mysql_init(NULL))) {
             return -3;
         }
@@ -431,6 +919,11 @@ namespace MysqlApi {
 * 关闭数据库连接 
 */
     void DataBase::DisConnect() {
+        if (m_pSession) {
+            delete m_pSession;
+            m_pSession = NULL;
+            return;
+        }
         mysql_close(m_Data);
         m_Data = NULL;
     }
@@ -445,14 +938,29 @@ namespace MysqlApi {
 
         unsigned long costtime;
         unsigned long starttime = util::get_current_time_stamp();
+        if (m_pSession) {
+            BackendResult result;
+            if (m_pSession->Query(sql, vector<CellView>(), result) != 0) {
+                cout << "BackendSession::Query is failed!!sql:" << sql << ",err:" << m_pSession->GetError() << endl;
+                QueryStats::Instance().Record(sql, util::get_current_time_stamp() - starttime, -1, 0, true);
+                return -1;
+            }
+            QueryStats::Instance().Record(sql, util::get_current_time_stamp() - starttime,
+                                          (long) result.affected_rows, 0, false);
+            return (int) result.affected_rows;
+        }
         int rt = mysql_real_query(m_Data, sql.c_str(), (unsigned long) sql.length());
+        unsigned long cost_us = util::get_current_time_stamp() - starttime;
         if (!rt) {
             //得到受影响的行数
-            costtime = (util::get_current_time_stamp() - starttime) / 1000;
+            int affected = (int) mysql_affected_rows(m_Data);
+            QueryStats::Instance().Record(sql, cost_us, affected, 0, false);
+            costtime = cost_us / 1000;
             if (costtime >= 1000)
                 cout << "Warn:Use " << costtime << "ms to do this sql:" << sql << endl;
-            return (int) mysql_affected_rows(m_Data);
+            return affected;
         } else {
+            QueryStats::Instance().Record(sql, cost_us, -1, 0, true);
             //执行查询失败
             const char *err = mysql_error(m_Data); // Returns an empty string
             if (err) {
@@ -473,6 +981,8 @@ namespace MysqlApi {
 * 返回值:0 表示成功 -1 失败
 */
     int DataBase::Ping() {
+        if (m_pSession)
+            return m_pSession->Ping();
         if (!mysql_ping(m_Data))
             return 0;
         else
@@ -508,7 +1018,8 @@ namespace MysqlApi {
 * 主要功能:开始事务
 */
     int DataBase::Start_Transaction() {
-        cout << "start transaction" << endl;
+        if (m_pSession)
+            return ExecQuery("START TRANSACTION") < 0 ? -1 : 0;
         if (!mysql_real_query(m_Data, "START TRANSACTION",
                               (unsigned long) strlen("START TRANSACTION"))) {
             return 0;
@@ -522,7 +1033,8 @@ namespace MysqlApi {
 * 返回值:0 表示成功 -1 表示失败
 */
     int DataBase::Commit() {
-        cout << "enter DataBase::Commit " << endl;
+        if (m_pSession)
+            return ExecQuery("COMMIT") < 0 ? -1 : 0;
         if (!mysql_real_query(m_Data, "COMMIT",
                               (unsigned long) strlen("COMMIT"))) {
             return 0;
@@ -536,7 +1048,8 @@ namespace MysqlApi {
 * 返回值:0 表示成功 -1 表示失败
 */
     int DataBase::Rollback() {
-        cout << "roll_back" << endl;
+        if (m_pSession)
+            return ExecQuery("ROLLBACK") < 0 ? -1 : 0;
         if (!mysql_real_query(m_Data, "ROLLBACK",
                               (unsigned long) strlen("ROLLBACK")))
             return 0;
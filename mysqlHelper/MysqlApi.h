@@ -5,11 +5,17 @@
 #include <vector>
 #include <string>
 #include <mysql/mysql.h>
+/* CR_* 客户端错误码, MariaDB Connector/C 的 mysql.h 不一定包含它 */
+#include <mysql/errmsg.h>
 
 using namespace std;
 
 namespace MysqlApi
 {
+class DataBase;
+/* 存储后端, 见 StorageBackend.h */
+class BackendSession;
+struct BackendResult;
 /*
 * 字段操作 
 */
@@ -47,31 +53,104 @@ public:
     int GetField_NO(string field_name);
 };
 /*
-* 1 单条记录
+* 列式存储的记录数据
+* 1 所有单元格的字节连续存放在一块缓冲区中, 每个单元格后补一个'\0'
+* 2 每列各自保存 偏移/长度/是否为NULL 数组
+* 3 相比每个单元格一个string, 省去了逐个单元格和逐行的内存分配
+*/
+class ColumnStore
+{
+public:
+    ColumnStore();
+
+    /* 清空数据并设置字段数, 已分配的内存保留复用 */
+    void Reset(int field_num);
+    /* 预分配行数 */
+    void Reserve(unsigned long rows);
+    /* 追加一行, lengths 为 mysql_fetch_lengths 的结果 */
+    void AppendRow(MYSQL_ROW row, unsigned long *lengths);
+
+    unsigned long GetRowCount() const { return m_rows; }
+    int GetFieldNum() const { return (int) m_columns.size(); }
+    /* 单元格数据的总字节数(含结尾的'\0') */
+    unsigned long GetDataBytes() const { return m_data.size(); }
+
+    /* 单元格数据, 以'\0'结尾, NULL值返回"" */
+    const char *GetData(unsigned long row, int col) const
+    {
+        const Column &c = m_columns[col];
+        return c.is_null[row] ? "" : &m_data[c.offset[row]];
+    }
+    unsigned long GetLength(unsigned long row, int col) const { return m_columns[col].length[row]; }
+    bool IsNull(unsigned long row, int col) const { return m_columns[col].is_null[row] != 0; }
+
+private:
+    struct Column
+    {
+        vector<unsigned long> offset;
+        vector<unsigned int> length;
+        vector<char> is_null;
+    };
+
+    /* 单元格字节 */
+    vector<char> m_data;
+    /* 每列的索引 */
+    vector<Column> m_columns;
+    /* 行数 */
+    unsigned long m_rows;
+};
+class CellView;
+/*
+* 1 单条记录, 只是记录集中一行的视图, 不持有数据
 * 2 [int ]操作 [""]操作
+* 3 所属的记录集重新执行查询或析构后, 视图失效
 */
 class Record
 {
 public:
-    /* 结果集 */
-    vector<string> m_rs;
-    /* 字段信息 占用4字节的内存 当记录数很大是回产生性能问题 */
+    /* 字段信息 */
     Field *m_field;
 
 public:
-    Record(){};
-    Record(Field *m_f);
+    Record() : m_field(NULL), m_store(NULL), m_row(0){};
+    Record(Field *m_f, const ColumnStore *store, unsigned long row);
     ~Record();
 
-    void SetData(string value);
     /* [""]操作 */
     string operator[](string s);
     string operator[](int num);
+    /* 不拷贝, 直接返回记录集内的数据(以'\0'结尾) */
+    const char *GetValue(int num) const;
+    unsigned long GetLength(int num) const;
+    /* 字段数 */
+    int Size() const;
+    /* 单元格视图, 区分NULL值 */
+    CellView GetCell(int num) const;
     /* null值判断 */
     bool IsNull(int num);
     bool IsNull(string s);
     /* 用 value tab value 的形式 返回结果 */
     string GetTabText();
+
+private:
+    const ColumnStore *m_store;
+    unsigned long m_row;
+};
+/*
+* 流式读取结果的回调
+* 1 ExecuteSQLStream 每凑满一批(batch_size条)记录回调一次 HandleRows
+* 2 rows 中的记录在各批之间复用, 回调返回后其内容即失效, 需要保留的数据请自行拷贝
+* 3 回调期间连接仍在读取结果, 不能在同一连接上执行其他sql
+*/
+class RowHandler
+{
+public:
+    virtual ~RowHandler() {}
+
+    /* 字段信息就绪后回调一次 */
+    virtual void HandleFields(Field * /* field */) {}
+    /* 处理一批记录, 返回false则停止读取 */
+    virtual bool HandleRows(vector<Record> &rows) = 0;
 };
 /*
 * 1 记录集合
@@ -82,8 +161,8 @@ public:
 class RecordSet
 {
 private:
-    /* 记录集 */
-    vector<Record> m_s;
+    /* 记录集(列式存储) */
+    ColumnStore m_store;
     /* 游标位置*/
     unsigned long pos;
     /* 记录数 */
@@ -97,14 +176,27 @@ private:
     MYSQL_FIELD *fd;
     MYSQL_ROW row;
     MYSQL *m_Data;
+    /* 安装了存储后端时经由会话执行 */
+    BackendSession *m_pSession;
+
+    /* 把后端的结果保存到 m_store, 返回行数 */
+    int StoreBackendResult(const BackendResult &result);
+    long ExecuteBackendStream(const string &SQL, RowHandler &handler, unsigned int batch_size, unsigned long starttime);
 
 public:
     RecordSet();
     RecordSet(MYSQL *hSQL);
+    /* 使用连接的句柄或存储后端会话 */
+    RecordSet(DataBase *db);
     ~RecordSet();
 
     /* 处理返回多行的查询，返回影响的行数 */
     int ExecuteSQL(string SQL);
+    /*
+    * 流式处理返回多行的查询(mysql_use_result), 结果不在客户端整体缓存, 内存占用只与 batch_size 有关
+    * 返回处理的行数, 失败返回-1
+    */
+    long ExecuteSQLStream(string SQL, RowHandler &handler, unsigned int batch_size = 1);
     /* 得到记录数目 */
     int GetRecordCount();
     /* 得到字段数目 */
@@ -122,6 +214,8 @@ public:
     /* 获取当前游标的对应字段数据 */
     std::string GetCurrentFieldValue(std::string sFieldName);
     std::string GetCurrentFieldValue(int iFieldNum);
+    /* 获取当前游标的对应字段数据, 不拷贝, 在下次查询前有效 */
+    const char *GetCurrentFieldData(int iFieldNum, unsigned long *pLength = NULL);
     /* 获取游标的对应字段数据 */
     bool GetFieldValue(long index, const char *sFieldName, char *sValue);
     bool GetFieldValue(long index, int iFieldNum, char *sValue);
@@ -138,6 +232,98 @@ public:
     Record operator[](int num);
 };
 
+/*
+* 单元格视图(指针 + 长度), 不拷贝数据
+* 1 数据属于产生它的 ResultView, 在其取下一行/析构之前有效
+* 2 区分 SQL NULL 与空串
+*/
+class CellView
+{
+public:
+    CellView() : m_data(""), m_length(0), m_null(true){};
+    CellView(const char *data, unsigned long length)
+        : m_data(data ? data : ""), m_length(length), m_null(NULL == data){};
+
+    const char *Data() const { return m_data; }
+    unsigned long Size() const { return m_length; }
+    bool IsNull() const { return m_null; }
+    bool Empty() const { return 0 == m_length; }
+
+    /* 与字符串比较, NULL值与任何字符串都不相等 */
+    bool Equals(const char *s, unsigned long length) const;
+    bool operator==(const string &s) const { return Equals(s.data(), s.length()); }
+    bool operator!=(const string &s) const { return !Equals(s.data(), s.length()); }
+
+    /* 拷贝出 string, NULL值为空串 */
+    string ToString() const { return string(m_data, m_length); }
+    void AssignTo(string &s) const { s.assign(m_data, m_length); }
+    /* 解析整数, NULL值或非法数字返回 def */
+    long ToLong(long def = 0) const;
+    double ToDouble(double def = 0) const;
+
+private:
+    const char *m_data;
+    unsigned long m_length;
+    bool m_null;
+};
+/*
+* 零拷贝的查询结果
+* 1 保留 MYSQL_RES, 逐行 Fetch, 单元格以 CellView 的形式直接指向 libmysqlclient 的行缓冲
+* 2 适合只比较或解析结果的读路径, 需要保留的数据请用 CellView::ToString 拷贝
+* 3 结果集在析构或下次 ExecuteSQL 时释放
+*/
+class ResultView
+{
+public:
+    ResultView(MYSQL *hSQL);
+    /* 使用连接的句柄或存储后端会话 */
+    ResultView(DataBase *db);
+    ~ResultView();
+
+    /* 执行查询并保留结果, 返回记录数, 失败返回-1 */
+    int ExecuteSQL(const string &SQL);
+    /* 取下一行, 没有更多行返回false; 执行后第一次调用得到第一行 */
+    bool Fetch();
+    /* 当前行的单元格 */
+    CellView Get(int iFieldNum) const;
+    CellView Get(const char *sFieldName) const;
+    CellView operator[](int iFieldNum) const { return Get(iFieldNum); }
+    /* 得到记录数目 */
+    int GetRecordCount() const { return m_recordcount; }
+    /* 得到字段数目 */
+    int GetFieldNum() const { return m_field_num; }
+    /* 得到指定字段的序号, 不存在返回-1 */
+    int GetFieldIndex(const char *sFieldName) const;
+    /* 返回字段类型, 没有结果集或序号越界返回 MYSQL_TYPE_NULL */
+    enum_field_types GetFieldType(int iFieldNum) const;
+    /* 释放结果集 */
+    void Free();
+    /* 接管一个已取回的结果集(如异步查询的结果) */
+    void Attach(MYSQL_RES *res);
+    /* 交出结果集的所有权, 之后由调用者释放; 存储后端的结果不能交出, 返回NULL */
+    MYSQL_RES *Detach();
+
+private:
+    /* Don't need copy or assignment */
+    ResultView(const ResultView &);
+    ResultView &operator=(const ResultView &);
+
+    int ExecuteBackend(const string &SQL);
+
+private:
+    MYSQL *m_Data;
+    MYSQL_RES *m_res;
+    MYSQL_ROW m_row;
+    unsigned long *m_lengths;
+    int m_recordcount;
+    int m_field_num;
+
+    /* 存储后端的会话和结果, 当前行为 m_cursor - 1 */
+    BackendSession *m_pSession;
+    BackendResult *m_pResult;
+    long m_cursor;
+};
+
 /*
 * 1 负责数据库的连接关闭
 * 2 执行sql 语句(不返回结果)
@@ -152,10 +338,16 @@ public:
 private:
     /* msyql 连接句柄 */
     MYSQL *m_Data;
+    /* 安装了存储后端时的会话, 此时 m_Data 为NULL */
+    BackendSession *m_pSession;
 
 public:
     /* 返回句柄 */
     MYSQL *GetMysql();
+    /* 返回存储后端的会话, 使用 libmysqlclient 时为NULL */
+    BackendSession *GetSession() { return m_pSession; }
+    /* 转义字符串以拼入sql, to 至少 length * 2 + 1 字节, 返回转义后的长度 */
+    unsigned long EscapeString(char *to, const char *from, unsigned long length);
     /* 连接数据库 */
     int Connect(string host, string user,
                 string passwd, string db,
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+#include "ParallelScan.h"
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 一个分区的流式读取, 每批记录拷贝到自己的存储后排队
+*/
+class ParallelScanner::PartitionHandler : public MysqlApi::RowHandler
+{
+public:
+    PartitionHandler(ParallelScanner *scanner, int partition)
+        : m_scanner(scanner), m_partition(partition), m_rows(0) {}
+
+    void HandleFields(MysqlApi::Field *field) { m_scanner->SetFields(field); }
+
+    bool HandleRows(vector<MysqlApi::Record> &rows)
+    {
+        Batch *batch = m_scanner->AllocBatch();
+        int field_num = rows.empty() ? 0 : rows[0].Size();
+        batch->store.Reset(field_num);
+        batch->store.Reserve(rows.size());
+        m_row.resize(field_num);
+        m_lengths.resize(field_num);
+        for (unsigned long r = 0; r < rows.size(); r++) {
+            MysqlApi::Record &record = rows[r];
+            for (int i = 0; i < field_num; i++) {
+                m_row[i] = record.IsNull(i) ? NULL : (char *) record.GetValue(i);
+                m_lengths[i] = record.GetLength(i);
+            }
+            batch->store.AppendRow(field_num ? &m_row[0] : NULL, field_num ? &m_lengths[0] : NULL);
+        }
+        batch->rows.clear();
+        for (unsigned long r = 0; r < rows.size(); r++)
+            batch->rows.push_back(MysqlApi::Record(&m_scanner->m_field, &batch->store, r));
+        m_rows += rows.size();
+        return m_scanner->Push(m_partition, batch);
+    }
+
+    unsigned long GetRows() const { return m_rows; }
+
+private:
+    ParallelScanner *m_scanner;
+    int m_partition;
+    unsigned long m_rows;
+    vector<char *> m_row;
+    vector<unsigned long> m_lengths;
+};
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 按主键范围分区的并行表扫描
+*/
+ParallelScanner::ParallelScanner(CdbConncetPool &pool, const Config &config)
+        : m_pool(pool), m_config(config), m_has_fields(false), m_aborted(false), m_failed(false), m_current(0),
+          m_done(0), m_rows(0), m_bytes(0), m_start_ms(0), m_next(0) {
+    if (m_config.parallelism <= 0)
+        m_config.parallelism = 1;
+    if (m_config.partitions <= 0)
+        m_config.partitions = m_config.parallelism * 4;
+    if (0 == m_config.batch_rows)
+        m_config.batch_rows = 1;
+    if (0 == m_config.queue_batches)
+        m_config.queue_batches = 1;
+    if (0 == m_config.sample_rows)
+        m_config.sample_rows = 1;
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_ready, NULL);
+    pthread_cond_init(&m_space, NULL);
+}
+
+ParallelScanner::~ParallelScanner() {
+    for (unsigned int i = 0; i < m_free.size(); i++)
+        delete m_free[i];
+    pthread_cond_destroy(&m_space);
+    pthread_cond_destroy(&m_ready);
+    pthread_mutex_destroy(&m_lock);
+}
+
+unsigned long ParallelScanner::NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+/* 等分 [min, max], 分界点为整数 */
+bool ParallelScanner::SplitMinMax(MysqlApi::DataBase &db, const string &table, const string &key,
+                                  const string &where, vector<string> &bounds) {
+    string sql = "select min(" + key + "),max(" + key + ") from " + table;
+    if (!where.empty())
+        sql += " where " + where;
+    MysqlApi::ResultView rs(&db);
+    if (rs.ExecuteSQL(sql) < 0 || !rs.Fetch())
+        return false;
+    //空表
+    if (rs[0].IsNull() || rs[1].IsNull())
+        return true;
+    long long min = strtoll(rs[0].ToString().c_str(), NULL, 10);
+    long long max = strtoll(rs[1].ToString().c_str(), NULL, 10);
+    unsigned long long span = (unsigned long long) max - (unsigned long long) min;
+    unsigned long long step = span / (unsigned long long) m_config.partitions;
+    if (0 == step)
+        step = 1;
+    char buf[32];
+    for (int i = 1; i < m_config.partitions; i++) {
+        unsigned long long offset = step * i;
+        if (offset > span)
+            break;
+        snprintf(buf, sizeof(buf), "%lld", (long long) ((unsigned long long) min + offset));
+        bounds.push_back(buf);
+    }
+    return true;
+}
+
+/* 按抽样的主键的分位数分区, 样本由服务器排序 */
+bool ParallelScanner::SplitSample(MysqlApi::DataBase &db, const string &table, const string &key,
+                                  const string &where, vector<string> &bounds) {
+    unsigned long target = (unsigned long) m_config.partitions * m_config.sample_rows;
+    double ratio = 1;
+    {
+        //表行数的估计值, 取不到时全取
+        string escaped(table.length() * 2 + 1, '\0');
+        escaped.resize(db.EscapeString(&escaped[0], table.data(), table.length()));
+        MysqlApi::ResultView rs(&db);
+        if (rs.ExecuteSQL("select table_rows from information_schema.tables where table_schema=database() "
+                          "and table_name='" + escaped + "'") > 0 && rs.Fetch()) {
+            long rows = rs[0].ToLong(0);
+            if (rows > 0 && (unsigned long) rows > target)
+                ratio = (double) target / rows;
+        }
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.9f", ratio);
+    string sql = "select " + key + " from " + table;
+    if (ratio < 1)
+        sql += string(" where rand()<") + buf + (where.empty() ? "" : " and (" + where + ")");
+    else if (!where.empty())
+        sql += " where " + where;
+    sql += " order by " + key;
+
+    MysqlApi::RecordSet rs(&db);
+    int count = rs.ExecuteSQL(sql);
+    if (count < 0)
+        return false;
+    if (0 == count)
+        return true;
+    bool numeric = rs.GetField()->IsNum(0);
+    string last;
+    for (int i = 1; i < m_config.partitions; i++) {
+        long index = (long) count * i / m_config.partitions;
+        unsigned long length = 0;
+        rs.Move(index - (long) rs.GetCurrentPos());
+        const char *data = rs.GetCurrentFieldData(0, &length);
+        string bound;
+        if (numeric)
+            bound.assign(data, length);
+        else {
+            string escaped(length * 2 + 1, '\0');
+            escaped.resize(db.EscapeString(&escaped[0], data, length));
+            bound = "'" + escaped + "'";
+        }
+        //重复的分界点会产生空分区
+        if (bound == last)
+            continue;
+        bounds.push_back(bound);
+        last = bound;
+    }
+    return true;
+}
+
+bool ParallelScanner::Split(MysqlApi::DataBase &db, const string &table, const string &key, const string &where,
+                            vector<string> &bounds) {
+    bounds.clear();
+    if (SPLIT_SAMPLE == m_config.split)
+        return SplitSample(db, table, key, where, bounds);
+    return SplitMinMax(db, table, key, where, bounds);
+}
+
+string ParallelScanner::BuildSql(int partition) const {
+    const Partition &part = m_partitions[partition];
+    string sql = "select " + m_columns + " from " + m_table;
+    string cond = m_where.empty() ? "" : "(" + m_where + ")";
+    if (!part.lower.empty())
+        cond += (cond.empty() ? "" : " and ") + m_key + ">=" + part.lower;
+    if (!part.upper.empty())
+        cond += (cond.empty() ? "" : " and ") + m_key + "<" + part.upper;
+    if (!cond.empty())
+        sql += " where " + cond;
+    if (m_config.ordered)
+        sql += " order by " + m_key;
+    return sql;
+}
+
+void ParallelScanner::SetFields(MysqlApi::Field *field) {
+    autoLock al(m_lock);
+    if (m_has_fields)
+        return;
+    m_field.m_name = field->m_name;
+    m_field.m_type = field->m_type;
+    m_field.m_table = field->m_table;
+    m_has_fields = true;
+}
+
+ParallelScanner::Batch *ParallelScanner::AllocBatch() {
+    {
+        autoLock al(m_lock);
+        if (!m_free.empty()) {
+            Batch *batch = m_free.back();
+            m_free.pop_back();
+            return batch;
+        }
+    }
+    return new Batch;
+}
+
+void ParallelScanner::Recycle(Batch *batch) {
+    autoLock al(m_lock);
+    m_free.push_back(batch);
+}
+
+bool ParallelScanner::Push(int partition, Batch *batch) {
+    autoLock al(m_lock);
+    Partition &part = m_partitions[partition];
+    while (!m_aborted && part.batches.size() >= m_config.queue_batches)
+        pthread_cond_wait(&m_space, &m_lock);
+    if (m_aborted) {
+        m_free.push_back(batch);
+        return false;
+    }
+    part.batches.push_back(batch);
+    pthread_cond_signal(&m_ready);
+    return true;
+}
+
+void ParallelScanner::FinishPartition(int partition) {
+    autoLock al(m_lock);
+    m_partitions[partition].done = true;
+    ++m_done;
+    pthread_cond_signal(&m_ready);
+}
+
+void ParallelScanner::Abort(bool failed) {
+    autoLock al(m_lock);
+    m_aborted = true;
+    if (failed)
+        m_failed = true;
+    pthread_cond_broadcast(&m_space);
+    pthread_cond_signal(&m_ready);
+}
+
+bool ParallelScanner::ScanPartition(Connection *pConn, int partition, unsigned long &produced) {
+    PartitionHandler handler(this, partition);
+    MysqlApi::RecordSet rs(&pConn->hDB);
+    long rows = rs.ExecuteSQLStream(BuildSql(partition), handler, m_config.batch_rows);
+    produced = handler.GetRows();
+    return rows >= 0;
+}
+
+void *ParallelScanner::WorkerEntry(void *arg) {
+    ((ParallelScanner *) arg)->Worker();
+    return NULL;
+}
+
+void ParallelScanner::Worker() {
+    Connection *pConn = m_pool.GetConnection(m_config.conn_wait_ms);
+    if (NULL == pConn) {
+        cout << "ParallelScanner::Worker no db connection, table:" << m_table << endl;
+        Abort(true);
+        return;
+    }
+    int partition;
+    while ((partition = m_next.fetchAdd(1)) < (int) m_partitions.size()) {
+        bool ok = false;
+        for (int attempt = 0; attempt <= m_config.max_retries; attempt++) {
+            unsigned long produced = 0;
+            ok = ScanPartition(pConn, partition, produced);
+            {
+                autoLock al(m_lock);
+                if (m_aborted) {
+                    //consumer 停止或其他分区失败, 读取中断不算失败
+                    ok = true;
+                    break;
+                }
+            }
+            //已有记录交出后不能重试, 否则会重复
+            if (ok || produced > 0)
+                break;
+            MYSQL *mysql = pConn->hDB.GetMysql();
+            unsigned int err = mysql ? mysql_errno(mysql) : 0;
+            if (err != CR_SERVER_GONE_ERROR && err != CR_SERVER_LOST)
+                break;
+            cout << "ParallelScanner::Worker connection lost, retry:" << attempt << ",partition:" << partition << endl;
+            pConn = m_pool.ReCreateConnection(pConn);
+            if (NULL == pConn)
+                break;
+        }
+        if (!ok) {
+            cout << "ParallelScanner::Worker failed to scan partition:" << partition << ",table:" << m_table << endl;
+            Abort(true);
+            break;
+        }
+        FinishPartition(partition);
+        autoLock al(m_lock);
+        if (m_aborted)
+            break;
+    }
+    if (pConn)
+        m_pool.ReleaseConnection(pConn);
+}
+
+void ParallelScanner::Report(ScanConsumer &consumer) {
+    consumer.HandleProgress(GetProgress());
+}
+
+ScanProgress ParallelScanner::GetProgress() {
+    autoLock al(m_lock);
+    ScanProgress progress;
+    progress.partitions = (int) m_partitions.size();
+    progress.partitions_done = m_done;
+    progress.rows = m_rows;
+    progress.bytes = m_bytes;
+    progress.elapsed_ms = m_start_ms ? NowMs() - m_start_ms : 0;
+    return progress;
+}
+
+ParallelScanner::Batch *ParallelScanner::Pop(int &partition, ScanConsumer &consumer, unsigned long &next_progress) {
+    int count = (int) m_partitions.size();
+    while (true) {
+        bool report = false;
+        {
+            autoLock al(m_lock);
+            while (true) {
+                if (m_aborted)
+                    return NULL;
+                //跳过已交完的分区; 有序模式下只看当前分区, 无序模式下轮询
+                while (m_current < count && m_partitions[m_current].done && m_partitions[m_current].batches.empty())
+                    ++m_current;
+                if (m_current >= count)
+                    return NULL;
+                int found = -1;
+                if (m_config.ordered) {
+                    if (!m_partitions[m_current].batches.empty())
+                        found = m_current;
+                } else {
+                    for (int i = m_current; i < count; i++) {
+                        if (!m_partitions[i].batches.empty()) {
+                            found = i;
+                            break;
+                        }
+                    }
+                }
+                if (found >= 0) {
+                    Partition &part = m_partitions[found];
+                    Batch *batch = part.batches.front();
+                    part.batches.pop_front();
+                    pthread_cond_broadcast(&m_space);
+                    partition = found;
+                    m_rows += batch->rows.size();
+                    m_bytes += batch->store.GetDataBytes();
+                    return batch;
+                }
+                if (m_config.progress_interval_ms && NowMs() >= next_progress)
+                    break;
+                if (0 == m_config.progress_interval_ms)
+                    pthread_cond_wait(&m_ready, &m_lock);
+                else {
+                    struct timespec ts;
+                    clock_gettime(CLOCK_REALTIME, &ts);
+                    //上面检查之后期限可能刚过, 不能让差值回绕
+                    unsigned long now = NowMs();
+                    unsigned long wait_ms = next_progress > now ? next_progress - now : 0;
+                    ts.tv_sec += wait_ms / 1000;
+                    ts.tv_nsec += (wait_ms % 1000) * 1000000;
+                    if (ts.tv_nsec >= 1000000000) {
+                        ts.tv_sec += 1;
+                        ts.tv_nsec -= 1000000000;
+                    }
+                    pthread_cond_timedwait(&m_ready, &m_lock, &ts);
+                }
+            }
+            report = true;
+        }
+        if (report) {
+            Report(consumer);
+            next_progress = NowMs() + m_config.progress_interval_ms;
+        }
+    }
+}
+
+long ParallelScanner::Scan(const string &table, const string &key, const string &columns, const string &where,
+                           ScanConsumer &consumer) {
+    m_table = table;
+    m_key = key;
+    m_columns = columns.empty() ? "*" : columns;
+    m_where = where;
+    m_start_ms = NowMs();
+
+    vector<string> bounds;
+    {
+        Connection *pConn = m_pool.GetConnection(m_config.conn_wait_ms);
+        if (NULL == pConn) {
+            cout << "ParallelScanner::Scan no db connection, table:" << table << endl;
+            return -1;
+        }
+        bool ok = Split(pConn->hDB, table, key, where, bounds);
+        m_pool.ReleaseConnection(pConn);
+        if (!ok) {
+            cout << "ParallelScanner::Scan failed to split table:" << table << endl;
+            return -1;
+        }
+    }
+
+    {
+        autoLock al(m_lock);
+        m_partitions.clear();
+        m_partitions.resize(bounds.size() + 1);
+        for (unsigned int i = 0; i < m_partitions.size(); i++) {
+            m_partitions[i].lower = i > 0 ? bounds[i - 1] : "";
+            m_partitions[i].upper = i < bounds.size() ? bounds[i] : "";
+            m_partitions[i].done = false;
+        }
+        m_has_fields = false;
+        m_aborted = false;
+        m_failed = false;
+        m_current = 0;
+        m_done = 0;
+        m_rows = 0;
+        m_bytes = 0;
+    }
+    m_next.store(0);
+
+    int thread_num = m_config.parallelism < (int) m_partitions.size() ? m_config.parallelism
+                                                                       : (int) m_partitions.size();
+    vector<pthread_t> threads;
+    for (int i = 0; i < thread_num; i++) {
+        pthread_t tid;
+        if (0 == pthread_create(&tid, NULL, WorkerEntry, this))
+            threads.push_back(tid);
+    }
+    if (threads.empty()) {
+        cout << "ParallelScanner::Scan failed to start threads, table:" << table << endl;
+        return -1;
+    }
+
+    bool fields_sent = false;
+    unsigned long next_progress = NowMs() + m_config.progress_interval_ms;
+    int partition = 0;
+    Batch *batch;
+    while ((batch = Pop(partition, consumer, next_progress)) != NULL) {
+        if (!fields_sent) {
+            consumer.HandleFields(&m_field);
+            fields_sent = true;
+        }
+        bool go_on = consumer.HandleRows(partition, batch->rows);
+        Recycle(batch);
+        if (!go_on) {
+            Abort(false);
+            break;
+        }
+    }
+    for (unsigned int i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+
+    //释放未交出的批
+    {
+        autoLock al(m_lock);
+        for (unsigned int i = 0; i < m_partitions.size(); i++) {
+            deque<Batch *> &batches = m_partitions[i].batches;
+            m_free.insert(m_free.end(), batches.begin(), batches.end());
+            batches.clear();
+        }
+    }
+    Report(consumer);
+    return m_failed ? -1 : (long) m_rows;
+}
+/* -------------------------------------------------- */
@@ -0,0 +1,200 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _PARALLEL_SCAN_H_
+#define _PARALLEL_SCAN_H_
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "DbConnectPool.h"
+
+/*
+* 并行扫描的进度
+*/
+struct ScanProgress
+{
+    int partitions;
+    int partitions_done;
+    /* 已交给 consumer 的行数和字节数 */
+    unsigned long rows;
+    unsigned long bytes;
+    unsigned long elapsed_ms;
+};
+
+/*
+* 并行扫描结果的接收者, 所有回调都在调用 Scan 的线程中依次进行, 不需要加锁
+*/
+class ScanConsumer
+{
+public:
+    virtual ~ScanConsumer() {}
+
+    /* 收到第一批记录前回调一次 */
+    virtual void HandleFields(MysqlApi::Field * /* field */) {}
+    /*
+    * 处理一批记录, partition 为所属分区(按主键从小到大编号)
+    * rows 在回调返回后失效; 返回false则停止扫描
+    */
+    virtual bool HandleRows(int partition, vector<MysqlApi::Record> &rows) = 0;
+    /* 每隔 progress_interval_ms 及扫描结束时回调 */
+    virtual void HandleProgress(const ScanProgress & /* progress */) {}
+};
+
+/*
+* 按主键范围分区的并行表扫描
+* 1 分区: SPLIT_MIN_MAX 用 select min(key),max(key) 把整数主键等分, 适合分布均匀的自增主键;
+*   SPLIT_SAMPLE 用 rand() 抽样约 partitions * sample_rows 个主键, 按分位数分区, 适合任意类型和有倾斜的主键
+* 2 首尾分区不设下界/上界, 扫描期间新增的超出范围的行也不会遗漏
+* 3 parallelism 个线程各取一个连接池连接, 依次领取分区, 用 ExecuteSQLStream(mysql_use_result) 流式读取
+* 4 各分区的记录按批排队, 由调用线程合并后交给 consumer:
+*   无序模式下哪个分区有数据就先交哪个; 有序模式下各分区内 order by key, 按分区顺序交出, 结果整体按主键有序
+* 5 每个分区最多排队 queue_batches 批, 满时该分区的读取暂停, 内存占用有上限
+*   (有序模式下排在后面的分区可能暂停较久, 需要服务器的 net_write_timeout 足够长)
+* 6 分区在交出任何记录前失败时换连接重试, 最多 max_retries 次; 之后的失败使整个扫描失败
+*
+* 用法:
+*     ParallelScanner::Config config;
+*     config.parallelism = 8;
+*     ParallelScanner scanner(Singleton<CdbConncetPool>::instance(), config);
+*     long rows = scanner.Scan("cdr", "id", "id,caller,callee,duration", "start_time >= '2026-10-01'", consumer);
+*/
+class ParallelScanner
+{
+public:
+    enum SplitMode
+    {
+        SPLIT_MIN_MAX,
+        SPLIT_SAMPLE
+    };
+
+    struct Config
+    {
+        /* 并发的线程(连接)数 */
+        int parallelism;
+        /* 分区数, 0则为 parallelism * 4 */
+        int partitions;
+        SplitMode split;
+        /* 是否按主键顺序交出 */
+        bool ordered;
+        /* 每批的行数 */
+        unsigned int batch_rows;
+        /* 每个分区最多排队的批数 */
+        unsigned int queue_batches;
+        /* SPLIT_SAMPLE 每个分区的样本数 */
+        unsigned int sample_rows;
+        int max_retries;
+        /* 取连接的最长等待时间 */
+        unsigned long conn_wait_ms;
+        /* 进度回调的间隔, 0则只在结束时回调 */
+        unsigned long progress_interval_ms;
+
+        Config()
+            : parallelism(4), partitions(0), split(SPLIT_MIN_MAX), ordered(false), batch_rows(1024),
+              queue_batches(4), sample_rows(32), max_retries(2), conn_wait_ms(3000), progress_interval_ms(1000) {}
+    };
+
+    ParallelScanner(CdbConncetPool &pool, const Config &config = Config());
+    ~ParallelScanner();
+
+    /*
+    * 扫描 table, key 为主键列, columns 为要读的列(如 "*"), where 为附加条件(可为空)
+    * 返回交给 consumer 的行数, 失败返回-1; consumer 提前停止时返回已交出的行数
+    * 同一个 ParallelScanner 同时只能执行一个 Scan
+    */
+    long Scan(const string &table, const string &key, const string &columns, const string &where,
+              ScanConsumer &consumer);
+
+    /* 当前进度, 可在其他线程调用 */
+    ScanProgress GetProgress();
+
+private:
+    /* 一批记录, 数据归这一批所有 */
+    struct Batch
+    {
+        MysqlApi::ColumnStore store;
+        vector<MysqlApi::Record> rows;
+    };
+
+    struct Partition
+    {
+        /* 边界为 sql 中的常量(已转义并加引号), 空表示不设该边界 */
+        string lower;
+        string upper;
+        deque<Batch *> batches;
+        bool done;
+    };
+
+    class PartitionHandler;
+    friend class PartitionHandler;
+
+    /* Don't need copy or assignment */
+    ParallelScanner(const ParallelScanner &);
+    ParallelScanner &operator=(const ParallelScanner &);
+
+    /* 计算各分区的边界, 失败返回false */
+    bool Split(MysqlApi::DataBase &db, const string &table, const string &key, const string &where,
+               vector<string> &bounds);
+    bool SplitMinMax(MysqlApi::DataBase &db, const string &table, const string &key, const string &where,
+                     vector<string> &bounds);
+    bool SplitSample(MysqlApi::DataBase &db, const string &table, const string &key, const string &where,
+                     vector<string> &bounds);
+    string BuildSql(int partition) const;
+
+    static void *WorkerEntry(void *arg);
+    void Worker();
+    /* 扫描一个分区, 成功返回true; produced 为已排队的行数 */
+    bool ScanPartition(Connection *pConn, int partition, unsigned long &produced);
+
+    /* 以下由工作线程调用 */
+    void SetFields(MysqlApi::Field *field);
+    Batch *AllocBatch();
+    /* 排队一批, 队列满时等待; 扫描已终止返回false */
+    bool Push(int partition, Batch *batch);
+    void FinishPartition(int partition);
+    void Abort(bool failed);
+
+    /* 取下一批交给 consumer, 没有了返回NULL */
+    Batch *Pop(int &partition, ScanConsumer &consumer, unsigned long &next_progress);
+    void Recycle(Batch *batch);
+    void Report(ScanConsumer &consumer);
+    static unsigned long NowMs();
+
+private:
+    CdbConncetPool &m_pool;
+    Config m_config;
+
+    /* 本次扫描的参数 */
+    string m_table;
+    string m_key;
+    string m_columns;
+    string m_where;
+
+    pthread_mutex_t m_lock;
+    /* 有新的批或分区完成 */
+    pthread_cond_t m_ready;
+    /* 队列有空位 */
+    pthread_cond_t m_space;
+    vector<Partition> m_partitions;
+    vector<Batch *> m_free;
+    MysqlApi::Field m_field;
+    bool m_has_fields;
+    bool m_aborted;
+    bool m_failed;
+    /* 有序模式下正在交出的分区, 无序模式下轮询的起点 */
+    int m_current;
+    /* 已读完的分区数 */
+    int m_done;
+    unsigned long m_rows;
+    unsigned long m_bytes;
+    unsigned long m_start_ms;
+
+    /* 下一个待领取的分区 */
+    zcUtils::Atomic<int> m_next;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include <string.h>
+
+#include "PhoneRegionIndex.h"
+#include "mysqlMgr.h"
+#include "timerThread.h"
+#include "timeval.h"
+
+/* 当前发布的索引 */
+static zcUtils::RcuPointer<PhoneRegionIndex> s_current_index;
+/* 串行化重新加载 */
+static pthread_mutex_t s_reload_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* 后台刷新 */
+class PhoneRegionRefresher : public TimerHandler
+{
+public:
+    void HandleTimer()
+    {
+        PhoneRegionIndex::Reload();
+    }
+};
+
+static Timer *s_refresh_timer = NULL;
+static PhoneRegionRefresher s_refresher;
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+PhoneRegionIndex::PhoneRegionIndex() : m_phone_count(0) {
+    memset(m_pages, 0, sizeof(m_pages));
+    //下标0表示没有记录
+    Region none = {"", "", ""};
+    m_regions.push_back(none);
+}
+
+PhoneRegionIndex::~PhoneRegionIndex() {
+    for (int i = 0; i < PAGE_NUM; i++)
+        delete[] m_pages[i];
+}
+
+long PhoneRegionIndex::PhoneToIndex(const char *phone, unsigned long length) {
+    if (length != (unsigned long) PHONE_LEN)
+        return -1;
+    long index = 0;
+    for (int i = 0; i < PHONE_LEN; i++) {
+        if (phone[i] < '0' || phone[i] > '9')
+            return -1;
+        index = index * 10 + (phone[i] - '0');
+    }
+    return index;
+}
+
+const char *PhoneRegionIndex::Intern(const char *data, unsigned long length) {
+    return m_strings.insert(string(data, length)).first->c_str();
+}
+
+uint16_t PhoneRegionIndex::AddRegion(const char *province, const char *city, const char *isp) {
+    string key = string(province) + '\t' + city + '\t' + isp;
+    map<string, uint16_t>::iterator it = m_region_ids.find(key);
+    if (it != m_region_ids.end())
+        return it->second;
+    if (m_regions.size() >= REGION_NOT_UNIQUE)
+        return REGION_NONE;
+    Region region = {province, city, isp};
+    uint16_t id = (uint16_t) m_regions.size();
+    m_regions.push_back(region);
+    m_region_ids[key] = id;
+    return id;
+}
+
+bool PhoneRegionIndex::AddPhone(const char *phone, unsigned long length, uint16_t region) {
+    long index = PhoneToIndex(phone, length);
+    if (index < 0)
+        return false;
+    uint16_t *&page = m_pages[index / PAGE_SIZE];
+    if (NULL == page) {
+        page = new uint16_t[PAGE_SIZE];
+        memset(page, 0, sizeof(uint16_t) * PAGE_SIZE);
+    }
+    uint16_t &slot = page[index % PAGE_SIZE];
+    if (REGION_NONE == slot) {
+        slot = region;
+        ++m_phone_count;
+    } else
+        slot = REGION_NOT_UNIQUE;
+    return true;
+}
+
+/*
+* 从数据库加载整张表
+* 表很小(约50万行), 一次取回后逐行建索引
+*/
+PhoneRegionIndex *PhoneRegionIndex::Load() {
+    unsigned long starttime = util::get_current_time_stamp();
+    PLMySql mysql_db(DB_ROUTE_READ);
+    MysqlApi::DataBase *db = mysql_db.get_db_instance();
+    if (NULL == db) {
+        cout << "PhoneRegionIndex::Load failed to get db connection." << endl;
+        return NULL;
+    }
+    MysqlApi::ResultView rs(db);
+    if (rs.ExecuteSQL("select prefix,phone,province,city,isp from phone_number_region;") < 0)
+        return NULL;
+
+    PhoneRegionIndex *index = new PhoneRegionIndex;
+    map<string, set<string> > prefix_isps;
+    unsigned long skipped = 0;
+    while (rs.Fetch()) {
+        MysqlApi::CellView prefix = rs[0], phone = rs[1], province = rs[2], city = rs[3], isp = rs[4];
+        const char *isp_str = index->Intern(isp.Data(), isp.Size());
+        if (!prefix.IsNull())
+            prefix_isps[prefix.ToString()].insert(isp_str);
+        uint16_t region = index->AddRegion(index->Intern(province.Data(), province.Size()),
+                                           index->Intern(city.Data(), city.Size()), isp_str);
+        //地区编号用完时跳过的号码会查不到, 整体放弃, 调用者继续查数据库
+        if (REGION_NONE == region) {
+            cout << "PhoneRegionIndex::Load too many regions:" << index->GetRegionCount() << endl;
+            delete index;
+            return NULL;
+        }
+        if (!index->AddPhone(phone.Data(), phone.Size(), region))
+            ++skipped;
+    }
+    //与 group by isp 的顺序一致
+    for (map<string, set<string> >::iterator it = prefix_isps.begin(); it != prefix_isps.end(); ++it) {
+        vector<const char *> &isps = index->m_prefix_isps[it->first];
+        for (set<string>::iterator s = it->second.begin(); s != it->second.end(); ++s)
+            isps.push_back(index->Intern(s->data(), s->length()));
+    }
+    cout << "PhoneRegionIndex::Load phones:" << index->m_phone_count << ",regions:" << index->GetRegionCount()
+         << ",skipped:" << skipped << ",memory:" << index->GetMemoryBytes()
+         << ",cost:" << (util::get_current_time_stamp() - starttime) / 1000 << "ms" << endl;
+    return index;
+}
+
+bool PhoneRegionIndex::Reload() {
+    autoLock al(s_reload_lock);
+    PhoneRegionIndex *index = Load();
+    if (NULL == index)
+        return false;
+    s_current_index.publish(index);
+    return true;
+}
+
+bool PhoneRegionIndex::Start(unsigned int refresh_seconds) {
+    if (!Reload())
+        return false;
+    if (refresh_seconds > 0 && NULL == s_refresh_timer) {
+        s_refresh_timer = new Timer(refresh_seconds);
+        s_refresh_timer->SetTimerHandler(&s_refresher);
+        if (!s_refresh_timer->Start()) {
+            delete s_refresh_timer;
+            s_refresh_timer = NULL;
+        }
+    }
+    return true;
+}
+
+void PhoneRegionIndex::Stop() {
+    if (s_refresh_timer) {
+        s_refresh_timer->Stop();
+        s_refresh_timer->Join();
+        delete s_refresh_timer;
+        s_refresh_timer = NULL;
+    }
+}
+
+PhoneRegionIndex::FindResult PhoneRegionIndex::Find(const string &phone, const Region *&region) const {
+    long index = PhoneToIndex(phone.data(), phone.length());
+    if (index < 0)
+        return BAD_PHONE;
+    const uint16_t *page = m_pages[index / PAGE_SIZE];
+    uint16_t id = page ? page[index % PAGE_SIZE] : REGION_NONE;
+    if (REGION_NONE == id)
+        return NOT_FOUND;
+    if (REGION_NOT_UNIQUE == id)
+        return NOT_UNIQUE;
+    region = &m_regions[id];
+    return FOUND;
+}
+
+int PhoneRegionIndex::FindIspsByPrefix(const string &prefix, vector<const char *> &isps) const {
+    map<string, vector<const char *> >::const_iterator it = m_prefix_isps.find(prefix);
+    if (it == m_prefix_isps.end())
+        return 0;
+    isps = it->second;
+    return (int) isps.size();
+}
+
+unsigned long PhoneRegionIndex::GetMemoryBytes() const {
+    unsigned long bytes = 0;
+    for (int i = 0; i < PAGE_NUM; i++) {
+        if (m_pages[i])
+            bytes += sizeof(uint16_t) * PAGE_SIZE;
+    }
+    return bytes;
+}
+
+PhoneRegionIndex::Reader::Reader() : m_pIndex(s_current_index.read()) {}
+/* -------------------------------------------------- */
@@ -0,0 +1,131 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _PHONE_REGION_INDEX_H_
+#define _PHONE_REGION_INDEX_H_
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rcu.h"
+
+using namespace std;
+
+/*
+* phone_number_region 表的内存索引
+* 1 号段(手机号前7位)直接作为下标: 按前3位分为1000页, 每页10000个 uint16 的地区编号, 只分配用到的页
+* 2 省/市/运营商字符串全部驻留, 相同的 省+市+运营商 共用一个地区编号
+* 3 建好后不再修改, 刷新时整体重建后替换(RCU), 查询不加锁
+*
+* 用法:
+*     PhoneRegionIndex::Reader index;
+*     if (index.valid()) {
+*         const PhoneRegionIndex::Region *region = NULL;
+*         if (PhoneRegionIndex::FOUND == index->Find(phone, region)) ...
+*     }
+*/
+class PhoneRegionIndex
+{
+public:
+    struct Region
+    {
+        const char *province;
+        const char *city;
+        const char *isp;
+    };
+
+    enum FindResult
+    {
+        FOUND = 0,
+        NOT_FOUND = 1,
+        /* 表中该号段有多条记录 */
+        NOT_UNIQUE = 2,
+        /* 不是7位数字 */
+        BAD_PHONE = 3,
+    };
+
+    /* 号段长度 */
+    static const int PHONE_LEN = 7;
+
+    ~PhoneRegionIndex();
+
+    /* 从数据库加载, 失败返回NULL */
+    static PhoneRegionIndex *Load();
+
+    /*
+    * 启动: 同步加载一次并发布, 之后每 refresh_seconds 秒在后台重新加载
+    * refresh_seconds 为0则不刷新; 加载失败返回false, DbFactory 仍走数据库
+    */
+    static bool Start(unsigned int refresh_seconds = 3600);
+    static void Stop();
+    /* 立即重新加载并替换, 失败时保留旧索引 */
+    static bool Reload();
+
+    /* 按7位号段查找 */
+    FindResult Find(const string &phone, const Region *&region) const;
+    /* 按前3位查找所有运营商(排序去重), 返回个数 */
+    int FindIspsByPrefix(const string &prefix, vector<const char *> &isps) const;
+
+    unsigned long GetPhoneCount() const { return m_phone_count; }
+    int GetRegionCount() const { return (int) m_regions.size() - 1; }
+    /* 号段页占用的内存 */
+    unsigned long GetMemoryBytes() const;
+
+    /* 当前索引的读视图, 生存期内索引不会被释放 */
+    class Reader
+    {
+    public:
+        Reader();
+
+        bool valid() const { return NULL != m_pIndex; }
+        const PhoneRegionIndex *operator->() const { return m_pIndex; }
+        const PhoneRegionIndex &operator*() const { return *m_pIndex; }
+
+    private:
+        /* Don't need copy or assignment */
+        Reader(const Reader &);
+        Reader &operator=(const Reader &);
+
+    private:
+        zcUtils::RcuReadGuard m_guard;
+        const PhoneRegionIndex *m_pIndex;
+    };
+
+private:
+    static const int PAGE_NUM = 1000;
+    static const int PAGE_SIZE = 10000;
+    /* 地区编号0表示没有记录 */
+    static const uint16_t REGION_NONE = 0;
+    static const uint16_t REGION_NOT_UNIQUE = 0xFFFF;
+
+    PhoneRegionIndex();
+
+    /* Don't need copy or assignment */
+    PhoneRegionIndex(const PhoneRegionIndex &);
+    PhoneRegionIndex &operator=(const PhoneRegionIndex &);
+
+    const char *Intern(const char *data, unsigned long length);
+    /* 返回地区编号, 超出上限返回 REGION_NONE */
+    uint16_t AddRegion(const char *province, const char *city, const char *isp);
+    bool AddPhone(const char *phone, unsigned long length, uint16_t region);
+    /* 7位数字转为下标, 非法返回-1 */
+    static long PhoneToIndex(const char *phone, unsigned long length);
+
+private:
+    /* 号段页 */
+    uint16_t *m_pages[PAGE_NUM];
+    /* 地区, 下标0不用 */
+    vector<Region> m_regions;
+    map<string, uint16_t> m_region_ids;
+    /* 驻留的字符串 */
+    set<string> m_strings;
+    /* 前3位 -> 运营商 */
+    map<string, vector<const char *> > m_prefix_isps;
+    unsigned long m_phone_count;
+};
+
+#endif
@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "PreparedStmt.h"
+#include "timeval.h"
+#include "QueryStats.h"
+#include "StorageBackend.h"
+
+/* mysqld_error.h 中的定义, mysql.h 不包含它 */
+#ifndef ER_UNKNOWN_STMT_HANDLER
+#define ER_UNKNOWN_STMT_HANDLER 1243
+#endif
+#ifndef ER_NEED_REPREPARE
+#define ER_NEED_REPREPARE 1615
+#endif
+
+/* 字符串结果的初始缓冲大小, 超出时按实际长度扩大 */
+#define STMT_INIT_BUFFER_SIZE 64
+
+namespace MysqlApi {
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 服务端预处理语句
+*/
+    Statement::Statement(MYSQL *hSQL, const string &SQL)
+            : m_Data(hSQL), m_stmt(NULL), m_sql(SQL), m_errno(0), m_pSession(NULL), m_pResult(NULL), m_next_row(0) {
+    }
+
+    Statement::Statement(BackendSession *pSession, const string &SQL)
+            : m_Data(NULL), m_stmt(NULL), m_sql(SQL), m_errno(0), m_pSession(pSession), m_pResult(new BackendResult),
+              m_next_row(0) {
+    }
+
+    Statement::~Statement() {
+        Close();
+        delete m_pResult;
+    }
+
+    void Statement::Close() {
+        if (m_stmt != NULL)
+            mysql_stmt_close(m_stmt);
+        m_stmt = NULL;
+    }
+
+    int Statement::Prepare() {
+        if (m_pSession)
+            return PrepareBackend();
+        Close();
+        m_errno = 0;
+        if (!(m_stmt = mysql_stmt_init(m_Data))) {
+            cout << "mysql_stmt_init is failed!!sql:" << m_sql << endl;
+            return -1;
+        }
+        if (mysql_stmt_prepare(m_stmt, m_sql.c_str(), (unsigned long) m_sql.length())) {
+            m_errno = mysql_stmt_errno(m_stmt);
+            cout << "mysql_stmt_prepare is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+            Close();
+            return -1;
+        }
+        //重新预处理时保留已绑定的参数, 未绑定的参数为NULL
+        unsigned long old_count = m_params.size();
+        m_params.resize(mysql_stmt_param_count(m_stmt));
+        for (unsigned long i = old_count; i < m_params.size(); i++) {
+            m_params[i].type = MYSQL_TYPE_NULL;
+            m_params[i].int_value = 0;
+            m_params[i].double_value = 0;
+            m_params[i].length = 0;
+            m_params[i].is_null = 1;
+        }
+
+        m_results.clear();
+        MYSQL_RES *meta = mysql_stmt_result_metadata(m_stmt);
+        if (meta != NULL) {
+            unsigned int num = mysql_num_fields(meta);
+            MYSQL_FIELD *fields = mysql_fetch_fields(meta);
+            m_results.resize(num);
+            for (unsigned int i = 0; i < num; i++) {
+                Result &r = m_results[i];
+                switch (fields[i].type) {
+                    case MYSQL_TYPE_TINY:
+                    case MYSQL_TYPE_SHORT:
+                    case MYSQL_TYPE_LONG:
+                    case MYSQL_TYPE_INT24:
+                    case MYSQL_TYPE_LONGLONG:
+                    case MYSQL_TYPE_YEAR:
+                        r.type = MYSQL_TYPE_LONGLONG;
+                        break;
+                    case MYSQL_TYPE_FLOAT:
+                    case MYSQL_TYPE_DOUBLE:
+                        r.type = MYSQL_TYPE_DOUBLE;
+                        break;
+                    case MYSQL_TYPE_DATE:
+                    case MYSQL_TYPE_DATETIME:
+                    case MYSQL_TYPE_TIMESTAMP:
+                        r.type = MYSQL_TYPE_DATETIME;
+                        break;
+                    default:
+                        r.type = MYSQL_TYPE_STRING;
+                        r.buffer.resize(STMT_INIT_BUFFER_SIZE);
+                        break;
+                }
+                r.int_value = 0;
+                r.double_value = 0;
+                memset(&r.time_value, 0, sizeof(r.time_value));
+                r.length = 0;
+                r.is_null = 1;
+                r.error = 0;
+            }
+            mysql_free_result(meta);
+        }
+        if (!BindResults()) {
+            Close();
+            return -1;
+        }
+        return 0;
+    }
+
+    bool Statement::BindResults() {
+        m_result_binds.resize(m_results.size());
+        if (m_results.empty())
+            return true;
+        memset(&m_result_binds[0], 0, sizeof(MYSQL_BIND) * m_result_binds.size());
+        for (unsigned int i = 0; i < m_results.size(); i++) {
+            Result &r = m_results[i];
+            MYSQL_BIND &b = m_result_binds[i];
+            b.buffer_type = r.type;
+            b.length = &r.length;
+            b.is_null = &r.is_null;
+            b.error = &r.error;
+            switch (r.type) {
+                case MYSQL_TYPE_LONGLONG:
+                    b.buffer = &r.int_value;
+                    break;
+                case MYSQL_TYPE_DOUBLE:
+                    b.buffer = &r.double_value;
+                    break;
+                case MYSQL_TYPE_DATETIME:
+                    b.buffer = &r.time_value;
+                    break;
+                default:
+                    //留一个字节补'\0'
+                    b.buffer = &r.buffer[0];
+                    b.buffer_length = r.buffer.size() - 1;
+                    break;
+            }
+        }
+        if (mysql_stmt_bind_result(m_stmt, &m_result_binds[0])) {
+            m_errno = mysql_stmt_errno(m_stmt);
+            cout << "mysql_stmt_bind_result is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+            return false;
+        }
+        return true;
+    }
+
+/* 绑定参数 */
+    void Statement::BindParam(int index, const string &value) {
+        BindParam(index, value.data(), (unsigned long) value.length());
+    }
+
+    void Statement::BindParam(int index, const char *value, unsigned long length) {
+        if (index < 0 || index >= (int) m_params.size()) {
+            cout << "Statement::BindParam index out of range:" << index << ",sql:" << m_sql << endl;
+            return;
+        }
+        Param &p = m_params[index];
+        p.type = MYSQL_TYPE_STRING;
+        p.str_value.assign(value, length);
+        p.length = length;
+        p.is_null = 0;
+    }
+
+    void Statement::BindParam(int index, long long value) {
+        if (index < 0 || index >= (int) m_params.size()) {
+            cout << "Statement::BindParam index out of range:" << index << ",sql:" << m_sql << endl;
+            return;
+        }
+        Param &p = m_params[index];
+        p.type = MYSQL_TYPE_LONGLONG;
+        p.int_value = value;
+        p.is_null = 0;
+    }
+
+    void Statement::BindParam(int index, double value) {
+        if (index < 0 || index >= (int) m_params.size()) {
+            cout << "Statement::BindParam index out of range:" << index << ",sql:" << m_sql << endl;
+            return;
+        }
+        Param &p = m_params[index];
+        p.type = MYSQL_TYPE_DOUBLE;
+        p.double_value = value;
+        p.is_null = 0;
+    }
+
+    void Statement::BindNull(int index) {
+        if (index < 0 || index >= (int) m_params.size()) {
+            cout << "Statement::BindNull index out of range:" << index << ",sql:" << m_sql << endl;
+            return;
+        }
+        m_params[index].type = MYSQL_TYPE_NULL;
+        m_params[index].is_null = 1;
+    }
+
+    bool Statement::NeedReprepare(unsigned int err) {
+        return CR_SERVER_GONE_ERROR == err || CR_SERVER_LOST == err ||
+               ER_UNKNOWN_STMT_HANDLER == err || ER_NEED_REPREPARE == err;
+    }
+
+/*
+* 执行语句
+* 连接断开或语句句柄失效时重新预处理并重试一次, 连接本身的自动重连由 MYSQL_OPT_RECONNECT 完成
+*/
+    long Statement::Execute() {
+        unsigned long costtime;
+        unsigned long starttime = util::get_current_time_stamp();
+        long ret = ExecuteOnce();
+        if (ret < 0 && NeedReprepare(m_errno)) {
+            cout << "Statement::Execute reprepare, err:" << m_errno << ",sql:" << m_sql << endl;
+            if (0 == Prepare())
+                ret = ExecuteOnce();
+        }
+        unsigned long cost_us = util::get_current_time_stamp() - starttime;
+        //模板中已是?占位, 指纹即语句本身
+        QueryStats::Instance().Record(m_sql, cost_us, ret, 0, ret < 0);
+        costtime = cost_us / 1000;
+        if (costtime >= 1000)
+            cout << "Warn:Use " << costtime << "ms to do sql..." << m_sql << endl;
+        return ret;
+    }
+
+    long Statement::ExecuteOnce() {
+        if (m_pSession)
+            return ExecuteBackend();
+        if (NULL == m_stmt && Prepare() != 0)
+            return -1;
+        m_errno = 0;
+        mysql_stmt_free_result(m_stmt);
+
+        m_param_binds.resize(m_params.size());
+        if (!m_params.empty()) {
+            memset(&m_param_binds[0], 0, sizeof(MYSQL_BIND) * m_param_binds.size());
+            for (unsigned int i = 0; i < m_params.size(); i++) {
+                Param &p = m_params[i];
+                MYSQL_BIND &b = m_param_binds[i];
+                b.buffer_type = p.type;
+                b.is_null = &p.is_null;
+                switch (p.type) {
+                    case MYSQL_TYPE_LONGLONG:
+                        b.buffer = &p.int_value;
+                        break;
+                    case MYSQL_TYPE_DOUBLE:
+                        b.buffer = &p.double_value;
+                        break;
+                    case MYSQL_TYPE_STRING:
+                        b.buffer = (void *) p.str_value.data();
+                        b.buffer_length = p.length;
+                        b.length = &p.length;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (mysql_stmt_bind_param(m_stmt, &m_param_binds[0])) {
+                m_errno = mysql_stmt_errno(m_stmt);
+                cout << "mysql_stmt_bind_param is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+                return -1;
+            }
+        }
+
+        if (mysql_stmt_execute(m_stmt)) {
+            m_errno = mysql_stmt_errno(m_stmt);
+            cout << "mysql_stmt_execute is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+            return -1;
+        }
+        if (m_results.empty())
+            return (long) mysql_stmt_affected_rows(m_stmt);
+        //结果整体取到客户端, 连接可以立即执行其他语句
+        if (mysql_stmt_store_result(m_stmt)) {
+            m_errno = mysql_stmt_errno(m_stmt);
+            cout << "mysql_stmt_store_result is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+            return -1;
+        }
+        return (long) mysql_stmt_num_rows(m_stmt);
+    }
+
+    bool Statement::Fetch() {
+        if (m_pSession)
+            return FetchBackend();
+        if (NULL == m_stmt || m_results.empty())
+            return false;
+        int rt = mysql_stmt_fetch(m_stmt);
+        if (MYSQL_NO_DATA == rt)
+            return false;
+        if (1 == rt) {
+            m_errno = mysql_stmt_errno(m_stmt);
+            cout << "mysql_stmt_fetch is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+            return false;
+        }
+        bool rebind = false;
+        for (unsigned int i = 0; i < m_results.size(); i++) {
+            Result &r = m_results[i];
+            if (r.type != MYSQL_TYPE_STRING || r.is_null)
+                continue;
+            if (r.length >= r.buffer.size()) {
+                //被截断, 扩大缓冲后单独取回该列
+                r.buffer.resize(r.length + 1);
+                MYSQL_BIND b;
+                memset(&b, 0, sizeof(b));
+                b.buffer_type = MYSQL_TYPE_STRING;
+                b.buffer = &r.buffer[0];
+                b.buffer_length = r.buffer.size() - 1;
+                b.length = &r.length;
+                b.is_null = &r.is_null;
+                if (mysql_stmt_fetch_column(m_stmt, &b, i, 0)) {
+                    m_errno = mysql_stmt_errno(m_stmt);
+                    cout << "mysql_stmt_fetch_column is failed!!sql:" << m_sql << ",err:" << mysql_stmt_error(m_stmt) << endl;
+                    return false;
+                }
+                rebind = true;
+            }
+            r.buffer[r.length] = '\0';
+        }
+        if (rebind && !BindResults())
+            return false;
+        return true;
+    }
+
+/*
+* 存储后端上的语句
+* 1 预处理只数出 ? 的个数, 字段在执行后才知道
+* 2 执行时把参数格式化为文本, 由后端替换 ?
+*/
+    int Statement::PrepareBackend() {
+        m_errno = 0;
+        unsigned long count = 0;
+        char quote = 0;
+        for (unsigned long i = 0; i < m_sql.length(); i++) {
+            char c = m_sql[i];
+            if (quote) {
+                if ('\\' == c)
+                    ++i;
+                else if (quote == c)
+                    quote = 0;
+            } else if ('\'' == c || '"' == c || '`' == c)
+                quote = c;
+            else if ('?' == c)
+                ++count;
+        }
+        unsigned long old_count = m_params.size();
+        m_params.resize(count);
+        for (unsigned long i = old_count; i < m_params.size(); i++) {
+            m_params[i].type = MYSQL_TYPE_NULL;
+            m_params[i].int_value = 0;
+            m_params[i].double_value = 0;
+            m_params[i].length = 0;
+            m_params[i].is_null = 1;
+        }
+        m_results.clear();
+        return 0;
+    }
+
+    long Statement::ExecuteBackend() {
+        m_errno = 0;
+        m_next_row = 0;
+        //数字参数格式化后的文本, 在执行期间有效
+        vector<string> texts(m_params.size());
+        vector<CellView> params(m_params.size());
+        char temp[32];
+        for (unsigned int i = 0; i < m_params.size(); i++) {
+            const Param &p = m_params[i];
+            if (p.is_null)
+                continue;
+            switch (p.type) {
+                case MYSQL_TYPE_LONGLONG:
+                    snprintf(temp, sizeof(temp), "%lld", p.int_value);
+                    texts[i] = temp;
+                    params[i] = CellView(texts[i].data(), texts[i].length());
+                    break;
+                case MYSQL_TYPE_DOUBLE:
+                    snprintf(temp, sizeof(temp), "%.17g", p.double_value);
+                    texts[i] = temp;
+                    params[i] = CellView(texts[i].data(), texts[i].length());
+                    break;
+                default:
+                    params[i] = CellView(p.str_value.data(), p.length);
+                    break;
+            }
+        }
+        m_errno = m_pSession->Query(m_sql, params, *m_pResult);
+        if (m_errno) {
+            cout << "BackendSession::Query is failed!!sql:" << m_sql << ",err:" << m_pSession->GetError() << endl;
+            m_pResult->Clear();
+            m_results.clear();
+            return -1;
+        }
+        if (m_pResult->fields.empty()) {
+            m_results.clear();
+            return (long) m_pResult->affected_rows;
+        }
+        m_results.resize(m_pResult->fields.size());
+        for (unsigned int i = 0; i < m_results.size(); i++) {
+            m_results[i].type = MYSQL_TYPE_STRING;
+            m_results[i].length = 0;
+            m_results[i].is_null = 1;
+        }
+        return (long) m_pResult->rows;
+    }
+
+    bool Statement::FetchBackend() {
+        if (m_results.empty() || m_next_row >= m_pResult->rows)
+            return false;
+        const CellView *cells = &m_pResult->cells[m_next_row * m_results.size()];
+        for (unsigned int i = 0; i < m_results.size(); i++) {
+            Result &r = m_results[i];
+            r.is_null = cells[i].IsNull() ? 1 : 0;
+            r.length = cells[i].Size();
+            r.buffer.resize(r.length + 1);
+            memcpy(&r.buffer[0], cells[i].Data(), r.length);
+            r.buffer[r.length] = '\0';
+        }
+        ++m_next_row;
+        return true;
+    }
+
+/* 当前行的数据 */
+    bool Statement::GetString(int col, string &value) const {
+        const Result &r = m_results[col];
+        if (r.is_null) {
+            value.clear();
+            return false;
+        }
+        char temp[64];
+        switch (r.type) {
+            case MYSQL_TYPE_LONGLONG:
+                snprintf(temp, sizeof(temp), "%lld", r.int_value);
+                value = temp;
+                break;
+            case MYSQL_TYPE_DOUBLE:
+                snprintf(temp, sizeof(temp), "%.17g", r.double_value);
+                value = temp;
+                break;
+            case MYSQL_TYPE_DATETIME:
+                snprintf(temp, sizeof(temp), "%04u-%02u-%02u %02u:%02u:%02u",
+                         r.time_value.year, r.time_value.month, r.time_value.day,
+                         r.time_value.hour, r.time_value.minute, r.time_value.second);
+                value = temp;
+                break;
+            default:
+                value.assign(&r.buffer[0], r.length);
+                break;
+        }
+        return true;
+    }
+
+    CellView Statement::GetCell(int col) const {
+        const Result &r = m_results[col];
+        if (r.is_null || r.type != MYSQL_TYPE_STRING)
+            return CellView();
+        return CellView(&r.buffer[0], r.length);
+    }
+
+    long long Statement::GetInt64(int col, long long def) const {
+        const Result &r = m_results[col];
+        if (r.is_null)
+            return def;
+        switch (r.type) {
+            case MYSQL_TYPE_LONGLONG:
+                return r.int_value;
+            case MYSQL_TYPE_DOUBLE:
+                return (long long) r.double_value;
+            case MYSQL_TYPE_STRING:
+                return CellView(&r.buffer[0], r.length).ToLong(def);
+            default:
+                return def;
+        }
+    }
+
+    double Statement::GetDouble(int col, double def) const {
+        const Result &r = m_results[col];
+        if (r.is_null)
+            return def;
+        switch (r.type) {
+            case MYSQL_TYPE_LONGLONG:
+                return (double) r.int_value;
+            case MYSQL_TYPE_DOUBLE:
+                return r.double_value;
+            case MYSQL_TYPE_STRING:
+                return CellView(&r.buffer[0], r.length).ToDouble(def);
+            default:
+                return def;
+        }
+    }
+
+    time_t Statement::GetTime(int col, time_t def) const {
+        const Result &r = m_results[col];
+        if (r.is_null || r.type != MYSQL_TYPE_DATETIME)
+            return def;
+        const MYSQL_TIME &t = r.time_value;
+        if (0 == t.year && 0 == t.month && 0 == t.day)
+            return 0;
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year = t.year - 1900;
+        tm.tm_mon = t.month - 1;
+        tm.tm_mday = t.day;
+        tm.tm_hour = t.hour;
+        tm.tm_min = t.minute;
+        tm.tm_sec = t.second;
+        tm.tm_isdst = -1;
+        return mktime(&tm);
+    }
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 预处理语句缓存
+*/
+    StmtCache::StmtCache() : m_Data(NULL), m_pSession(NULL) {}
+
+    StmtCache::~StmtCache() {
+        Clear();
+    }
+
+    void StmtCache::Clear() {
+        for (map<string, Statement *>::iterator it = m_stmts.begin(); it != m_stmts.end(); ++it)
+            delete it->second;
+        m_stmts.clear();
+    }
+
+    Statement *StmtCache::Get(MYSQL *hSQL, const string &SQL) {
+        if (NULL == hSQL)
+            return NULL;
+        if (hSQL != m_Data) {
+            //连接已重建, 旧句柄上的语句全部作废
+            Clear();
+            m_Data = hSQL;
+            m_pSession = NULL;
+        }
+        map<string, Statement *>::iterator it = m_stmts.find(SQL);
+        if (it != m_stmts.end())
+            return it->second;
+        Statement *stmt = new Statement(hSQL, SQL);
+        if (stmt->Prepare() != 0) {
+            delete stmt;
+            return NULL;
+        }
+        m_stmts[SQL] = stmt;
+        return stmt;
+    }
+
+    Statement *StmtCache::Get(DataBase &db, const string &SQL) {
+        BackendSession *session = db.GetSession();
+        if (NULL == session)
+            return Get(db.GetMysql(), SQL);
+        if (session != m_pSession) {
+            Clear();
+            m_Data = NULL;
+            m_pSession = session;
+        }
+        map<string, Statement *>::iterator it = m_stmts.find(SQL);
+        if (it != m_stmts.end())
+            return it->second;
+        Statement *stmt = new Statement(session, SQL);
+        if (stmt->Prepare() != 0) {
+            delete stmt;
+            return NULL;
+        }
+        m_stmts[SQL] = stmt;
+        return stmt;
+    }
+/* -------------------------------------------------- */
+}
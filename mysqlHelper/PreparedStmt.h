@@ -0,0 +1,147 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _PREPARED_STMT_H_
+#define _PREPARED_STMT_H_
+
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MysqlApi.h"
+
+namespace MysqlApi
+{
+/*
+* 服务端预处理语句(二进制协议)
+* 1 sql 中用 ? 作为参数占位, 参数按类型绑定, 不需要拼接和转义字符串
+* 2 结果按列的原生类型取回: 整数为 long long, 浮点为 double, 日期为 MYSQL_TIME, 其余为字节
+* 3 连接被自动重连后语句句柄失效, Execute 会重新预处理并重试一次
+* 4 不是线程安全的, 与所属连接一起使用
+* 5 在存储后端的会话上时, 参数按文本传给后端, 结果都按字符串取回
+*/
+class Statement
+{
+public:
+    Statement(MYSQL *hSQL, const string &SQL);
+    Statement(BackendSession *pSession, const string &SQL);
+    ~Statement();
+
+    /* 预处理, 成功返回0 */
+    int Prepare();
+    /* 参数个数 */
+    int GetParamCount() const { return (int) m_params.size(); }
+
+    /* 绑定参数, 序号从0开始, 值被拷贝 */
+    void BindParam(int index, const string &value);
+    void BindParam(int index, const char *value, unsigned long length);
+    void BindParam(int index, long long value);
+    void BindParam(int index, double value);
+    void BindNull(int index);
+
+    /* 执行, 查询语句返回记录数, 其余语句返回影响的行数, 失败返回-1 */
+    long Execute();
+    /* 取下一行, 没有更多行返回false */
+    bool Fetch();
+
+    /* 当前行的数据, 序号从0开始 */
+    int GetFieldNum() const { return (int) m_results.size(); }
+    bool IsNull(int col) const { return m_results[col].is_null != 0; }
+    /* 数字和日期列会被格式化 */
+    bool GetString(int col, string &value) const;
+    /* 字符串列为不拷贝的视图, 其他列返回NULL视图 */
+    CellView GetCell(int col) const;
+    long long GetInt64(int col, long long def = 0) const;
+    double GetDouble(int col, double def = 0) const;
+    /* 日期列按本地时区转为 time_t */
+    time_t GetTime(int col, time_t def = 0) const;
+
+    const string &GetSQL() const { return m_sql; }
+    unsigned int GetErrno() const { return m_errno; }
+
+private:
+    /* Don't need copy or assignment */
+    Statement(const Statement &);
+    Statement &operator=(const Statement &);
+
+    void Close();
+    bool BindResults();
+    long ExecuteOnce();
+    int PrepareBackend();
+    long ExecuteBackend();
+    bool FetchBackend();
+    /* 连接断开或句柄失效, 需要重新预处理 */
+    static bool NeedReprepare(unsigned int err);
+
+private:
+    struct Param
+    {
+        enum_field_types type;
+        long long int_value;
+        double double_value;
+        string str_value;
+        unsigned long length;
+        my_bool is_null;
+    };
+    struct Result
+    {
+        enum_field_types type;
+        long long int_value;
+        double double_value;
+        MYSQL_TIME time_value;
+        vector<char> buffer;
+        unsigned long length;
+        my_bool is_null;
+        my_bool error;
+    };
+
+    MYSQL *m_Data;
+    MYSQL_STMT *m_stmt;
+    string m_sql;
+    unsigned int m_errno;
+
+    vector<Param> m_params;
+    vector<MYSQL_BIND> m_param_binds;
+    vector<Result> m_results;
+    vector<MYSQL_BIND> m_result_binds;
+
+    /* 存储后端的会话, 结果和下一行的序号 */
+    BackendSession *m_pSession;
+    BackendResult *m_pResult;
+    unsigned long m_next_row;
+};
+
+/*
+* 按 sql 模板缓存预处理语句, 每个连接一份
+* 1 同一 sql 只在服务端预处理一次
+* 2 连接句柄变化(重建连接)后自动清空, 语句会在新连接上重新预处理
+*/
+class StmtCache
+{
+public:
+    StmtCache();
+    ~StmtCache();
+
+    /* 返回已预处理的语句, 预处理失败返回NULL */
+    Statement *Get(MYSQL *hSQL, const string &SQL);
+    /* 按连接使用句柄或存储后端会话 */
+    Statement *Get(DataBase &db, const string &SQL);
+    /* 关闭所有语句 */
+    void Clear();
+    int Size() const { return (int) m_stmts.size(); }
+
+private:
+    /* Don't need copy or assignment */
+    StmtCache(const StmtCache &);
+    StmtCache &operator=(const StmtCache &);
+
+private:
+    MYSQL *m_Data;
+    BackendSession *m_pSession;
+    map<string, Statement *> m_stmts;
+};
+} // namespace MysqlApi
+
+#endif
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "QueryCache.h"
+
+/* 每个条目除数据外的估算开销 */
+#define QUERY_CACHE_ENTRY_OVERHEAD 128
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 缓存的查询结果
+*/
+void QueryResult::Clear() {
+    m_cells.clear();
+    m_nulls.clear();
+    m_rows = 0;
+}
+
+void QueryResult::Reset(int field_num) {
+    Clear();
+    m_field_num = field_num;
+}
+
+void QueryResult::Append(const string &value, bool is_null) {
+    m_cells.push_back(value);
+    m_nulls.push_back(is_null ? 1 : 0);
+    if (m_field_num > 0 && 0 == m_cells.size() % m_field_num)
+        ++m_rows;
+}
+
+unsigned long QueryResult::GetBytes() const {
+    unsigned long bytes = sizeof(QueryResult) + m_nulls.size();
+    for (unsigned int i = 0; i < m_cells.size(); i++)
+        bytes += sizeof(string) + m_cells[i].capacity();
+    return bytes;
+}
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 读穿透的查询缓存
+*/
+QueryCache::QueryCache(const Config &config)
+        : m_config(config), m_hits(0), m_negative_hits(0), m_misses(0), m_coalesced(0),
+          m_evictions(0), m_expirations(0), m_load_errors(0) {
+    if (m_config.shard_num <= 0)
+        m_config.shard_num = 1;
+    m_shards.resize(m_config.shard_num);
+    for (unsigned int i = 0; i < m_shards.size(); i++) {
+        pthread_mutex_init(&m_shards[i].lock, NULL);
+        m_shards[i].head = NULL;
+        m_shards[i].tail = NULL;
+        m_shards[i].bytes = 0;
+    }
+    m_shard_max_bytes = m_config.max_bytes / m_shards.size();
+}
+
+QueryCache::~QueryCache() {
+    Clear();
+    for (unsigned int i = 0; i < m_shards.size(); i++)
+        pthread_mutex_destroy(&m_shards[i].lock);
+}
+
+unsigned long QueryCache::NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+/* 参数带长度前缀, 避免不同的参数拼出相同的键 */
+string QueryCache::MakeKey(const string &sql, const vector<string> &params) {
+    string key = sql;
+    char temp[16];
+    for (unsigned int i = 0; i < params.size(); i++) {
+        snprintf(temp, sizeof(temp), "\n%u:", (unsigned int) params[i].length());
+        key += temp;
+        key += params[i];
+    }
+    return key;
+}
+
+/* FNV-1a */
+unsigned long QueryCache::Hash(const string &key) {
+    unsigned long hash = 14695981039346656037UL;
+    for (unsigned int i = 0; i < key.length(); i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+QueryCache::Shard &QueryCache::GetShard(const string &key) {
+    return m_shards[Hash(key) % m_shards.size()];
+}
+
+void QueryCache::Unlink(Shard &shard, Entry *entry) {
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        shard.head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        shard.tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+void QueryCache::PushFront(Shard &shard, Entry *entry) {
+    entry->prev = NULL;
+    entry->next = shard.head;
+    if (shard.head)
+        shard.head->prev = entry;
+    shard.head = entry;
+    if (NULL == shard.tail)
+        shard.tail = entry;
+}
+
+void QueryCache::Remove(Shard &shard, Entry *entry) {
+    Unlink(shard, entry);
+    shard.entries.erase(entry->key);
+    shard.bytes -= entry->bytes;
+    delete entry;
+}
+
+void QueryCache::Insert(Shard &shard, const string &key, DB_OPERATOR_RESULT status, const QueryResult &result) {
+    map<string, Entry *>::iterator it = shard.entries.find(key);
+    if (it != shard.entries.end())
+        Remove(shard, it->second);
+
+    Entry *entry = new Entry;
+    entry->key = key;
+    entry->result = result;
+    entry->status = status;
+    entry->expire_ms = NowMs() + (DB_OPERATOR_RESULT_OK == status ? m_config.ttl_ms : m_config.negative_ttl_ms);
+    entry->bytes = key.capacity() + entry->result.GetBytes() + QUERY_CACHE_ENTRY_OVERHEAD;
+    entry->prev = entry->next = NULL;
+    shard.entries[key] = entry;
+    PushFront(shard, entry);
+    shard.bytes += entry->bytes;
+
+    //超出内存上限, 从最久未用的开始淘汰(至少保留刚插入的)
+    while (shard.bytes > m_shard_max_bytes && shard.tail != entry) {
+        Remove(shard, shard.tail);
+        m_evictions.fetchAdd(1);
+    }
+}
+
+DB_OPERATOR_RESULT QueryCache::Query(const string &sql, const vector<string> &params, QueryResult &result) {
+    string key = MakeKey(sql, params);
+    Shard &shard = GetShard(key);
+
+    pthread_mutex_lock(&shard.lock);
+    map<string, Entry *>::iterator it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        Entry *entry = it->second;
+        if (NowMs() < entry->expire_ms) {
+            Unlink(shard, entry);
+            PushFront(shard, entry);
+            DB_OPERATOR_RESULT status = entry->status;
+            if (DB_OPERATOR_RESULT_OK == status) {
+                result = entry->result;
+                m_hits.fetchAdd(1);
+            } else {
+                result.Clear();
+                m_negative_hits.fetchAdd(1);
+            }
+            pthread_mutex_unlock(&shard.lock);
+            return status;
+        }
+        Remove(shard, entry);
+        m_expirations.fetchAdd(1);
+    }
+
+    //已有线程在查询同一个键, 等待其结果
+    map<string, Pending *>::iterator pit = shard.pending.find(key);
+    if (pit != shard.pending.end()) {
+        Pending *pending = pit->second;
+        ++pending->waiters;
+        m_coalesced.fetchAdd(1);
+        while (!pending->done)
+            pthread_cond_wait(&pending->cond, &shard.lock);
+        DB_OPERATOR_RESULT status = pending->status;
+        result = pending->result;
+        if (0 == --pending->waiters) {
+            pthread_cond_destroy(&pending->cond);
+            delete pending;
+        }
+        pthread_mutex_unlock(&shard.lock);
+        return status;
+    }
+
+    Pending *pending = new Pending;
+    pthread_cond_init(&pending->cond, NULL);
+    pending->done = false;
+    pending->invalidated = false;
+    //查询者自己也算一个
+    pending->waiters = 1;
+    pending->status = DB_OPERATOR_RESULT_FATAL_ERROR;
+    shard.pending[key] = pending;
+    m_misses.fetchAdd(1);
+    pthread_mutex_unlock(&shard.lock);
+
+    DB_OPERATOR_RESULT status = Load(sql, params, result);
+    if (status != DB_OPERATOR_RESULT_OK)
+        result.Clear();
+
+    pthread_mutex_lock(&shard.lock);
+    //被失效的查询已不在 pending 中, 同一个键可能已有新的查询
+    if (!pending->invalidated)
+        shard.pending.erase(key);
+    if (DB_OPERATOR_RESULT_OK == status ||
+        (DB_OPERATOR_RESULT_NO_RESULT == status && m_config.negative_ttl_ms > 0)) {
+        if (!pending->invalidated)
+            Insert(shard, key, status, result);
+    } else if (status != DB_OPERATOR_RESULT_NO_RESULT)
+        m_load_errors.fetchAdd(1);
+    pending->status = status;
+    if (pending->waiters > 1)
+        pending->result = result;
+    pending->done = true;
+    pthread_cond_broadcast(&pending->cond);
+    if (0 == --pending->waiters) {
+        pthread_cond_destroy(&pending->cond);
+        delete pending;
+    }
+    pthread_mutex_unlock(&shard.lock);
+    return status;
+}
+
+DB_OPERATOR_RESULT QueryCache::Load(const string &sql, const vector<string> &params, QueryResult &result) {
+    PLMySql mysql_db(DB_ROUTE_READ);
+    MysqlApi::Statement *stmt = mysql_db.get_statement(sql);
+    if (NULL == stmt)
+        return DB_OPERATOR_RESULT_FATAL_ERROR;
+    if (stmt->GetParamCount() != (int) params.size()) {
+        cout << "QueryCache::Load param count mismatch, sql:" << sql << endl;
+        return DB_OPERATOR_RESULT_PARAM_ERROR;
+    }
+    for (unsigned int i = 0; i < params.size(); i++)
+        stmt->BindParam(i, params[i]);
+    if (stmt->Execute() < 0)
+        return DB_OPERATOR_RESULT_FATAL_ERROR;
+
+    int field_num = stmt->GetFieldNum();
+    result.Reset(field_num);
+    string value;
+    while (stmt->Fetch()) {
+        for (int i = 0; i < field_num; i++) {
+            stmt->GetString(i, value);
+            result.Append(value, stmt->IsNull(i));
+        }
+    }
+    return result.GetRowCount() > 0 ? DB_OPERATOR_RESULT_OK : DB_OPERATOR_RESULT_NO_RESULT;
+}
+
+void QueryCache::Invalidate(const string &sql, const vector<string> &params) {
+    string key = MakeKey(sql, params);
+    Shard &shard = GetShard(key);
+    autoLock al(shard.lock);
+    map<string, Entry *>::iterator it = shard.entries.find(key);
+    if (it != shard.entries.end())
+        Remove(shard, it->second);
+    //进行中的查询可能读到失效前的数据, 不缓存它的结果, 之后的 Get 重新查询
+    map<string, Pending *>::iterator pit = shard.pending.find(key);
+    if (pit != shard.pending.end()) {
+        pit->second->invalidated = true;
+        shard.pending.erase(pit);
+    }
+}
+
+void QueryCache::Clear() {
+    for (unsigned int i = 0; i < m_shards.size(); i++) {
+        Shard &shard = m_shards[i];
+        autoLock al(shard.lock);
+        while (shard.head)
+            Remove(shard, shard.head);
+        for (map<string, Pending *>::iterator it = shard.pending.begin(); it != shard.pending.end(); ++it)
+            it->second->invalidated = true;
+        shard.pending.clear();
+    }
+}
+
+void QueryCache::GetStats(Stats &stats) {
+    stats.hits = m_hits.load();
+    stats.negative_hits = m_negative_hits.load();
+    stats.misses = m_misses.load();
+    stats.coalesced = m_coalesced.load();
+    stats.evictions = m_evictions.load();
+    stats.expirations = m_expirations.load();
+    stats.load_errors = m_load_errors.load();
+    stats.entries = 0;
+    stats.bytes = 0;
+    for (unsigned int i = 0; i < m_shards.size(); i++) {
+        autoLock al(m_shards[i].lock);
+        stats.entries += m_shards[i].entries.size();
+        stats.bytes += m_shards[i].bytes;
+    }
+}
+/* -------------------------------------------------- */
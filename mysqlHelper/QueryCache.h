@@ -0,0 +1,171 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _QUERY_CACHE_H_
+#define _QUERY_CACHE_H_
+
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "dbFactory.h"
+
+/*
+* 缓存的查询结果(按行存放的字符串)
+*/
+class QueryResult
+{
+public:
+    QueryResult() : m_field_num(0), m_rows(0) {}
+
+    int GetRowCount() const { return m_rows; }
+    int GetFieldNum() const { return m_field_num; }
+    const string &Get(int row, int col) const { return m_cells[row * m_field_num + col]; }
+    bool IsNull(int row, int col) const { return m_nulls[row * m_field_num + col] != 0; }
+
+    void Clear();
+    /* 设置字段数, 清空数据 */
+    void Reset(int field_num);
+    /* 追加一个单元格, 按行依次追加 */
+    void Append(const string &value, bool is_null);
+    /* 估算占用的内存 */
+    unsigned long GetBytes() const;
+
+private:
+    vector<string> m_cells;
+    vector<char> m_nulls;
+    int m_field_num;
+    int m_rows;
+};
+
+/*
+* 读穿透的查询缓存(LRU + TTL)
+* 1 以 sql 模板 + 参数为键, 未命中时用预处理语句查询(sql 中用 ? 占位, 参数按字符串绑定)
+* 2 没有结果(DB_OPERATOR_RESULT_NO_RESULT)也缓存, 有效期为 negative_ttl_ms; 出错不缓存
+* 3 按键的哈希分片, 每片一把锁和一条 LRU 链; 总内存超过 max_bytes 时从最久未用的开始淘汰
+* 4 多个线程同时未命中同一个键时只有一个去查询, 其余等待其结果
+*
+* 用法:
+*     QueryCache cache;
+*     vector<string> params(1, phone);
+*     QueryResult result;
+*     if (DB_OPERATOR_RESULT_OK == cache.Query("select isp from phone_number_region where phone=?", params, result))
+*         provider = result.Get(0, 0);
+*/
+class QueryCache
+{
+public:
+    struct Config
+    {
+        /* 分片数 */
+        int shard_num;
+        /* 结果的有效期 */
+        unsigned long ttl_ms;
+        /* 没有结果的有效期, 0则不缓存 */
+        unsigned long negative_ttl_ms;
+        /* 内存上限(估算) */
+        unsigned long max_bytes;
+
+        Config() : shard_num(16), ttl_ms(60 * 1000), negative_ttl_ms(10 * 1000), max_bytes(64 * 1024 * 1024) {}
+    };
+
+    struct Stats
+    {
+        unsigned long hits;
+        unsigned long negative_hits;
+        unsigned long misses;
+        /* 等待其他线程查询结果的次数 */
+        unsigned long coalesced;
+        unsigned long evictions;
+        unsigned long expirations;
+        unsigned long load_errors;
+        unsigned long entries;
+        unsigned long bytes;
+    };
+
+    QueryCache(const Config &config = Config());
+    virtual ~QueryCache();
+
+    /*
+    * 查询, 返回 DB_OPERATOR_RESULT_OK / NO_RESULT / FATAL_ERROR
+    * 成功时结果拷贝到 result
+    */
+    DB_OPERATOR_RESULT Query(const string &sql, const vector<string> &params, QueryResult &result);
+
+    /* 使某个键失效 */
+    void Invalidate(const string &sql, const vector<string> &params);
+    void Clear();
+
+    void GetStats(Stats &stats);
+
+protected:
+    /* 实际的查询, 默认用连接池中连接的预处理语句 */
+    virtual DB_OPERATOR_RESULT Load(const string &sql, const vector<string> &params, QueryResult &result);
+
+private:
+    struct Entry
+    {
+        string key;
+        QueryResult result;
+        DB_OPERATOR_RESULT status;
+        unsigned long expire_ms;
+        unsigned long bytes;
+        Entry *prev;
+        Entry *next;
+    };
+
+    /* 正在查询的键 */
+    struct Pending
+    {
+        pthread_cond_t cond;
+        bool done;
+        /* 查询期间被 Invalidate 或 Clear, 结果不再缓存, 已从 pending 中移除 */
+        bool invalidated;
+        int waiters;
+        DB_OPERATOR_RESULT status;
+        QueryResult result;
+    };
+
+    struct Shard
+    {
+        pthread_mutex_t lock;
+        map<string, Entry *> entries;
+        map<string, Pending *> pending;
+        /* LRU 链, head 为最近使用 */
+        Entry *head;
+        Entry *tail;
+        unsigned long bytes;
+    };
+
+    /* Don't need copy or assignment */
+    QueryCache(const QueryCache &);
+    QueryCache &operator=(const QueryCache &);
+
+    static string MakeKey(const string &sql, const vector<string> &params);
+    static unsigned long Hash(const string &key);
+    static unsigned long NowMs();
+    Shard &GetShard(const string &key);
+    /* 以下需持有分片锁 */
+    void Unlink(Shard &shard, Entry *entry);
+    void PushFront(Shard &shard, Entry *entry);
+    void Remove(Shard &shard, Entry *entry);
+    void Insert(Shard &shard, const string &key, DB_OPERATOR_RESULT status, const QueryResult &result);
+
+private:
+    Config m_config;
+    vector<Shard> m_shards;
+    unsigned long m_shard_max_bytes;
+
+    zcUtils::Atomic<unsigned long> m_hits;
+    zcUtils::Atomic<unsigned long> m_negative_hits;
+    zcUtils::Atomic<unsigned long> m_misses;
+    zcUtils::Atomic<unsigned long> m_coalesced;
+    zcUtils::Atomic<unsigned long> m_evictions;
+    zcUtils::Atomic<unsigned long> m_expirations;
+    zcUtils::Atomic<unsigned long> m_load_errors;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "QueryStats.h"
+#include "threadUtil.h"
+
+namespace MysqlApi {
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 语句指纹
+*/
+static bool IsWordChar(char c) {
+    return isalnum((unsigned char) c) || '_' == c || '$' == c;
+}
+
+/* 两侧的空白是否需要保留, before 表示前一个字符 */
+static bool IsSpaced(char c, bool before) {
+    if (IsWordChar(c) || '`' == c || '*' == c)
+        return true;
+    return before ? ('?' == c || ')' == c) : ('\'' == c || '"' == c || '.' == c);
+}
+
+/* 跳过引号内的常量, 返回结束引号之后的位置 */
+static unsigned long SkipQuoted(const char *sql, unsigned long length, unsigned long i) {
+    char quote = sql[i++];
+    while (i < length) {
+        if ('\\' == sql[i])
+            i += 2;
+        else if (quote == sql[i]) {
+            //两个引号是转义
+            if (i + 1 < length && quote == sql[i + 1])
+                i += 2;
+            else
+                return i + 1;
+        } else
+            ++i;
+    }
+    return length;
+}
+
+/* 跳过数字常量(含小数、指数和十六进制) */
+static unsigned long SkipNumber(const char *sql, unsigned long length, unsigned long i) {
+    if ('0' == sql[i] && i + 1 < length && ('x' == sql[i + 1] || 'X' == sql[i + 1])) {
+        i += 2;
+        while (i < length && isxdigit((unsigned char) sql[i]))
+            ++i;
+        return i;
+    }
+    while (i < length && (isdigit((unsigned char) sql[i]) || '.' == sql[i]))
+        ++i;
+    if (i < length && ('e' == sql[i] || 'E' == sql[i])) {
+        unsigned long j = i + 1;
+        if (j < length && ('+' == sql[j] || '-' == sql[j]))
+            ++j;
+        if (j < length && isdigit((unsigned char) sql[j])) {
+            while (j < length && isdigit((unsigned char) sql[j]))
+                ++j;
+            i = j;
+        }
+    }
+    return i;
+}
+
+void QueryStats::Fingerprint(const char *sql, unsigned long length, string &fingerprint) {
+    fingerprint.clear();
+    fingerprint.reserve(length < 1024 ? length : 1024);
+    bool space = false;
+    unsigned long i = 0;
+    while (i < length) {
+        char c = sql[i];
+        //空白和注释都合并为一个空格, 在输出下一个字符时再决定是否保留
+        if (isspace((unsigned char) c)) {
+            space = true;
+            ++i;
+            continue;
+        }
+        if ('/' == c && i + 1 < length && '*' == sql[i + 1]) {
+            const char *end = NULL;
+            if (i + 2 < length)
+                end = (const char *) memmem(sql + i + 2, length - i - 2, "*/", 2);
+            i = end ? (unsigned long) (end - sql) + 2 : length;
+            space = true;
+            continue;
+        }
+        if ('#' == c || ('-' == c && i + 2 < length && '-' == sql[i + 1] && isspace((unsigned char) sql[i + 2]))) {
+            while (i < length && sql[i] != '\n')
+                ++i;
+            space = true;
+            continue;
+        }
+
+        char last = fingerprint.empty() ? '\0' : fingerprint[fingerprint.length() - 1];
+        //紧跟在标识符后的数字属于标识符
+        bool after_word = IsWordChar(last) && !space;
+        //只在两个词之间保留空格, 运算符和括号两侧的空格去掉
+        if (space && IsSpaced(last, true) && IsSpaced(c, false))
+            fingerprint += ' ';
+        space = false;
+
+        if ('\'' == c || '"' == c) {
+            i = SkipQuoted(sql, length, i);
+            fingerprint += '?';
+        } else if ('`' == c) {
+            //带引号的标识符原样保留
+            const char *end = (const char *) memchr(sql + i + 1, '`', length - i - 1);
+            unsigned long next = end ? (unsigned long) (end - sql) + 1 : length;
+            fingerprint.append(sql + i, next - i);
+            i = next;
+        } else if ((isdigit((unsigned char) c) || ('.' == c && i + 1 < length && isdigit((unsigned char) sql[i + 1])))
+                   && !after_word) {
+            i = SkipNumber(sql, length, i);
+            fingerprint += '?';
+        } else if (IsWordChar(c)) {
+            while (i < length && IsWordChar(sql[i]))
+                fingerprint += (char) tolower((unsigned char) sql[i++]);
+        } else {
+            fingerprint += c;
+            ++i;
+        }
+
+        //(?,?,...) 合并为 (?+), 多行的 (?+),(?+),... 合并为一个
+        if (')' == c) {
+            string::size_type open = fingerprint.rfind('(');
+            if (open != string::npos && open + 2 < fingerprint.length() && '?' == fingerprint[open + 1]) {
+                string::size_type k = open + 2;
+                while (k + 1 < fingerprint.length() && ',' == fingerprint[k] && '?' == fingerprint[k + 1])
+                    k += 2;
+                if (k + 1 == fingerprint.length()) {
+                    fingerprint.replace(open, string::npos, "(?+)");
+                    string::size_type n = fingerprint.length();
+                    if (n >= 9 && 0 == fingerprint.compare(n - 9, 9, "(?+),(?+)"))
+                        fingerprint.erase(n - 5);
+                }
+            }
+        }
+    }
+    //去掉结尾的分号
+    while (!fingerprint.empty() && ';' == fingerprint[fingerprint.length() - 1])
+        fingerprint.erase(fingerprint.length() - 1);
+}
+/*-----------------------------------------------------*/
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 统计
+*/
+QueryStats &QueryStats::Instance() {
+    //不析构, 退出时其他线程可能仍在记录
+    static QueryStats *s_stats = new QueryStats;
+    return *s_stats;
+}
+
+QueryStats::QueryStats()
+        : m_enabled(1), m_slow_us(1000 * 1000), m_slow_sample_ms(10 * 1000), m_max_fingerprints(2000),
+          m_fingerprints(0), m_untracked(0), m_slow_logged(0), m_slow_log_size(100), m_slow_next(0),
+          m_max_sql_len(8192) {
+    for (int i = 0; i < SHARD_NUM; i++)
+        pthread_mutex_init(&m_shards[i].lock, NULL);
+    pthread_mutex_init(&m_slow_lock, NULL);
+}
+
+QueryStats::~QueryStats() {
+    Reset();
+    pthread_mutex_destroy(&m_slow_lock);
+    for (int i = 0; i < SHARD_NUM; i++)
+        pthread_mutex_destroy(&m_shards[i].lock);
+}
+
+unsigned long QueryStats::NowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+/* FNV-1a */
+unsigned long QueryStats::Hash(const string &key) {
+    unsigned long hash = 14695981039346656037UL;
+    for (unsigned int i = 0; i < key.length(); i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+int QueryStats::BucketIndex(unsigned long us) {
+    if (us < (unsigned long) HIST_LINEAR)
+        return (int) us;
+    int bits = 63 - __builtin_clzl(us);
+    if (bits >= HIST_MAX_BITS)
+        return HIST_BUCKETS - 1;
+    int sub = (int) (us >> (bits - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1);
+    return HIST_LINEAR + (bits - 4) * (1 << HIST_SUB_BITS) + sub;
+}
+
+unsigned long QueryStats::BucketValue(int index) {
+    if (index < HIST_LINEAR)
+        return (unsigned long) index;
+    int k = index - HIST_LINEAR;
+    int bits = k / (1 << HIST_SUB_BITS) + 4;
+    int sub = k % (1 << HIST_SUB_BITS);
+    unsigned long width = 1UL << (bits - HIST_SUB_BITS);
+    return ((1UL << HIST_SUB_BITS) + sub) * width + width / 2;
+}
+
+unsigned long QueryStats::Percentile(const Entry &entry, double ratio) {
+    if (0 == entry.count)
+        return 0;
+    unsigned long target = (unsigned long) ceil(entry.count * ratio);
+    if (target < 1)
+        target = 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += entry.hist[i];
+        if (seen >= target)
+            return std::min(BucketValue(i), entry.max_us);
+    }
+    return entry.max_us;
+}
+
+void QueryStats::SetSlowLog(unsigned long slow_ms, unsigned long slow_sample_ms, unsigned int slow_log_size) {
+    m_slow_us.store(slow_ms * 1000);
+    m_slow_sample_ms.store(slow_sample_ms);
+    autoLock al(m_slow_lock);
+    if (slow_log_size != m_slow_log_size) {
+        //按时间顺序保留最近的若干条
+        vector<SlowQuery> queries;
+        for (unsigned int i = 0; i < m_slow_log.size(); i++)
+            queries.push_back(m_slow_log[(m_slow_next + i) % m_slow_log.size()]);
+        if (queries.size() > slow_log_size)
+            queries.erase(queries.begin(), queries.end() - slow_log_size);
+        m_slow_log.swap(queries);
+        m_slow_log_size = slow_log_size;
+        m_slow_next = m_slow_log_size ? (unsigned int) m_slow_log.size() % m_slow_log_size : 0;
+    }
+}
+
+void QueryStats::Record(const string &sql, unsigned long latency_us, long rows, unsigned long bytes, bool failed) {
+    if (!IsEnabled())
+        return;
+    string fingerprint;
+    Fingerprint(sql.data(), sql.length(), fingerprint);
+
+    bool slow = latency_us >= m_slow_us.load();
+    Shard &shard = m_shards[Hash(fingerprint) % SHARD_NUM];
+    {
+        autoLock al(shard.lock);
+        Entry *&entry = shard.entries[fingerprint];
+        if (NULL == entry) {
+            if (m_fingerprints.load() >= m_max_fingerprints.load()) {
+                shard.entries.erase(fingerprint);
+                m_untracked.fetchAdd(1);
+                return;
+            }
+            entry = new Entry;
+            memset(entry, 0, sizeof(Entry));
+            m_fingerprints.fetchAdd(1);
+        }
+        ++entry->count;
+        if (failed)
+            ++entry->errors;
+        else if (rows > 0)
+            entry->rows += rows;
+        entry->bytes += bytes;
+        entry->total_us += latency_us;
+        if (latency_us > entry->max_us)
+            entry->max_us = latency_us;
+        ++entry->hist[BucketIndex(latency_us)];
+        if (slow) {
+            //同一指纹按间隔采样, 避免慢查询集中出现时刷满日志
+            unsigned long now = NowMs();
+            if (entry->last_slow_ms && now - entry->last_slow_ms < m_slow_sample_ms.load())
+                slow = false;
+            else
+                entry->last_slow_ms = now;
+        }
+    }
+    if (slow)
+        AddSlowQuery(fingerprint, sql, latency_us, rows, failed);
+}
+
+void QueryStats::AddSlowQuery(const string &fingerprint, const string &sql, unsigned long latency_us, long rows,
+                              bool failed) {
+    SlowQuery query;
+    query.fingerprint = fingerprint;
+    if (sql.length() > m_max_sql_len)
+        query.sql = sql.substr(0, m_max_sql_len) + "...";
+    else
+        query.sql = sql;
+    query.latency_us = latency_us;
+    query.rows = rows;
+    query.failed = failed;
+    query.time = time(NULL);
+
+    autoLock al(m_slow_lock);
+    if (0 == m_slow_log_size)
+        return;
+    if (m_slow_log.size() < m_slow_log_size)
+        m_slow_log.push_back(query);
+    else
+        m_slow_log[m_slow_next] = query;
+    m_slow_next = (m_slow_next + 1) % m_slow_log_size;
+    m_slow_logged.fetchAdd(1);
+}
+
+static bool MoreTotalTime(const QueryStats::Summary &a, const QueryStats::Summary &b) {
+    return a.total_us > b.total_us;
+}
+
+void QueryStats::GetSummaries(vector<Summary> &summaries, unsigned int top) {
+    summaries.clear();
+    for (int i = 0; i < SHARD_NUM; i++) {
+        autoLock al(m_shards[i].lock);
+        for (map<string, Entry *>::iterator it = m_shards[i].entries.begin(); it != m_shards[i].entries.end(); ++it) {
+            const Entry &entry = *it->second;
+            Summary summary;
+            summary.fingerprint = it->first;
+            summary.count = entry.count;
+            summary.errors = entry.errors;
+            summary.rows = entry.rows;
+            summary.bytes = entry.bytes;
+            summary.total_us = entry.total_us;
+            summary.max_us = entry.max_us;
+            summary.p50_us = Percentile(entry, 0.50);
+            summary.p99_us = Percentile(entry, 0.99);
+            summaries.push_back(summary);
+        }
+    }
+    std::sort(summaries.begin(), summaries.end(), MoreTotalTime);
+    if (top > 0 && summaries.size() > top)
+        summaries.resize(top);
+}
+
+void QueryStats::GetSlowQueries(vector<SlowQuery> &queries) {
+    autoLock al(m_slow_lock);
+    queries.clear();
+    //缓冲已满时 m_slow_next 指向最旧的一条
+    unsigned int start = m_slow_log.size() < m_slow_log_size ? 0 : m_slow_next;
+    for (unsigned int i = 0; i < m_slow_log.size(); i++)
+        queries.push_back(m_slow_log[(start + i) % m_slow_log.size()]);
+}
+
+void QueryStats::GetStats(Stats &stats) {
+    stats.fingerprints = m_fingerprints.load();
+    stats.untracked = m_untracked.load();
+    stats.slow_logged = m_slow_logged.load();
+}
+
+void QueryStats::Reset() {
+    for (int i = 0; i < SHARD_NUM; i++) {
+        autoLock al(m_shards[i].lock);
+        for (map<string, Entry *>::iterator it = m_shards[i].entries.begin(); it != m_shards[i].entries.end(); ++it)
+            delete it->second;
+        m_fingerprints.fetchSub(m_shards[i].entries.size());
+        m_shards[i].entries.clear();
+    }
+    m_untracked.store(0);
+    autoLock al(m_slow_lock);
+    m_slow_log.clear();
+    m_slow_next = 0;
+}
+/* -------------------------------------------------- */
+
+}
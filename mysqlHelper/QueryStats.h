@@ -0,0 +1,164 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _QUERY_STATS_H_
+#define _QUERY_STATS_H_
+
+#include <pthread.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+
+using namespace std;
+
+namespace MysqlApi {
+
+/*
+* 按语句指纹统计的查询耗时
+* 1 指纹: 字符串/数字常量替换为?, 合并空白, 去掉注释, 关键字和标识符转小写, in (?,?,...) 和多行 values 合并为 (?+)
+* 2 每个指纹记录调用次数、失败次数、返回(影响)的行数、取回的字节数、总耗时和最大耗时, 以及耗时的对数直方图(用于 p50/p99)
+* 3 超过慢查询阈值的语句保存完整文本, 同一指纹在 slow_sample_ms 内只记一条, 环形缓冲保存最近 slow_log_size 条
+* 4 按指纹哈希分片加锁; 统计只在内存中累计, 由调用方定期拉取
+*
+* RecordSet / ResultView / DataBase::ExecQuery / Statement::Execute 执行后自动记录
+*
+* 用法:
+*     vector<MysqlApi::QueryStats::Summary> top;
+*     MysqlApi::QueryStats::Instance().GetSummaries(top, 20);
+*     for (unsigned int i = 0; i < top.size(); i++)
+*         cout << top[i].fingerprint << " count:" << top[i].count << " p99:" << top[i].p99_us << "us" << endl;
+*/
+class QueryStats
+{
+public:
+    struct Summary
+    {
+        string fingerprint;
+        unsigned long count;
+        unsigned long errors;
+        unsigned long rows;
+        unsigned long bytes;
+        unsigned long total_us;
+        unsigned long max_us;
+        /* 由直方图估算, 误差在 1/8 以内 */
+        unsigned long p50_us;
+        unsigned long p99_us;
+    };
+
+    struct SlowQuery
+    {
+        string fingerprint;
+        /* 完整文本, 超过 max_sql_len 时截断 */
+        string sql;
+        unsigned long latency_us;
+        long rows;
+        bool failed;
+        time_t time;
+    };
+
+    struct Stats
+    {
+        /* 当前的指纹数 */
+        unsigned long fingerprints;
+        /* 指纹数达到上限后未统计的次数 */
+        unsigned long untracked;
+        /* 累计记入慢查询日志的条数 */
+        unsigned long slow_logged;
+    };
+
+    /* 进程内共用的统计 */
+    static QueryStats &Instance();
+
+    QueryStats();
+    ~QueryStats();
+
+    /* 关闭后 Record 直接返回 */
+    void SetEnabled(bool enabled) { m_enabled.store(enabled ? 1 : 0); }
+    bool IsEnabled() const { return m_enabled.load() != 0; }
+    /* 慢查询阈值, 同一指纹的采样间隔, 日志保留的条数 */
+    void SetSlowLog(unsigned long slow_ms, unsigned long slow_sample_ms = 10 * 1000, unsigned int slow_log_size = 100);
+    /* 指纹数上限, 防止拼接sql导致无限增长 */
+    void SetMaxFingerprints(unsigned long max_fingerprints) { m_max_fingerprints.store(max_fingerprints); }
+
+    /*
+    * 记录一次执行
+    * rows 为返回或影响的行数, bytes 为取回的数据量(不清楚时传0)
+    */
+    void Record(const string &sql, unsigned long latency_us, long rows, unsigned long bytes, bool failed);
+
+    /* 按总耗时从高到低, top 为0则返回全部 */
+    void GetSummaries(vector<Summary> &summaries, unsigned int top = 0);
+    /* 按时间从旧到新 */
+    void GetSlowQueries(vector<SlowQuery> &queries);
+    void GetStats(Stats &stats);
+    /* 清空统计和慢查询日志 */
+    void Reset();
+
+    /* 计算指纹 */
+    static void Fingerprint(const char *sql, unsigned long length, string &fingerprint);
+
+private:
+    /* 耗时直方图: 小于16us 每微秒一格, 之后每个2的幂分为8格, 最大到 2^40us */
+    static const int HIST_LINEAR = 16;
+    static const int HIST_SUB_BITS = 3;
+    static const int HIST_MAX_BITS = 40;
+    static const int HIST_BUCKETS = HIST_LINEAR + (HIST_MAX_BITS - 4) * (1 << HIST_SUB_BITS);
+    static const int SHARD_NUM = 16;
+
+    struct Entry
+    {
+        unsigned long count;
+        unsigned long errors;
+        unsigned long rows;
+        unsigned long bytes;
+        unsigned long total_us;
+        unsigned long max_us;
+        unsigned long last_slow_ms;
+        unsigned int hist[HIST_BUCKETS];
+    };
+
+    struct Shard
+    {
+        pthread_mutex_t lock;
+        map<string, Entry *> entries;
+    };
+
+    /* Don't need copy or assignment */
+    QueryStats(const QueryStats &);
+    QueryStats &operator=(const QueryStats &);
+
+    static int BucketIndex(unsigned long us);
+    /* 格子的中间值 */
+    static unsigned long BucketValue(int index);
+    static unsigned long Percentile(const Entry &entry, double ratio);
+    static unsigned long Hash(const string &key);
+    static unsigned long NowMs();
+    void AddSlowQuery(const string &fingerprint, const string &sql, unsigned long latency_us, long rows, bool failed);
+
+private:
+    Shard m_shards[SHARD_NUM];
+
+    zcUtils::Atomic<int> m_enabled;
+    zcUtils::Atomic<unsigned long> m_slow_us;
+    zcUtils::Atomic<unsigned long> m_slow_sample_ms;
+    zcUtils::Atomic<unsigned long> m_max_fingerprints;
+    zcUtils::Atomic<unsigned long> m_fingerprints;
+    zcUtils::Atomic<unsigned long> m_untracked;
+    zcUtils::Atomic<unsigned long> m_slow_logged;
+
+    /* 慢查询环形缓冲 */
+    pthread_mutex_t m_slow_lock;
+    vector<SlowQuery> m_slow_log;
+    unsigned int m_slow_log_size;
+    /* 下一条写入的位置 */
+    unsigned int m_slow_next;
+    unsigned long m_max_sql_len;
+};
+
+}
+
+#endif
@@ -0,0 +1,329 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ResultExporter.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace MysqlApi {
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*
+* 流式导出查询结果
+*/
+ResultExporter::ResultExporter(int fd, const Config &config)
+        : m_fd(fd), m_config(config), m_used(0), m_mark(0), m_bytes(0), m_rows(0), m_errno(0) {
+    if (m_config.buffer_size < 4096)
+        m_config.buffer_size = 4096;
+    m_buf.resize(m_config.buffer_size);
+
+    memset(m_special, 0, sizeof(m_special));
+    switch (m_config.format) {
+        case FORMAT_TSV:
+            m_special[(unsigned char) '\\'] = 1;
+            m_special[(unsigned char) '\t'] = 1;
+            m_special[(unsigned char) '\n'] = 1;
+            m_special[(unsigned char) '\r'] = 1;
+            m_special[0] = 1;
+            break;
+        case FORMAT_CSV:
+            m_special[(unsigned char) ','] = 1;
+            m_special[(unsigned char) '"'] = 1;
+            m_special[(unsigned char) '\n'] = 1;
+            m_special[(unsigned char) '\r'] = 1;
+            break;
+        case FORMAT_JSON:
+            for (int c = 0; c < 0x20; c++)
+                m_special[c] = 1;
+            m_special[(unsigned char) '"'] = 1;
+            m_special[(unsigned char) '\\'] = 1;
+            break;
+    }
+}
+
+ResultExporter::~ResultExporter() {}
+
+long ResultExporter::Export(DataBase &db, const string &SQL) {
+    RecordSet rs(&db);
+    return Export(rs, SQL);
+}
+
+long ResultExporter::Export(RecordSet &rs, const string &SQL) {
+    m_used = 0;
+    m_mark = 0;
+    m_iov.clear();
+    m_errno = 0;
+    long rows = rs.ExecuteSQLStream(SQL, *this, m_config.batch_rows);
+    bool flushed = Flush();
+    if (rows < 0 || !flushed)
+        return -1;
+    return rows;
+}
+
+unsigned long ResultExporter::ScanPlain(const char *data, unsigned long length) const {
+    const unsigned char *s = (const unsigned char *) data;
+    unsigned long i = 0;
+    while (i < length && !m_special[s[i]])
+        ++i;
+    return i;
+}
+
+unsigned int ResultExporter::EscapeChar(unsigned char c, char *out) const {
+    static const char HEX[] = "0123456789abcdef";
+    switch (m_config.format) {
+        case FORMAT_TSV:
+            out[0] = '\\';
+            out[1] = '\0' == c ? '0' : ('\t' == c ? 't' : ('\n' == c ? 'n' : ('\r' == c ? 'r' : (char) c)));
+            return 2;
+        case FORMAT_CSV:
+            //值已在引号内, 只需把 " 写两次
+            out[0] = (char) c;
+            if ('"' != c)
+                return 1;
+            out[1] = '"';
+            return 2;
+        case FORMAT_JSON:
+            out[0] = '\\';
+            switch (c) {
+                case '"':
+                case '\\':
+                    out[1] = (char) c;
+                    return 2;
+                case '\n':
+                    out[1] = 'n';
+                    return 2;
+                case '\r':
+                    out[1] = 'r';
+                    return 2;
+                case '\t':
+                    out[1] = 't';
+                    return 2;
+                case '\b':
+                    out[1] = 'b';
+                    return 2;
+                case '\f':
+                    out[1] = 'f';
+                    return 2;
+                default:
+                    out[1] = 'u';
+                    out[2] = '0';
+                    out[3] = '0';
+                    out[4] = HEX[c >> 4];
+                    out[5] = HEX[c & 0xF];
+                    return 6;
+            }
+    }
+    out[0] = (char) c;
+    return 1;
+}
+
+bool ResultExporter::Reserve(unsigned long n) {
+    if (m_buf.size() - m_used >= n)
+        return true;
+    if (!Flush())
+        return false;
+    //缓冲已写空, 此时扩大不会使 m_iov 中的指针失效
+    if (n > m_buf.size())
+        m_buf.resize(n);
+    return true;
+}
+
+bool ResultExporter::WriteAll(struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(m_fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            m_errno = errno;
+            cout << "ResultExporter::WriteAll writev is failed!!err:" << strerror(m_errno) << endl;
+            return false;
+        }
+        m_bytes += n;
+        //跳过已写完的段, 部分写出的段从剩余处继续
+        while (count > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0 && n > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+bool ResultExporter::Flush() {
+    if (m_used > m_mark) {
+        struct iovec iov;
+        iov.iov_base = &m_buf[m_mark];
+        iov.iov_len = m_used - m_mark;
+        m_iov.push_back(iov);
+    }
+    bool ok = 0 == m_errno && (m_iov.empty() || WriteAll(&m_iov[0], (int) m_iov.size()));
+    m_iov.clear();
+    m_used = 0;
+    m_mark = 0;
+    return ok;
+}
+
+void ResultExporter::AppendRaw(const char *data, unsigned long length) {
+    memcpy(&m_buf[m_used], data, length);
+    m_used += length;
+}
+
+/* 追加不需转义的数据, 大段的直接引用 */
+bool ResultExporter::AppendLarge(const char *data, unsigned long length) {
+    if (length < ZERO_COPY_BYTES) {
+        if (!Reserve(length))
+            return false;
+        AppendRaw(data, length);
+        return true;
+    }
+    struct iovec iov;
+    if (m_used > m_mark) {
+        iov.iov_base = &m_buf[m_mark];
+        iov.iov_len = m_used - m_mark;
+        m_iov.push_back(iov);
+        m_mark = m_used;
+    }
+    iov.iov_base = (void *) data;
+    iov.iov_len = length;
+    m_iov.push_back(iov);
+    return m_iov.size() < IOV_MAX || Flush();
+}
+
+/* 按缓冲的剩余空间分段转义, 每段内不需转义的连续字节整段拷贝 */
+bool ResultExporter::AppendEscaped(const char *data, unsigned long length) {
+    const unsigned char *s = (const unsigned char *) data;
+    const unsigned char *end = s + length;
+    while (s < end) {
+        if (!Reserve(MAX_ESCAPE_BYTES * 64))
+            return false;
+        unsigned long room = (m_buf.size() - m_used) / MAX_ESCAPE_BYTES;
+        const unsigned char *stop = end - s > (long) room ? s + room : end;
+        char *out = &m_buf[m_used];
+        while (s < stop) {
+            const unsigned char *run = s;
+            while (s < stop && !m_special[*s])
+                ++s;
+            memcpy(out, run, s - run);
+            out += s - run;
+            if (s < stop)
+                out += EscapeChar(*s++, out);
+        }
+        m_used = out - &m_buf[0];
+    }
+    return true;
+}
+
+bool ResultExporter::AppendCell(const char *data, unsigned long length, bool is_null, bool numeric) {
+    if (is_null) {
+        if (FORMAT_CSV == m_config.format)
+            return true;
+        if (!Reserve(4))
+            return false;
+        if (FORMAT_TSV == m_config.format)
+            AppendRaw("\\N", 2);
+        else
+            AppendRaw("null", 4);
+        return true;
+    }
+    if (FORMAT_JSON == m_config.format && numeric && length > 0)
+        return AppendLarge(data, length);
+
+    unsigned long plain = ScanPlain(data, length);
+    if (FORMAT_TSV == m_config.format)
+        return AppendLarge(data, plain) && AppendEscaped(data + plain, length - plain);
+    //CSV 中不含特殊字符的非空值不加引号, 空串加引号以区别于NULL
+    bool quoted = FORMAT_JSON == m_config.format || plain < length || 0 == length;
+    if (!quoted)
+        return AppendLarge(data, length);
+    if (!Reserve(1))
+        return false;
+    AppendRaw("\"", 1);
+    if (!AppendLarge(data, plain) || !AppendEscaped(data + plain, length - plain) || !Reserve(1))
+        return false;
+    AppendRaw("\"", 1);
+    return true;
+}
+
+void ResultExporter::HandleFields(Field *field) {
+    int field_num = (int) field->m_name.size();
+    m_numeric.assign(field_num, 0);
+    m_keys.clear();
+    for (int i = 0; i < field_num; i++) {
+        m_numeric[i] = field->IsNum(i) ? 1 : 0;
+        if (m_config.format != FORMAT_JSON)
+            continue;
+        //"name": 形式的键, 每个结果集只转义一次
+        const string &name = field->m_name[i];
+        string key = 0 == i ? "{\"" : ",\"";
+        char escaped[MAX_ESCAPE_BYTES];
+        for (unsigned int k = 0; k < name.length(); k++) {
+            unsigned char c = (unsigned char) name[k];
+            if (m_special[c])
+                key.append(escaped, EscapeChar(c, escaped));
+            else
+                key += (char) c;
+        }
+        key += "\":";
+        m_keys.push_back(key);
+    }
+
+    if (!m_config.header || FORMAT_JSON == m_config.format)
+        return;
+    for (int i = 0; i < field_num; i++) {
+        const string &name = field->m_name[i];
+        if (i > 0) {
+            if (!Reserve(1))
+                return;
+            AppendRaw(FORMAT_CSV == m_config.format ? "," : "\t", 1);
+        }
+        if (!AppendCell(name.data(), name.length(), false, false))
+            return;
+    }
+    if (Reserve(1))
+        AppendRaw("\n", 1);
+}
+
+bool ResultExporter::HandleRows(vector<Record> &rows) {
+    const char *separator = FORMAT_CSV == m_config.format ? "," : "\t";
+    for (unsigned long r = 0; r < rows.size(); r++) {
+        Record &record = rows[r];
+        int field_num = record.Size();
+        for (int i = 0; i < field_num; i++) {
+            bool ok;
+            if (FORMAT_JSON == m_config.format) {
+                const string &key = m_keys[i];
+                ok = Reserve(key.length());
+                if (ok)
+                    AppendRaw(key.data(), key.length());
+            } else if (i > 0) {
+                ok = Reserve(1);
+                if (ok)
+                    AppendRaw(separator, 1);
+            } else
+                ok = true;
+            if (!ok || !AppendCell(record.GetValue(i), record.GetLength(i), record.IsNull(i), m_numeric[i] != 0))
+                return false;
+        }
+        if (!Reserve(3))
+            return false;
+        if (FORMAT_JSON == m_config.format)
+            AppendRaw(0 == field_num ? "{}\n" : "}\n", 0 == field_num ? 3 : 2);
+        else
+            AppendRaw("\n", 1);
+    }
+    m_rows += rows.size();
+    //引用的单元格在本批回调返回后失效, 须先写出
+    if (!m_iov.empty())
+        return Flush();
+    return 0 == m_errno;
+}
+/* -------------------------------------------------- */
+} // namespace MysqlApi
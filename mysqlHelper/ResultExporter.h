@@ -0,0 +1,124 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _RESULT_EXPORTER_H_
+#define _RESULT_EXPORTER_H_
+
+#include <sys/uio.h>
+#include <string>
+#include <vector>
+
+#include "MysqlApi.h"
+
+namespace MysqlApi
+{
+/*
+* 流式导出查询结果到文件或管道
+* 1 经由 RecordSet::ExecuteSQLStream(mysql_use_result) 逐批读取, 内存占用只与 batch_rows 和 buffer_size 有关
+* 2 各行格式化到一块复用的输出缓冲, 转义按段进行: 不需转义的连续字节整段拷贝; 缓冲写满才 write 一次
+* 3 不需转义的大单元格(>= ZERO_COPY_BYTES)不拷贝, 与缓冲中的数据一起用 writev 写出
+* 4 格式:
+*     TSV  与 SELECT ... INTO OUTFILE 默认格式相同, 可直接 LOAD DATA: \ tab 换行 回车 \0 转义, NULL 为 \N
+*     CSV  RFC 4180: 含 , " 回车 换行 的值加双引号, 其中的 " 写为 ""; NULL 为空, 空串为 ""
+*     JSON 每行一个对象(NDJSON), 数字类型的列不加引号, NULL 为 null; 字节按 UTF-8 原样输出
+* 5 行以 \n 结尾; 写失败(如管道关闭)时停止读取, Export 返回-1, 错误码由 GetErrno 取得
+* 6 fd 需为阻塞模式; 不负责关闭 fd
+*
+* 用法:
+*     ResultExporter::Config config;
+*     config.format = ResultExporter::FORMAT_CSV;
+*     config.header = true;
+*     ResultExporter exporter(fd, config);
+*     long rows = exporter.Export(conn->hDB, "select * from cdr");
+*/
+class ResultExporter : public RowHandler
+{
+public:
+    enum Format
+    {
+        FORMAT_TSV,
+        FORMAT_CSV,
+        FORMAT_JSON
+    };
+
+    struct Config
+    {
+        Format format;
+        /* TSV/CSV 是否先输出一行字段名 */
+        bool header;
+        /* 输出缓冲的大小 */
+        unsigned long buffer_size;
+        /* 每批读取的行数 */
+        unsigned int batch_rows;
+
+        Config() : format(FORMAT_TSV), header(false), buffer_size(4 * 1024 * 1024), batch_rows(4096) {}
+    };
+
+    /* 不转义直接引用的单元格的最小长度 */
+    static const unsigned long ZERO_COPY_BYTES = 16 * 1024;
+
+    ResultExporter(int fd, const Config &config = Config());
+    ~ResultExporter();
+
+    /* 执行查询并导出全部结果, 返回导出的行数, 失败返回-1 */
+    long Export(DataBase &db, const string &SQL);
+    long Export(RecordSet &rs, const string &SQL);
+
+    /* 累计写出的字节数和行数 */
+    unsigned long GetBytes() const { return m_bytes; }
+    unsigned long GetRows() const { return m_rows; }
+    /* 写失败时的 errno, 没有失败为0 */
+    int GetErrno() const { return m_errno; }
+
+    /* RowHandler */
+    void HandleFields(Field *field);
+    bool HandleRows(vector<Record> &rows);
+
+private:
+    /* Don't need copy or assignment */
+    ResultExporter(const ResultExporter &);
+    ResultExporter &operator=(const ResultExporter &);
+
+    /* 缓冲中至少留出 n 字节, 不够时先写出 */
+    bool Reserve(unsigned long n);
+    /* 写出缓冲和引用的单元格 */
+    bool Flush();
+    bool WriteAll(struct iovec *iov, int count);
+
+    void AppendRaw(const char *data, unsigned long length);
+    bool AppendLarge(const char *data, unsigned long length);
+    bool AppendEscaped(const char *data, unsigned long length);
+    bool AppendCell(const char *data, unsigned long length, bool is_null, bool numeric);
+    /* 第一个需要转义的字节的位置, 都不需要时返回 length */
+    unsigned long ScanPlain(const char *data, unsigned long length) const;
+    /* 转义一个字节, 返回写入的字节数(最多 MAX_ESCAPE_BYTES) */
+    unsigned int EscapeChar(unsigned char c, char *out) const;
+
+private:
+    /* 一个字节转义后的最大长度(JSON 的 \u00XX) */
+    static const unsigned int MAX_ESCAPE_BYTES = 6;
+
+    int m_fd;
+    Config m_config;
+    /* 需要转义(CSV 为需要加引号)的字节 */
+    char m_special[256];
+
+    vector<char> m_buf;
+    unsigned long m_used;
+    /* 缓冲中尚未加入 m_iov 的起始位置 */
+    unsigned long m_mark;
+    /* 待写出的段, 有引用单元格时才使用 */
+    vector<struct iovec> m_iov;
+
+    /* JSON 每列的 "{"name":" 或 ","name":" */
+    vector<string> m_keys;
+    vector<char> m_numeric;
+
+    unsigned long m_bytes;
+    unsigned long m_rows;
+    int m_errno;
+};
+} // namespace MysqlApi
+
+#endif
@@ -0,0 +1,98 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#include "RowMapper.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace MysqlApi {
+
+/*
+* 解析整数, 不经过 strtoll 的 locale 处理
+* 允许整数形式的 DECIMAL(如 "12.000"), 小数部分必须全为0
+*/
+    bool DecodeInt64(const CellView &cell, long long &value) {
+        if (cell.IsNull() || cell.Empty())
+            return false;
+        const char *p = cell.Data();
+        const char *end = p + cell.Size();
+        bool negative = false;
+        if (*p == '-' || *p == '+') {
+            negative = (*p == '-');
+            if (++p == end)
+                return false;
+        }
+        unsigned long long n = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+            n = n * 10 + (*p - '0');
+        if (p < end && *p == '.') {
+            for (++p; p < end && *p == '0'; ++p);
+        }
+        if (p != end)
+            return false;
+        value = negative ? -(long long) n : (long long) n;
+        return true;
+    }
+
+    bool DecodeDouble(const CellView &cell, double &value) {
+        if (cell.IsNull() || cell.Empty())
+            return false;
+        //行缓冲以'\0'结尾
+        char *end = NULL;
+        double d = strtod(cell.Data(), &end);
+        if (end != cell.Data() + cell.Size())
+            return false;
+        value = d;
+        return true;
+    }
+
+/* 读取固定位数的数字 */
+    static bool ReadDigits(const char *&p, const char *end, int width, int &value) {
+        if (end - p < width)
+            return false;
+        value = 0;
+        for (int i = 0; i < width; ++i, ++p) {
+            if (*p < '0' || *p > '9')
+                return false;
+            value = value * 10 + (*p - '0');
+        }
+        return true;
+    }
+
+/* "YYYY-MM-DD" 或 "YYYY-MM-DD HH:MM:SS[.ffffff]" */
+    bool DecodeTime(const CellView &cell, time_t &value) {
+        if (cell.IsNull() || cell.Size() < 10)
+            return false;
+        const char *p = cell.Data();
+        const char *end = p + cell.Size();
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        if (!ReadDigits(p, end, 4, tm.tm_year) || *p++ != '-' ||
+            !ReadDigits(p, end, 2, tm.tm_mon) || *p++ != '-' ||
+            !ReadDigits(p, end, 2, tm.tm_mday))
+            return false;
+        if (p < end) {
+            if ((*p++ != ' ') ||
+                !ReadDigits(p, end, 2, tm.tm_hour) || p == end || *p++ != ':' ||
+                !ReadDigits(p, end, 2, tm.tm_min) || p == end || *p++ != ':' ||
+                !ReadDigits(p, end, 2, tm.tm_sec))
+                return false;
+        }
+        if (0 == tm.tm_year && 0 == tm.tm_mon && 0 == tm.tm_mday) {
+            value = 0;
+            return true;
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        value = mktime(&tm);
+        return value != (time_t) -1;
+    }
+
+    bool IsTimeType(enum_field_types type) {
+        return MYSQL_TYPE_DATE == type || MYSQL_TYPE_DATETIME == type ||
+               MYSQL_TYPE_TIMESTAMP == type || MYSQL_TYPE_NEWDATE == type;
+    }
+}
@@ -0,0 +1,337 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _ROW_MAPPER_H_
+#define _ROW_MAPPER_H_
+
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "MysqlApi.h"
+
+namespace MysqlApi
+{
+/*
+* 直接从行缓冲解码单元格, NULL值或格式不符返回false
+* 1 整数: TINY/SHORT/LONG/INT24/LONGLONG/YEAR 以及整数形式的 DECIMAL
+* 2 浮点: FLOAT/DOUBLE/DECIMAL
+* 3 日期: DATE/DATETIME/TIMESTAMP, 按本地时区转为 time_t, "0000-00-00" 为0
+*/
+bool DecodeInt64(const CellView &cell, long long &value);
+bool DecodeDouble(const CellView &cell, double &value);
+bool DecodeTime(const CellView &cell, time_t &value);
+/* 是否是日期时间类型 */
+bool IsTimeType(enum_field_types type);
+
+/*
+* 字段解析后的位置和类型, 每个结果集解析一次
+*/
+struct BoundColumn
+{
+    int index;
+    enum_field_types type;
+};
+
+/*
+* 结构体与结果列的绑定关系(按列名), 只描述一次, 可在多线程间共享
+* 1 Bind 绑定成员与列名, 成员类型决定解码方式
+* 2 long/time_t 成员绑定到日期列时得到 time_t, 绑定到数字列时得到整数
+* 3 NULL值: 数字成员为0, 字符串成员为空串
+*
+* 用法:
+*     struct PhoneRegion {
+*         string phone;
+*         string province;
+*         long long id;
+*         time_t update_time;
+*         MYSQL_ROW_MAPPING(PhoneRegion) {
+*             MYSQL_COLUMN(PhoneRegion, phone);
+*             MYSQL_COLUMN(PhoneRegion, province);
+*             MYSQL_COLUMN(PhoneRegion, id);
+*             MYSQL_COLUMN_AS(PhoneRegion, update_time, "updated_at");
+*         }
+*     };
+*     TypedResult<PhoneRegion> rs(mysql);
+*     rs.ExecuteSQL("select phone,province,id,updated_at from phone_number_region");
+*     PhoneRegion region;
+*     while (rs.Next(region)) ...
+*/
+template <class T>
+class RowMapper
+{
+public:
+    RowMapper(){};
+
+    RowMapper &Bind(const char *column, int T::*member)
+    {
+        Binding &b = Add(column, KIND_INT);
+        b.member.i = member;
+        return *this;
+    }
+    RowMapper &Bind(const char *column, unsigned int T::*member)
+    {
+        Binding &b = Add(column, KIND_UINT);
+        b.member.ui = member;
+        return *this;
+    }
+    /* time_t 即 long */
+    RowMapper &Bind(const char *column, long T::*member)
+    {
+        Binding &b = Add(column, KIND_LONG);
+        b.member.l = member;
+        return *this;
+    }
+    RowMapper &Bind(const char *column, unsigned long T::*member)
+    {
+        Binding &b = Add(column, KIND_ULONG);
+        b.member.ul = member;
+        return *this;
+    }
+    RowMapper &Bind(const char *column, long long T::*member)
+    {
+        Binding &b = Add(column, KIND_INT64);
+        b.member.ll = member;
+        return *this;
+    }
+    RowMapper &Bind(const char *column, double T::*member)
+    {
+        Binding &b = Add(column, KIND_DOUBLE);
+        b.member.d = member;
+        return *this;
+    }
+    RowMapper &Bind(const char *column, bool T::*member)
+    {
+        Binding &b = Add(column, KIND_BOOL);
+        b.member.b = member;
+        return *this;
+    }
+    RowMapper &Bind(const char *column, string T::*member)
+    {
+        Binding &b = Add(column, KIND_STRING);
+        b.member.s = member;
+        return *this;
+    }
+
+    int Size() const { return (int) m_bindings.size(); }
+
+    /* 由结构体的 MYSQL_ROW_MAPPING 描述得到的绑定 */
+    static const RowMapper &Default()
+    {
+        static RowMapper mapper(DescribeTag);
+        return mapper;
+    }
+
+    /* 按列名解析列的位置和类型, 有列不存在返回false */
+    bool Resolve(const ResultView &rs, vector<BoundColumn> &columns) const
+    {
+        columns.resize(m_bindings.size());
+        for (unsigned int i = 0; i < m_bindings.size(); i++)
+        {
+            columns[i].index = rs.GetFieldIndex(m_bindings[i].column.c_str());
+            if (columns[i].index < 0)
+                return MissingColumn(m_bindings[i].column);
+            columns[i].type = rs.GetFieldType(columns[i].index);
+        }
+        return true;
+    }
+    bool Resolve(Field &field, vector<BoundColumn> &columns) const
+    {
+        columns.resize(m_bindings.size());
+        for (unsigned int i = 0; i < m_bindings.size(); i++)
+        {
+            columns[i].index = field.GetField_NO(m_bindings[i].column);
+            if (columns[i].index < 0)
+                return MissingColumn(m_bindings[i].column);
+            columns[i].type = field.m_type[columns[i].index];
+        }
+        return true;
+    }
+
+    /* 把当前行解码到 row 中 */
+    void Map(const ResultView &rs, const vector<BoundColumn> &columns, T &row) const
+    {
+        for (unsigned int i = 0; i < m_bindings.size(); i++)
+            Decode(m_bindings[i], columns[i].type, rs.Get(columns[i].index), row);
+    }
+    /* 用于 ExecuteSQLStream 的 HandleRows */
+    void Map(const Record &rec, const vector<BoundColumn> &columns, T &row) const
+    {
+        for (unsigned int i = 0; i < m_bindings.size(); i++)
+            Decode(m_bindings[i], columns[i].type, rec.GetCell(columns[i].index), row);
+    }
+
+private:
+    enum Kind
+    {
+        KIND_INT,
+        KIND_UINT,
+        KIND_LONG,
+        KIND_ULONG,
+        KIND_INT64,
+        KIND_DOUBLE,
+        KIND_BOOL,
+        KIND_STRING
+    };
+
+    struct Binding
+    {
+        string column;
+        Kind kind;
+        union {
+            int T::*i;
+            unsigned int T::*ui;
+            long T::*l;
+            unsigned long T::*ul;
+            long long T::*ll;
+            double T::*d;
+            bool T::*b;
+            string T::*s;
+        } member;
+    };
+
+    enum DescribeTagType
+    {
+        DescribeTag
+    };
+
+    RowMapper(DescribeTagType) { T::DescribeColumns(*this); }
+
+    Binding &Add(const char *column, Kind kind)
+    {
+        m_bindings.push_back(Binding());
+        m_bindings.back().column = column;
+        m_bindings.back().kind = kind;
+        return m_bindings.back();
+    }
+
+    static bool MissingColumn(const string &column)
+    {
+        cout << "RowMapper::column not in result:" << column << endl;
+        return false;
+    }
+
+    static void Decode(const Binding &b, enum_field_types type, const CellView &cell, T &row)
+    {
+        long long n = 0;
+        double d = 0;
+        switch (b.kind)
+        {
+            case KIND_STRING:
+                cell.AssignTo(row.*(b.member.s));
+                return;
+            case KIND_DOUBLE:
+                row.*(b.member.d) = DecodeDouble(cell, d) ? d : 0;
+                return;
+            case KIND_LONG:
+                if (IsTimeType(type))
+                {
+                    time_t t = 0;
+                    row.*(b.member.l) = DecodeTime(cell, t) ? (long) t : 0;
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+        //其余都是整数
+        if (!DecodeInt64(cell, n))
+            n = 0;
+        switch (b.kind)
+        {
+            case KIND_INT:
+                row.*(b.member.i) = (int) n;
+                break;
+            case KIND_UINT:
+                row.*(b.member.ui) = (unsigned int) n;
+                break;
+            case KIND_LONG:
+                row.*(b.member.l) = (long) n;
+                break;
+            case KIND_ULONG:
+                row.*(b.member.ul) = (unsigned long) n;
+                break;
+            case KIND_INT64:
+                row.*(b.member.ll) = n;
+                break;
+            case KIND_BOOL:
+                row.*(b.member.b) = (n != 0);
+                break;
+            default:
+                break;
+        }
+    }
+
+private:
+    vector<Binding> m_bindings;
+};
+
+/*
+* 类型化的查询结果, 逐行解码为结构体
+* 1 列位置在 ExecuteSQL 后解析一次, 取行时不再按列名查找
+* 2 除字符串成员外, 取行不分配内存
+*/
+template <class T>
+class TypedResult
+{
+public:
+    TypedResult(MYSQL *hSQL, const RowMapper<T> &mapper = RowMapper<T>::Default())
+        : m_rs(hSQL), m_mapper(mapper){};
+
+    /* 执行查询, 返回记录数, 失败或有绑定的列不在结果中返回-1 */
+    int ExecuteSQL(const string &SQL)
+    {
+        int count = m_rs.ExecuteSQL(SQL);
+        if (count > 0 && !m_mapper.Resolve(m_rs, m_columns))
+        {
+            m_rs.Free();
+            return -1;
+        }
+        return count;
+    }
+    /* 取下一行, 没有更多行返回false */
+    bool Next(T &row)
+    {
+        if (!m_rs.Fetch())
+            return false;
+        m_mapper.Map(m_rs, m_columns, row);
+        return true;
+    }
+    /* 把剩余的行全部追加到 rows */
+    int FetchAll(vector<T> &rows)
+    {
+        int n = 0;
+        rows.reserve(rows.size() + m_rs.GetRecordCount());
+        T row;
+        while (Next(row))
+        {
+            rows.push_back(row);
+            ++n;
+        }
+        return n;
+    }
+    int GetRecordCount() const { return m_rs.GetRecordCount(); }
+    /* 当前行的原始单元格 */
+    ResultView &GetResult() { return m_rs; }
+
+private:
+    /* Don't need copy or assignment */
+    TypedResult(const TypedResult &);
+    TypedResult &operator=(const TypedResult &);
+
+private:
+    ResultView m_rs;
+    const RowMapper<T> &m_mapper;
+    vector<BoundColumn> m_columns;
+};
+} // namespace MysqlApi
+
+/* 在结构体内声明列绑定, 后跟函数体 */
+#define MYSQL_ROW_MAPPING(Type) static void DescribeColumns(MysqlApi::RowMapper<Type> &mapper)
+/* 绑定与成员同名的列 */
+#define MYSQL_COLUMN(Type, member) mapper.Bind(#member, &Type::member)
+/* 绑定指定名称的列 */
+#define MYSQL_COLUMN_AS(Type, member, column) mapper.Bind(column, &Type::member)
+
+#endif
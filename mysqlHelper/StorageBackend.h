@@ -0,0 +1,88 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+#ifndef _STORAGE_BACKEND_H_
+#define _STORAGE_BACKEND_H_
+
+#include <string>
+#include <vector>
+
+#include "MysqlApi.h"
+
+namespace MysqlApi
+{
+/*
+* 后端返回的结果
+* 1 单元格为视图, 指向后端自己的存储, 在同一会话执行下一条语句前有效
+* 2 按行存放, 第 r 行第 c 列为 cells[r * fields.size() + c]
+*/
+struct BackendResult
+{
+    /* 字段名, 指向后端的存储 */
+    vector<const char *> fields;
+    vector<CellView> cells;
+    unsigned long rows;
+    /* 非查询语句影响的行数 */
+    unsigned long affected_rows;
+
+    BackendResult() : rows(0), affected_rows(0) {}
+
+    void Clear()
+    {
+        fields.clear();
+        cells.clear();
+        rows = 0;
+        affected_rows = 0;
+    }
+};
+
+/*
+* 后端的一个会话, 对应一个连接, 与 DataBase 一样不是线程安全的
+*/
+class BackendSession
+{
+public:
+    virtual ~BackendSession() {}
+
+    /*
+    * 执行语句, params 依次替换 sql 中的 ?(预处理语句), 没有参数时传空
+    * 成功返回0, 失败返回错误码(与 mysqld 的错误码一致), 错误信息由 GetError 取得
+    */
+    virtual unsigned int Query(const string &sql, const vector<CellView> &params, BackendResult &result) = 0;
+    virtual const char *GetError() const = 0;
+    /* 会话是否可用, 可用返回0 */
+    virtual int Ping() { return 0; }
+};
+
+/*
+* 存储后端
+* 1 默认(没有安装后端时)使用 libmysqlclient
+* 2 安装后端后 DataBase::Connect 改为向后端开会话; DataBase::ExecQuery, 事务, 用 DataBase 构造的
+*   RecordSet / ResultView, 以及 StmtCache::Get(DataBase &, ...) 取得的预处理语句都经由会话执行
+* 3 直接使用 MYSQL 句柄的接口(GetMysql() 为NULL)不受支持, 如 BulkWriter, AsyncMysqlEngine
+*
+* 用法(压测时用内存引擎代替数据库):
+*     MemoryBackend backend;
+*     backend.CreateTable("phone_number_region", columns);
+*     ...
+*     MysqlApi::StorageBackend::Install(&backend);
+*     Singleton<CdbConncetPool>::instance().CreateConnectionPool("memory", "db", "", "", 0, 8);
+*/
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() {}
+
+    virtual const char *GetName() const = 0;
+    /* 开一个会话, 失败返回NULL */
+    virtual BackendSession *Open(const string &host, const string &user, const string &passwd,
+                                 const string &db, unsigned int port) = 0;
+
+    /* 安装进程内使用的后端, NULL 恢复为 libmysqlclient; 需在建立连接前调用, 不持有所有权 */
+    static void Install(StorageBackend *backend);
+    static StorageBackend *GetInstalled();
+};
+} // namespace MysqlApi
+
+#endif
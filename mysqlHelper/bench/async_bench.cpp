@@ -0,0 +1,122 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* AsyncMysqlEngine 的示例和吞吐, 需要本地(或可访问的) mysqld, 并用 MariaDB Connector/C 编译
+* 用法: async_bench host db user pwd [port] [connections] [queries] [sql]
+* 1 用 AsyncFuture 查一次 select 1, 检查结果
+* 2 同一条 sql 先在一个连接上同步执行 queries 次, 再通过引擎异步提交 queries 次, 对比吞吐
+* 3 提交一批查询后立即 Stop, 检查每个查询都已回调(未执行的以 CR_SERVER_GONE_ERROR 回调)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "AsyncMysql.h"
+#include "timeval.h"
+#include "atomic.h"
+
+/* 只计数的回调 */
+class CountingHandler : public MysqlApi::AsyncResultHandler
+{
+public:
+    zcUtils::Atomic<long> done;
+    zcUtils::Atomic<long> failed;
+
+    CountingHandler() : done(0), failed(0) {}
+
+    void OnQueryDone(unsigned int err_no, const char * /* error */,
+                     MysqlApi::ResultView & /* result */, unsigned long /* affected_rows */) {
+        if (err_no)
+            failed.fetchAdd(1);
+        done.fetchAdd(1);
+    }
+};
+
+static bool CheckFuture(MysqlApi::AsyncMysqlEngine &engine) {
+    MysqlApi::AsyncFuture future;
+    if (!engine.Submit("select 1", &future) || !future.Wait(3000)) {
+        printf("select 1: no answer in 3s\n");
+        return false;
+    }
+    if (future.GetErrno()) {
+        printf("select 1: err:%u %s\n", future.GetErrno(), future.GetError().c_str());
+        return false;
+    }
+    MysqlApi::ResultView &result = future.GetResult();
+    if (!result.Fetch() || result.Get(0).ToLong(-1) != 1) {
+        printf("select 1: unexpected result\n");
+        return false;
+    }
+    printf("select 1: ok\n");
+    return true;
+}
+
+static bool RunSync(char **argv, unsigned int port, long queries, const string &sql) {
+    MysqlApi::DataBase db;
+    if (db.Connect(argv[1], argv[3], argv[4], argv[2], port, 10, 3, 10, 0) != 0) {
+        printf("sync: failed to connect\n");
+        return false;
+    }
+    unsigned long starttime = util::get_current_time_stamp();
+    long failed = 0;
+    for (long i = 0; i < queries; i++) {
+        MysqlApi::ResultView result(&db);
+        if (result.ExecuteSQL(sql) < 0)
+            ++failed;
+    }
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    printf("%-6s conns:1 queries:%ld failed:%ld cost:%lums rate:%.0f/s\n", "sync", queries, failed, costtime / 1000,
+           queries * 1000000.0 / (costtime ? costtime : 1));
+    return true;
+}
+
+static bool RunAsync(MysqlApi::AsyncMysqlEngine &engine, int conns, long queries, const string &sql) {
+    CountingHandler handler;
+    unsigned long starttime = util::get_current_time_stamp();
+    for (long i = 0; i < queries; i++)
+        engine.Submit(sql, &handler);
+    while (handler.done.load() < queries)
+        usleep(100);
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    printf("%-6s conns:%d queries:%ld failed:%ld cost:%lums rate:%.0f/s\n", "async", conns, queries,
+           handler.failed.load(), costtime / 1000, queries * 1000000.0 / (costtime ? costtime : 1));
+    return 0 == handler.failed.load();
+}
+
+/* Stop 前提交的查询必须全部回调, 否则等待它们的调用者会一直阻塞 */
+static bool RunStop(MysqlApi::AsyncMysqlEngine &engine, long queries, const string &sql) {
+    CountingHandler handler;
+    for (long i = 0; i < queries; i++)
+        engine.Submit(sql, &handler);
+    engine.Stop();
+    printf("stop   submitted:%ld answered:%ld failed:%ld\n", queries, handler.done.load(), handler.failed.load());
+    return handler.done.load() == queries;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        printf("usage: %s host db user pwd [port] [connections] [queries] [sql]\n", argv[0]);
+        return 1;
+    }
+    unsigned int port = argc > 5 ? atoi(argv[5]) : 3306;
+    int conns = argc > 6 ? atoi(argv[6]) : 8;
+    long queries = argc > 7 ? atol(argv[7]) : 20000;
+    string sql = argc > 8 ? argv[8] : "select 1";
+
+    MysqlApi::AsyncMysqlEngine engine;
+    if (!engine.Start(argv[1], argv[2], argv[3], argv[4], port, conns)) {
+        printf("failed to start the async engine\n");
+        return 1;
+    }
+    if (!CheckFuture(engine))
+        return 1;
+    if (!RunSync(argv, port, queries, sql))
+        return 1;
+    if (!RunAsync(engine, conns, queries, sql))
+        return 1;
+    if (!RunStop(engine, queries, sql))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,186 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* DbFactory 查询路径的吞吐, 用内存存储引擎代替数据库, 不需要 MySQL
+* 用法: dbfactory_bench [threads] [connections] [seconds] [segments] [index] [stats]
+*   segments 为生成的7位号段数, index 为1时启动号段内存索引, stats 为0时关闭查询统计
+* 依次测 getProviderByPhone / getRegionByPhone / getProviderByPrefix / getRegionByPhones,
+* 测的是连接池、预处理语句缓存、结果处理等客户端开销
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "dbFactory.h"
+#include "DbConnectPool.h"
+#include "MemoryBackend.h"
+#include "PhoneRegionIndex.h"
+#include "QueryStats.h"
+#include "singleton.h"
+#include "timeval.h"
+#include "atomic.h"
+
+/* 生成的7位号段: 3位前缀 + 4位序号, 最多 18 * 10000 个 */
+static const char *PREFIXES[] = {"130", "131", "132", "155", "156", "186", "134", "135", "139", "150", "182", "188",
+                                 "133", "153", "177", "180", "189", "199"};
+static const char *ISPS[] = {"联通", "联通", "联通", "联通", "联通", "联通", "移动", "移动", "移动", "移动", "移动",
+                             "移动", "电信", "电信", "电信", "电信", "电信", "电信"};
+static const char *PROVINCES[] = {"北京", "上海", "广东", "浙江", "江苏", "四川", "湖北", "山东"};
+
+enum BenchCase
+{
+    CASE_PROVIDER_BY_PHONE,
+    CASE_REGION_BY_PHONE,
+    CASE_PROVIDER_BY_PREFIX,
+    CASE_REGION_BY_PHONES
+};
+
+struct BenchArgs
+{
+    BenchCase which;
+    int segments;
+    unsigned int seed;
+    zcUtils::Atomic<int> *stop;
+    unsigned long count;
+    unsigned long errors;
+};
+
+static int PrefixNum() {
+    return sizeof(PREFIXES) / sizeof(PREFIXES[0]);
+}
+
+/* 第 n 个号段的7位号码 */
+static string SegmentPhone(int n) {
+    char phone[16];
+    snprintf(phone, sizeof(phone), "%s%04d", PREFIXES[n % PrefixNum()], n / PrefixNum() % 10000);
+    return phone;
+}
+
+static void LoadTable(MysqlApi::MemoryBackend &backend, int segments) {
+    vector<string> columns;
+    columns.push_back("prefix");
+    columns.push_back("phone");
+    columns.push_back("province");
+    columns.push_back("city");
+    columns.push_back("isp");
+    backend.CreateTable("phone_number_region", columns);
+
+    vector<string> values(columns.size());
+    for (int n = 0; n < segments; n++) {
+        int province = n / PrefixNum() % 8;
+        char city[32];
+        snprintf(city, sizeof(city), "%s%d市", PROVINCES[province], n / PrefixNum() % 20);
+        values[0] = PREFIXES[n % PrefixNum()];
+        values[1] = SegmentPhone(n);
+        values[2] = PROVINCES[province];
+        values[3] = city;
+        values[4] = ISPS[n % PrefixNum()];
+        backend.Insert("phone_number_region", values);
+    }
+    backend.CreateIndex("phone_number_region", "phone");
+    backend.CreateIndex("phone_number_region", "prefix");
+}
+
+static void *BenchWorker(void *arg) {
+    BenchArgs *args = (BenchArgs *) arg;
+    string provider, province, city;
+    int count = 0;
+    vector<string> phones(20);
+    map<string, PhoneRegionInfo> regions;
+    while (0 == args->stop->load()) {
+        string phone = SegmentPhone(rand_r(&args->seed) % args->segments);
+        DB_OPERATOR_RESULT rt = DB_OPERATOR_RESULT_OK;
+        switch (args->which) {
+            case CASE_PROVIDER_BY_PHONE:
+                rt = DbFactory::getProviderByPhone(phone, provider);
+                break;
+            case CASE_REGION_BY_PHONE:
+                rt = DbFactory::getRegionByPhone(phone, province, city);
+                break;
+            case CASE_PROVIDER_BY_PREFIX:
+                rt = DbFactory::getProviderByPrefix(phone.substr(0, 3), provider, count);
+                break;
+            case CASE_REGION_BY_PHONES:
+                for (unsigned int i = 0; i < phones.size(); i++)
+                    phones[i] = SegmentPhone(rand_r(&args->seed) % args->segments);
+                regions.clear();
+                rt = DbFactory::getRegionByPhones(phones, regions);
+                break;
+        }
+        if (rt != DB_OPERATOR_RESULT_OK)
+            ++args->errors;
+        ++args->count;
+    }
+    return NULL;
+}
+
+static void RunBench(const char *name, BenchCase which, int threads, int segments, int seconds) {
+    zcUtils::Atomic<int> stop(0);
+    vector<BenchArgs> args(threads);
+    vector<pthread_t> ids(threads);
+    for (int i = 0; i < threads; i++) {
+        args[i].which = which;
+        args[i].segments = segments;
+        args[i].seed = i + 1;
+        args[i].stop = &stop;
+        args[i].count = 0;
+        args[i].errors = 0;
+    }
+    unsigned long starttime = util::get_current_time_stamp();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, BenchWorker, &args[i]);
+    sleep(seconds);
+    stop.store(1);
+    unsigned long total = 0, errors = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        total += args[i].count;
+        errors += args[i].errors;
+    }
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    printf("%-20s threads:%d ops:%lu rate:%.0f/s avg:%.3fus errors:%lu\n", name, threads, total,
+           total * 1000000.0 / costtime, costtime * threads / (double) (total ? total : 1), errors);
+}
+
+int main(int argc, char **argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    int conns = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    int segments = argc > 4 ? atoi(argv[4]) : 100000;
+    bool use_index = argc > 5 && atoi(argv[5]) != 0;
+    bool stats = argc > 6 ? atoi(argv[6]) != 0 : true;
+    if (threads <= 0 || conns <= 0 || segments <= 0 || segments > PrefixNum() * 10000) {
+        printf("usage: %s [threads] [connections] [seconds] [segments] [index] [stats]\n", argv[0]);
+        return 1;
+    }
+
+    MysqlApi::MemoryBackend backend;
+    LoadTable(backend, segments);
+    MysqlApi::StorageBackend::Install(&backend);
+    MysqlApi::QueryStats::Instance().SetEnabled(stats);
+
+    CdbConncetPool &pool = Singleton<CdbConncetPool>::instance();
+    pool.Init();
+    if (!pool.CreateConnectionPool("memory", "bench", "", "", 0, conns)) {
+        printf("failed to create connection pool\n");
+        return 1;
+    }
+    if (use_index && !PhoneRegionIndex::Start(0)) {
+        printf("failed to load phone region index\n");
+        return 1;
+    }
+    printf("backend:%s segments:%d index:%s stats:%s\n", backend.GetName(), segments, use_index ? "on" : "off",
+           stats ? "on" : "off");
+
+    RunBench("getProviderByPhone", CASE_PROVIDER_BY_PHONE, threads, segments, seconds);
+    RunBench("getRegionByPhone", CASE_REGION_BY_PHONE, threads, segments, seconds);
+    RunBench("getProviderByPrefix", CASE_PROVIDER_BY_PREFIX, threads, segments, seconds);
+    RunBench("getRegionByPhones", CASE_REGION_BY_PHONES, threads, segments, seconds);
+
+    if (use_index)
+        PhoneRegionIndex::Stop();
+    return 0;
+}
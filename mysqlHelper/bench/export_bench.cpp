@@ -0,0 +1,96 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* 结果导出的吞吐, 用内存存储引擎生成数据, 不需要 MySQL
+* 用法: export_bench [rows] [output] [text_bytes]
+*   output 默认为 /dev/null; text_bytes 为长文本列的长度, >= 16K 时走 writev 直接引用
+* 依次测 TSV / CSV / JSON 三种格式, 约十分之一的值含需要转义的字符
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "MemoryBackend.h"
+#include "ResultExporter.h"
+#include "timeval.h"
+
+static void LoadTable(MysqlApi::MemoryBackend &backend, long rows, unsigned long text_bytes) {
+    vector<string> columns;
+    columns.push_back("id");
+    columns.push_back("caller");
+    columns.push_back("callee");
+    columns.push_back("name");
+    columns.push_back("note");
+    backend.CreateTable("cdr", columns);
+
+    string text(text_bytes, 'x');
+    vector<string> values(columns.size());
+    char buf[64];
+    for (long n = 0; n < rows; n++) {
+        snprintf(buf, sizeof(buf), "%ld", n);
+        values[0] = buf;
+        snprintf(buf, sizeof(buf), "138%08ld", n % 100000000);
+        values[1] = buf;
+        snprintf(buf, sizeof(buf), "186%08ld", (n * 7919) % 100000000);
+        values[2] = buf;
+        values[3] = 0 == n % 10 ? "O'Neil, \"Jr\"\tsales" : "zhang san";
+        values[4] = text;
+        backend.Insert("cdr", values);
+    }
+}
+
+static bool RunBench(const char *name, MysqlApi::ResultExporter::Format format, const char *output) {
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("failed to open %s\n", output);
+        return false;
+    }
+    MysqlApi::DataBase db;
+    if (db.Connect("memory", "", "", "bench", 0, 0, 0, 0, 0) != 0) {
+        printf("failed to connect\n");
+        close(fd);
+        return false;
+    }
+    MysqlApi::ResultExporter::Config config;
+    config.format = format;
+    config.header = true;
+    MysqlApi::ResultExporter exporter(fd, config);
+
+    unsigned long starttime = util::get_current_time_stamp();
+    long rows = exporter.Export(db, "select * from cdr");
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    close(fd);
+    if (rows < 0) {
+        printf("%-5s failed, errno:%d\n", name, exporter.GetErrno());
+        return false;
+    }
+    printf("%-5s rows:%ld bytes:%lu cost:%lums rate:%.1fMB/s %.0frows/s\n", name, rows, exporter.GetBytes(),
+           costtime / 1000, exporter.GetBytes() / (double) (costtime ? costtime : 1),
+           rows * 1000000.0 / (costtime ? costtime : 1));
+    return true;
+}
+
+int main(int argc, char **argv) {
+    long rows = argc > 1 ? atol(argv[1]) : 1000000;
+    const char *output = argc > 2 ? argv[2] : "/dev/null";
+    unsigned long text_bytes = argc > 3 ? strtoul(argv[3], NULL, 10) : 64;
+    if (rows <= 0) {
+        printf("usage: %s [rows] [output] [text_bytes]\n", argv[0]);
+        return 1;
+    }
+
+    MysqlApi::MemoryBackend backend;
+    LoadTable(backend, rows, text_bytes);
+    MysqlApi::StorageBackend::Install(&backend);
+
+    if (!RunBench("tsv", MysqlApi::ResultExporter::FORMAT_TSV, output))
+        return 1;
+    if (!RunBench("csv", MysqlApi::ResultExporter::FORMAT_CSV, output))
+        return 1;
+    if (!RunBench("json", MysqlApi::ResultExporter::FORMAT_JSON, output))
+        return 1;
+    return 0;
+}
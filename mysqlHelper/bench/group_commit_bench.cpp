@@ -0,0 +1,205 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* GroupCommitter 的吞吐和停止时的完整性, 需要 mysqld
+* 用法: group_commit_bench host db user pwd [port] [threads] [ops]
+* 在 db 中建表 group_commit_bench(用完删除)
+* 1 threads 个线程共插入 ops 行, 每行一个操作并等待结果, 分别测逐条自动提交和组提交
+* 2 threads 个线程共提交 ops 个操作后立即 Stop, 检查每个 future 都已完成且行数与成功的操作数一致
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "GroupCommit.h"
+#include "timeval.h"
+
+static const char *CREATE_SQL = "create table if not exists group_commit_bench "
+                                "(id bigint not null auto_increment primary key, worker int, seq bigint) engine=innodb";
+
+struct BenchArgs
+{
+    CdbConncetPool *pool;
+    GroupCommitter *committer;
+    int worker;
+    long count;
+    /* Stop 用例: 提交后不等待, 由主线程在 Stop 后检查 */
+    vector<GroupCommitFuture *> futures;
+    long failed;
+};
+
+static string InsertSql(int worker, long seq) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "insert into group_commit_bench (worker, seq) values (%d, %ld)", worker, seq);
+    return sql;
+}
+
+static void *AutoCommitWorker(void *arg) {
+    BenchArgs *args = (BenchArgs *) arg;
+    for (long i = 0; i < args->count; i++) {
+        Connection *pConn = args->pool->GetConnection();
+        if (NULL == pConn || pConn->hDB.ExecQuery(InsertSql(args->worker, i)) < 0)
+            ++args->failed;
+        if (pConn)
+            args->pool->ReleaseConnection(pConn);
+    }
+    return NULL;
+}
+
+static void *GroupCommitWorker(void *arg) {
+    BenchArgs *args = (BenchArgs *) arg;
+    for (long i = 0; i < args->count; i++) {
+        GroupCommitFuture future;
+        if (!args->committer->Submit(InsertSql(args->worker, i), &future) || !future.Wait() ||
+            future.GetResult() < 0)
+            ++args->failed;
+    }
+    return NULL;
+}
+
+static void *SubmitWorker(void *arg) {
+    BenchArgs *args = (BenchArgs *) arg;
+    for (long i = 0; i < args->count; i++) {
+        GroupCommitFuture *future = new GroupCommitFuture;
+        if (args->committer->Submit(InsertSql(args->worker, i), future))
+            args->futures.push_back(future);
+        else
+            delete future;
+    }
+    return NULL;
+}
+
+static long CountRows(CdbConncetPool &pool) {
+    Connection *pConn = pool.GetConnection();
+    if (NULL == pConn)
+        return -1;
+    MysqlApi::ResultView result(&pConn->hDB);
+    long rows = -1;
+    if (result.ExecuteSQL("select count(*) from group_commit_bench") > 0 && result.Fetch())
+        rows = result.Get(0).ToLong(-1);
+    pool.ReleaseConnection(pConn);
+    return rows;
+}
+
+static bool ResetTable(CdbConncetPool &pool) {
+    Connection *pConn = pool.GetConnection();
+    if (NULL == pConn)
+        return false;
+    bool ok = pConn->hDB.ExecQuery(CREATE_SQL) >= 0 && pConn->hDB.ExecQuery("truncate table group_commit_bench") >= 0;
+    pool.ReleaseConnection(pConn);
+    return ok;
+}
+
+static bool RunCase(const char *name, void *(*worker)(void *), CdbConncetPool &pool, GroupCommitter *committer,
+                    int threads, long ops) {
+    if (!ResetTable(pool)) {
+        printf("%s: failed to prepare the table\n", name);
+        return false;
+    }
+    vector<BenchArgs> args(threads);
+    vector<pthread_t> ids(threads);
+    unsigned long starttime = util::get_current_time_stamp();
+    for (int i = 0; i < threads; i++) {
+        args[i].pool = &pool;
+        args[i].committer = committer;
+        args[i].worker = i;
+        args[i].count = ops / threads;
+        args[i].failed = 0;
+        pthread_create(&ids[i], NULL, worker, &args[i]);
+    }
+    long failed = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        failed += args[i].failed;
+    }
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    long total = ops / threads * threads;
+    printf("%-12s threads:%d ops:%ld failed:%ld cost:%lums rate:%.0f/s", name, threads, total, failed,
+           costtime / 1000, total * 1000000.0 / (costtime ? costtime : 1));
+    if (committer)
+        printf(" commits:%lu", committer->GetCommits());
+    printf("\n");
+    return 0 == failed;
+}
+
+/* Stop 前提交成功的操作都必须完成, 否则等待它们的调用者会一直阻塞 */
+static bool RunStop(CdbConncetPool &pool, int threads, long ops) {
+    if (!ResetTable(pool)) {
+        printf("stop: failed to prepare the table\n");
+        return false;
+    }
+    //小批次加长窗口, Stop 时大部分操作还在排队
+    GroupCommitter::Config config;
+    config.max_batch = 16;
+    config.window_ms = 20;
+    GroupCommitter committer(pool, config);
+    committer.Start();
+    vector<BenchArgs> args(threads);
+    vector<pthread_t> ids(threads);
+    for (int i = 0; i < threads; i++) {
+        args[i].committer = &committer;
+        args[i].worker = i;
+        args[i].count = ops / threads;
+        pthread_create(&ids[i], NULL, SubmitWorker, &args[i]);
+    }
+    for (int i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+    committer.Stop();
+
+    long submitted = 0, pending = 0, succeeded = 0;
+    for (int i = 0; i < threads; i++) {
+        for (unsigned int k = 0; k < args[i].futures.size(); k++) {
+            GroupCommitFuture *future = args[i].futures[k];
+            ++submitted;
+            //没完成的 future 可能还会被写入, 不释放
+            if (!future->Wait(1)) {
+                ++pending;
+                continue;
+            }
+            if (future->GetResult() >= 0)
+                ++succeeded;
+            delete future;
+        }
+    }
+    long rows = CountRows(pool);
+    printf("stop         submitted:%ld pending:%ld succeeded:%ld rows:%ld\n", submitted, pending, succeeded, rows);
+    return 0 == pending && rows == succeeded;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        printf("usage: %s host db user pwd [port] [threads] [ops]\n", argv[0]);
+        return 1;
+    }
+    unsigned int port = argc > 5 ? atoi(argv[5]) : 3306;
+    int threads = argc > 6 ? atoi(argv[6]) : 16;
+    long ops = argc > 7 ? atol(argv[7]) : 20000;
+    if (threads <= 0 || ops < threads) {
+        printf("usage: %s host db user pwd [port] [threads] [ops]\n", argv[0]);
+        return 1;
+    }
+
+    CdbConncetPool pool;
+    pool.Init();
+    if (!pool.CreateConnectionPool(argv[1], argv[2], argv[3], argv[4], port, threads + 1)) {
+        printf("failed to create connection pool\n");
+        return 1;
+    }
+    bool ok = RunCase("autocommit", AutoCommitWorker, pool, NULL, threads, ops);
+    {
+        GroupCommitter committer(pool);
+        committer.Start();
+        ok = RunCase("group commit", GroupCommitWorker, pool, &committer, threads, ops) && ok;
+        committer.Stop();
+    }
+    ok = RunStop(pool, threads, ops) && ok;
+
+    Connection *pConn = pool.GetConnection();
+    if (pConn) {
+        pConn->hDB.ExecQuery("drop table if exists group_commit_bench");
+        pool.ReleaseConnection(pConn);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* MessageHandler 的消息吞吐
+* 用法: message_bench [producers] [workers] [messages]
+* 1 producers 个线程共投递 messages 条消息, workers 个线程处理, Handle 只计数
+* 2 扇出: 每条种子消息在 Handle 中再投递 FANOUT 条子消息, 分别测不开/开本地队列
+* 对照组为原来的实现(SafeQueue + sem_t + 退出消息), 保留在本文件中
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "threadUtil.h"
+#include "timeval.h"
+#include "atomic.h"
+
+static const int FANOUT = 16;
+
+/* 原来的实现: 加锁队列, 每条消息一次 sem_post/sem_wait, 停止时每个线程一条退出消息 */
+class LegacyMessageHandler : public ThreadPool
+{
+private:
+    bool m_initialized;
+    SafeQueue<Thread_Message *> m_queue;
+    sem_t m_sem;
+
+public:
+    LegacyMessageHandler() : m_initialized(false) {}
+    ~LegacyMessageHandler() {
+        sem_destroy(&m_sem);
+    }
+
+    bool PutMsg(Thread_Message *msg) {
+        if (!m_initialized)
+            return false;
+        m_queue.PutMsg(msg);
+        return 0 == sem_post(&m_sem);
+    }
+
+    bool Init() {
+        m_initialized = 0 == sem_init(&m_sem, 0, 0);
+        return m_initialized;
+    }
+
+    bool Stop() {
+        for (int i = 0; i < m_num; i++) {
+            Thread_Message *msg = new Thread_Message;
+            msg->isQuitMsg = true;
+            PutMsg(msg);
+        }
+        m_initialized = false;
+        return true;
+    }
+
+protected:
+    virtual int Run() {
+        while (1) {
+            if (0 != sem_wait(&m_sem))
+                continue;
+            Thread_Message *msg = NULL;
+            if (m_queue.GetMsg(msg)) {
+                if (msg->isQuitMsg) {
+                    delete msg;
+                    return 0;
+                }
+                Handle(msg);
+                delete msg;
+            }
+        }
+        return 0;
+    }
+
+    virtual void Handle(Thread_Message *msg) = 0;
+};
+
+class BenchMessage : public Thread_Message
+{
+public:
+    /* 种子消息, 处理时投递子消息 */
+    bool seed;
+
+    BenchMessage(bool s = false) : seed(s) {}
+};
+
+template <class Base>
+class CountingHandler : public Base
+{
+public:
+    zcUtils::Atomic<long> handled;
+
+    CountingHandler() : handled(0) {}
+
+protected:
+    void Handle(Thread_Message *msg) {
+        if (((BenchMessage *) msg)->seed) {
+            for (int i = 0; i < FANOUT; i++)
+                this->PutMsg(new BenchMessage);
+        }
+        handled.fetchAdd(1);
+    }
+};
+
+template <class Handler>
+struct ProducerArgs
+{
+    Handler *handler;
+    long count;
+    bool seed;
+};
+
+template <class Handler>
+static void *Producer(void *arg) {
+    ProducerArgs<Handler> *args = (ProducerArgs<Handler> *) arg;
+    for (long i = 0; i < args->count; i++)
+        args->handler->PutMsg(new BenchMessage(args->seed));
+    return NULL;
+}
+
+/* 投递并等待全部处理完, 返回耗时(us) */
+template <class Handler>
+static unsigned long RunCase(Handler &handler, int producers, int workers, long messages, bool seed) {
+    handler.Init();
+    handler.Start(workers);
+
+    vector<pthread_t> ids(producers);
+    vector<ProducerArgs<Handler> > args(producers);
+    unsigned long starttime = util::get_current_time_stamp();
+    for (int i = 0; i < producers; i++) {
+        args[i].handler = &handler;
+        args[i].count = messages / producers;
+        args[i].seed = seed;
+        pthread_create(&ids[i], NULL, Producer<Handler>, &args[i]);
+    }
+    for (int i = 0; i < producers; i++)
+        pthread_join(ids[i], NULL);
+    long expected = (seed ? FANOUT + 1 : 1) * (messages / producers * producers);
+    while (handler.handled.load() < expected)
+        usleep(100);
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    handler.Stop();
+    handler.Join();
+    return costtime;
+}
+
+static void Report(const char *name, long messages, unsigned long costtime) {
+    printf("%-24s messages:%ld cost:%lums rate:%.0f/s\n", name, messages, costtime / 1000,
+           messages * 1000000.0 / (costtime ? costtime : 1));
+}
+
+int main(int argc, char **argv) {
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int workers = argc > 2 ? atoi(argv[2]) : 4;
+    long messages = argc > 3 ? atol(argv[3]) : 2000000;
+    if (producers <= 0 || workers <= 0 || messages < producers) {
+        printf("usage: %s [producers] [workers] [messages]\n", argv[0]);
+        return 1;
+    }
+    printf("producers:%d workers:%d\n", producers, workers);
+
+    {
+        CountingHandler<LegacyMessageHandler> handler;
+        Report("legacy", messages, RunCase(handler, producers, workers, messages, false));
+    }
+    {
+        CountingHandler<MessageHandler> handler;
+        Report("lock-free", messages, RunCase(handler, producers, workers, messages, false));
+    }
+
+    long seeds = messages / (FANOUT + 1);
+    long total = seeds * (FANOUT + 1);
+    {
+        CountingHandler<LegacyMessageHandler> handler;
+        Report("legacy fan-out", total, RunCase(handler, producers, workers, seeds, true));
+    }
+    {
+        CountingHandler<MessageHandler> handler;
+        Report("lock-free fan-out", total, RunCase(handler, producers, workers, seeds, true));
+    }
+    {
+        CountingHandler<MessageHandler> handler;
+        handler.SetLocalQueue(true);
+        Report("lock-free fan-out local", total, RunCase(handler, producers, workers, seeds, true));
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* 连接池取/还连接的吞吐
+* 用法: pool_bench host db user pwd [port] [threads] [connections] [seconds]
+* 分别测共享栈和线程粘滞两种方式, 每次取到连接后不做查询直接归还, 只测连接池本身的开销
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "DbConnectPool.h"
+#include "timeval.h"
+#include "atomic.h"
+
+struct BenchArgs
+{
+    CdbConncetPool *pool;
+    zcUtils::Atomic<int> *stop;
+    unsigned long count;
+    /* 与上次取到的是同一个连接的次数 */
+    unsigned long same;
+};
+
+static void *BenchWorker(void *arg) {
+    BenchArgs *args = (BenchArgs *) arg;
+    Connection *last = NULL;
+    while (0 == args->stop->load()) {
+        Connection *pConn = args->pool->GetConnection();
+        if (NULL == pConn)
+            break;
+        if (pConn == last)
+            ++args->same;
+        last = pConn;
+        args->pool->ReleaseConnection(pConn);
+        ++args->count;
+    }
+    return NULL;
+}
+
+static bool RunBench(const char *name, bool sticky, char **argv, unsigned int port, int threads, int conns, int seconds) {
+    CdbConncetPool pool;
+    pool.Init();
+    pool.SetStickyConnection(sticky);
+    if (!pool.CreateConnectionPool(argv[1], argv[2], argv[3], argv[4], port, conns)) {
+        printf("failed to create connection pool\n");
+        return false;
+    }
+
+    zcUtils::Atomic<int> stop(0);
+    vector<BenchArgs> args(threads);
+    vector<pthread_t> ids(threads);
+    for (int i = 0; i < threads; i++) {
+        args[i].pool = &pool;
+        args[i].stop = &stop;
+        args[i].count = 0;
+        args[i].same = 0;
+    }
+    unsigned long starttime = util::get_current_time_stamp();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, BenchWorker, &args[i]);
+    sleep(seconds);
+    stop.store(1);
+    unsigned long total = 0, same = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        total += args[i].count;
+        same += args[i].same;
+    }
+    unsigned long costtime = util::get_current_time_stamp() - starttime;
+    printf("%-8s threads:%d conns:%d checkouts:%lu rate:%.0f/s avg:%.3fus same_conn:%.1f%%\n",
+           name, threads, conns, total, total * 1000000.0 / costtime, costtime * threads / (double) (total ? total : 1),
+           total ? same * 100.0 / total : 0.0);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        printf("usage: %s host db user pwd [port] [threads] [connections] [seconds]\n", argv[0]);
+        return 1;
+    }
+    unsigned int port = argc > 5 ? atoi(argv[5]) : 3306;
+    int threads = argc > 6 ? atoi(argv[6]) : 8;
+    int conns = argc > 7 ? atoi(argv[7]) : 8;
+    int seconds = argc > 8 ? atoi(argv[8]) : 5;
+
+    if (!RunBench("shared", false, argv, port, threads, conns, seconds))
+        return 1;
+    if (!RunBench("sticky", true, argv, port, threads, conns, seconds))
+        return 1;
+    return 0;
+}
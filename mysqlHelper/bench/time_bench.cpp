@@ -0,0 +1,87 @@
+//
+// Created by Passerby on 2026/10/19.
+//
+
+/*
+* timeval.h 中取时间和格式化时间的开销
+* 用法: time_bench [loops]
+* 每种方式调用 loops 次, 输出每次调用的平均耗时(ns)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timeval.h"
+
+/* 防止循环被优化掉 */
+static volatile unsigned long g_sink;
+
+static void Report(const char *name, long loops, unsigned long long costns) {
+    printf("%-36s %.1fns/call\n", name, (double) costns / loops);
+}
+
+int main(int argc, char **argv) {
+    long loops = argc > 1 ? atol(argv[1]) : 10000000;
+    if (loops <= 0) {
+        printf("usage: %s [loops]\n", argv[0]);
+        return 1;
+    }
+    printf("loops:%ld tsc:%s\n", loops, util::TscClock::available() ? "yes" : "no");
+
+    unsigned long long start = util::TscClock::now();
+    for (long i = 0; i < loops; i++)
+        g_sink += util::get_current_time_stamp();
+    Report("get_current_time_stamp", loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < loops; i++)
+        g_sink += util::get_monotonic_us();
+    Report("get_monotonic_us", loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < loops; i++)
+        g_sink += util::get_coarse_monotonic_ms();
+    Report("get_coarse_monotonic_ms", loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < loops; i++)
+        g_sink += util::get_coarse_time_stamp();
+    Report("get_coarse_time_stamp", loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < loops; i++)
+        g_sink += util::TscClock::now();
+    Report("TscClock::now", loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    /* 格式化的次数少一些, 原来的实现每次都要 localtime_r + strftime */
+    long format_loops = loops / 10 ? loops / 10 : 1;
+    char buf[32];
+    start = util::TscClock::now();
+    for (long i = 0; i < format_loops; i++) {
+        time_t seconds = util::get_current_time_stamp() / 1000000;
+        struct tm _date;
+        localtime_r(&seconds, &_date);
+        g_sink += strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &_date);
+    }
+    Report("localtime_r + strftime", format_loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < format_loops; i++)
+        g_sink += util::format_timestamp(util::get_current_time_stamp(), buf, sizeof(buf));
+    Report("format_timestamp", format_loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < format_loops; i++)
+        g_sink += util::format_timestamp_ms(util::get_current_time_stamp(), buf, sizeof(buf));
+    Report("format_timestamp_ms", format_loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < format_loops; i++)
+        g_sink += util::get_current_time_str().size();
+    Report("get_current_time_str", format_loops, util::TscClock::toNs(util::TscClock::now() - start));
+
+    start = util::TscClock::now();
+    for (long i = 0; i < format_loops; i++)
+        g_sink += util::get_current_time_str_by_format("%Y%m%d%H%M%S").size();
+    Report("get_current_time_str_by_format", format_loops, util::TscClock::toNs(util::TscClock::now() - start));
+    return 0;
+}
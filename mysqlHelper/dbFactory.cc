@@ -3,8 +3,15 @@
 //
 
 #include "dbFactory.h"
+#include "PhoneRegionIndex.h"
 
-#include <sstream>
+#include <set>
+#include <errno.h>
+#include <semaphore.h>
+
+#include "atomic.h"
+#include "singleton.h"
+#include "threadUtil.h"
 
 DB_OPERATOR_RESULT DbFactory::getProviderByPrefix(const string &pre, string &provider, int &count) {
     if (!pre.length())
@@ -15,21 +22,34 @@ DB_OPERATOR_RESULT DbFactory::getProviderByPrefix(const string &pre, string &pro
     provider = "";
     count = 0;
 
-    // get db instance
-    PLMySql mysql_db;
-    MysqlApi::DataBase *new_db = mysql_db.get_db_instance();
-    stringstream select_sql;
-    select_sql << "select isp from phone_number_region where prefix='" << pre << "' group by isp;";
+    // 已加载内存索引时直接查索引
+    {
+        PhoneRegionIndex::Reader index;
+        if (index.valid()) {
+            vector<const char *> isps;
+            count = index->FindIspsByPrefix(pre, isps);
+            if (0 == count)
+                return DB_OPERATOR_RESULT_NO_RESULT;
+            provider = isps[0];
+            return DB_OPERATOR_RESULT_OK;
+        }
+    }
 
-    MysqlApi::RecordSet rs(new_db->GetMysql());
-    int retCount = rs.ExecuteSQL(select_sql.str());
+    // 使用连接上缓存的预处理语句
+    PLMySql mysql_db(DB_ROUTE_READ);
+    MysqlApi::Statement *stmt = mysql_db.get_statement("select isp from phone_number_region where prefix=? group by isp");
+    if (NULL == stmt)
+        return DB_OPERATOR_RESULT_FATAL_ERROR;
+    stmt->BindParam(0, pre);
+
+    long retCount = stmt->Execute();
     if (-1 == retCount)
         return DB_OPERATOR_RESULT_FATAL_ERROR;
-    else if (0 == retCount)
+    else if (0 == retCount || !stmt->Fetch())
         return DB_OPERATOR_RESULT_NO_RESULT;
 
-    provider = rs.GetCurrentFieldValue(0);
-    count = retCount;
+    stmt->GetString(0, provider);
+    count = (int) retCount;
 
     return DB_OPERATOR_RESULT_OK;
 }
@@ -40,24 +60,44 @@ DB_OPERATOR_RESULT DbFactory::getProviderByPhone(const string &phone, string &pr
 
     provider = "";
 
-    // get db instance
-    PLMySql mysql_db;
-    MysqlApi::DataBase *new_db = mysql_db.get_db_instance();
-    stringstream select_sql;
-    select_sql << "select isp from phone_number_region where phone='" << phone << "';";
+    // 已加载内存索引时直接查索引, 非7位号段仍走数据库
+    {
+        PhoneRegionIndex::Reader index;
+        const PhoneRegionIndex::Region *region = NULL;
+        if (index.valid()) {
+            switch (index->Find(phone, region)) {
+                case PhoneRegionIndex::FOUND:
+                    provider = region->isp;
+                    return DB_OPERATOR_RESULT_OK;
+                case PhoneRegionIndex::NOT_FOUND:
+                    return DB_OPERATOR_RESULT_NO_RESULT;
+                case PhoneRegionIndex::NOT_UNIQUE:
+                    cout << "getProviderByPhone::phone=" << phone << "结果不唯一" << endl;
+                    return DB_OPERATOR_RESULT_FATAL_ERROR;
+                default:
+                    break;
+            }
+        }
+    }
 
-    MysqlApi::RecordSet rs(new_db->GetMysql());
-    int retCount = rs.ExecuteSQL(select_sql.str());
+    // 使用连接上缓存的预处理语句
+    PLMySql mysql_db(DB_ROUTE_READ);
+    MysqlApi::Statement *stmt = mysql_db.get_statement("select isp from phone_number_region where phone=?");
+    if (NULL == stmt)
+        return DB_OPERATOR_RESULT_FATAL_ERROR;
+    stmt->BindParam(0, phone);
+
+    long retCount = stmt->Execute();
     if (-1 == retCount)
         return DB_OPERATOR_RESULT_FATAL_ERROR;
-    else if (0 == retCount)
+    else if (0 == retCount || !stmt->Fetch())
         return DB_OPERATOR_RESULT_NO_RESULT;
     else if (1 != retCount) {
         cout << "getProviderByPhone::phone=" << phone << "结果不唯一:" << retCount << endl;
         return DB_OPERATOR_RESULT_FATAL_ERROR;
     }
 
-    provider = rs.GetCurrentFieldValue(0);
+    stmt->GetString(0, provider);
     return DB_OPERATOR_RESULT_OK;
 }
 
@@ -68,24 +108,222 @@ DB_OPERATOR_RESULT DbFactory::getRegionByPhone(const string &phone, string &prov
     province = "";
     city = "";
 
-    // get db instance
-    PLMySql mysql_db;
-    MysqlApi::DataBase *new_db = mysql_db.get_db_instance();
-    stringstream select_sql;
-    select_sql << "select province,city from phone_number_region where phone='" << phone << "';";
+    // 已加载内存索引时直接查索引, 非7位号段仍走数据库
+    {
+        PhoneRegionIndex::Reader index;
+        const PhoneRegionIndex::Region *region = NULL;
+        if (index.valid()) {
+            switch (index->Find(phone, region)) {
+                case PhoneRegionIndex::FOUND:
+                    province = region->province;
+                    city = region->city;
+                    return DB_OPERATOR_RESULT_OK;
+                case PhoneRegionIndex::NOT_FOUND:
+                    return DB_OPERATOR_RESULT_NO_RESULT;
+                case PhoneRegionIndex::NOT_UNIQUE:
+                    cout << "getRegionByPhone::phone=" << phone << "结果不唯一" << endl;
+                    return DB_OPERATOR_RESULT_FATAL_ERROR;
+                default:
+                    break;
+            }
+        }
+    }
 
-    MysqlApi::RecordSet rs(new_db->GetMysql());
-    int retCount = rs.ExecuteSQL(select_sql.str());
+    // 使用连接上缓存的预处理语句
+    PLMySql mysql_db(DB_ROUTE_READ);
+    MysqlApi::Statement *stmt = mysql_db.get_statement("select province,city from phone_number_region where phone=?");
+    if (NULL == stmt)
+        return DB_OPERATOR_RESULT_FATAL_ERROR;
+    stmt->BindParam(0, phone);
+
+    long retCount = stmt->Execute();
     if (-1 == retCount)
         return DB_OPERATOR_RESULT_FATAL_ERROR;
-    else if (0 == retCount)
+    else if (0 == retCount || !stmt->Fetch())
         return DB_OPERATOR_RESULT_NO_RESULT;
     else if (1 != retCount) {
         cout << "getRegionByPhone::phone=" << phone << "结果不唯一:" << retCount << endl;
         return DB_OPERATOR_RESULT_FATAL_ERROR;
     }
 
-    province = rs.GetCurrentFieldValue(0);
-    city = rs.GetCurrentFieldValue(1);
+    stmt->GetString(0, province);
+    stmt->GetString(1, city);
     return DB_OPERATOR_RESULT_OK;
-}
\ No newline at end of file
+}
+
+/*
+ * 批量查询的共享状态，每组的结果单独存放，全部完成后再合并
+ */
+struct PhoneBatchJob {
+    vector<vector<string> > chunks;
+    vector<map<string, PhoneRegionInfo> > results;
+    vector<char> failed;
+    zcUtils::Atomic<unsigned int> next;
+    /* 每个协助的线程做完后 post 一次 */
+    sem_t helpers_done;
+
+    PhoneBatchJob() : next(0) {
+        sem_init(&helpers_done, 0, 0);
+    }
+
+    ~PhoneBatchJob() {
+        sem_destroy(&helpers_done);
+    }
+};
+
+// 查询一组号段，结果不唯一的号段会被剔除
+static bool queryPhoneChunk(const vector<string> &phones, map<string, PhoneRegionInfo> &regions) {
+    PLMySql mysql_db(DB_ROUTE_READ);
+    MysqlApi::DataBase *new_db = mysql_db.get_db_instance();
+    if (NULL == new_db)
+        return false;
+
+    string select_sql = "select phone,province,city,isp from phone_number_region where phone in (";
+    vector<char> escaped;
+    for (unsigned int i = 0; i < phones.size(); i++) {
+        escaped.resize(phones[i].length() * 2 + 1);
+        unsigned long n = new_db->EscapeString(&escaped[0], phones[i].data(), phones[i].length());
+        if (i > 0)
+            select_sql += ',';
+        select_sql += '\'';
+        select_sql.append(&escaped[0], n);
+        select_sql += '\'';
+    }
+    select_sql += ");";
+
+    MysqlApi::ResultView rs(new_db);
+    if (-1 == rs.ExecuteSQL(select_sql))
+        return false;
+
+    set<string> duplicated;
+    while (rs.Fetch()) {
+        string phone = rs[0].ToString();
+        if (regions.count(phone)) {
+            duplicated.insert(phone);
+            continue;
+        }
+        PhoneRegionInfo &info = regions[phone];
+        rs[1].AssignTo(info.province);
+        rs[2].AssignTo(info.city);
+        rs[3].AssignTo(info.isp);
+    }
+    for (set<string>::iterator it = duplicated.begin(); it != duplicated.end(); ++it) {
+        cout << "getRegionByPhones::phone=" << *it << "结果不唯一" << endl;
+        regions.erase(*it);
+    }
+    return true;
+}
+
+// 逐个领取未查询的组
+static void runPhoneBatch(PhoneBatchJob *job) {
+    while (true) {
+        unsigned int index = job->next.fetchAdd(1);
+        if (index >= job->chunks.size())
+            break;
+        job->failed[index] = !queryPhoneChunk(job->chunks[index], job->results[index]);
+    }
+}
+
+struct PhoneBatchMessage : public Thread_Message {
+    PhoneBatchJob *job;
+};
+
+/*
+ * 批量查询的常驻线程, 与调用线程一起领取各组, 避免每次查询都创建线程
+ * 第一次用到时启动 BATCH_PARALLEL - 1 个线程, 随进程存在
+ */
+class PhoneBatchPool : public MessageHandler {
+public:
+    PhoneBatchPool() : m_running(false) {
+        m_running = Init() && Start(DbFactory::BATCH_PARALLEL - 1);
+        if (!m_running)
+            cout << "PhoneBatchPool failed to start, batch queries run in the calling thread." << endl;
+    }
+
+    // 投递成功返回 true, 处理完后 post job->helpers_done
+    bool Help(PhoneBatchJob *job) {
+        if (!m_running)
+            return false;
+        PhoneBatchMessage *msg = new PhoneBatchMessage;
+        msg->job = job;
+        if (!PutMsg(msg)) {
+            delete msg;
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    void Handle(Thread_Message *msg) {
+        PhoneBatchJob *job = ((PhoneBatchMessage *) msg)->job;
+        runPhoneBatch(job);
+        sem_post(&job->helpers_done);
+    }
+
+private:
+    bool m_running;
+};
+
+DB_OPERATOR_RESULT DbFactory::getRegionByPhones(const vector<string> &phones, map<string, PhoneRegionInfo> &regions) {
+    if (phones.empty())
+        return DB_OPERATOR_RESULT_PARAM_ERROR;
+
+    regions.clear();
+    set<string> unique_phones(phones.begin(), phones.end());
+
+    // 已加载内存索引时直接查索引，非7位号段仍走数据库
+    vector<string> remain;
+    {
+        PhoneRegionIndex::Reader index;
+        for (set<string>::iterator it = unique_phones.begin(); it != unique_phones.end(); ++it) {
+            const PhoneRegionIndex::Region *region = NULL;
+            PhoneRegionIndex::FindResult found = index.valid() ? index->Find(*it, region) : PhoneRegionIndex::BAD_PHONE;
+            if (PhoneRegionIndex::FOUND == found) {
+                PhoneRegionInfo &info = regions[*it];
+                info.province = region->province;
+                info.city = region->city;
+                info.isp = region->isp;
+            } else if (PhoneRegionIndex::BAD_PHONE == found)
+                remain.push_back(*it);
+        }
+    }
+    if (remain.empty())
+        return DB_OPERATOR_RESULT_OK;
+
+    PhoneBatchJob job;
+    for (unsigned int i = 0; i < remain.size(); i += BATCH_SIZE) {
+        unsigned int end = i + BATCH_SIZE < remain.size() ? i + BATCH_SIZE : remain.size();
+        job.chunks.push_back(vector<string>(remain.begin() + i, remain.begin() + end));
+    }
+    job.results.resize(job.chunks.size());
+    job.failed.resize(job.chunks.size(), 0);
+
+    // 只有一组时在当前线程查询
+    unsigned int thread_num = job.chunks.size() < BATCH_PARALLEL ? job.chunks.size() : BATCH_PARALLEL;
+    unsigned int helpers = 0;
+    for (unsigned int i = 1; i < thread_num; i++) {
+        if (zcUtils::Singleton<PhoneBatchPool>::instance().Help(&job))
+            ++helpers;
+    }
+    runPhoneBatch(&job);
+    // 协助的线程可能还在查最后一组, job 在栈上, 等它们都做完
+    for (unsigned int i = 0; i < helpers; i++) {
+        while (sem_wait(&job.helpers_done) != 0 && EINTR == errno) {}
+    }
+
+    bool failed = false;
+    for (unsigned int i = 0; i < job.chunks.size(); i++) {
+        failed = failed || job.failed[i];
+        regions.insert(job.results[i].begin(), job.results[i].end());
+    }
+    return failed ? DB_OPERATOR_RESULT_FATAL_ERROR : DB_OPERATOR_RESULT_OK;
+}
+
+DB_OPERATOR_RESULT DbFactory::getProviderByPhones(const vector<string> &phones, map<string, string> &providers) {
+    map<string, PhoneRegionInfo> regions;
+    DB_OPERATOR_RESULT ret = getRegionByPhones(phones, regions);
+    providers.clear();
+    for (map<string, PhoneRegionInfo>::iterator it = regions.begin(); it != regions.end(); ++it)
+        providers[it->first] = it->second.isp;
+    return ret;
+}
@@ -5,7 +5,9 @@
 #ifndef MAGIC_CUBE_DBFACTORY_H
 #define MAGIC_CUBE_DBFACTORY_H
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "mysqlMgr.h"
 
@@ -34,6 +36,18 @@ static string dbResultToString(DB_OPERATOR_RESULT db_rst)
     return "Unknown db result!";
 }
 
+/*
+ * 号段对应的地区和运营商
+ */
+struct PhoneRegionInfo {
+    string province;
+    string city;
+    string isp;
+};
+
+/*
+ * 号段相关的查询在 PhoneRegionIndex::Start 之后走内存索引, 否则查数据库
+ */
 class DbFactory {
 public:
     /*
@@ -53,6 +67,23 @@ public:
      * 通过手机号前7位获取省市，手机号前七位是唯一的
      */
     static DB_OPERATOR_RESULT getRegionByPhone(const string &phone, string &province, string &city);
+
+    /*
+     * 批量获取多个号段的地区和运营商
+     * phones:号段，可以重复
+     * regions:以号段为键的结果，查不到或结果不唯一的号段不在其中
+     * 号段按 BATCH_SIZE 个一组用 in (...) 查询，各组在最多 BATCH_PARALLEL 个连接上并行执行
+     * 任一组查询失败返回 DB_OPERATOR_RESULT_FATAL_ERROR，已查到的结果仍保留
+     */
+    static DB_OPERATOR_RESULT getRegionByPhones(const vector<string> &phones, map<string, PhoneRegionInfo> &regions);
+
+    /*
+     * 批量获取多个号段的运营商，规则同 getRegionByPhones
+     */
+    static DB_OPERATOR_RESULT getProviderByPhones(const vector<string> &phones, map<string, string> &providers);
+
+    static const unsigned int BATCH_SIZE = 500;
+    static const unsigned int BATCH_PARALLEL = 4;
 };
 
 #endif //MAGIC_CUBE_DBFACTORY_H
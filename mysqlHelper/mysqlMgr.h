@@ -4,21 +4,34 @@
 #include <string>
 #include "singleton.h"
 #include "DbConnectPool.h"
+#include "DbRoutedPool.h"
 #include "MysqlApi.h"
 
 using namespace zcUtils;
 
+/*
+* 取一个连接, 析构时归还
+* 多节点连接池(Singleton<CdbRoutedPool>)启动后经由它按 route 选择节点, 否则用单节点连接池
+*/
 class PLMySql
 {
 private:
     CdbConncetPool &pool;
+    CdbRoutedPool *router;
     Connection *conn;
 
 public:
-    PLMySql()
+    PLMySql(DB_ROUTE route = DB_ROUTE_WRITE)
         : pool(Singleton<CdbConncetPool>::instance()),
+          router(NULL),
           conn(NULL)
     {
+        CdbRoutedPool &routed = Singleton<CdbRoutedPool>::instance();
+        if (routed.IsStarted()) {
+            router = &routed;
+            conn = router->GetConnection(route);
+            return;
+        }
         //try
         //{
         conn = pool.GetConnection();
@@ -31,7 +44,10 @@ public:
     {
         //try
         //{
-        pool.ReleaseConnection(conn);
+        if (router)
+            router->ReleaseConnection(conn);
+        else
+            pool.ReleaseConnection(conn);
         conn = NULL;
         //}
         //catch(...)
@@ -44,5 +60,12 @@ public:
             return &conn->hDB;
         return NULL;
     }
+    /* 取该连接上缓存的预处理语句, 不存在则预处理, 失败返回NULL */
+    MysqlApi::Statement *get_statement(const std::string &sql)
+    {
+        if (conn)
+            return conn->stmts.Get(conn->hDB, sql);
+        return NULL;
+    }
 };
 #endif
\ No newline at end of file
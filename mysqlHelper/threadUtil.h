@@ -7,6 +7,10 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <vector>
+
+#include "atomic.h"
+#include "mpmc_queue.h"
 
 using namespace std;
 
@@ -53,37 +57,24 @@ public:
 class atomic_Int
 {
 private:
-	pthread_mutex_t m_lock;
-	int m_num;
+	zcUtils::Atomic<int> m_num;
 
 public:
-	atomic_Int() : m_num(0)
-	{
-		pthread_mutex_init(&m_lock, NULL);
-	}
-	atomic_Int(int num) : m_num(num)
-	{
-		pthread_mutex_init(&m_lock, NULL);
-	}
-	~atomic_Int()
-	{
-		pthread_mutex_destroy(&m_lock);
-	}
+	atomic_Int() : m_num(0) {}
+	atomic_Int(int num) : m_num(num) {}
+
 	int atomic_set(int num)
 	{
-		autoLock al(m_lock);
-		m_num = num;
-		return m_num;
+		m_num.store(num);
+		return num;
 	}
 	int atomic_inc()
 	{
-		autoLock al(m_lock);
-		return ++m_num;
+		return m_num.addFetch(1);
 	}
 	int atomic_dec()
 	{
-		autoLock al(m_lock);
-		return --m_num;
+		return m_num.subFetch(1);
 	}
 };
 
@@ -195,6 +186,8 @@ public:
 			if (0 != err)
 			{
 				printf("ThreadPool::Start Error: failed to create thread.\n");
+				//只记录已创建的线程, Join 不会等待无效的 id
+				m_num = i;
 				return false;
 			}
 		}
@@ -219,134 +212,313 @@ public:
 class Thread_Message
 {
 public:
+	/* 兼容旧用法: 取到退出消息的线程退出. Stop 不再投递它 */
 	bool isQuitMsg;
 	Thread_Message() : isQuitMsg(false) {}
 	virtual ~Thread_Message() {}
 };
 
+/*
+* 消息处理线程池
+* 1 消息放在无锁的有界 MPMC 队列中. 队列满时放入加锁的溢出队列, 所以 PutMsg 不会因队列满而失败
+* 2 工作线程一次取一批(SetBatchSize), 然后逐条 Handle, 处理完 delete
+* 3 开启 SetLocalQueue 后, 工作线程在 Handle 中 PutMsg 的消息放入本线程的队列, 优先由本线程处理;
+*   其他线程没有消息时从中窃取
+* 4 空闲线程先自旋, 再在条件变量上等待. 只有存在等待的线程时, PutMsg 才加锁唤醒
+* 5 Stop 不投递退出消息: 只置停止标志并唤醒所有线程. 各线程处理完已投递的消息后调用 PreQuit 退出
+*/
 class MessageHandler : public ThreadPool
 {
 private:
-	bool m_initialized;
-	SafeQueue<Thread_Message *> m_queue;
-	sem_t m_sem;
+	/* 工作线程所属的 MessageHandler 和序号 */
+	struct WorkerSlot
+	{
+		MessageHandler *owner;
+		int index;
+	};
+
+	/* 空闲时自旋检查的次数 */
+	static const int SPIN_COUNT = 128;
+
+	zcUtils::Atomic<int> m_initialized;
+	zcUtils::Atomic<int> m_stopping;
 	atomic_Int running_num;
+	zcUtils::Atomic<int> m_started;
+	/* 在条件变量上等待的线程数 */
+	zcUtils::Atomic<int> m_idle;
+	/* 溢出队列中的消息数 */
+	zcUtils::Atomic<int> m_overflow_num;
+
+	unsigned int m_capacity;
+	unsigned int m_batch;
+	bool m_local;
+
+	zcUtils::MpmcQueue<Thread_Message *> *m_queue;
+	vector<zcUtils::MpmcQueue<Thread_Message *> *> m_locals;
+	SafeQueue<Thread_Message *> m_overflow;
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_cond;
+
+	/* Don't need copy or assignment */
+	MessageHandler(const MessageHandler &);
+	MessageHandler &operator=(const MessageHandler &);
+
+	static WorkerSlot &CurrentWorker()
+	{
+		static __thread WorkerSlot slot;
+		return slot;
+	}
+
+	void Wake()
+	{
+		zcUtils::memoryFence();
+		if (m_idle.load() > 0)
+		{
+			autoLock al(m_lock);
+			pthread_cond_signal(&m_cond);
+		}
+	}
+
+	void Enqueue(Thread_Message *msg)
+	{
+		if (!m_queue->push(msg))
+		{
+			m_overflow.PutMsg(msg);
+			m_overflow_num.fetchAdd(1);
+		}
+	}
+
+	bool HasWork()
+	{
+		if (!m_queue->empty() || m_overflow_num.load() > 0)
+			return true;
+		for (unsigned int i = 0; i < m_locals.size(); i++)
+		{
+			if (!m_locals[i]->empty())
+				return true;
+		}
+		return false;
+	}
+
+	/* 依次取本线程队列, 公共队列, 溢出队列, 最后从其他线程窃取一半 */
+	unsigned int TakeBatch(int index, Thread_Message **msgs)
+	{
+		unsigned int n = 0;
+		if (m_local && (n = m_locals[index]->popBatch(msgs, m_batch)) > 0)
+			return n;
+		if ((n = m_queue->popBatch(msgs, m_batch)) > 0)
+			return n;
+		if (m_overflow_num.load() > 0)
+		{
+			while (n < m_batch && m_overflow.GetMsg(msgs[n]))
+			{
+				m_overflow_num.fetchSub(1);
+				++n;
+			}
+			if (n > 0)
+				return n;
+		}
+		if (m_local)
+		{
+			unsigned int steal = m_batch > 1 ? m_batch / 2 : 1;
+			for (unsigned int k = 1; k < m_locals.size(); k++)
+			{
+				if ((n = m_locals[(index + k) % m_locals.size()]->popBatch(msgs, steal)) > 0)
+					return n;
+			}
+		}
+		return 0;
+	}
+
+	/* 等待新消息, 停止且没有消息时返回false */
+	bool WaitForWork()
+	{
+		for (int i = 0; i < SPIN_COUNT; i++)
+		{
+			if (HasWork())
+				return true;
+			zcUtils::cpuRelax();
+		}
+		autoLock al(m_lock);
+		m_idle.fetchAdd(1);
+		zcUtils::memoryFence();
+		while (!HasWork() && !m_stopping.load())
+			pthread_cond_wait(&m_cond, &m_lock);
+		m_idle.fetchSub(1);
+		return !m_stopping.load() || HasWork();
+	}
+
+	void DeleteAll()
+	{
+		Thread_Message *msg = NULL;
+		while (m_queue->pop(msg))
+			delete msg;
+		while (m_overflow.GetMsg(msg))
+		{
+			m_overflow_num.fetchSub(1);
+			delete msg;
+		}
+		for (unsigned int i = 0; i < m_locals.size(); i++)
+		{
+			while (m_locals[i]->pop(msg))
+				delete msg;
+		}
+	}
 
 public:
-	MessageHandler() : m_initialized(false), running_num(0) {}
+	MessageHandler()
+		: m_initialized(0), m_stopping(0), running_num(0), m_started(0), m_idle(0), m_overflow_num(0),
+		  m_capacity(65536), m_batch(32), m_local(false), m_queue(NULL)
+	{
+		pthread_mutex_init(&m_lock, NULL);
+		pthread_cond_init(&m_cond, NULL);
+	}
 	~MessageHandler()
 	{
-		sem_destroy(&m_sem);
+		if (m_queue)
+			DeleteAll();
+		delete m_queue;
+		for (unsigned int i = 0; i < m_locals.size(); i++)
+			delete m_locals[i];
+		pthread_cond_destroy(&m_cond);
+		pthread_mutex_destroy(&m_lock);
+	}
+
+	/* 每次最多取出的消息数, 在 Start 前设置 */
+	void SetBatchSize(unsigned int batch)
+	{
+		m_batch = batch > 0 ? batch : 1;
+	}
+
+	/* 是否为每个工作线程建本地队列, 在 Start 前设置 */
+	void SetLocalQueue(bool local)
+	{
+		m_local = local;
 	}
 
 	bool PutMsg(Thread_Message *msg)
 	{
-		if (!m_initialized)
+		if (!m_initialized.load())
 			return false;
 
-		//put message into the queue, and signal semaphore
-		m_queue.PutMsg(msg);
-		int err = sem_post(&m_sem);
-		if (0 != err)
-		{
-			printf("MessageHandler::PutMsg Error: failed to do sem_post.\n");
-			return false;
-		}
+		WorkerSlot &slot = CurrentWorker();
+		if (!(m_local && this == slot.owner && m_locals[slot.index]->push(msg)))
+			Enqueue(msg);
+		Wake();
 		return true;
 	}
 
-	bool Init()
+	/* capacity 为无锁队列的容量, 超出的消息进溢出队列 */
+	bool Init(unsigned int capacity = 65536)
 	{
-		if (m_initialized)
+		if (m_initialized.load())
 			return false;
 
-		int err = sem_init(&m_sem, 0, 0);
-		if (0 != err)
+		if (NULL == m_queue)
 		{
-			printf("MessageHandler::Init Error: failed to do sem_init.\n");
-			return false;
+			m_capacity = capacity;
+			m_queue = new zcUtils::MpmcQueue<Thread_Message *>(capacity);
 		}
-
-		m_initialized = true;
+		m_stopping.store(0);
+		m_initialized.store(1);
 		return true;
 	}
 
 	virtual bool Start(int num = 3)
 	{
-		if (!ThreadPool::Start(num))
+		if (NULL == m_queue || num < 1)
 			return false;
-		running_num.atomic_set(m_num);
-		return true;
+		if (m_local)
+		{
+			for (int i = (int) m_locals.size(); i < num; i++)
+				m_locals.push_back(new zcUtils::MpmcQueue<Thread_Message *>(m_capacity));
+		}
+		m_started.store(0);
+		//先按 num 计数, 已创建的线程可能在 Start 返回前就退出
+		running_num.atomic_set(num);
+		if (ThreadPool::Start(num))
+			return true;
+
+		//减去没创建成功的线程, 否则计数到不了 0, 剩余的消息不会被删除
+		for (int i = m_num; i < num; i++)
+		{
+			if (0 == running_num.atomic_dec())
+				DeleteAll();
+		}
+		return false;
 	}
 
 	bool Stop()
 	{
-		if (!m_initialized)
+		if (!m_initialized.load())
 			return false;
 
-		for (int i = 0; i < m_num; i++)
-		{
-			Thread_Message *msg = new Thread_Message;
-			msg->isQuitMsg = true;
-			PutMsg(msg);
-		}
-		m_initialized = false;
+		m_initialized.store(0);
+		m_stopping.store(1);
+		autoLock al(m_lock);
+		pthread_cond_broadcast(&m_cond);
 		return true;
 	}
 
 	bool isInitialized()
 	{
-		return m_initialized;
+		return m_initialized.load() != 0;
 	}
 
 protected:
 	virtual int Run()
 	{
-		if (!m_initialized)
+		if (NULL == m_queue)
 			return -1;
 
-		while (1)
+		int index = m_started.fetchAdd(1);
+		WorkerSlot &slot = CurrentWorker();
+		slot.owner = this;
+		slot.index = index;
+
+		vector<Thread_Message *> msgs(m_batch);
+		bool quit = false;
+		while (!quit)
 		{
-			int err = sem_wait(&m_sem);
-			if (0 != err)
+			unsigned int n = TakeBatch(index, &msgs[0]);
+			if (0 == n)
 			{
-				if (EINTR == errno)
-					continue;
-
-				printf("MessageHandler::Run Error: failed to do sem_wait.\n");
-				return -1;
+				if (!WaitForWork())
+					break;
+				continue;
 			}
+			//取满一批说明还有积压, 叫醒一个空闲线程分担
+			if (n == m_batch)
+				Wake();
 
-			Thread_Message *msg = NULL;
-			if (m_queue.GetMsg(msg))
+			for (unsigned int i = 0; i < n; i++)
 			{
+				Thread_Message *msg = msgs[i];
 				if (msg->isQuitMsg)
 				{
-					PreQuit();
-					return 0;
-				}
-				else
-				{
-					Handle(msg);
+					//本批余下的消息还给公共队列
+					for (unsigned int k = i + 1; k < n; k++)
+						Enqueue(msgs[k]);
+					Wake();
+					delete msg;
+					quit = true;
+					break;
 				}
+				Handle(msg);
 				delete msg;
 			}
 		}
 
+		slot.owner = NULL;
+		PreQuit();
 		return 0;
 	}
 
 	virtual void PreQuit()
 	{
+		//最后一个退出的线程删除剩余的消息
 		if (0 == running_num.atomic_dec())
-		{
-			//delete all messages in the queue
-			Thread_Message *msg = NULL;
-			while (m_queue.GetMsg(msg))
-			{
-				delete msg;
-			}
-		}
+			DeleteAll();
 	}
 
 	//to be overrided by subclass
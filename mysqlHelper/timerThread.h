@@ -11,6 +11,7 @@
 #include "threadUtil.h"
 #include <stdio.h>
 #include <signal.h>
+#include <unistd.h>
 
 class TimerHandler
 {
@@ -20,7 +21,7 @@ public:
 	virtual void HandleTimer() = 0;
 };
 
-class Timer : public Thread
+class Timer : public ThreadPool
 {
 protected:
 	unsigned int m_Interval;
@@ -33,7 +34,6 @@ protected:
 #ifdef _DEBUG
 		printf("=Timer= INFO: timer thread starts.\n");
 #endif
-		m_Running = true;
 		while (m_Running)
 		{
 			for (unsigned int i = 0; i < m_Interval; i++)
@@ -59,6 +59,13 @@ public:
 	Timer(unsigned int seconds = 1) : m_Interval(seconds), m_Running(false), m_TimerHandler(NULL) {}
 	~Timer() {}
 
+	/* 定时器只需要一个线程 */
+	virtual bool Start(int /* num */ = 1)
+	{
+		m_Running = true;
+		return ThreadPool::Start(1);
+	}
+
 	virtual bool Stop()
 	{
 		m_Running = false;
@@ -72,7 +79,7 @@ public:
 
 	bool SetInterval(unsigned int interval)
 	{
-		if (0 == m_Interval)
+		if (0 == interval)
 			return false;
 
 		m_Interval = interval;
@@ -9,10 +9,14 @@
 /*----------------------------- Dependencies -------------------------------*/
 
 #include <sys/time.h>
+#include <time.h>
 #include <sstream>
 #include <iomanip>
 #include <string.h>
 #include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 /*--------------------------------------------------------------------------*/
 
@@ -191,28 +195,227 @@ static unsigned long get_current_time_stamp()
     gettimeofday(&now, NULL);
     return (1000000 * now.tv_sec + now.tv_usec);
 }
+
+#ifdef CLOCK_MONOTONIC_COARSE
+#define UTIL_CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC_COARSE
+#define UTIL_CLOCK_REALTIME_COARSE CLOCK_REALTIME_COARSE
+#else
+#define UTIL_CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC
+#define UTIL_CLOCK_REALTIME_COARSE CLOCK_REALTIME
+#endif
+
+//monotonic time in micro-seconds, not affected by changes of the system time, use it for intervals
+inline unsigned long get_monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+//coarse monotonic time in milli-seconds, resolution is one kernel tick (1-4ms) but reading it is much cheaper
+inline unsigned long get_coarse_monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(UTIL_CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+//same as get_current_time_stamp() with the resolution of one kernel tick
+inline unsigned long get_coarse_time_stamp()
+{
+    struct timespec ts;
+    clock_gettime(UTIL_CLOCK_REALTIME_COARSE, &ts);
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+/*!
+ * \class TscClock
+ * \brief Nano-second interval clock reading the cpu time stamp counter.
+ *        Calibrated against CLOCK_MONOTONIC on first use (about 10ms), and only used
+ *        when the cpu reports an invariant TSC; otherwise it falls back to CLOCK_MONOTONIC.
+ *        Ticks are only meaningful as differences within one process.
+ */
+class TscClock
+{
+public:
+    /* whether the TSC is used */
+    static bool available() { return params().ns_per_tick > 0; }
+
+    /* raw ticks, nano-seconds when the TSC is not available */
+    static unsigned long long now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (params().ns_per_tick > 0)
+            return __builtin_ia32_rdtsc();
+#endif
+        return monotonicNs();
+    }
+
+    static unsigned long long toNs(unsigned long long ticks)
+    {
+        double ns_per_tick = params().ns_per_tick;
+        return ns_per_tick > 0 ? (unsigned long long) (ticks * ns_per_tick) : ticks;
+    }
+
+    static unsigned long long nowNs() { return toNs(now()); }
+
+private:
+    struct Params
+    {
+        double ns_per_tick;
+    };
+
+    static unsigned long long monotonicNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    static Params calibrate()
+    {
+        Params p;
+        p.ns_per_tick = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        //invariant TSC: CPUID.80000007H:EDX[8]
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8)))
+            return p;
+        unsigned long long t0 = monotonicNs();
+        unsigned long long c0 = __builtin_ia32_rdtsc();
+        unsigned long long t1;
+        do
+            t1 = monotonicNs();
+        while (t1 - t0 < 10000000ULL);
+        unsigned long long c1 = __builtin_ia32_rdtsc();
+        if (c1 > c0)
+            p.ns_per_tick = (double) (t1 - t0) / (double) (c1 - c0);
+#endif
+        return p;
+    }
+
+    static const Params &params()
+    {
+        static const Params p = calibrate();
+        return p;
+    }
+};
+
+/*
+ * per-thread local time of the current minute; timestamps in the same minute
+ * only rewrite the seconds, so localtime_r runs about once a minute per thread
+ */
+struct LocalTimeCache
+{
+    bool valid;
+    time_t minute;
+    char text[20];
+};
+
+inline void format_two_digits(char *p, int v)
+{
+    p[0] = (char) ('0' + v / 10);
+    p[1] = (char) ('0' + v % 10);
+}
+
+//format timestamp(us) as "YYYY-MM-DD HH:MM:SS" into buf (at least 20 bytes), return the length written
+inline size_t format_timestamp(unsigned long timestamp, char *buf, size_t size)
+{
+    static __thread LocalTimeCache cache;
+    if (size < 20)
+    {
+        if (size > 0)
+            buf[0] = '\0';
+        return 0;
+    }
+    time_t seconds = timestamp / 1000000;
+    if (!cache.valid || seconds < cache.minute || seconds >= cache.minute + 60)
+    {
+        struct tm _date;
+        localtime_r(&seconds, &_date);
+        int year = _date.tm_year + 1900;
+        //out of four digits or a leap second, not cached
+        if (year < 0 || year > 9999 || _date.tm_sec > 59)
+        {
+            cache.valid = false;
+            return strftime(buf, size, "%Y-%m-%d %H:%M:%S", &_date);
+        }
+        format_two_digits(cache.text, year / 100);
+        format_two_digits(cache.text + 2, year % 100);
+        cache.text[4] = '-';
+        format_two_digits(cache.text + 5, _date.tm_mon + 1);
+        cache.text[7] = '-';
+        format_two_digits(cache.text + 8, _date.tm_mday);
+        cache.text[10] = ' ';
+        format_two_digits(cache.text + 11, _date.tm_hour);
+        cache.text[13] = ':';
+        format_two_digits(cache.text + 14, _date.tm_min);
+        cache.text[16] = ':';
+        cache.minute = seconds - _date.tm_sec;
+        cache.valid = true;
+    }
+    memcpy(buf, cache.text, 17);
+    format_two_digits(buf + 17, (int) (seconds - cache.minute));
+    buf[19] = '\0';
+    return 19;
+}
+
+//format timestamp(us) as "YYYY-MM-DD HH:MM:SS.mmm" into buf (at least 24 bytes), return the length written
+inline size_t format_timestamp_ms(unsigned long timestamp, char *buf, size_t size)
+{
+    size_t n = format_timestamp(timestamp, buf, size);
+    if (19 != n || size < 24)
+        return n;
+    int ms = (int) (timestamp / 1000 % 1000);
+    buf[19] = '.';
+    buf[20] = (char) ('0' + ms / 100);
+    format_two_digits(buf + 21, ms % 100);
+    buf[23] = '\0';
+    return 23;
+}
+
 //convert timestamp to string
 static std::string convert_timestamp_to_str(unsigned long timestamp)
 {
-    //get current date
     char return_time[30];
-    struct tm _date;
-    time_t seconds = timestamp / 1000000;
-    localtime_r(&seconds, &_date);
-    memset(return_time, 0, sizeof(return_time));
-    strftime(return_time, sizeof(return_time) - 1, "%Y-%m-%d %H:%M:%S", &_date);
-    return return_time;
+    size_t n = format_timestamp(timestamp, return_time, sizeof(return_time));
+    return std::string(return_time, n);
 }
 
+/*
+ * per-thread result of the last second and format; formats that do not fit
+ * are formatted every time
+ */
+struct FormatTimeCache
+{
+    bool valid;
+    time_t second;
+    char format[64];
+    char text[50];
+};
+
 static std::string convert_timestamp_to_str_by_format(unsigned long timestamp, const char *timeformat)
 {
+    static __thread FormatTimeCache cache;
+    time_t seconds = timestamp / 1000000;
+    size_t format_len = strlen(timeformat);
+    bool cacheable = format_len < sizeof(cache.format);
+    if (cacheable && cache.valid && cache.second == seconds && 0 == memcmp(cache.format, timeformat, format_len + 1))
+        return cache.text;
+
     //get current date
     char return_time[50];
     struct tm _date;
-    time_t seconds = timestamp / 1000000;
     localtime_r(&seconds, &_date);
     memset(return_time, 0, sizeof(return_time));
     strftime(return_time, sizeof(return_time) - 1, timeformat, &_date);
+    if (cacheable)
+    {
+        memcpy(cache.format, timeformat, format_len + 1);
+        memcpy(cache.text, return_time, sizeof(return_time));
+        cache.second = seconds;
+        cache.valid = true;
+    }
     return return_time;
 }
 
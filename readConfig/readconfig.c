@@ -167,7 +167,7 @@ static void move_variables(struct ast_category *oldCategory, struct ast_category
 struct ast_category *ast_category_new(const char *name) {
     struct ast_category *category;
 
-    category = (struct ast_category *) malloc(sizeof(struct category));
+    category = (struct ast_category *) malloc(sizeof(struct ast_category));
     if (category) {
         memset(category, 0, sizeof(struct ast_category));
         ast_copy_string(category->name, name, sizeof(category->name));
@@ -374,7 +374,7 @@ static struct ast_config *config_text_file_load(const char *filename, struct ast
 #endif
         if (glob_ret == GLOB_NOSPACE)
             warnLog("Glob Expansion of pattern '%s' failed: Not enough memory", fn);
-        else if (glob_ret = GLOB_ABORTED)
+        else if (glob_ret == GLOB_ABORTED)
             warnLog("Glob Expansion of pattern '%s' failed: Read error", fn);
         else {
             // loop over expanded files
@@ -472,7 +472,7 @@ static struct ast_config *config_text_file_load(const char *filename, struct ast
     return config;
 }
 
-struct ast_confog *ast_config_internal_load(const char *filename, struct ast_config *config) {
+struct ast_config *ast_config_internal_load(const char *filename, struct ast_config *config) {
     struct ast_config *result;
     if (config->include_level == config->max_include_level) {
         warnLog("Maximum Include level (%d) exceeded", config->max_include_level);
@@ -93,7 +93,7 @@ void ast_category_append(struct ast_config *config, struct ast_category *categor
 void ast_category_destroy(struct ast_category *category);
 
 struct ast_variable *ast_variable_new(const char *name, const char *value);
-void ast_variable_append(struct ast_category *category, struct ast_varialbe *variable);
+void ast_variable_append(struct ast_category *category, struct ast_variable *variable);
 //int ast_variable_delete(struct ast_config *config, char *category, char *variable, char *value);
 
 void ast_copy_string(char *dst, const char *src, size_t size);